@@ -2,9 +2,12 @@
 #include "HermesBranchSupportPluginSettings.h"
 
 #include <Misc/App.h>
+#include <Misc/ConfigCacheIni.h>
 
 #include "Hermes.h"
 
+DEFINE_LOG_CATEGORY_STATIC(LogHermesBranchSupport, Log, All);
+
 UHermesBranchSupportPluginSettings::UHermesBranchSupportPluginSettings(const FObjectInitializer& ObjectInitializer)
 	: Super(ObjectInitializer)
 {
@@ -26,16 +29,32 @@ UHermesBranchSupportPluginSettings::UHermesBranchSupportPluginSettings(const FOb
 void UHermesBranchSupportPluginSettings::PostInitProperties()
 {
 	Super::PostInitProperties();
+
+#if WITH_EDITOR
+	// The replacements used to be in the editor config, which cooked games don't load. Keep using them until they've
+	// been moved, so that upgrading doesn't quietly change the scheme.
+	const FString Section = GetClass()->GetPathName();
+	if (HasAnyFlags(RF_ClassDefaultObject) && GConfig->DoesSectionExist(*Section, GEditorIni))
+	{
+		LoadConfig(GetClass(), *GEditorIni);
+		UE_LOG(LogHermesBranchSupport, Warning,
+		       TEXT("[%s] should be moved from DefaultEditor.ini to DefaultGame.ini, or game builds won't use it"),
+		       *Section);
+	}
+#endif
+
 	BranchName = FApp::GetBranchName();
 	UpdatePreview();
 }
 
+#if WITH_EDITOR
 void UHermesBranchSupportPluginSettings::PostEditChangeProperty(
 	FPropertyChangedEvent& PropertyChangedEvent)
 {
 	UpdatePreview();
 	Super::PostEditChangeProperty(PropertyChangedEvent);
 }
+#endif
 
 TOptional<FString> UHermesBranchSupportPluginSettings::GetScheme() const
 {
@@ -17,7 +17,8 @@ struct FTokenReplacement
 	FString Replacement;
 };
 
-UCLASS(Config=Editor, DefaultConfig, meta = (DisplayName = "Hermes URLs - Branch Based URLs"))
+/** Kept in the game config rather than the editor's, so that cooked game builds pick the same scheme as the editor */
+UCLASS(Config=Game, DefaultConfig, meta = (DisplayName = "Hermes URLs - Branch Based URLs"))
 class UHermesBranchSupportPluginSettings : public UDeveloperSettings
 {
 	GENERATED_BODY()
@@ -42,7 +43,9 @@ public:
 public:
 	UHermesBranchSupportPluginSettings(const FObjectInitializer& ObjectInitializer);
 	virtual void PostInitProperties() override;
+#if WITH_EDITOR
 	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
 
 	virtual FName GetCategoryName() const override
 	{
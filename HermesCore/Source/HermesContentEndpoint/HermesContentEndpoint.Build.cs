@@ -10,17 +10,23 @@ public class HermesContentEndpoint : ModuleRules
 			{
 				"ApplicationCore",
 				"AssetRegistry",
+				"CollectionManager",
 				"ContentBrowser",
 				"Core",
 				"CoreUObject",
+				"DesktopPlatform",
 				"EditorStyle",
 				"Engine",
 				"HermesServer",
+				"ImageWrapper",
 				"InputCore",
+				"Json",
 				"MainFrame",
+				"MaterialEditor",
 				"Projects",
 				"Slate",
 				"SlateCore",
+				"SourceControl",
 				"ToolMenus",
 				"UnrealEd",
 			}
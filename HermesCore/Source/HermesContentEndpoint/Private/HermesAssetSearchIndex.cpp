@@ -0,0 +1,341 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#include "HermesAssetSearchIndex.h"
+
+#include <Algo/Unique.h>
+#include <AssetRegistry/AssetRegistryModule.h>
+#include <HAL/PlatformTime.h>
+
+#if ENGINE_MAJOR_VERSION >= 5
+typedef FTSTicker FHermesCoreTicker;
+#else
+typedef FTicker FHermesCoreTicker;
+#endif
+
+namespace HermesAssetSearchIndexPrivate
+{
+	/** How many of the query's trigrams an asset needs to contain to be considered a match */
+	static constexpr float MIN_TRIGRAM_MATCH = 0.6f;
+	/** Don't bother compacting until at least this many entries have been removed */
+	static constexpr int32 MIN_REMOVED_TO_COMPACT = 1024;
+	/** How long building the index gets to spend per frame, it goes over by however long a single path takes */
+	static constexpr double BUILD_BUDGET_SECONDS = 0.002;
+
+	/** World Partition maps can have millions of these, and nobody is looking for them by name */
+	static bool IsExternalPackage(const FAssetData& Asset)
+	{
+		const FString PackageName = Asset.PackageName.ToString();
+		return PackageName.Contains(TEXT("/__ExternalActors__/")) || PackageName.Contains(TEXT("/__ExternalObjects__/"));
+	}
+
+	static FString GetSearchText(const FHermesObjectPath& ObjectPath)
+	{
+		return ObjectPath.ToString().ToLower();
+	}
+
+	/** Append the distinct trigrams in Text to OutTrigrams, each one packed into a single integer */
+	static void GetTrigrams(const FString& Text, TArray<uint64>& OutTrigrams)
+	{
+		for (int32 Index = 0; Index + 2 < Text.Len(); ++Index)
+		{
+			OutTrigrams.Add(static_cast<uint64>(static_cast<uint16>(Text[Index])) << 32 |
+				static_cast<uint64>(static_cast<uint16>(Text[Index + 1])) << 16 |
+				static_cast<uint64>(static_cast<uint16>(Text[Index + 2])));
+		}
+
+		OutTrigrams.Sort();
+		OutTrigrams.SetNum(Algo::Unique(OutTrigrams));
+	}
+
+	struct FMatch
+	{
+		int32 EntryIndex;
+		float Score;
+		int32 NameLength;
+	};
+}
+
+void FHermesAssetSearchIndex::Search(const FString& Query, FName ClassName, int32 MaxResults,
+                                     TArray<FHermesObjectPath>& OutResults)
+{
+	using namespace HermesAssetSearchIndexPrivate;
+
+	const double StartTime = FPlatformTime::Seconds();
+	TArray<FString> Terms;
+	Query.ToLower().ParseIntoArrayWS(Terms);
+	if (Terms.Num() == 0)
+	{
+		return;
+	}
+
+	TArray<uint64> QueryTrigrams;
+	for (const FString& Term : Terms)
+	{
+		GetTrigrams(Term, QueryTrigrams);
+	}
+
+	// Count how many of the query's trigrams each asset has, only touching the assets that have at least one
+	TArray<int32> Candidates;
+	HitCounts.Reset();
+	HitCounts.SetNumZeroed(Entries.Num());
+	for (const uint64 Trigram : QueryTrigrams)
+	{
+		if (const TArray<int32>* Posting = Postings.Find(Trigram))
+		{
+			for (const int32 EntryIndex : *Posting)
+			{
+				if (HitCounts[EntryIndex]++ == 0)
+				{
+					Candidates.Add(EntryIndex);
+				}
+			}
+		}
+	}
+
+	// Terms that are too short to have a trigram can only filter, so a query made up of only those has to look at
+	// every asset
+	if (QueryTrigrams.Num() == 0)
+	{
+		for (int32 EntryIndex = 0; EntryIndex < Entries.Num(); ++EntryIndex)
+		{
+			Candidates.Add(EntryIndex);
+		}
+	}
+
+	const int32 MinHits = FMath::Max(1, FMath::CeilToInt(QueryTrigrams.Num() * MIN_TRIGRAM_MATCH));
+	TArray<FMatch> Matches;
+	for (const int32 EntryIndex : Candidates)
+	{
+		const FEntry& Entry = Entries[EntryIndex];
+		if (Entry.bRemoved || (QueryTrigrams.Num() > 0 && HitCounts[EntryIndex] < MinHits) ||
+			(!ClassName.IsNone() && Entry.ClassName != ClassName))
+		{
+			continue;
+		}
+
+		const FString Text = GetSearchText(Entry.ObjectPath);
+		int32 NameStart = 0;
+		Text.FindLastChar(TEXT('.'), NameStart);
+		const FString Name = Text.RightChop(NameStart + 1);
+
+		bool bAllInName = true;
+		bool bAllInPath = true;
+		for (const FString& Term : Terms)
+		{
+			bAllInName = bAllInName && Name.Contains(Term);
+			bAllInPath = bAllInPath && Text.Contains(Term);
+		}
+		if (QueryTrigrams.Num() == 0 && !bAllInPath)
+		{
+			continue;
+		}
+
+		// Mostly rank by how much of the query matched, but prefer assets whose name has every term in it, and then
+		// ones that start with the first term (e.g. "fireball" over "bp_big_fireball_impact")
+		float Score = QueryTrigrams.Num() > 0 ? static_cast<float>(HitCounts[EntryIndex]) / QueryTrigrams.Num() : 1.0f;
+		Score += bAllInName ? 1.0f : bAllInPath ? 0.5f : 0.0f;
+		Score += Name.StartsWith(Terms[0]) ? 0.25f : 0.0f;
+		Matches.Add({EntryIndex, Score, Name.Len()});
+	}
+
+	Matches.Sort([](const FMatch& A, const FMatch& B)
+	{
+		return A.Score != B.Score ? A.Score > B.Score : A.NameLength < B.NameLength;
+	});
+
+	const int32 NumResults = FMath::Min(MaxResults, Matches.Num());
+	OutResults.Reserve(OutResults.Num() + NumResults);
+	for (int32 Index = 0; Index < NumResults; ++Index)
+	{
+		OutResults.Add(Entries[Matches[Index].EntryIndex].ObjectPath);
+	}
+
+	UE_LOG(LogHermesContentEndpoint, Verbose,
+	       TEXT("Searching %d assets for '%s' looked at %d candidates and found %d matches in %.2f ms"),
+	       Num(), *Query, Candidates.Num(), Matches.Num(),
+	       (FPlatformTime::Seconds() - StartTime) * 1000.0);
+}
+
+void FHermesAssetSearchIndex::Add(const FAssetData& Asset)
+{
+	using namespace HermesAssetSearchIndexPrivate;
+
+	// Only index the primary asset of each package, since that's what links point at
+	if (!Asset.IsUAsset() || Asset.IsRedirector() || IsExternalPackage(Asset))
+	{
+		return;
+	}
+
+	const FHermesObjectPath ObjectPath = GetObjectPath(Asset);
+	if (EntryIndices.Contains(ObjectPath))
+	{
+		return;
+	}
+
+	const int32 EntryIndex = Entries.Add({ObjectPath, GetAssetClassName(Asset)});
+	EntryIndices.Add(ObjectPath, EntryIndex);
+	IndexEntry(EntryIndex);
+}
+
+void FHermesAssetSearchIndex::Remove(const FHermesObjectPath& ObjectPath)
+{
+	using namespace HermesAssetSearchIndexPrivate;
+
+	int32 EntryIndex;
+	if (!EntryIndices.RemoveAndCopyValue(ObjectPath, EntryIndex))
+	{
+		return;
+	}
+
+	Entries[EntryIndex].bRemoved = true;
+	++NumRemoved;
+	if (NumRemoved >= MIN_REMOVED_TO_COMPACT && NumRemoved > Entries.Num() / 2)
+	{
+		Compact();
+	}
+}
+
+void FHermesAssetSearchIndex::Reset()
+{
+	if (BuildTickerHandle.IsValid())
+	{
+		FHermesCoreTicker::GetCoreTicker().RemoveTicker(BuildTickerHandle);
+		BuildTickerHandle.Reset();
+	}
+	PathsToIndex.Empty();
+	OnBuilt.Unbind();
+
+	if (IAssetRegistry* AssetRegistry = IAssetRegistry::Get())
+	{
+		AssetRegistry->OnAssetAdded().Remove(AssetAddedDelegateHandle);
+		AssetRegistry->OnAssetRemoved().Remove(AssetRemovedDelegateHandle);
+		AssetRegistry->OnAssetRenamed().Remove(AssetRenamedDelegateHandle);
+	}
+	AssetAddedDelegateHandle.Reset();
+	AssetRemovedDelegateHandle.Reset();
+	AssetRenamedDelegateHandle.Reset();
+
+	bFollowingAssetRegistry = false;
+	Entries.Empty();
+	EntryIndices.Empty();
+	Postings.Empty();
+	HitCounts.Empty();
+	NumRemoved = 0;
+}
+
+void FHermesAssetSearchIndex::FollowAssetRegistry(FSimpleDelegate&& InOnBuilt)
+{
+	if (bFollowingAssetRegistry)
+	{
+		return;
+	}
+
+	IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry").Get();
+
+	// Following the registry from the start means that nothing that changes while we're building is missed. Assets
+	// that show up in both are only indexed once.
+	AssetAddedDelegateHandle = AssetRegistry.OnAssetAdded().AddRaw(this, &FHermesAssetSearchIndex::OnAssetAdded);
+	AssetRemovedDelegateHandle = AssetRegistry.OnAssetRemoved().AddRaw(this, &FHermesAssetSearchIndex::OnAssetRemoved);
+	AssetRenamedDelegateHandle = AssetRegistry.OnAssetRenamed().AddRaw(this, &FHermesAssetSearchIndex::OnAssetRenamed);
+	bFollowingAssetRegistry = true;
+
+	// Getting every asset at once takes seconds in a huge project, but the assets in a single path are cheap to get
+	OnBuilt = MoveTemp(InOnBuilt);
+	BuildStartTime = FPlatformTime::Seconds();
+	BuildSeconds = 0.0;
+	AssetRegistry.GetAllCachedPaths(PathsToIndex);
+	BuildTickerHandle = FHermesCoreTicker::GetCoreTicker().AddTicker(
+		FTickerDelegate::CreateRaw(this, &FHermesAssetSearchIndex::IndexNextPaths));
+}
+
+bool FHermesAssetSearchIndex::IndexNextPaths(float DeltaTime)
+{
+	using namespace HermesAssetSearchIndexPrivate;
+
+	IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry").Get();
+	const double StartTime = FPlatformTime::Seconds();
+	TArray<FAssetData> Assets;
+	while (PathsToIndex.Num() > 0 && FPlatformTime::Seconds() - StartTime < BUILD_BUDGET_SECONDS)
+	{
+		Assets.Reset();
+		AssetRegistry.GetAssetsByPath(FName(*PathsToIndex.Pop()), Assets, /* bRecursive = */ false,
+		                              /* bIncludeOnlyOnDiskAssets = */ true);
+		for (const FAssetData& Asset : Assets)
+		{
+			Add(Asset);
+		}
+	}
+	BuildSeconds += FPlatformTime::Seconds() - StartTime;
+
+	if (PathsToIndex.Num() > 0)
+	{
+		return true;
+	}
+
+	// Returning false removes us from the ticker, which is what IsBuilt goes by
+	BuildTickerHandle.Reset();
+	UE_LOG(LogHermesContentEndpoint, Display,
+	       TEXT("Built a search index of %d assets with %d trigrams in %.2f s, spread over %.2f s"), Num(),
+	       Postings.Num(), BuildSeconds, FPlatformTime::Seconds() - BuildStartTime);
+
+	FSimpleDelegate Callback = MoveTemp(OnBuilt);
+	Callback.ExecuteIfBound();
+	return false;
+}
+
+SIZE_T FHermesAssetSearchIndex::GetAllocatedSize() const
+{
+	SIZE_T Size = Entries.GetAllocatedSize() + EntryIndices.GetAllocatedSize() + Postings.GetAllocatedSize() +
+		HitCounts.GetAllocatedSize();
+	for (const TPair<uint64, TArray<int32>>& Posting : Postings)
+	{
+		Size += Posting.Value.GetAllocatedSize();
+	}
+	return Size;
+}
+
+void FHermesAssetSearchIndex::Compact()
+{
+	TArray<FEntry> OldEntries = MoveTemp(Entries);
+	Entries.Reset(OldEntries.Num() - NumRemoved);
+	EntryIndices.Reset();
+	Postings.Reset();
+	NumRemoved = 0;
+
+	for (FEntry& Entry : OldEntries)
+	{
+		if (!Entry.bRemoved)
+		{
+			const int32 EntryIndex = Entries.Add(MoveTemp(Entry));
+			EntryIndices.Add(Entries[EntryIndex].ObjectPath, EntryIndex);
+			IndexEntry(EntryIndex);
+		}
+	}
+}
+
+void FHermesAssetSearchIndex::IndexEntry(int32 EntryIndex)
+{
+	using namespace HermesAssetSearchIndexPrivate;
+
+	TArray<uint64> Trigrams;
+	GetTrigrams(GetSearchText(Entries[EntryIndex].ObjectPath), Trigrams);
+	for (const uint64 Trigram : Trigrams)
+	{
+		Postings.FindOrAdd(Trigram).Add(EntryIndex);
+	}
+}
+
+void FHermesAssetSearchIndex::OnAssetAdded(const FAssetData& Asset)
+{
+	Add(Asset);
+}
+
+void FHermesAssetSearchIndex::OnAssetRemoved(const FAssetData& Asset)
+{
+	Remove(GetObjectPath(Asset));
+}
+
+void FHermesAssetSearchIndex::OnAssetRenamed(const FAssetData& Asset, const FString& OldObjectPath)
+{
+	Remove(FHermesObjectPath(*OldObjectPath));
+	Add(Asset);
+}
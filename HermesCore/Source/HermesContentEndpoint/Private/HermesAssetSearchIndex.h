@@ -0,0 +1,89 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#pragma once
+
+#include "HermesContentEndpoint.h"
+
+#include <AssetRegistry/AssetData.h>
+#include <Containers/Ticker.h>
+#include <CoreMinimal.h>
+#include <Runtime/Launch/Resources/Version.h>
+
+/**
+ * A trigram index over the object paths of every asset, for finding assets by (part of) their name or path without
+ * scanning the whole asset registry. Matches don't need to contain every trigram of the query, so small typos still
+ * find what was meant.
+ *
+ * The endpoint builds the index once the asset registry has loaded, a few paths per frame, and keeps it up to date from
+ * the asset registry's events after that. It can also be filled by hand, e.g. from a synthetic registry.
+ */
+struct FHermesAssetSearchIndex
+{
+	/**
+	 * Find the assets that best match the whitespace-separated terms in Query, best match first.
+	 *
+	 * @param ClassName only return assets of this class (e.g. "Blueprint"), or NAME_None for any class
+	 */
+	void Search(const FString& Query, FName ClassName, int32 MaxResults, TArray<FHermesObjectPath>& OutResults);
+
+	void Add(const FAssetData& Asset);
+	void Remove(const FHermesObjectPath& ObjectPath);
+
+	/**
+	 * Index every asset in the asset registry, spread over as many frames as it takes, and keep the index up to date
+	 * as assets are added, removed or renamed. OnBuilt is called once the whole registry has been indexed.
+	 */
+	void FollowAssetRegistry(FSimpleDelegate&& OnBuilt = FSimpleDelegate());
+	bool IsFollowingAssetRegistry() const { return bFollowingAssetRegistry; }
+	/** Set once every asset that was in the registry when we started following it has been indexed */
+	bool IsBuilt() const { return bFollowingAssetRegistry && !BuildTickerHandle.IsValid(); }
+
+	/** Stop following the asset registry, and throw away the index */
+	void Reset();
+
+	SIZE_T GetAllocatedSize() const;
+	int32 Num() const { return Entries.Num() - NumRemoved; }
+
+private:
+	struct FEntry
+	{
+		FHermesObjectPath ObjectPath;
+		FName ClassName;
+		bool bRemoved = false;
+	};
+
+	void Compact();
+	void IndexEntry(int32 EntryIndex);
+	/** Index the assets in the next few paths, returns false once every path has been indexed */
+	bool IndexNextPaths(float DeltaTime);
+
+	void OnAssetAdded(const FAssetData& Asset);
+	void OnAssetRemoved(const FAssetData& Asset);
+	void OnAssetRenamed(const FAssetData& Asset, const FString& OldObjectPath);
+
+	bool bFollowingAssetRegistry = false;
+	TArray<FEntry> Entries;
+	TMap<FHermesObjectPath, int32> EntryIndices;
+	/** The entries that contain each trigram, in the order they were added */
+	TMap<uint64, TArray<int32>> Postings;
+	/** Removed entries are left in the postings until there are enough of them to be worth compacting */
+	int32 NumRemoved = 0;
+
+	/** How many of the query's trigrams each entry contains, kept around to avoid reallocating it for every search */
+	TArray<uint16> HitCounts;
+
+	FDelegateHandle AssetAddedDelegateHandle;
+	FDelegateHandle AssetRemovedDelegateHandle;
+	FDelegateHandle AssetRenamedDelegateHandle;
+
+	/** The asset registry paths that haven't been indexed yet, while the index is being built */
+	TArray<FString> PathsToIndex;
+	FSimpleDelegate OnBuilt;
+	double BuildStartTime = 0.0;
+	/** How much of the time since BuildStartTime was spent indexing, the rest of it was spent waiting for frames */
+	double BuildSeconds = 0.0;
+#if ENGINE_MAJOR_VERSION >= 5
+	FTSTicker::FDelegateHandle BuildTickerHandle;
+#else
+	FDelegateHandle BuildTickerHandle;
+#endif
+};
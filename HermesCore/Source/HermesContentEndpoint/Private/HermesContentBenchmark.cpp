@@ -0,0 +1,272 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#include "HermesContentBenchmark.h"
+
+#include "HermesAssetSearchIndex.h"
+#include "HermesContentEndpoint.h"
+#include "HermesContentResolver.h"
+
+#include <AssetRegistry/AssetRegistryState.h>
+#include <HAL/PlatformTime.h>
+#include <Math/RandomStream.h>
+#include <Misc/Paths.h>
+#include <Misc/OutputDevice.h>
+#include <Runtime/Launch/Resources/Version.h>
+#include <UObject/ObjectRedirector.h>
+
+namespace HermesContentBenchmarkPrivate
+{
+	/** How many assets share a directory, which is roughly what a large project looks like */
+	static constexpr int32 ASSETS_PER_DIRECTORY = 256;
+	/** Every Nth asset has been renamed, leaving a redirector behind at its old path */
+	static constexpr int32 RENAMED_STRIDE = 16;
+	/** How many distinct assets the hot requests cycle through, i.e. the handful of assets someone keeps linking to */
+	static constexpr int32 HOT_SET_SIZE = 64;
+	static constexpr int32 RANDOM_SEED = 0x4E524D53;
+	/** Searches look at a lot more than a single package, so they're measured with fewer requests */
+	static constexpr int32 MAX_SEARCH_REQUESTS = 1000;
+
+	static const FName NAME_DestinationObject(TEXT("DestinationObject"));
+
+	enum class ETemperature : uint8
+	{
+		Hot,
+		Cold,
+		Missing,
+		Renamed,
+	};
+
+	static FString GetDirectory(int32 Index)
+	{
+		return FString::Printf(TEXT("/Game/HermesBenchmark/Dir%05d"), Index / ASSETS_PER_DIRECTORY);
+	}
+
+	static FString GetAssetName(int32 Index, bool bRenamed = false)
+	{
+		return FString::Printf(bRenamed ? TEXT("Old_Asset%08d") : TEXT("Asset%08d"), Index);
+	}
+
+	static FAssetData MakeAssetData(const FString& Directory, const FString& AssetName, const UClass* Class,
+	                                FAssetDataTagMap Tags = FAssetDataTagMap())
+	{
+		const FName PackageName(*(Directory / AssetName));
+#if ENGINE_MAJOR_VERSION == 5 && ENGINE_MINOR_VERSION >= 1 || ENGINE_MAJOR_VERSION > 5
+		return FAssetData(PackageName, FName(*Directory), FName(*AssetName), Class->GetClassPathName(),
+		                  MoveTemp(Tags));
+#else
+		return FAssetData(PackageName, FName(*Directory), FName(*AssetName), Class->GetFName(), MoveTemp(Tags));
+#endif
+	}
+
+	static void FillRegistry(FAssetRegistryState& State, int32 NumAssets)
+	{
+		for (int32 Index = 0; Index < NumAssets; ++Index)
+		{
+			const FString Directory = GetDirectory(Index);
+			const FString AssetName = GetAssetName(Index);
+			State.AddAssetData(new FAssetData(MakeAssetData(Directory, AssetName, UObject::StaticClass())));
+
+			if (Index % RENAMED_STRIDE == 0)
+			{
+				FAssetDataTagMap Tags;
+				Tags.Add(NAME_DestinationObject, Directory / AssetName + TEXT(".") + AssetName);
+				State.AddAssetData(new FAssetData(MakeAssetData(Directory, GetAssetName(Index, true),
+				                                                UObjectRedirector::StaticClass(), MoveTemp(Tags))));
+			}
+		}
+	}
+
+	static FString MakePath(ETemperature Temperature, int32 RequestIndex, int32 NumAssets, FRandomStream& Random)
+	{
+		switch (Temperature)
+		{
+			case ETemperature::Hot:
+			{
+				const int32 Index = (RequestIndex % HOT_SET_SIZE) * (NumAssets / HOT_SET_SIZE);
+				return GetDirectory(Index) / GetAssetName(Index);
+			}
+			case ETemperature::Cold:
+			{
+				const int32 Index = Random.RandHelper(NumAssets);
+				return GetDirectory(Index) / GetAssetName(Index);
+			}
+			case ETemperature::Missing:
+			{
+				return FString::Printf(TEXT("/Game/HermesBenchmark/Missing/Asset%08d"), RequestIndex);
+			}
+			case ETemperature::Renamed:
+			{
+				const int32 Index = Random.RandHelper(NumAssets / RENAMED_STRIDE) * RENAMED_STRIDE;
+				return GetDirectory(Index) / GetAssetName(Index, true);
+			}
+		}
+		return FString();
+	}
+
+	static const TCHAR* LexToString(ETemperature Temperature)
+	{
+		switch (Temperature)
+		{
+			case ETemperature::Hot:
+				return TEXT("Hot");
+			case ETemperature::Cold:
+				return TEXT("Cold");
+			case ETemperature::Missing:
+				return TEXT("Missing");
+			case ETemperature::Renamed:
+				return TEXT("Renamed");
+		}
+		return TEXT("Invalid");
+	}
+
+	static void RunScenario(const FAssetRegistryState& State, int32 NumAssets, int32 NumRequests,
+	                        ETemperature Temperature, bool bEdit, FOutputDevice& Ar)
+	{
+		// Build the requests up front, so that we only time the resolution
+		FRandomStream Random(RANDOM_SEED);
+		TArray<TArray<FHermesRequest>> Requests;
+		Requests.SetNum(NumRequests);
+		for (int32 Index = 0; Index < NumRequests; ++Index)
+		{
+			FHermesRequest& Request = Requests[Index].Emplace_GetRef();
+			Request.Path = MakePath(Temperature, Index, NumAssets, Random);
+			if (bEdit)
+			{
+				Request.QueryParams.Add(TEXT("edit"), FString());
+			}
+		}
+
+		auto GetAssetsByPackageName = [&State](FName PackageName, TArray<FAssetData>& OutAssets)
+		{
+			for (const FAssetData* AssetData : State.GetAssetsByPackageName(PackageName))
+			{
+				OutAssets.Add(*AssetData);
+			}
+		};
+
+		TArray<double> Durations;
+		Durations.Reserve(NumRequests);
+		uint64 RetainedBytes = 0;
+		int32 NumResolved = 0;
+		for (const TArray<FHermesRequest>& Request : Requests)
+		{
+			FHermesContentResolution Resolution;
+			const uint64 StartCycles = FPlatformTime::Cycles64();
+			HermesContentResolver::Resolve(Request, GetAssetsByPackageName, Resolution);
+			Durations.Add(FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles) * 1000.0);
+
+			RetainedBytes += Resolution.AssetsToReveal.GetAllocatedSize() + Resolution.AssetsToEdit.GetAllocatedSize();
+			NumResolved += Resolution.AssetsToReveal.Num() > 0 || Resolution.AssetsToEdit.Num() > 0 ? 1 : 0;
+		}
+
+		Durations.Sort();
+		double Total = 0.0;
+		for (const double Duration : Durations)
+		{
+			Total += Duration;
+		}
+
+		Ar.Logf(TEXT("%-8s %-6s %9d %9d %10.2f %10.2f %10.2f %10.2f %12.1f"), LexToString(Temperature),
+		        bEdit ? TEXT("Edit") : TEXT("Reveal"), NumRequests, NumResolved, Total / NumRequests,
+		        Durations[NumRequests / 2], Durations[FMath::Min(NumRequests - 1, NumRequests * 99 / 100)],
+		        Durations.Last(), static_cast<double>(RetainedBytes) / NumRequests);
+	}
+
+	/** Search for an exact name, a name with a typo in it, a name along with its directory, and something missing */
+	static FString MakeSearchQuery(int32 Variant, int32 NumAssets, FRandomStream& Random)
+	{
+		const int32 Index = Random.RandHelper(NumAssets);
+		switch (Variant)
+		{
+			case 0:
+				return GetAssetName(Index);
+			case 1:
+			{
+				FString Name = GetAssetName(Index);
+				Name.RemoveAt(Random.RandHelper(Name.Len()));
+				return Name;
+			}
+			case 2:
+				return FPaths::GetCleanFilename(GetDirectory(Index)) + TEXT(" ") + GetAssetName(Index);
+			default:
+				return TEXT("fireball");
+		}
+	}
+
+	static void RunSearchScenario(int32 NumAssets, int32 NumRequests, FOutputDevice& Ar)
+	{
+		const double BuildStartTime = FPlatformTime::Seconds();
+		FHermesAssetSearchIndex Index;
+		for (int32 AssetIndex = 0; AssetIndex < NumAssets; ++AssetIndex)
+		{
+			Index.Add(MakeAssetData(GetDirectory(AssetIndex), GetAssetName(AssetIndex), UObject::StaticClass()));
+		}
+
+		const SIZE_T IndexSize = Index.GetAllocatedSize();
+		Ar.Logf(TEXT("Built a search index in %.2fs, it takes up %.1f MiB (%.0f bytes per asset)"),
+		        FPlatformTime::Seconds() - BuildStartTime, IndexSize / (1024.0 * 1024.0),
+		        static_cast<double>(IndexSize) / NumAssets);
+
+		FRandomStream Random(RANDOM_SEED);
+		NumRequests = FMath::Min(NumRequests, MAX_SEARCH_REQUESTS);
+		TArray<double> Durations;
+		Durations.Reserve(NumRequests);
+		int32 NumFound = 0;
+		TArray<FHermesObjectPath> Results;
+		for (int32 RequestIndex = 0; RequestIndex < NumRequests; ++RequestIndex)
+		{
+			const FString Query = MakeSearchQuery(RequestIndex % 4, NumAssets, Random);
+			Results.Reset();
+			const uint64 StartCycles = FPlatformTime::Cycles64();
+			Index.Search(Query, NAME_None, 20, Results);
+			Durations.Add(FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles) * 1000.0);
+			NumFound += Results.Num() > 0 ? 1 : 0;
+		}
+
+		Durations.Sort();
+		double Total = 0.0;
+		for (const double Duration : Durations)
+		{
+			Total += Duration;
+		}
+
+		Ar.Logf(TEXT("%-8s %-6s %9d %9d %10.2f %10.2f %10.2f %10.2f"), TEXT("Mixed"), TEXT("Search"), NumRequests,
+		        NumFound, Total / NumRequests, Durations[NumRequests / 2],
+		        Durations[FMath::Min(NumRequests - 1, NumRequests * 99 / 100)], Durations.Last());
+	}
+}
+
+void HermesContentBenchmark::Run(int32 NumAssets, int32 NumRequests, FOutputDevice& Ar)
+{
+	using namespace HermesContentBenchmarkPrivate;
+
+	NumAssets = FMath::Clamp(NumAssets, HOT_SET_SIZE * RENAMED_STRIDE, 10 * 1000 * 1000);
+	NumRequests = FMath::Max(NumRequests, 1);
+
+	Ar.Logf(TEXT("Building a synthetic asset registry with %d assets"), NumAssets);
+	const double BuildStartTime = FPlatformTime::Seconds();
+	FAssetRegistryState State;
+	FillRegistry(State, NumAssets);
+	const double BuildDuration = FPlatformTime::Seconds() - BuildStartTime;
+
+	const SIZE_T StateSize = State.GetAllocatedSize();
+	Ar.Logf(TEXT("Built in %.2fs, the registry state takes up %.1f MiB (%.0f bytes per asset)"), BuildDuration,
+	        StateSize / (1024.0 * 1024.0), static_cast<double>(StateSize) / NumAssets);
+
+	// Every missing request logs an error, which would drown out both the log and the measurements
+	const ELogVerbosity::Type PreviousVerbosity = LogHermesContentEndpoint.GetVerbosity();
+	LogHermesContentEndpoint.SetVerbosity(ELogVerbosity::Fatal);
+
+	Ar.Logf(TEXT("%-8s %-6s %9s %9s %10s %10s %10s %10s %12s"), TEXT("Assets"), TEXT("Action"), TEXT("Requests"),
+	        TEXT("Resolved"), TEXT("Mean (us)"), TEXT("p50 (us)"), TEXT("p99 (us)"), TEXT("Max (us)"),
+	        TEXT("Bytes/req"));
+	for (const ETemperature Temperature : {
+		     ETemperature::Hot, ETemperature::Cold, ETemperature::Missing, ETemperature::Renamed
+	     })
+	{
+		RunScenario(State, NumAssets, NumRequests, Temperature, false, Ar);
+		RunScenario(State, NumAssets, NumRequests, Temperature, true, Ar);
+	}
+	RunSearchScenario(NumAssets, NumRequests, Ar);
+
+	LogHermesContentEndpoint.SetVerbosity(PreviousVerbosity);
+}
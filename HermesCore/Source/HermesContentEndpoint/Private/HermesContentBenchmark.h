@@ -0,0 +1,20 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#pragma once
+
+#include <CoreMinimal.h>
+
+class FOutputDevice;
+
+namespace HermesContentBenchmark
+{
+	/**
+	 * Fill an in-memory asset registry state with synthetic assets, and measure how long it takes to resolve reveal &
+	 * edit requests for hot, cold, missing and renamed assets, and how much memory each resolution holds on to. Also
+	 * measures how long it takes to build & search the asset search index over the same assets.
+	 *
+	 * This only covers resolving requests (see HermesContentResolver), not syncing the content browser or opening
+	 * editors, since the synthetic assets don't exist on disk. The Hermes.Content.Benchmark.RequestPath automation test
+	 * measures the whole path against real assets.
+	 */
+	void Run(int32 NumAssets, int32 NumRequests, FOutputDevice& Ar);
+}
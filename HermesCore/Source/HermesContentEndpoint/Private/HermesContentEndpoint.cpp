@@ -1,71 +1,156 @@
 // Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
 #include "HermesContentEndpoint.h"
 
+#include "HermesAssetSearchIndex.h"
+#include "HermesContentBenchmark.h"
 #include "HermesContentEndpointEditorExtension.h"
+#include "HermesContentResolver.h"
+#include "HermesGraphAnchors.h"
+#include "HermesLinkIndexExporter.h"
+#include "HermesPreviewCache.h"
 
 #include <AssetRegistry/AssetRegistryModule.h>
+#include <CollectionManagerModule.h>
 #include <ContentBrowserModule.h>
 #include <CoreMinimal.h>
 #include <Editor.h>
+#include <HAL/IConsoleManager.h>
 #include <HermesServer.h>
+#include <ICollectionManager.h>
 #include <IContentBrowserSingleton.h>
 #include <Interfaces/IMainFrameModule.h>
+#include <Misc/PackageName.h>
 #include <Subsystems/AssetEditorSubsystem.h>
 
 #define LOCTEXT_NAMESPACE "Editor.HermesContentEndpoint"
 
-DEFINE_LOG_CATEGORY_STATIC(LogHermesContentEndpoint, Log, All);
+DEFINE_LOG_CATEGORY(LogHermesContentEndpoint);
 
 const FName NAME_EndpointId(TEXT("content"));
+const FName NAME_CollectionEndpointId(TEXT("collection"));
+const FName NAME_PreviewEndpointId(TEXT("preview"));
+const FName NAME_SearchEndpointId(TEXT("search"));
 
-struct FPendingRequest
-{
-	FString Path;
-	FHermesQueryParamsMap Query;
-};
+// How many packages a single link can add to the prefetch, including the ones it depends on
+static constexpr int32 MAX_PREFETCH_PACKAGES_PER_LINK = 256;
 
 struct FHermesContentEndpointModule : IModuleInterface
 {
 	virtual void StartupModule() override final;
 	virtual void ShutdownModule() override final;
 
+	/** Make sure OnAssetRegistryFilesLoaded is called once the asset registry has finished loading */
+	void WaitForAssetRegistry(IAssetRegistry& AssetRegistry);
 	void OnAssetRegistryFilesLoaded();
-	void OnRequest(const FString& Path, const FHermesQueryParamsMap& QueryParams);
+	void OnSearchIndexBuilt();
+	void OnRequests(const TArray<FHermesRequest>& Requests);
+	void OnCollectionRequest(const FString& Path, const FHermesQueryParamsMap& QueryParams);
+	void OnPreviewRequest(const FString& Path, const FHermesQueryParamsMap& QueryParams);
+	void OnSearchRequest(const FString& Path, const FHermesQueryParamsMap& QueryParams);
+	void OnPrefetch(const FHermesRequest& Request, TArray<FString>& OutFilenames);
 
-	TArray<FPendingRequest> PendingRequests;
+	static void BringMainFrameToFront();
+
+	TArray<FHermesRequest> PendingRequests;
+	/** Packages to refresh previews for once the asset registry has loaded */
+	TArray<FName> PendingPreviews;
+	/** Searches that arrived before the search index was built, as their path and query parameters */
+	TArray<TPair<FString, FHermesQueryParamsMap>> PendingSearches;
 	FDelegateHandle AssetRegistryLoadedDelegateHandle;
+	TArray<IConsoleObject*> ConsoleCommands;
 	FHermesContentEndpointEditorExtension EditorExtension;
+	FHermesGraphAnchorIndex GraphAnchors;
+	FHermesPreviewCache PreviewCache;
+	FHermesAssetSearchIndex SearchIndex;
 };
 
 IMPLEMENT_MODULE(FHermesContentEndpointModule, HermesContentEndpoint);
 
 void FHermesContentEndpointModule::StartupModule()
 {
+	const double StartTime = FPlatformTime::Seconds();
+
 	// Register a "post-loading" callback if the asset registry is currently loading
 	IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry").Get();
 	if (AssetRegistry.IsLoadingAssets())
 	{
-		UE_LOG(LogHermesContentEndpoint, Verbose,
-		       TEXT("Asset registry is currently loading, setting up callback for when it finishes"));
-		AssetRegistryLoadedDelegateHandle = AssetRegistry.OnFilesLoaded().AddRaw(
-			this, &FHermesContentEndpointModule::OnAssetRegistryFilesLoaded);
+		WaitForAssetRegistry(AssetRegistry);
 	}
+	else
+	{
+		SearchIndex.FollowAssetRegistry(
+			FSimpleDelegate::CreateRaw(this, &FHermesContentEndpointModule::OnSearchIndexBuilt));
+	}
+
+	// These endpoints sync the content browser or open editors and bring the main frame to the front, which hitches
+	// and steals focus from a running game
+	FHermesEndpointOptions Options;
+	Options.bDeferDuringPIE = true;
+
+	// Content links are the ones that are slow to open from a cold file cache, so they're the ones worth prefetching
+	FHermesEndpointOptions ContentOptions = Options;
+	ContentOptions.Prefetch.BindRaw(this, &FHermesContentEndpointModule::OnPrefetch);
 
 	IHermesServerModule& Hermes = FModuleManager::LoadModuleChecked<IHermesServerModule>("HermesServer");
-	Hermes.Register(NAME_EndpointId, FHermesOnRequest::CreateRaw(this, &FHermesContentEndpointModule::OnRequest));
+	Hermes.RegisterCoalescing(NAME_EndpointId,
+	                          FHermesOnCoalescedRequests::CreateRaw(this, &FHermesContentEndpointModule::OnRequests),
+	                          ContentOptions);
+	Hermes.Register(NAME_CollectionEndpointId,
+	                FHermesOnRequest::CreateRaw(this, &FHermesContentEndpointModule::OnCollectionRequest), Options);
+	Hermes.Register(NAME_SearchEndpointId,
+	                FHermesOnRequest::CreateRaw(this, &FHermesContentEndpointModule::OnSearchRequest), Options);
+	// Previews only write to the cache, so they're fine to handle while playing
+	Hermes.Register(NAME_PreviewEndpointId,
+	                FHermesOnRequest::CreateRaw(this, &FHermesContentEndpointModule::OnPreviewRequest));
+	PreviewCache.Install();
 
 	EditorExtension.InstallContentBrowserExtension();
 	EditorExtension.InstallAssetEditorExtension();
+
+	ConsoleCommands.Add(IConsoleManager::Get().RegisterConsoleCommand(
+		TEXT("Hermes.Content.Benchmark"),
+		TEXT(
+			"Measure how long content links take to resolve against a synthetic asset registry. Only covers resolving, see the Hermes.Content.Benchmark.RequestPath automation test for the whole request path. Usage: Hermes.Content.Benchmark [NumAssets=100000] [NumRequests=10000]"),
+		FConsoleCommandWithArgsAndOutputDeviceDelegate::CreateLambda(
+			[](const TArray<FString>& Args, FOutputDevice& Ar)
+			{
+				HermesContentBenchmark::Run(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 100000,
+				                            Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 10000, Ar);
+			})));
+	ConsoleCommands.Add(IConsoleManager::Get().RegisterConsoleCommand(
+		TEXT("Hermes.Content.ExportIndex"),
+		TEXT(
+			"Write a link index that Tools/HermesLinkResolver can resolve content links against without running the editor. Usage: Hermes.Content.ExportIndex [Filename]"),
+		FConsoleCommandWithArgsAndOutputDeviceDelegate::CreateLambda(
+			[](const TArray<FString>& Args, FOutputDevice& Ar)
+			{
+				HermesLinkIndex::Export(Args.Num() > 0 ? Args[0] : HermesLinkIndex::GetDefaultFilename(), Ar);
+			})));
+
+	Hermes.ReportStartupCost(TEXT("HermesContentEndpoint.StartupModule"), FPlatformTime::Seconds() - StartTime);
 }
 
 void FHermesContentEndpointModule::ShutdownModule()
 {
+	for (IConsoleObject* Command : ConsoleCommands)
+	{
+		IConsoleManager::Get().UnregisterConsoleObject(Command);
+	}
+	ConsoleCommands.Reset();
+
 	EditorExtension.UninstallAssetEditorExtension();
 	EditorExtension.UninstallContentBrowserExtension();
+	GraphAnchors.Reset();
+	PreviewCache.Uninstall();
+	SearchIndex.Reset();
+	PendingSearches.Reset();
 
 	if (auto Hermes = FModuleManager::GetModulePtr<IHermesServerModule>("HermesServer"))
 	{
 		Hermes->Unregister(NAME_EndpointId);
+		Hermes->Unregister(NAME_CollectionEndpointId);
+		Hermes->Unregister(NAME_PreviewEndpointId);
+		Hermes->Unregister(NAME_SearchEndpointId);
 	}
 
 	if (AssetRegistryLoadedDelegateHandle.IsValid())
@@ -79,64 +164,284 @@ void FHermesContentEndpointModule::ShutdownModule()
 	}
 }
 
+void FHermesContentEndpointModule::WaitForAssetRegistry(IAssetRegistry& AssetRegistry)
+{
+	if (!AssetRegistryLoadedDelegateHandle.IsValid())
+	{
+		UE_LOG(LogHermesContentEndpoint, Verbose,
+		       TEXT("Asset registry is currently loading, setting up callback for when it finishes"));
+		AssetRegistryLoadedDelegateHandle = AssetRegistry.OnFilesLoaded().AddRaw(
+			this, &FHermesContentEndpointModule::OnAssetRegistryFilesLoaded);
+	}
+}
+
 void FHermesContentEndpointModule::OnAssetRegistryFilesLoaded()
 {
-	UE_LOG(LogHermesContentEndpoint, Verbose, TEXT("Finished loading asset registry, processing %d pending requests"),
-	       PendingRequests.Num());
+	UE_LOG(LogHermesContentEndpoint, Verbose,
+	       TEXT("Finished loading asset registry, processing %d pending requests and %d pending previews"),
+	       PendingRequests.Num(), PendingPreviews.Num());
 
+	if (IAssetRegistry* AssetRegistry = IAssetRegistry::Get())
+	{
+		AssetRegistry->OnFilesLoaded().Remove(AssetRegistryLoadedDelegateHandle);
+	}
 	AssetRegistryLoadedDelegateHandle.Reset();
 
 	// Process any requests that came in while we were loading
-	TArray<FPendingRequest> Requests(MoveTemp(PendingRequests));
-	for (const FPendingRequest& Request : Requests)
+	const TArray<FHermesRequest> Requests(MoveTemp(PendingRequests));
+	if (Requests.Num() > 0)
+	{
+		OnRequests(Requests);
+	}
+
+	for (const FName PackageName : TArray<FName>(MoveTemp(PendingPreviews)))
 	{
-		OnRequest(Request.Path, Request.Query);
+		OnPreviewRequest(PackageName.ToString(), FHermesQueryParamsMap());
+	}
+
+	// Searches keep waiting until the index has been built, which takes a few frames once we start it here
+	SearchIndex.FollowAssetRegistry(
+		FSimpleDelegate::CreateRaw(this, &FHermesContentEndpointModule::OnSearchIndexBuilt));
+	if (SearchIndex.IsBuilt())
+	{
+		OnSearchIndexBuilt();
+	}
+}
+
+void FHermesContentEndpointModule::OnSearchIndexBuilt()
+{
+	const TArray<TPair<FString, FHermesQueryParamsMap>> Searches(MoveTemp(PendingSearches));
+	for (const TPair<FString, FHermesQueryParamsMap>& Search : Searches)
+	{
+		OnSearchRequest(Search.Key, Search.Value);
 	}
 }
 
-void FHermesContentEndpointModule::OnRequest(const FString& Path, const FHermesQueryParamsMap& QueryParams)
+void FHermesContentEndpointModule::OnRequests(const TArray<FHermesRequest>& Requests)
 {
-	// If the asset registry is still loading assets, put this in the queue for when it's done
+	// If the asset registry is still loading assets, put these in the queue for when it's done
 	IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry").Get();
 	if (AssetRegistry.IsLoadingAssets())
 	{
 		UE_LOG(LogHermesContentEndpoint, Verbose,
-		       TEXT("Received request for %s while loading asset registry, putting in queue"), *Path);
-		FPendingRequest& Request = PendingRequests.AddDefaulted_GetRef();
-		Request.Path = Path;
-		Request.Query = QueryParams;
+		       TEXT("Received %d request(s) while loading asset registry, putting in queue"), Requests.Num());
+		PendingRequests.Append(Requests);
+		WaitForAssetRegistry(AssetRegistry);
 		return;
 	}
 
-	TArray<FAssetData> AssetData;
-	AssetRegistry.GetAssetsByPackageName(*Path, AssetData);
-	if (AssetData.Num() > 0)
+	// Requests are coalesced, so gather up everything we need to do and do it all at once rather than thrashing the
+	// content browser & window focus once per request.
+	FHermesContentResolution Resolution;
+	HermesContentResolver::Resolve(Requests, [&AssetRegistry](FName PackageName, TArray<FAssetData>& OutAssets)
 	{
-		// Since this is a valid asset, either open it or edit it
-		const bool bShouldEdit = QueryParams.Contains("edit");
-		if (bShouldEdit)
+		AssetRegistry.GetAssetsByPackageName(PackageName, OutAssets);
+	}, Resolution);
+
+	if (Resolution.MapsToOpen.Num() > 0)
+	{
+		// Only one map can be open at a time, so the most recent link wins
+		if (Resolution.MapsToOpen.Num() > 1)
 		{
-			UE_LOG(LogHermesContentEndpoint, Verbose, TEXT("Opening %s for editing"), *Path);
-			UAssetEditorSubsystem* AssetEditorSubsystem = GEditor->GetEditorSubsystem<UAssetEditorSubsystem>();
-			AssetEditorSubsystem->OpenEditorForAsset(AssetData[0].GetAsset());
+			UE_LOG(LogHermesContentEndpoint, Warning,
+			       TEXT("Received %d links into maps at once, only opening the last one"), Resolution.MapsToOpen.Num());
 		}
-		else
+		HermesMapLinks::Open(Resolution.MapsToOpen.Last());
+	}
+
+	if (Resolution.AssetsToReveal.Num() > 0)
+	{
+		IContentBrowserSingleton& ContentBrowser = FModuleManager::LoadModuleChecked<FContentBrowserModule>(
+			"ContentBrowser").Get();
+
+		const bool bAllowLockedBrowsers = false;
+		const bool bFocusContentBrowser = true;
+		ContentBrowser.SyncBrowserToAssets(Resolution.AssetsToReveal, bAllowLockedBrowsers, bFocusContentBrowser);
+	}
+
+	if (Resolution.AssetsToEdit.Num() > 0)
+	{
+		UAssetEditorSubsystem* AssetEditorSubsystem = GEditor->GetEditorSubsystem<UAssetEditorSubsystem>();
+		for (const FAssetData& Asset : Resolution.AssetsToEdit)
+		{
+			AssetEditorSubsystem->OpenEditorForAsset(Asset.GetAsset());
+		}
+	}
+
+	for (const TPair<FAssetData, FGuid>& Anchor : Resolution.AnchorsToFocus)
+	{
+		if (!GraphAnchors.Focus(Anchor.Key.GetAsset(), Anchor.Value))
 		{
-			UE_LOG(LogHermesContentEndpoint, Verbose, TEXT("Focusing %s in content browser"), *Path);
+			UE_LOG(LogHermesContentEndpoint, Error, TEXT("Couldn't find a node with the GUID %s in %s"),
+			       *Anchor.Value.ToString(), *Anchor.Key.PackageName.ToString());
+		}
+	}
+
+	BringMainFrameToFront();
+}
 
-			IContentBrowserSingleton& ContentBrowser = FModuleManager::LoadModuleChecked<FContentBrowserModule>(
-				"ContentBrowser").Get();
+void FHermesContentEndpointModule::OnPrefetch(const FHermesRequest& Request, TArray<FString>& OutFilenames)
+{
+	IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry").Get();
+	FHermesContentResolution Resolution;
+	HermesContentResolver::Resolve({Request}, [&AssetRegistry](FName PackageName, TArray<FAssetData>& OutAssets)
+	{
+		AssetRegistry.GetAssetsByPackageName(PackageName, OutAssets);
+	}, Resolution);
 
-			const bool bAllowLockedBrowsers = false;
-			const bool bFocusContentBrowser = true;
-			ContentBrowser.SyncBrowserToAssets(AssetData, bAllowLockedBrowsers, bFocusContentBrowser);
+	TArray<FName> Packages;
+	for (const FAssetData& Asset : Resolution.AssetsToEdit)
+	{
+		Packages.AddUnique(Asset.PackageName);
+	}
+	for (const FHermesMapLink& Link : Resolution.MapsToOpen)
+	{
+		Packages.AddUnique(Link.Map.PackageName);
+	}
+	for (const FAssetData& Asset : Resolution.AssetsToReveal)
+	{
+		Packages.AddUnique(Asset.PackageName);
+	}
+
+	// Opening an asset loads everything it hard references, so that's read from disk too. Walked breadth first, so that
+	// the cap cuts off what's furthest away.
+	for (int32 Index = 0; Index < Packages.Num() && Packages.Num() < MAX_PREFETCH_PACKAGES_PER_LINK; ++Index)
+	{
+		TArray<FName> Dependencies;
+		AssetRegistry.GetDependencies(Packages[Index], Dependencies, UE::AssetRegistry::EDependencyCategory::Package,
+		                              UE::AssetRegistry::EDependencyQuery::Hard);
+		for (FName Dependency : Dependencies)
+		{
+			if (Packages.Num() >= MAX_PREFETCH_PACKAGES_PER_LINK)
+			{
+				break;
+			}
+			if (!FPackageName::IsScriptPackage(Dependency.ToString()))
+			{
+				Packages.AddUnique(Dependency);
+			}
 		}
 	}
-	else
+
+	// The registry doesn't say which extension a package has, and checking means touching the disk on the game thread,
+	// so both are handed over and the prefetcher skips the one that doesn't exist
+	for (FName PackageName : Packages)
+	{
+		FString Filename;
+		if (FPackageName::TryConvertLongPackageNameToFilename(PackageName.ToString(), Filename))
+		{
+			OutFilenames.Add(Filename + FPackageName::GetAssetPackageExtension());
+			OutFilenames.Add(Filename + FPackageName::GetMapPackageExtension());
+		}
+	}
+}
+
+void FHermesContentEndpointModule::OnCollectionRequest(const FString& Path, const FHermesQueryParamsMap& QueryParams)
+{
+	FString CollectionName = Path;
+	CollectionName.RemoveFromStart(TEXT("/"));
+
+	ICollectionManager& CollectionManager = FCollectionManagerModule::GetModule().Get();
+	TArray<FHermesObjectPath> ObjectPaths;
+	if (!CollectionManager.GetAssetsInCollection(FName(*CollectionName), ECollectionShareType::CST_All, ObjectPaths))
+	{
+		UE_LOG(LogHermesContentEndpoint, Error, TEXT("Couldn't find the collection %s"), *CollectionName);
+		return;
+	}
+
+	// Reveal the collection's assets just like a batch of content links, which also takes care of waiting for the
+	// asset registry if it's still loading
+	TArray<FHermesRequest> Requests;
+	Requests.Reserve(ObjectPaths.Num());
+	for (const FHermesObjectPath& ObjectPath : ObjectPaths)
+	{
+		Requests.Emplace_GetRef().Path = FPackageName::ObjectPathToPackageName(ObjectPath.ToString());
+	}
+	OnRequests(Requests);
+}
+
+void FHermesContentEndpointModule::OnPreviewRequest(const FString& Path, const FHermesQueryParamsMap& QueryParams)
+{
+	IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry").Get();
+	if (AssetRegistry.IsLoadingAssets())
+	{
+		UE_LOG(LogHermesContentEndpoint, Verbose,
+		       TEXT("Received preview for %s while loading asset registry, putting in queue"), *Path);
+		PendingPreviews.AddUnique(FName(*Path));
+		WaitForAssetRegistry(AssetRegistry);
+		return;
+	}
+
+	if (!PreviewCache.Refresh(FName(*Path)))
 	{
 		UE_LOG(LogHermesContentEndpoint, Error, TEXT("Couldn't find any assets for %s"), *Path);
 	}
+}
+
+void FHermesContentEndpointModule::OnSearchRequest(const FString& Path, const FHermesQueryParamsMap& QueryParams)
+{
+	// Accept both search?q=fireball and search/fireball
+	const FString* QueryParam = QueryParams.Find(TEXT("q"));
+	FString Query = QueryParam != nullptr ? *QueryParam : Path;
+	Query.RemoveFromStart(TEXT("/"));
+	if (Query.IsEmpty())
+	{
+		UE_LOG(LogHermesContentEndpoint, Error, TEXT("Search request without a query"));
+		return;
+	}
 
+	IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry").Get();
+	if (AssetRegistry.IsLoadingAssets() || !SearchIndex.IsBuilt())
+	{
+		UE_LOG(LogHermesContentEndpoint, Verbose,
+		       TEXT("Received search for '%s' while building the search index, putting in queue"), *Query);
+		PendingSearches.Emplace(Path, QueryParams);
+		if (AssetRegistry.IsLoadingAssets())
+		{
+			WaitForAssetRegistry(AssetRegistry);
+		}
+		else
+		{
+			SearchIndex.FollowAssetRegistry(
+				FSimpleDelegate::CreateRaw(this, &FHermesContentEndpointModule::OnSearchIndexBuilt));
+		}
+		return;
+	}
+
+	const FString* ClassParam = QueryParams.Find(TEXT("class"));
+	const FString* LimitParam = QueryParams.Find(TEXT("limit"));
+	const FName ClassName = ClassParam != nullptr ? FName(**ClassParam) : NAME_None;
+	const int32 MaxResults = LimitParam != nullptr ? FMath::Max(1, FCString::Atoi(**LimitParam)) : 20;
+
+	TArray<FHermesObjectPath> ObjectPaths;
+	SearchIndex.Search(Query, ClassName, MaxResults, ObjectPaths);
+	if (ObjectPaths.Num() == 0)
+	{
+		UE_LOG(LogHermesContentEndpoint, Warning, TEXT("Couldn't find any assets matching '%s'"), *Query);
+		return;
+	}
+
+	TArray<FAssetData> Assets;
+	Assets.Reserve(ObjectPaths.Num());
+	for (const FHermesObjectPath& ObjectPath : ObjectPaths)
+	{
+		const FAssetData Asset = AssetRegistry.GetAssetByObjectPath(ObjectPath);
+		if (Asset.IsValid())
+		{
+			Assets.Add(Asset);
+		}
+	}
+
+	IContentBrowserSingleton& ContentBrowser = FModuleManager::LoadModuleChecked<FContentBrowserModule>(
+		"ContentBrowser").Get();
+	const bool bAllowLockedBrowsers = false;
+	const bool bFocusContentBrowser = true;
+	ContentBrowser.SyncBrowserToAssets(Assets, bAllowLockedBrowsers, bFocusContentBrowser);
+	BringMainFrameToFront();
+}
+
+void FHermesContentEndpointModule::BringMainFrameToFront()
+{
 	IMainFrameModule& MainFrameModule = IMainFrameModule::Get();
 	TSharedPtr<SWindow> ParentWindow = MainFrameModule.GetParentWindow();
 	if (ParentWindow.IsValid())
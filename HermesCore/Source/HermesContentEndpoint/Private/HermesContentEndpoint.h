@@ -1,6 +1,42 @@
 ﻿// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
 #pragma once
 
+#include <AssetRegistry/AssetData.h>
 #include <CoreMinimal.h>
+#include <Runtime/Launch/Resources/Version.h>
+
+DECLARE_LOG_CATEGORY_EXTERN(LogHermesContentEndpoint, Log, All);
 
 extern const FName NAME_EndpointId;
+extern const FName NAME_CollectionEndpointId;
+extern const FName NAME_PreviewEndpointId;
+extern const FName NAME_SearchEndpointId;
+
+// Collections and the asset registry identify assets by FSoftObjectPath since 5.1, and by FName before that
+#if ENGINE_MAJOR_VERSION == 5 && ENGINE_MINOR_VERSION >= 1 || ENGINE_MAJOR_VERSION > 5
+typedef FSoftObjectPath FHermesObjectPath;
+
+inline FHermesObjectPath GetObjectPath(const FAssetData& Asset)
+{
+	return Asset.GetSoftObjectPath();
+}
+
+/** The short name of the asset's class, e.g. "World" */
+inline FName GetAssetClassName(const FAssetData& Asset)
+{
+	return Asset.AssetClassPath.GetAssetName();
+}
+#else
+typedef FName FHermesObjectPath;
+
+inline FHermesObjectPath GetObjectPath(const FAssetData& Asset)
+{
+	return Asset.ObjectPath;
+}
+
+/** The short name of the asset's class, e.g. "World" */
+inline FName GetAssetClassName(const FAssetData& Asset)
+{
+	return Asset.AssetClass;
+}
+#endif
@@ -2,11 +2,21 @@
 #include "HermesContentEndpointEditorExtension.h"
 
 #include "HermesContentEndpoint.h"
+#include "HermesLinkExport.h"
 
+#include <CollectionManagerModule.h>
+#include <DesktopPlatformModule.h>
+#include <Framework/Application/SlateApplication.h>
 #include <Framework/Commands/Commands.h>
+#include <Framework/Notifications/NotificationManager.h>
 #include <HAL/PlatformApplicationMisc.h>
+#include <HAL/PlatformTime.h>
 #include <HermesServer.h>
+#include <ICollectionManager.h>
+#include <IDesktopPlatform.h>
+#include <ISourceControlModule.h>
 #include <Interfaces/IPluginManager.h>
+#include <Misc/SecureHash.h>
 #include <Runtime/Launch/Resources/Version.h>
 #include <Styling/CoreStyle.h>
 #include <Styling/SlateStyle.h>
@@ -14,11 +24,15 @@
 #include <ToolMenus.h>
 #include <Toolkits/AssetEditorToolkit.h>
 #include <Toolkits/AssetEditorToolkitMenuContext.h>
+#include <Widgets/Notifications/SNotificationList.h>
 
 #define LOCTEXT_NAMESPACE "Editor.HermesContentEndpointEditorExtension"
 
 static const FName HermesContentEndpointStyleSetName("HermesContentEndpointStyle");
 
+/** Beyond this many links, the clipboard isn't a useful place to put them -- export them or use a collection instead */
+static constexpr int32 MAX_CLIPBOARD_URLS = 1000;
+
 struct FHermesContentEndpointEditorCommands : public TCommands<FHermesContentEndpointEditorCommands>
 {
 	FHermesContentEndpointEditorCommands();
@@ -29,6 +43,12 @@ struct FHermesContentEndpointEditorCommands : public TCommands<FHermesContentEnd
 
 	// Copies an URL to edit the given asset
 	TSharedPtr<FUICommandInfo> CopyEditURL;
+
+	// Copies a single URL that reveals a collection of the given assets
+	TSharedPtr<FUICommandInfo> CopyCollectionURL;
+
+	// Writes the URLs for the given assets to a file
+	TSharedPtr<FUICommandInfo> ExportURLs;
 };
 
 FHermesContentEndpointEditorCommands::FHermesContentEndpointEditorCommands()
@@ -47,6 +67,12 @@ void FHermesContentEndpointEditorCommands::RegisterCommands()
 	           EUserInterfaceActionType::Button, FInputChord(EModifierKey::Alt | EModifierKey::Shift, EKeys::C));
 	UI_COMMAND(CopyEditURL, "Copy URL that opens asset", "Copy an URL that'll open this asset for editing.",
 	           EUserInterfaceActionType::Button, FInputChord(EModifierKey::Alt | EModifierKey::Shift, EKeys::E));
+	UI_COMMAND(CopyCollectionURL, "Copy URL that reveals selection as a collection",
+	           "Add the selected assets to a shared collection, and copy a single URL that'll reveal all of them in the content browser.",
+	           EUserInterfaceActionType::Button, FInputChord());
+	UI_COMMAND(ExportURLs, "Export URLs to file...",
+	           "Write URLs that'll reveal the selected assets to a text, CSV or JSON file.",
+	           EUserInterfaceActionType::Button, FInputChord());
 }
 
 void FHermesContentEndpointEditorExtension::CopyEndpointURLsToClipboard(TArray<FName> Packages,
@@ -57,34 +83,163 @@ void FHermesContentEndpointEditorExtension::CopyEndpointURLsToClipboard(TArray<F
 		return;
 	}
 
+	if (Packages.Num() > MAX_CLIPBOARD_URLS)
+	{
+		FNotificationInfo Info(FText::Format(
+			LOCTEXT("TooManyURLs",
+			        "{0} URLs are too many for the clipboard, use \"Export URLs to file\" or \"Copy URL that reveals selection as a collection\" instead"),
+			FText::AsNumber(Packages.Num())));
+		Info.ExpireDuration = 8.0f;
+		FSlateNotificationManager::Get().AddNotification(Info);
+		return;
+	}
+
 	IHermesServerModule& Hermes = FModuleManager::LoadModuleChecked<IHermesServerModule>("HermesServer");
 
-	// Get the URL for each package and concatenate them with newlines in between
+	// Get the URL for each package and join them with newlines, formatting the scheme & endpoint only once
+	const FString EndpointUrl = Hermes.GetUri(NAME_EndpointId);
 	FString ClipboardText;
-	for (const FName& Package : Packages)
+	ClipboardText.Reserve(Packages.Num() * (EndpointUrl.Len() + 64));
+	for (int32 Index = 0; Index < Packages.Num(); ++Index)
 	{
-		ClipboardText += Hermes.GetUri(NAME_EndpointId, *Package.ToString());
-		if (OptionalSuffix)
+		if (Index > 0)
 		{
-			ClipboardText += OptionalSuffix;
+			ClipboardText += LINE_TERMINATOR;
 		}
-		ClipboardText += LINE_TERMINATOR;
+		HermesLinkExport::AppendUrl(ClipboardText, EndpointUrl, Packages[Index], OptionalSuffix);
 	}
 
-	// Strip the final newline
-	const int32 LineTerminatorLen = FCString::Strlen(LINE_TERMINATOR);
-	checkf(ClipboardText.EndsWith(LINE_TERMINATOR), TEXT("There should always be at least one line terminator!"));
-#if ENGINE_MAJOR_VERSION == 5 && ENGINE_MINOR_VERSION >= 5 || ENGINE_MAJOR_VERSION > 5
-	ClipboardText.RemoveAt(ClipboardText.Len() - LineTerminatorLen, LineTerminatorLen, EAllowShrinking::No);
-#else
-	ClipboardText.RemoveAt(ClipboardText.Len() - LineTerminatorLen, LineTerminatorLen, false);
-#endif
-
 	FPlatformApplicationMisc::ClipboardCopy(*ClipboardText);
 }
 
-void FHermesContentEndpointEditorExtension::InstallContentBrowserExtension()
+void FHermesContentEndpointEditorExtension::CopyCollectionURLToClipboard(const TArray<FAssetData>& Assets)
 {
+	TSet<FHermesObjectPath> UniqueObjectPaths;
+	UniqueObjectPaths.Reserve(Assets.Num());
+	for (const FAssetData& Asset : Assets)
+	{
+		UniqueObjectPaths.Add(GetObjectPath(Asset));
+	}
+	if (UniqueObjectPaths.Num() == 0)
+	{
+		return;
+	}
+
+	// Name the collection after a hash of its contents, so that copying the same selection again reuses the same
+	// collection. The paths are sorted first, since the order they were selected in doesn't matter.
+	TArray<FString> SortedPaths;
+	SortedPaths.Reserve(UniqueObjectPaths.Num());
+	for (const FHermesObjectPath& ObjectPath : UniqueObjectPaths)
+	{
+		SortedPaths.Add(ObjectPath.ToString());
+	}
+	SortedPaths.Sort();
+
+	FSHA1 Hash;
+	for (const FString& ObjectPath : SortedPaths)
+	{
+		Hash.UpdateWithString(*ObjectPath, ObjectPath.Len() + 1);
+	}
+	Hash.Final();
+	uint8 Digest[FSHA1::DigestSize];
+	Hash.GetHash(Digest);
+	FName CollectionName(*(TEXT("Hermes_") + BytesToHex(Digest, 16)));
+
+	// Someone could've changed the collection since it was created, in which case it no longer holds this selection
+	ICollectionManager& CollectionManager = FCollectionManagerModule::GetModule().Get();
+	bool bCreateCollection = true;
+	if (CollectionManager.CollectionExists(CollectionName, ECollectionShareType::CST_Shared))
+	{
+		TArray<FHermesObjectPath> ExistingObjectPaths;
+		CollectionManager.GetAssetsInCollection(CollectionName, ECollectionShareType::CST_Shared, ExistingObjectPaths);
+		bCreateCollection = ExistingObjectPaths.Num() != UniqueObjectPaths.Num() ||
+			ExistingObjectPaths.ContainsByPredicate([&UniqueObjectPaths](const FHermesObjectPath& ObjectPath)
+			{
+				return !UniqueObjectPaths.Contains(ObjectPath);
+			});
+		if (bCreateCollection)
+		{
+			CollectionName = FName(*(TEXT("Hermes_") + FGuid::NewGuid().ToString(EGuidFormats::Digits)));
+		}
+	}
+
+	if (bCreateCollection)
+	{
+		if (!CollectionManager.CreateCollection(CollectionName, ECollectionShareType::CST_Shared,
+		                                        ECollectionStorageMode::Static) ||
+			!CollectionManager.AddToCollection(CollectionName, ECollectionShareType::CST_Shared,
+			                                   UniqueObjectPaths.Array()))
+		{
+			FNotificationInfo Info(FText::Format(LOCTEXT("CollectionFailed", "Unable to create a collection: {0}"),
+			                                     CollectionManager.GetLastError()));
+			Info.ExpireDuration = 8.0f;
+			FSlateNotificationManager::Get().AddNotification(Info);
+			return;
+		}
+	}
+
+	IHermesServerModule& Hermes = FModuleManager::LoadModuleChecked<IHermesServerModule>("HermesServer");
+	FPlatformApplicationMisc::ClipboardCopy(*Hermes.GetUri(NAME_CollectionEndpointId, CollectionName.ToString()));
+
+	// With source control, the editor checks shared collections in as soon as they're saved. Without it, the collection
+	// only exists on this machine, and the link won't work for anyone else until the file has been shared.
+	if (!ISourceControlModule::Get().IsEnabled())
+	{
+		FNotificationInfo Info(FText::Format(
+			LOCTEXT("CollectionNotShared",
+			        "Copied a link to the collection {0}. Source control is disabled, so the link only works for others once they have Content/Collections/{0}.collection"),
+			FText::FromName(CollectionName)));
+		Info.ExpireDuration = 8.0f;
+		FSlateNotificationManager::Get().AddNotification(Info);
+	}
+}
+
+void FHermesContentEndpointEditorExtension::ExportEndpointURLsToFile(TArray<FName> Packages)
+{
+	IDesktopPlatform* DesktopPlatform = FDesktopPlatformModule::Get();
+	if (Packages.Num() == 0 || DesktopPlatform == nullptr)
+	{
+		return;
+	}
+
+	TArray<FString> Filenames;
+	const bool bPicked = DesktopPlatform->SaveFileDialog(
+		FSlateApplication::Get().FindBestParentWindowHandleForDialogs(nullptr),
+		LOCTEXT("ExportURLsTitle", "Export URLs").ToString(),
+		FPaths::ProjectSavedDir(),
+		TEXT("Links.txt"),
+		TEXT("Text file (*.txt)|*.txt|CSV file (*.csv)|*.csv|JSON file (*.json)|*.json"),
+		EFileDialogFlags::None,
+		Filenames);
+	if (!bPicked || Filenames.Num() == 0)
+	{
+		return;
+	}
+
+	IHermesServerModule& Hermes = FModuleManager::LoadModuleChecked<IHermesServerModule>("HermesServer");
+	HermesLinkExport::ExportAsync(MoveTemp(Packages), Hermes.GetUri(NAME_EndpointId), Filenames[0]);
+}
+
+TArray<FName> FHermesContentEndpointEditorExtension::GetUniquePackages(const TArray<FAssetData>& Assets)
+{
+	// Selections can be huge, so de-duplicate through a set rather than with AddUnique
+	TSet<FName> UniquePackages;
+	UniquePackages.Reserve(Assets.Num());
+	for (const FAssetData& Asset : Assets)
+	{
+		UniquePackages.Add(Asset.PackageName);
+	}
+	return UniquePackages.Array();
+}
+
+void FHermesContentEndpointEditorExtension::RegisterStyleAndCommands()
+{
+	if (SlateStyle.IsValid())
+	{
+		return;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
 	{
 		auto Plugin = IPluginManager::Get().FindPlugin("HermesCore");
 		checkf(Plugin, TEXT("Couldn't load our own plugin descriptor"));
@@ -97,12 +252,16 @@ void FHermesContentEndpointEditorExtension::InstallContentBrowserExtension()
 #define IMAGE_BRUSH_SVG( RelativePath, ... ) FSlateVectorImageBrush(SlateStyle->RootToContentDir(RelativePath, TEXT(".svg")), __VA_ARGS__)
 		SlateStyle->Set("HermesContentEndpointEditorExtensions.CopyEditURL", new IMAGE_BRUSH_SVG("hermes_icon_16", CoreStyleConstants::Icon16x16));
 		SlateStyle->Set("HermesContentEndpointEditorExtensions.CopyRevealURL", new IMAGE_BRUSH_SVG("hermes_icon_16", CoreStyleConstants::Icon16x16));
+		SlateStyle->Set("HermesContentEndpointEditorExtensions.CopyCollectionURL", new IMAGE_BRUSH_SVG("hermes_icon_16", CoreStyleConstants::Icon16x16));
+		SlateStyle->Set("HermesContentEndpointEditorExtensions.ExportURLs", new IMAGE_BRUSH_SVG("hermes_icon_16", CoreStyleConstants::Icon16x16));
 #undef IMAGE_BRUSH_SVG
 #else
 #define IMAGE_BRUSH( RelativePath, ... ) FSlateImageBrush(SlateStyle->RootToContentDir(RelativePath, TEXT(".png")), __VA_ARGS__)
 		const FVector2D Icon16x16(16.0f, 16.0f);
 		SlateStyle->Set("HermesContentEndpointEditorExtensions.CopyEditURL", new IMAGE_BRUSH("hermes_icon_16", Icon16x16));
 		SlateStyle->Set("HermesContentEndpointEditorExtensions.CopyRevealURL", new IMAGE_BRUSH("hermes_icon_16", Icon16x16));
+		SlateStyle->Set("HermesContentEndpointEditorExtensions.CopyCollectionURL", new IMAGE_BRUSH("hermes_icon_16", Icon16x16));
+		SlateStyle->Set("HermesContentEndpointEditorExtensions.ExportURLs", new IMAGE_BRUSH("hermes_icon_16", Icon16x16));
 #undef IMAGE_BRUSH
 #endif
 
@@ -111,53 +270,107 @@ void FHermesContentEndpointEditorExtension::InstallContentBrowserExtension()
 
 	FHermesContentEndpointEditorCommands::Register();
 
-	FContentBrowserModule& ContentBrowserModule = FModuleManager::LoadModuleChecked<FContentBrowserModule>(
-		TEXT("ContentBrowser"));
+	FModuleManager::LoadModuleChecked<IHermesServerModule>("HermesServer").ReportStartupCost(
+		TEXT("HermesContentEndpoint style & commands"), FPlatformTime::Seconds() - StartTime, true);
+}
+
+void FHermesContentEndpointEditorExtension::UnregisterStyleAndCommands()
+{
+	if (!SlateStyle.IsValid())
+	{
+		return;
+	}
+
+	FHermesContentEndpointEditorCommands::Unregister();
+
+	FSlateStyleRegistry::UnRegisterSlateStyle(*SlateStyle);
+	SlateStyle.Reset();
+}
+
+void FHermesContentEndpointEditorExtension::InstallContentBrowserExtension()
+{
+	if (FContentBrowserModule* ContentBrowserModule = FModuleManager::GetModulePtr<FContentBrowserModule>(
+		TEXT("ContentBrowser")))
+	{
+		ExtendContentBrowser(*ContentBrowserModule);
+	}
+	else
+	{
+		ModulesChangedDelegateHandle = FModuleManager::Get().OnModulesChanged().AddRaw(
+			this, &FHermesContentEndpointEditorExtension::OnModulesChanged);
+	}
+}
+
+void FHermesContentEndpointEditorExtension::OnModulesChanged(FName ModuleName, EModuleChangeReason Reason)
+{
+	if (Reason == EModuleChangeReason::ModuleLoaded && ModuleName == TEXT("ContentBrowser"))
+	{
+		FModuleManager::Get().OnModulesChanged().Remove(ModulesChangedDelegateHandle);
+		ModulesChangedDelegateHandle.Reset();
+
+		ExtendContentBrowser(FModuleManager::GetModuleChecked<FContentBrowserModule>(TEXT("ContentBrowser")));
+	}
+}
 
+void FHermesContentEndpointEditorExtension::ExtendContentBrowser(FContentBrowserModule& ContentBrowserModule)
+{
 	// Set up a callback to register our CopyRevealURL command when needed
 	TArray<FContentBrowserCommandExtender>& ContentBrowserCommandExtenders = ContentBrowserModule.
 		GetAllContentBrowserCommandExtenders();
-	ContentBrowserCommandExtenders.Add(FContentBrowserCommandExtender::CreateStatic(&OnExtendContentBrowserCommands));
+	ContentBrowserCommandExtenders.Add(FContentBrowserCommandExtender::CreateRaw(
+		this, &FHermesContentEndpointEditorExtension::OnExtendContentBrowserCommands));
 	ContentBrowserCommandExtenderDelegateHandle = ContentBrowserCommandExtenders.Last().GetHandle();
 
 	// Set up a callback for whenever the context menu is generated to add our CopyRevealURL command
 	TArray<FContentBrowserMenuExtender_SelectedAssets>& ContentBrowserAssetContextMenuExtenders = ContentBrowserModule.
 		GetAllAssetViewContextMenuExtenders();
-	ContentBrowserAssetContextMenuExtenders.Add(
-		FContentBrowserMenuExtender_SelectedAssets::CreateStatic(&OnExtendContentBrowserAssetSelectionMenu));
+	ContentBrowserAssetContextMenuExtenders.Add(FContentBrowserMenuExtender_SelectedAssets::CreateRaw(
+		this, &FHermesContentEndpointEditorExtension::OnExtendContentBrowserAssetSelectionMenu));
 	ContentBrowserAssetExtenderDelegateHandle = ContentBrowserAssetContextMenuExtenders.Last().GetHandle();
 }
 
 void FHermesContentEndpointEditorExtension::UninstallContentBrowserExtension()
 {
-	FContentBrowserModule& ContentBrowserModule = FModuleManager::LoadModuleChecked<FContentBrowserModule>(
-		TEXT("ContentBrowser"));
-
-	TArray<FContentBrowserMenuExtender_SelectedAssets>& ContentBrowserAssetContextMenuExtenders = ContentBrowserModule.
-		GetAllAssetViewContextMenuExtenders();
-	ContentBrowserAssetContextMenuExtenders.RemoveAll([this](const FContentBrowserMenuExtender_SelectedAssets& Delegate)
+	if (ModulesChangedDelegateHandle.IsValid())
 	{
-		return Delegate.GetHandle() == ContentBrowserAssetExtenderDelegateHandle;
-	});
-	ContentBrowserAssetExtenderDelegateHandle.Reset();
+		FModuleManager::Get().OnModulesChanged().Remove(ModulesChangedDelegateHandle);
+		ModulesChangedDelegateHandle.Reset();
+	}
 
-	TArray<FContentBrowserCommandExtender>& ContentBrowserCommandExtenders = ContentBrowserModule.
-		GetAllContentBrowserCommandExtenders();
-	ContentBrowserCommandExtenders.RemoveAll([this](const FContentBrowserCommandExtender& Delegate)
+	// If the content browser was never loaded there's nothing to remove, and no reason to load it now
+	if (FContentBrowserModule* ContentBrowserModule = FModuleManager::GetModulePtr<FContentBrowserModule>(
+		TEXT("ContentBrowser")))
 	{
-		return Delegate.GetHandle() == ContentBrowserCommandExtenderDelegateHandle;
-	});
+		TArray<FContentBrowserMenuExtender_SelectedAssets>& ContentBrowserAssetContextMenuExtenders =
+			ContentBrowserModule->GetAllAssetViewContextMenuExtenders();
+		ContentBrowserAssetContextMenuExtenders.RemoveAll(
+			[this](const FContentBrowserMenuExtender_SelectedAssets& Delegate)
+			{
+				return Delegate.GetHandle() == ContentBrowserAssetExtenderDelegateHandle;
+			});
+
+		TArray<FContentBrowserCommandExtender>& ContentBrowserCommandExtenders = ContentBrowserModule->
+			GetAllContentBrowserCommandExtenders();
+		ContentBrowserCommandExtenders.RemoveAll([this](const FContentBrowserCommandExtender& Delegate)
+		{
+			return Delegate.GetHandle() == ContentBrowserCommandExtenderDelegateHandle;
+		});
+	}
+	ContentBrowserAssetExtenderDelegateHandle.Reset();
 	ContentBrowserCommandExtenderDelegateHandle.Reset();
 
-	FSlateStyleRegistry::UnRegisterSlateStyle(*SlateStyle);
-	SlateStyle.Reset();
+	// The asset editor extension is uninstalled first, so nothing is using the commands any more
+	UnregisterStyleAndCommands();
 }
 
 void FHermesContentEndpointEditorExtension::OnExtendContentBrowserCommands(TSharedRef<FUICommandList> CommandList,
                                                                            FOnContentBrowserGetSelection
                                                                            GetSelectionDelegate)
 {
-	CommandList->MapAction(FHermesContentEndpointEditorCommands::Get().CopyRevealURL,
+	RegisterStyleAndCommands();
+
+	const FHermesContentEndpointEditorCommands& Commands = FHermesContentEndpointEditorCommands::Get();
+	CommandList->MapAction(Commands.CopyRevealURL,
 	                       FExecuteAction::CreateLambda([GetSelectionDelegate]
 	                       {
 		                       if (GetSelectionDelegate.IsBound())
@@ -165,13 +378,31 @@ void FHermesContentEndpointEditorExtension::OnExtendContentBrowserCommands(TShar
 			                       TArray<FAssetData> SelectedAssets;
 			                       TArray<FString> SelectedPaths;
 			                       GetSelectionDelegate.Execute(SelectedAssets, SelectedPaths);
-
-			                       TArray<FName> Packages;
-			                       for (const auto& Asset : SelectedAssets)
-			                       {
-				                       Packages.AddUnique(Asset.PackageName);
-			                       }
-			                       CopyEndpointURLsToClipboard(Packages);
+			                       CopyEndpointURLsToClipboard(GetUniquePackages(SelectedAssets));
+		                       }
+	                       })
+	);
+	CommandList->MapAction(Commands.CopyCollectionURL,
+	                       FExecuteAction::CreateLambda([GetSelectionDelegate]
+	                       {
+		                       if (GetSelectionDelegate.IsBound())
+		                       {
+			                       TArray<FAssetData> SelectedAssets;
+			                       TArray<FString> SelectedPaths;
+			                       GetSelectionDelegate.Execute(SelectedAssets, SelectedPaths);
+			                       CopyCollectionURLToClipboard(SelectedAssets);
+		                       }
+	                       })
+	);
+	CommandList->MapAction(Commands.ExportURLs,
+	                       FExecuteAction::CreateLambda([GetSelectionDelegate]
+	                       {
+		                       if (GetSelectionDelegate.IsBound())
+		                       {
+			                       TArray<FAssetData> SelectedAssets;
+			                       TArray<FString> SelectedPaths;
+			                       GetSelectionDelegate.Execute(SelectedAssets, SelectedPaths);
+			                       ExportEndpointURLsToFile(GetUniquePackages(SelectedAssets));
 		                       }
 	                       })
 	);
@@ -180,6 +411,8 @@ void FHermesContentEndpointEditorExtension::OnExtendContentBrowserCommands(TShar
 TSharedRef<FExtender> FHermesContentEndpointEditorExtension::OnExtendContentBrowserAssetSelectionMenu(
 	const TArray<FAssetData>& SelectedAssets)
 {
+	RegisterStyleAndCommands();
+
 	TSharedRef<FExtender> Extender(new FExtender());
 
 	// Add our option after "Copy File Path" in the context menu
@@ -189,7 +422,10 @@ TSharedRef<FExtender> FHermesContentEndpointEditorExtension::OnExtendContentBrow
 		nullptr,
 		FMenuExtensionDelegate::CreateLambda([](FMenuBuilder& MenuBuilder)
 		{
-			MenuBuilder.AddMenuEntry(FHermesContentEndpointEditorCommands::Get().CopyRevealURL);
+			const FHermesContentEndpointEditorCommands& Commands = FHermesContentEndpointEditorCommands::Get();
+			MenuBuilder.AddMenuEntry(Commands.CopyRevealURL);
+			MenuBuilder.AddMenuEntry(Commands.CopyCollectionURL);
+			MenuBuilder.AddMenuEntry(Commands.ExportURLs);
 		})
 	);
 
@@ -202,22 +438,38 @@ void FHermesContentEndpointEditorExtension::InstallAssetEditorExtension()
 
 	TArray<FAssetEditorExtender>& AssetEditorMenuExtenderDelegates =
 		FAssetEditorToolkit::GetSharedMenuExtensibilityManager()->GetExtenderDelegates();
-	AssetEditorMenuExtenderDelegates.Add(FAssetEditorExtender::CreateStatic(&OnExtendAssetEditor));
+	AssetEditorMenuExtenderDelegates.Add(
+		FAssetEditorExtender::CreateRaw(this, &FHermesContentEndpointEditorExtension::OnExtendAssetEditor));
 	AssetEditorExtenderDelegateHandle = AssetEditorMenuExtenderDelegates.Last().GetHandle();
 
+	UToolMenus::RegisterStartupCallback(FSimpleMulticastDelegate::FDelegate::CreateRaw(
+		this, &FHermesContentEndpointEditorExtension::ExtendAssetEditorMenu));
+}
+
+void FHermesContentEndpointEditorExtension::ExtendAssetEditorMenu()
+{
+	FToolMenuOwnerScoped OwnerScoped(this);
+
 	// Locate the "Asset" menu in the tool menus
 	UToolMenu* Menu = UToolMenus::Get()->ExtendMenu("MainFrame.MainMenu.Asset");
 	// Find the "asset editor actions" section (which is the only one)
 	FToolMenuSection& Section = Menu->FindOrAddSection("AssetEditorActions");
 	// Add a new entry that adds the "copy to clipboard" option
 	FToolMenuEntry& Entry = Section.AddDynamicEntry("ContentEndpointCommands",
-	                                                FNewToolMenuSectionDelegate::CreateStatic(&CreateAssetContextMenu));
+	                                                FNewToolMenuSectionDelegate::CreateRaw(
+		                                                this, &FHermesContentEndpointEditorExtension::CreateAssetContextMenu));
 	// Position it after the "Find in Content Browser" option on that menu
 	Entry.InsertPosition = FToolMenuInsert("FindInContentBrowser", EToolMenuInsertType::After);
 }
 
 void FHermesContentEndpointEditorExtension::UninstallAssetEditorExtension()
 {
+	UToolMenus::UnRegisterStartupCallback(this);
+	if (UToolMenus* ToolMenus = UToolMenus::TryGet())
+	{
+		ToolMenus->UnregisterOwner(this);
+	}
+
 	TArray<FAssetEditorExtender>& AssetEditorMenuExtenderDelegates =
 		FAssetEditorToolkit::GetSharedMenuExtensibilityManager()->GetExtenderDelegates();
 	AssetEditorMenuExtenderDelegates.RemoveAll([this](const FAssetEditorExtender& Delegate)
@@ -244,6 +496,8 @@ TSharedRef<FExtender> FHermesContentEndpointEditorExtension::OnExtendAssetEditor
 
 	if (PackageNames.Num() > 0)
 	{
+		RegisterStyleAndCommands();
+
 		// Quote from FAssetManagerEditorModule::OnExtendAssetEditor:
 		// - "It's safe to modify the CommandList here because this is run as the editor UI is created and the payloads are safe"
 		CommandList->MapAction(
@@ -266,6 +520,7 @@ void FHermesContentEndpointEditorExtension::CreateAssetContextMenu(FToolMenuSect
 		{
 			if (IsValid(EditedAsset) && EditedAsset->IsAsset())
 			{
+				RegisterStyleAndCommands();
 				InSection.AddMenuEntry(FHermesContentEndpointEditorCommands::Get().CopyEditURL);
 				break;
 			}
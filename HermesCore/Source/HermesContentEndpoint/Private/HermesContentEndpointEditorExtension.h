@@ -3,6 +3,7 @@
 
 #include <ContentBrowserModule.h>
 #include <CoreMinimal.h>
+#include <Modules/ModuleManager.h>
 
 class FExtender;
 class FMenuBuilder;
@@ -11,26 +12,47 @@ class FUICommandList;
 struct FAssetData;
 struct FToolMenuSection;
 
+/**
+ * Adds the "Copy URL" entries to the content browser & asset editors. Installing only hooks up cheap callbacks, the
+ * style set & commands are registered the first time one of the menus is built, so that they cost nothing during
+ * editor startup.
+ */
 struct FHermesContentEndpointEditorExtension
 {
+	/** Extends the content browser as soon as its module is loaded, without loading it ourselves */
 	void InstallContentBrowserExtension();
 	void UninstallContentBrowserExtension();
 
+	/** Extends the asset editors' "Asset" menu once the tool menus are ready */
 	void InstallAssetEditorExtension();
 	void UninstallAssetEditorExtension();
 
 private:
+	/** Register the style set & commands, if they haven't been registered yet */
+	void RegisterStyleAndCommands();
+	void UnregisterStyleAndCommands();
+
+	void OnModulesChanged(FName ModuleName, EModuleChangeReason Reason);
+	void ExtendContentBrowser(FContentBrowserModule& ContentBrowserModule);
+	void ExtendAssetEditorMenu();
+
 	static void CopyEndpointURLsToClipboard(TArray<FName> Packages, const TCHAR* OptionalSuffix = nullptr);
+	/** Put the selected assets in a shared collection, and copy a single URL that reveals that collection */
+	static void CopyCollectionURLToClipboard(const TArray<FAssetData>& Assets);
+	/** Ask for a filename, and write the URLs for the given packages to it in the background */
+	static void ExportEndpointURLsToFile(TArray<FName> Packages);
+	static TArray<FName> GetUniquePackages(const TArray<FAssetData>& Assets);
 
-	static TSharedRef<FExtender> OnExtendContentBrowserAssetSelectionMenu(const TArray<FAssetData>& SelectedAssets);
-	static void OnExtendContentBrowserCommands(TSharedRef<FUICommandList> CommandList,
-	                                           FOnContentBrowserGetSelection GetSelectionDelegate);
+	TSharedRef<FExtender> OnExtendContentBrowserAssetSelectionMenu(const TArray<FAssetData>& SelectedAssets);
+	void OnExtendContentBrowserCommands(TSharedRef<FUICommandList> CommandList,
+	                                    FOnContentBrowserGetSelection GetSelectionDelegate);
 
-	static void CreateAssetContextMenu(FToolMenuSection& InSection);
-	static TSharedRef<FExtender> OnExtendAssetEditor(const TSharedRef<FUICommandList> CommandList,
-	                                                 const TArray<UObject*> ContextSensitiveObjects);
+	void CreateAssetContextMenu(FToolMenuSection& InSection);
+	TSharedRef<FExtender> OnExtendAssetEditor(const TSharedRef<FUICommandList> CommandList,
+	                                          const TArray<UObject*> ContextSensitiveObjects);
 
 private:
+	FDelegateHandle ModulesChangedDelegateHandle;
 	FDelegateHandle ContentBrowserAssetExtenderDelegateHandle;
 	FDelegateHandle ContentBrowserCommandExtenderDelegateHandle;
 
@@ -0,0 +1,110 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#include "HermesContentResolver.h"
+
+#include "HermesContentEndpoint.h"
+
+#include <Misc/PackageName.h>
+
+namespace HermesContentResolverPrivate
+{
+	/** Redirectors can point at other redirectors, but a chain longer than this is most likely a cycle */
+	static constexpr int32 MAX_REDIRECTOR_DEPTH = 8;
+	static const FName NAME_DestinationObject(TEXT("DestinationObject"));
+	static const FName NAME_World(TEXT("World"));
+
+	static bool GetRedirectorDestination(const FAssetData& Redirector, FName& OutPackageName)
+	{
+		FString Destination;
+		if (!Redirector.GetTagValue(NAME_DestinationObject, Destination) || Destination.IsEmpty() ||
+			Destination == TEXT("None"))
+		{
+			return false;
+		}
+
+		OutPackageName = FName(
+			*FPackageName::ObjectPathToPackageName(FPackageName::ExportTextPathToObjectPath(Destination)));
+		return true;
+	}
+}
+
+void HermesContentResolver::Resolve(const TArray<FHermesRequest>& Requests,
+                                    FGetAssetsByPackageName GetAssetsByPackageName,
+                                    FHermesContentResolution& OutResolution)
+{
+	using namespace HermesContentResolverPrivate;
+
+	TSet<FName> RevealedPackages;
+	TArray<FAssetData> AssetData;
+	for (const FHermesRequest& Request : Requests)
+	{
+		AssetData.Reset();
+		FName PackageName(*Request.Path);
+		GetAssetsByPackageName(PackageName, AssetData);
+
+		// Links to assets that have since been renamed point at the redirector that was left behind
+		bool bRedirected = false;
+		for (int32 Depth = 0; Depth < MAX_REDIRECTOR_DEPTH && AssetData.Num() == 1 && AssetData[0].IsRedirector();
+		     ++Depth)
+		{
+			FName DestinationPackageName;
+			if (!GetRedirectorDestination(AssetData[0], DestinationPackageName) ||
+				DestinationPackageName == PackageName)
+			{
+				break;
+			}
+
+			UE_LOG(LogHermesContentEndpoint, Verbose, TEXT("Following redirector from %s to %s"),
+			       *PackageName.ToString(), *DestinationPackageName.ToString());
+			PackageName = DestinationPackageName;
+			AssetData.Reset();
+			GetAssetsByPackageName(PackageName, AssetData);
+			bRedirected = true;
+		}
+
+		if (AssetData.Num() == 0)
+		{
+			UE_LOG(LogHermesContentEndpoint, Error, TEXT("Couldn't find any assets for %s"), *Request.Path);
+			++OutResolution.NumMissing;
+			continue;
+		}
+		OutResolution.NumRedirected += bRedirected ? 1 : 0;
+
+		// Links into a map open it in the level editor rather than revealing it
+		FHermesMapLink MapLink;
+		if (GetAssetClassName(AssetData[0]) == NAME_World && HermesMapLinks::ParseTarget(Request.QueryParams, MapLink))
+		{
+			UE_LOG(LogHermesContentEndpoint, Verbose, TEXT("Opening %s in the level editor"), *Request.Path);
+			MapLink.Map = AssetData[0];
+			OutResolution.MapsToOpen.Add(MoveTemp(MapLink));
+			continue;
+		}
+
+		// Links to a node inside an asset need its editor open, so "node" implies "edit"
+		FGuid Anchor;
+		if (const FString* Node = Request.QueryParams.Find(TEXT("node")))
+		{
+			if (!FGuid::Parse(*Node, Anchor))
+			{
+				UE_LOG(LogHermesContentEndpoint, Error, TEXT("'%s' isn't a valid node GUID"), **Node);
+			}
+		}
+
+		// Since this is a valid asset, either open it or edit it
+		const bool bShouldEdit = Request.QueryParams.Contains("edit") || Anchor.IsValid();
+		if (bShouldEdit)
+		{
+			UE_LOG(LogHermesContentEndpoint, Verbose, TEXT("Opening %s for editing"), *Request.Path);
+			OutResolution.AssetsToEdit.Add(AssetData[0]);
+			if (Anchor.IsValid())
+			{
+				OutResolution.AnchorsToFocus.Emplace(AssetData[0], Anchor);
+			}
+		}
+		else if (!RevealedPackages.Contains(PackageName))
+		{
+			UE_LOG(LogHermesContentEndpoint, Verbose, TEXT("Focusing %s in content browser"), *Request.Path);
+			RevealedPackages.Add(PackageName);
+			OutResolution.AssetsToReveal.Append(AssetData);
+		}
+	}
+}
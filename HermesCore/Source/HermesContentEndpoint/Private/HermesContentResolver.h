@@ -0,0 +1,38 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#pragma once
+
+#include "HermesMapLinks.h"
+
+#include <AssetRegistry/AssetData.h>
+#include <CoreMinimal.h>
+#include <HermesServer.h>
+
+/** What a batch of content requests resolved to */
+struct FHermesContentResolution
+{
+	/** Every asset in each package that should be revealed in the content browser, each package only once */
+	TArray<FAssetData> AssetsToReveal;
+	/** The primary asset of each package that should be opened in an editor */
+	TArray<FAssetData> AssetsToEdit;
+	/** Graph nodes or material expressions to focus once AssetsToEdit have been opened, by the asset they're in */
+	TArray<TPair<FAssetData, FGuid>> AnchorsToFocus;
+	/** Maps that should be opened in the level editor at a specific actor or location */
+	TArray<FHermesMapLink> MapsToOpen;
+	/** Requests for packages that don't exist */
+	int32 NumMissing = 0;
+	/** Requests for packages that had been renamed, and were resolved by following their redirectors */
+	int32 NumRedirected = 0;
+};
+
+namespace HermesContentResolver
+{
+	/** Append the assets in a package to OutAssets, e.g. by querying the asset registry */
+	typedef TFunctionRef<void(FName /* PackageName */, TArray<FAssetData>& /* OutAssets */)> FGetAssetsByPackageName;
+
+	/**
+	 * Figure out what a batch of content requests should do, without doing any of it. This is kept separate from the
+	 * endpoint so that it can be measured against a synthetic asset registry.
+	 */
+	void Resolve(const TArray<FHermesRequest>& Requests, FGetAssetsByPackageName GetAssetsByPackageName,
+	             FHermesContentResolution& OutResolution);
+}
@@ -0,0 +1,138 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#include "HermesGraphAnchors.h"
+
+#include "HermesContentEndpoint.h"
+
+#include <EdGraph/EdGraph.h>
+#include <EdGraph/EdGraphNode.h>
+#include <Editor.h>
+#include <Engine/Blueprint.h>
+#include <HermesServer.h>
+#include <IMaterialEditor.h>
+#include <Kismet2/KismetEditorUtilities.h>
+#include <Materials/MaterialExpression.h>
+#include <Subsystems/AssetEditorSubsystem.h>
+#include <UObject/UObjectHash.h>
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Anchor index hits"), STAT_HermesAnchorIndexHits, STATGROUP_HermesServer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Anchor index rebuilds"), STAT_HermesAnchorIndexRebuilds, STATGROUP_HermesServer);
+
+namespace HermesGraphAnchorsPrivate
+{
+	static const FName NAME_MaterialEditor(TEXT("MaterialEditor"));
+
+	static FGuid GetAnchorGuid(const UObject* Object, bool bIsBlueprint)
+	{
+		if (const UMaterialExpression* Expression = Cast<UMaterialExpression>(Object))
+		{
+			return Expression->MaterialExpressionGuid;
+		}
+
+		// The material editor builds a transient graph inside the material, with new GUIDs every time it's opened, so
+		// only Blueprints' graphs are worth linking to
+		if (!bIsBlueprint)
+		{
+			return FGuid();
+		}
+		if (const UEdGraphNode* Node = Cast<UEdGraphNode>(Object))
+		{
+			return Node->NodeGuid;
+		}
+		if (const UEdGraph* Graph = Cast<UEdGraph>(Object))
+		{
+			return Graph->GraphGuid;
+		}
+		return FGuid();
+	}
+
+	static bool FocusMaterialExpression(UObject* Asset, UMaterialExpression* Expression)
+	{
+		// Materials & material functions are both edited in the material editor, which doesn't go through the Kismet
+		// hyperlink mechanism
+		UAssetEditorSubsystem* AssetEditorSubsystem = GEditor->GetEditorSubsystem<UAssetEditorSubsystem>();
+		IAssetEditorInstance* Editor = AssetEditorSubsystem->FindEditorForAsset(Asset, /* bFocusIfOpen = */ true);
+		if (Editor == nullptr || Editor->GetEditorName() != NAME_MaterialEditor)
+		{
+			return false;
+		}
+
+		static_cast<IMaterialEditor*>(Editor)->JumpToExpression(Expression);
+		return true;
+	}
+}
+
+bool FHermesGraphAnchorIndex::Focus(UObject* Asset, const FGuid& Guid)
+{
+	using namespace HermesGraphAnchorsPrivate;
+
+	UObject* Anchor = Asset != nullptr ? Find(Asset, Guid) : nullptr;
+	if (Anchor == nullptr)
+	{
+		return false;
+	}
+
+	if (UMaterialExpression* Expression = Cast<UMaterialExpression>(Anchor))
+	{
+		return FocusMaterialExpression(Asset, Expression);
+	}
+
+	FKismetEditorUtilities::BringKismetToFocusAttentionOnObject(Anchor);
+	return true;
+}
+
+void FHermesGraphAnchorIndex::Reset()
+{
+	Indices.Reset();
+}
+
+UObject* FHermesGraphAnchorIndex::Find(UObject* Asset, const FGuid& Guid)
+{
+	FAnchors* Anchors = Indices.Find(Asset);
+	if (Anchors != nullptr)
+	{
+		const TWeakObjectPtr<UObject>* Anchor = Anchors->Find(Guid);
+		if (Anchor != nullptr && Anchor->IsValid())
+		{
+			INC_DWORD_STAT(STAT_HermesAnchorIndexHits);
+			return Anchor->Get();
+		}
+	}
+	else
+	{
+		// Drop the indices of assets that have since been unloaded, so they don't pile up over a long session
+		for (auto It = Indices.CreateIterator(); It; ++It)
+		{
+			if (It.Key().ResolveObjectPtr() == nullptr)
+			{
+				It.RemoveCurrent();
+			}
+		}
+		Anchors = &Indices.Add(Asset);
+	}
+
+	// Either this is the first link into the asset, or it's been edited since it was indexed (or the link is stale)
+	INC_DWORD_STAT(STAT_HermesAnchorIndexRebuilds);
+	const double StartTime = FPlatformTime::Seconds();
+	Anchors->Reset();
+	Build(Asset, *Anchors);
+	UE_LOG(LogHermesContentEndpoint, Verbose, TEXT("Indexed %d anchor(s) in %s in %.2f ms"), Anchors->Num(),
+	       *Asset->GetPathName(), (FPlatformTime::Seconds() - StartTime) * 1000.0);
+
+	const TWeakObjectPtr<UObject>* Anchor = Anchors->Find(Guid);
+	return Anchor != nullptr ? Anchor->Get() : nullptr;
+}
+
+void FHermesGraphAnchorIndex::Build(UObject* Asset, FAnchors& OutAnchors)
+{
+	using namespace HermesGraphAnchorsPrivate;
+
+	const bool bIsBlueprint = Asset->IsA<UBlueprint>();
+	ForEachObjectWithOuter(Asset, [&OutAnchors, bIsBlueprint](UObject* Object)
+	{
+		const FGuid Guid = GetAnchorGuid(Object, bIsBlueprint);
+		if (Guid.IsValid() && IsValid(Object))
+		{
+			OutAnchors.Add(Guid, Object);
+		}
+	}, /* bIncludeNestedObjects = */ true);
+}
@@ -0,0 +1,27 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#pragma once
+
+#include <CoreMinimal.h>
+#include <UObject/ObjectKey.h>
+
+/**
+ * Finds the Blueprint graphs & nodes (including anim graph states) and material expressions inside an asset by their
+ * GUID, for links like "/Game/BP_Door?edit&node=<guid>". Each asset is indexed the first time it's linked into, so
+ * later links into the same asset don't need to walk all of its graphs.
+ */
+struct FHermesGraphAnchorIndex
+{
+	/** Bring the asset's (already open) editor to the object with the given GUID, returns false if there isn't one */
+	bool Focus(UObject* Asset, const FGuid& Guid);
+
+	void Reset();
+
+private:
+	typedef TMap<FGuid, TWeakObjectPtr<UObject>> FAnchors;
+
+	/** Returns nullptr if the asset doesn't have anything with that GUID */
+	UObject* Find(UObject* Asset, const FGuid& Guid);
+	static void Build(UObject* Asset, FAnchors& OutAnchors);
+
+	TMap<FObjectKey, FAnchors> Indices;
+};
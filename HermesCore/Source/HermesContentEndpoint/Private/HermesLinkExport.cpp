@@ -0,0 +1,234 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#include "HermesLinkExport.h"
+
+#include <Async/Async.h>
+#include <Framework/Notifications/NotificationManager.h>
+#include <HAL/FileManager.h>
+#include <Misc/Paths.h>
+#include <Widgets/Notifications/SNotificationList.h>
+
+#include <atomic>
+
+#define LOCTEXT_NAMESPACE "Editor.HermesLinkExport"
+
+DEFINE_LOG_CATEGORY_STATIC(LogHermesLinkExport, Log, All);
+
+namespace HermesLinkExportPrivate
+{
+	/** How many links we format before writing them out and reporting progress */
+	static constexpr int32 CHUNK_SIZE = 4096;
+
+	static void WriteUtf8(FArchive& Writer, const FString& Text)
+	{
+		const FTCHARToUTF8 Utf8(*Text);
+		Writer.Serialize(const_cast<uint8*>(reinterpret_cast<const uint8*>(Utf8.Get())), Utf8.Length());
+	}
+
+	static void AppendCsvField(FString& Out, const FString& Field)
+	{
+		int32 Index;
+		if (!Field.FindChar(TEXT(','), Index) && !Field.FindChar(TEXT('"'), Index) && !Field.FindChar(TEXT('\n'), Index))
+		{
+			Out += Field;
+			return;
+		}
+
+		Out += TEXT('"');
+		Out += Field.Replace(TEXT("\""), TEXT("\"\""));
+		Out += TEXT('"');
+	}
+
+	static void AppendJsonString(FString& Out, const FString& Value)
+	{
+		Out += TEXT('"');
+		for (const TCHAR Character : Value)
+		{
+			if (Character == TEXT('"') || Character == TEXT('\\'))
+			{
+				Out += TEXT('\\');
+				Out += Character;
+			}
+			else if (Character < 0x20)
+			{
+				Out += FString::Printf(TEXT("\\u%04x"), Character);
+			}
+			else
+			{
+				Out += Character;
+			}
+		}
+		Out += TEXT('"');
+	}
+
+	static void AppendEntry(FString& Out, EHermesLinkExportFormat Format, const FString& EndpointUrl, FName Package,
+	                        bool bFirst)
+	{
+		FString Url;
+		HermesLinkExport::AppendUrl(Url, EndpointUrl, Package);
+
+		switch (Format)
+		{
+			case EHermesLinkExportFormat::Text:
+				Out += Url;
+				Out += LINE_TERMINATOR;
+				break;
+			case EHermesLinkExportFormat::Csv:
+				AppendCsvField(Out, Package.ToString());
+				Out += TEXT(',');
+				AppendCsvField(Out, Url);
+				Out += LINE_TERMINATOR;
+				break;
+			case EHermesLinkExportFormat::Json:
+				Out += bFirst ? TEXT("\n  {\"package\": ") : TEXT(",\n  {\"package\": ");
+				AppendJsonString(Out, Package.ToString());
+				Out += TEXT(", \"url\": ");
+				AppendJsonString(Out, Url);
+				Out += TEXT('}');
+				break;
+		}
+	}
+
+	static void UpdateProgress(TWeakPtr<SNotificationItem> WeakNotification, int32 Written, int32 Total)
+	{
+		AsyncTask(ENamedThreads::GameThread, [WeakNotification, Written, Total]
+		{
+			if (TSharedPtr<SNotificationItem> Notification = WeakNotification.Pin())
+			{
+				Notification->SetText(FText::Format(LOCTEXT("ExportProgress", "Exporting links ({0} / {1})"),
+				                                    FText::AsNumber(Written), FText::AsNumber(Total)));
+			}
+		});
+	}
+
+	static void Finish(TWeakPtr<SNotificationItem> WeakNotification, FText Text, bool bSuccess, FString Filename)
+	{
+		AsyncTask(ENamedThreads::GameThread, [WeakNotification, Text, bSuccess, Filename]
+		{
+			if (TSharedPtr<SNotificationItem> Notification = WeakNotification.Pin())
+			{
+				Notification->SetText(Text);
+				if (bSuccess)
+				{
+					Notification->SetHyperlink(FSimpleDelegate::CreateLambda([Filename]
+					                           {
+						                           FPlatformProcess::ExploreFolder(*Filename);
+					                           }),
+					                           FText::FromString(FPaths::GetCleanFilename(Filename)));
+				}
+				Notification->SetCompletionState(bSuccess ? SNotificationItem::CS_Success : SNotificationItem::CS_Fail);
+				Notification->ExpireAndFadeout();
+			}
+		});
+	}
+}
+
+void HermesLinkExport::AppendUrl(FString& Out, const FString& EndpointUrl, FName Package, const TCHAR* OptionalSuffix)
+{
+	// Matches GetUri, which strips the leading slash of the path since the endpoint URL already ends in one
+	const FString PackageName = Package.ToString();
+	Out += EndpointUrl;
+	Out += PackageName.StartsWith(TEXT("/")) ? *PackageName + 1 : *PackageName;
+	if (OptionalSuffix)
+	{
+		Out += OptionalSuffix;
+	}
+}
+
+EHermesLinkExportFormat HermesLinkExport::GetFormatForFilename(const FString& Filename)
+{
+	const FString Extension = FPaths::GetExtension(Filename);
+	if (Extension.Equals(TEXT("csv"), ESearchCase::IgnoreCase))
+	{
+		return EHermesLinkExportFormat::Csv;
+	}
+	if (Extension.Equals(TEXT("json"), ESearchCase::IgnoreCase))
+	{
+		return EHermesLinkExportFormat::Json;
+	}
+	return EHermesLinkExportFormat::Text;
+}
+
+void HermesLinkExport::ExportAsync(TArray<FName> Packages, FString EndpointUrl, FString Filename)
+{
+	using namespace HermesLinkExportPrivate;
+
+	TSharedRef<std::atomic<bool>> bCancelled = MakeShared<std::atomic<bool>>(false);
+
+	FNotificationInfo Info(FText::Format(LOCTEXT("ExportProgress", "Exporting links ({0} / {1})"), FText::AsNumber(0),
+	                                     FText::AsNumber(Packages.Num())));
+	Info.bFireAndForget = false;
+	Info.ButtonDetails.Add(FNotificationButtonInfo(LOCTEXT("CancelExport", "Cancel"), FText(),
+	                                               FSimpleDelegate::CreateLambda([bCancelled]
+	                                               {
+		                                               *bCancelled = true;
+	                                               }), SNotificationItem::CS_Pending));
+	TSharedPtr<SNotificationItem> Notification = FSlateNotificationManager::Get().AddNotification(Info);
+	if (Notification.IsValid())
+	{
+		Notification->SetCompletionState(SNotificationItem::CS_Pending);
+	}
+
+	TWeakPtr<SNotificationItem> WeakNotification = Notification;
+	Async(EAsyncExecution::ThreadPool,
+	      [Packages = MoveTemp(Packages), EndpointUrl = MoveTemp(EndpointUrl), Filename = MoveTemp(Filename),
+		      bCancelled, WeakNotification]
+	      {
+		      const EHermesLinkExportFormat Format = GetFormatForFilename(Filename);
+		      TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*Filename));
+		      if (!Writer.IsValid())
+		      {
+			      UE_LOG(LogHermesLinkExport, Error, TEXT("Unable to open %s for writing"), *Filename);
+			      Finish(WeakNotification, LOCTEXT("ExportFailed", "Unable to open the file for writing"), false,
+			             Filename);
+			      return;
+		      }
+
+		      FString Chunk;
+		      Chunk.Reserve(CHUNK_SIZE * (EndpointUrl.Len() + 128));
+		      if (Format == EHermesLinkExportFormat::Csv)
+		      {
+			      Chunk += TEXT("package,url");
+			      Chunk += LINE_TERMINATOR;
+		      }
+		      else if (Format == EHermesLinkExportFormat::Json)
+		      {
+			      Chunk += TEXT("[");
+		      }
+
+		      for (int32 Index = 0; Index < Packages.Num(); ++Index)
+		      {
+			      AppendEntry(Chunk, Format, EndpointUrl, Packages[Index], Index == 0);
+
+			      const int32 Written = Index + 1;
+			      if (Written % CHUNK_SIZE == 0 && Written != Packages.Num())
+			      {
+				      WriteUtf8(*Writer, Chunk);
+				      Chunk.Reset();
+
+				      if (*bCancelled)
+				      {
+					      Writer.Reset();
+					      IFileManager::Get().Delete(*Filename);
+					      Finish(WeakNotification, LOCTEXT("ExportCancelled", "Export cancelled"), false, Filename);
+					      return;
+				      }
+				      UpdateProgress(WeakNotification, Written, Packages.Num());
+			      }
+		      }
+
+		      if (Format == EHermesLinkExportFormat::Json)
+		      {
+			      Chunk += Packages.Num() > 0 ? TEXT("\n]\n") : TEXT("]\n");
+		      }
+		      WriteUtf8(*Writer, Chunk);
+
+		      const bool bSuccess = Writer->Close() && !Writer->IsError();
+		      UE_CLOG(!bSuccess, LogHermesLinkExport, Error, TEXT("Failed to write links to %s"), *Filename);
+		      Finish(WeakNotification,
+		             bSuccess
+			             ? FText::Format(LOCTEXT("ExportSucceeded", "Exported {0} links"), FText::AsNumber(Packages.Num()))
+			             : LOCTEXT("ExportWriteFailed", "Failed to write the links to the file"), bSuccess, Filename);
+	      });
+}
+
+#undef LOCTEXT_NAMESPACE
@@ -0,0 +1,35 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#pragma once
+
+#include <CoreMinimal.h>
+
+/** The file formats links can be exported to */
+enum class EHermesLinkExportFormat : uint8
+{
+	/** One URL per line */
+	Text,
+	/** A header, followed by one "package,url" row per package */
+	Csv,
+	/** An array of { "package": ..., "url": ... } objects */
+	Json,
+};
+
+namespace HermesLinkExport
+{
+	/**
+	 * Append the URL for a package to Out. This is equivalent to calling IHermesServerModule::GetUri for each package,
+	 * but only formats the scheme & endpoint once.
+	 *
+	 * @param EndpointUrl the URL of the endpoint itself, i.e. IHermesServerModule::GetUri(Endpoint)
+	 */
+	void AppendUrl(FString& Out, const FString& EndpointUrl, FName Package, const TCHAR* OptionalSuffix = nullptr);
+
+	/** Pick a format based on the extension of the filename, defaulting to Text */
+	EHermesLinkExportFormat GetFormatForFilename(const FString& Filename);
+
+	/**
+	 * Write the URLs for the given packages to a file. The file is written in chunks on a worker thread, and progress
+	 * is reported through an editor notification that also lets the user cancel the export.
+	 */
+	void ExportAsync(TArray<FName> Packages, FString EndpointUrl, FString Filename);
+}
@@ -0,0 +1,149 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#include "HermesLinkIndexExporter.h"
+
+#include "HermesContentEndpoint.h"
+#include "HermesLinkIndexFormat.h"
+
+#include <AssetRegistry/AssetRegistryModule.h>
+#include <HAL/PlatformTime.h>
+#include <Misc/DateTime.h>
+#include <Misc/FileHelper.h>
+#include <Misc/OutputDevice.h>
+#include <Misc/PackageName.h>
+#include <Misc/Paths.h>
+#include <Runtime/Launch/Resources/Version.h>
+
+namespace HermesLinkIndexPrivate
+{
+	static const FName NAME_DestinationObject(TEXT("DestinationObject"));
+
+	/** The string blob, with identical strings stored only once */
+	struct FStringTable
+	{
+		TArray<uint8> Bytes;
+		TMap<FString, uint32> Offsets;
+
+		uint32 Add(const FString& String)
+		{
+			if (const uint32* Existing = Offsets.Find(String))
+			{
+				return *Existing;
+			}
+
+			const uint32 Offset = Bytes.Num();
+			const FTCHARToUTF8 Utf8(*String);
+			Bytes.Append(reinterpret_cast<const uint8*>(Utf8.Get()), Utf8.Length());
+			Bytes.Add(0);
+			Offsets.Add(String, Offset);
+			return Offset;
+		}
+
+		const char* Get(uint32 Offset) const
+		{
+			return reinterpret_cast<const char*>(Bytes.GetData() + Offset);
+		}
+	};
+
+	static uint64 GetDiskSize(const IAssetRegistry& AssetRegistry, FName PackageName)
+	{
+#if ENGINE_MAJOR_VERSION == 5 && ENGINE_MINOR_VERSION >= 1 || ENGINE_MAJOR_VERSION > 5
+		const TOptional<FAssetPackageData> PackageData = AssetRegistry.GetAssetPackageDataCopy(PackageName);
+		return PackageData.IsSet() && PackageData->DiskSize > 0 ? PackageData->DiskSize : 0;
+#else
+		const FAssetPackageData* PackageData = AssetRegistry.GetAssetPackageData(PackageName);
+		return PackageData != nullptr && PackageData->DiskSize > 0 ? PackageData->DiskSize : 0;
+#endif
+	}
+
+	template <typename StructType>
+	static void Append(TArray<uint8>& Out, const StructType& Struct)
+	{
+		Out.Append(reinterpret_cast<const uint8*>(&Struct), sizeof(Struct));
+	}
+}
+
+FString HermesLinkIndex::GetDefaultFilename()
+{
+	return FPaths::ProjectSavedDir() / TEXT("Hermes") / TEXT("LinkIndex.bin");
+}
+
+bool HermesLinkIndex::Export(const FString& Filename, FOutputDevice& Ar)
+{
+	using namespace HermesLinkIndexPrivate;
+
+	IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry").Get();
+	if (AssetRegistry.IsLoadingAssets())
+	{
+		Ar.Logf(ELogVerbosity::Error, TEXT("The asset registry is still loading, try again once it's done"));
+		return false;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	TArray<FAssetData> Assets;
+	AssetRegistry.GetAllAssets(Assets, /* bIncludeOnlyOnDiskAssets = */ true);
+
+	FStringTable Strings;
+	TArray<FEntry> Entries;
+	Entries.Reserve(Assets.Num());
+	TMap<FName, uint64> DiskSizes;
+	for (const FAssetData& Asset : Assets)
+	{
+		FEntry& Entry = Entries.AddZeroed_GetRef();
+		Entry.PackageName = Strings.Add(Asset.PackageName.ToString());
+		Entry.AssetName = Strings.Add(Asset.AssetName.ToString());
+		Entry.ClassName = Strings.Add(GetAssetClassName(Asset).ToString());
+		Entry.RedirectsTo = NO_STRING;
+		Entry.Flags = Asset.IsUAsset() ? PrimaryAsset : 0;
+
+		FString Destination;
+		if (Asset.IsRedirector() && Asset.GetTagValue(NAME_DestinationObject, Destination) && Destination != TEXT("None"))
+		{
+			Entry.Flags |= Redirector;
+			Entry.RedirectsTo = Strings.Add(
+				FPackageName::ObjectPathToPackageName(FPackageName::ExportTextPathToObjectPath(Destination)));
+		}
+
+		uint64* DiskSize = DiskSizes.Find(Asset.PackageName);
+		if (DiskSize == nullptr)
+		{
+			DiskSize = &DiskSizes.Add(Asset.PackageName, GetDiskSize(AssetRegistry, Asset.PackageName));
+		}
+		Entry.DiskSize = *DiskSize;
+	}
+
+	// The primary asset goes first within each package, since that's the one links resolve to
+	Entries.Sort([&Strings](const FEntry& A, const FEntry& B)
+	{
+		const int Comparison = ComparePackageNames(Strings.Get(A.PackageName), Strings.Get(B.PackageName));
+		if (Comparison != 0)
+		{
+			return Comparison < 0;
+		}
+		return (A.Flags & PrimaryAsset) > (B.Flags & PrimaryAsset);
+	});
+
+	FHeader Header = {};
+	FMemory::Memcpy(Header.Magic, MAGIC, sizeof(Header.Magic));
+	Header.Version = VERSION;
+	Header.NumEntries = Entries.Num();
+	Header.EntriesOffset = sizeof(FHeader);
+	Header.StringsOffset = Header.EntriesOffset + Entries.Num() * sizeof(FEntry);
+	Header.StringsSize = Strings.Bytes.Num();
+	Header.ExportTime = FDateTime::UtcNow().ToUnixTimestamp();
+
+	TArray<uint8> Contents;
+	Contents.Reserve(Header.StringsOffset + Header.StringsSize);
+	Append(Contents, Header);
+	Contents.Append(reinterpret_cast<const uint8*>(Entries.GetData()), Entries.Num() * sizeof(FEntry));
+	Contents.Append(Strings.Bytes);
+
+	if (!FFileHelper::SaveArrayToFile(Contents, *Filename))
+	{
+		Ar.Logf(ELogVerbosity::Error, TEXT("Unable to write the link index to %s"), *Filename);
+		return false;
+	}
+
+	Ar.Logf(TEXT("Exported %d assets in %d packages to %s (%.1f MiB) in %.2fs"), Entries.Num(), DiskSizes.Num(),
+	        *Filename, Contents.Num() / (1024.0 * 1024.0), FPlatformTime::Seconds() - StartTime);
+	return true;
+}
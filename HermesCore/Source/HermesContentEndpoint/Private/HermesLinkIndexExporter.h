@@ -0,0 +1,18 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#pragma once
+
+#include <CoreMinimal.h>
+
+class FOutputDevice;
+
+namespace HermesLinkIndex
+{
+	/** Where the index is written if no filename is given */
+	FString GetDefaultFilename();
+
+	/**
+	 * Write every asset the asset registry knows about to a compact link index (see HermesLinkIndexFormat.h), so that
+	 * tools can resolve content links without running the editor.
+	 */
+	bool Export(const FString& Filename, FOutputDevice& Ar);
+}
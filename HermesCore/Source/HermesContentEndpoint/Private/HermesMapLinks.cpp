@@ -0,0 +1,203 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#include "HermesMapLinks.h"
+
+#include "HermesContentEndpoint.h"
+
+#include <Editor.h>
+#include <EngineUtils.h>
+#include <FileHelpers.h>
+#include <HAL/PlatformTime.h>
+#include <Misc/PackageName.h>
+#include <Runtime/Launch/Resources/Version.h>
+
+#if ENGINE_MAJOR_VERSION >= 5
+#include <WorldPartition/WorldPartition.h>
+#include <WorldPartition/WorldPartitionActorDesc.h>
+#endif
+#if ENGINE_MAJOR_VERSION == 5 && ENGINE_MINOR_VERSION >= 1 || ENGINE_MAJOR_VERSION > 5
+#include <WorldPartition/LoaderAdapter/LoaderAdapterShape.h>
+#include <WorldPartition/WorldPartitionEditorLoaderAdapter.h>
+#endif
+#if ENGINE_MAJOR_VERSION == 5 && ENGINE_MINOR_VERSION >= 4 || ENGINE_MAJOR_VERSION > 5
+#include <WorldPartition/WorldPartitionActorDescInstance.h>
+#endif
+
+namespace HermesMapLinksPrivate
+{
+	/** How much is loaded around the target if the link doesn't say, in world units (i.e. 200 m) */
+	static constexpr float DEFAULT_RADIUS = 20000.0f;
+	/** The size of the box that's framed around a location, so that the camera doesn't end up inside of something */
+	static constexpr float LOCATION_FRAME_EXTENT = 500.0f;
+
+	static UWorld* GetEditorWorld()
+	{
+		return GEditor->GetEditorWorldContext().World();
+	}
+
+	static bool OpenMap(const FAssetData& Map)
+	{
+		UWorld* World = GetEditorWorld();
+		if (World != nullptr && World->GetOutermost()->GetFName() == Map.PackageName)
+		{
+			return true;
+		}
+
+		// Give the user a chance to save (or back out of) any changes to the current map, like opening it by hand does
+		if (!FEditorFileUtils::SaveDirtyPackages(/* bPromptUserToSave = */ true, /* bSaveMapPackages = */ true,
+		                                         /* bSaveContentPackages = */ false))
+		{
+			UE_LOG(LogHermesContentEndpoint, Display, TEXT("Not opening %s, saving the current map was cancelled"),
+			       *Map.PackageName.ToString());
+			return false;
+		}
+
+		const FString Filename = FPackageName::LongPackageNameToFilename(Map.PackageName.ToString(),
+		                                                                 FPackageName::GetMapPackageExtension());
+		return FEditorFileUtils::LoadMap(Filename, /* LoadAsTemplate = */ false, /* bShowProgress = */ true) &&
+			GetEditorWorld() != nullptr;
+	}
+
+#if ENGINE_MAJOR_VERSION >= 5
+	static AActor* FindLoadedActor(UWorld& World, const FGuid& ActorGuid)
+	{
+		for (TActorIterator<AActor> It(&World); It; ++It)
+		{
+			if (It->GetActorGuid() == ActorGuid)
+			{
+				return *It;
+			}
+		}
+		return nullptr;
+	}
+
+	/** Find the bounds of an actor that might not be loaded, returns false if the map doesn't have it */
+	static bool GetActorBounds(UWorld& World, const FGuid& ActorGuid, FBox& OutBounds)
+	{
+		if (UWorldPartition* WorldPartition = World.GetWorldPartition())
+		{
+#if ENGINE_MAJOR_VERSION == 5 && ENGINE_MINOR_VERSION >= 4 || ENGINE_MAJOR_VERSION > 5
+			const FWorldPartitionActorDescInstance* ActorDesc = WorldPartition->GetActorDescInstance(ActorGuid);
+			if (ActorDesc != nullptr)
+			{
+				OutBounds = ActorDesc->GetEditorBounds();
+				return true;
+			}
+#else
+			const FWorldPartitionActorDesc* ActorDesc = WorldPartition->GetActorDesc(ActorGuid);
+			if (ActorDesc != nullptr)
+			{
+				OutBounds = ActorDesc->GetBounds();
+				return true;
+			}
+#endif
+			return false;
+		}
+
+		AActor* Actor = FindLoadedActor(World, ActorGuid);
+		if (Actor != nullptr)
+		{
+			OutBounds = Actor->GetComponentsBoundingBox(/* bNonColliding = */ true);
+			return true;
+		}
+		return false;
+	}
+
+	/** Load the World Partition cells that overlap the bounds, leaving everything else unloaded */
+	static void LoadRegion(UWorld& World, UWorldPartition& WorldPartition, const FBox& Bounds)
+	{
+#if ENGINE_MAJOR_VERSION == 5 && ENGINE_MINOR_VERSION >= 1 || ENGINE_MAJOR_VERSION > 5
+		// A user-created region shows up in the World Partition editor, so it can be unloaded again from there
+		UWorldPartitionEditorLoaderAdapter* LoaderAdapter = WorldPartition.CreateEditorLoaderAdapter<
+			FLoaderAdapterShape>(&World, Bounds, TEXT("Hermes Link"));
+		LoaderAdapter->GetLoaderAdapter()->SetUserCreated(true);
+		LoaderAdapter->GetLoaderAdapter()->Load();
+#else
+		WorldPartition.LoadEditorCells(Bounds, /* bIsFromUserChange = */ true);
+#endif
+	}
+#endif
+}
+
+bool HermesMapLinks::ParseTarget(const FHermesQueryParamsMap& QueryParams, FHermesMapLink& OutLink)
+{
+	using namespace HermesMapLinksPrivate;
+
+	bool bHasTarget = false;
+	if (const FString* Actor = QueryParams.Find(TEXT("actor")))
+	{
+		if (!FGuid::Parse(*Actor, OutLink.ActorGuid))
+		{
+			UE_LOG(LogHermesContentEndpoint, Error, TEXT("'%s' isn't a valid actor GUID"), **Actor);
+			return false;
+		}
+		bHasTarget = true;
+	}
+	else if (const FString* Location = QueryParams.Find(TEXT("loc")))
+	{
+		TArray<FString> Components;
+		Location->ParseIntoArray(Components, TEXT(","));
+		if (Components.Num() != 3 || !Components[0].IsNumeric() || !Components[1].IsNumeric() ||
+			!Components[2].IsNumeric())
+		{
+			UE_LOG(LogHermesContentEndpoint, Error, TEXT("'%s' isn't a valid location, expected x,y,z"), **Location);
+			return false;
+		}
+		OutLink.Location = FVector(FCString::Atod(*Components[0]), FCString::Atod(*Components[1]),
+		                           FCString::Atod(*Components[2]));
+		bHasTarget = true;
+	}
+
+	const FString* Radius = QueryParams.Find(TEXT("radius"));
+	OutLink.Radius = DEFAULT_RADIUS;
+	if (Radius != nullptr && Radius->IsNumeric())
+	{
+		OutLink.Radius = FMath::Max(0.0f, FCString::Atof(**Radius));
+	}
+	return bHasTarget;
+}
+
+void HermesMapLinks::Open(const FHermesMapLink& Link)
+{
+	using namespace HermesMapLinksPrivate;
+
+	const double StartTime = FPlatformTime::Seconds();
+	if (!OpenMap(Link.Map))
+	{
+		return;
+	}
+
+	UWorld* World = GetEditorWorld();
+	FBox Target = FBox::BuildAABB(Link.Location, FVector(LOCATION_FRAME_EXTENT));
+#if ENGINE_MAJOR_VERSION >= 5
+	if (Link.ActorGuid.IsValid() && !GetActorBounds(*World, Link.ActorGuid, Target))
+	{
+		UE_LOG(LogHermesContentEndpoint, Error, TEXT("%s doesn't have an actor with the GUID %s"),
+		       *Link.Map.PackageName.ToString(), *Link.ActorGuid.ToString());
+		return;
+	}
+
+	if (UWorldPartition* WorldPartition = World->GetWorldPartition())
+	{
+		LoadRegion(*World, *WorldPartition, Target.ExpandBy(Link.Radius));
+	}
+
+	AActor* Actor = Link.ActorGuid.IsValid() ? FindLoadedActor(*World, Link.ActorGuid) : nullptr;
+	if (Actor != nullptr)
+	{
+		GEditor->SelectNone(/* bNoteSelectionChange = */ false, /* bDeselectBSPSurfs = */ true);
+		GEditor->SelectActor(Actor, /* bInSelected = */ true, /* bNotify = */ true);
+		Target = Actor->GetComponentsBoundingBox(/* bNonColliding = */ true);
+	}
+#else
+	if (Link.ActorGuid.IsValid())
+	{
+		UE_LOG(LogHermesContentEndpoint, Error, TEXT("Links to actors need Unreal Engine 5, framing the map's origin"));
+	}
+#endif
+
+	GEditor->MoveViewportCamerasToBox(Target, /* bActiveViewportOnly = */ false);
+
+	UE_LOG(LogHermesContentEndpoint, Display, TEXT("Opened %s at %s in %.1f s"), *Link.Map.PackageName.ToString(),
+	       Link.ActorGuid.IsValid() ? *Link.ActorGuid.ToString() : *Link.Location.ToString(),
+	       FPlatformTime::Seconds() - StartTime);
+}
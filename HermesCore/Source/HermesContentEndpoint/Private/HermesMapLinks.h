@@ -0,0 +1,32 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#pragma once
+
+#include <AssetRegistry/AssetData.h>
+#include <CoreMinimal.h>
+#include <HermesServer.h>
+
+/**
+ * A link to a spot inside a map, like "/Game/Maps/World?actor=<guid>" or "/Game/Maps/World?loc=100,200,300". An
+ * optional "&radius=<units>" controls how much of a World Partition map around the target is loaded.
+ */
+struct FHermesMapLink
+{
+	FAssetData Map;
+	/** The actor to frame, if it's valid. Otherwise Location is framed. */
+	FGuid ActorGuid;
+	FVector Location = FVector::ZeroVector;
+	/** How far around the target to load, in world units */
+	float Radius = 0.0f;
+};
+
+namespace HermesMapLinks
+{
+	/** Returns true if the query asks for a spot inside the map, and fills out everything but OutLink.Map */
+	bool ParseTarget(const FHermesQueryParamsMap& QueryParams, FHermesMapLink& OutLink);
+
+	/**
+	 * Open the map (if it isn't already), load only what's around the target if it uses World Partition, and frame the
+	 * target in the level viewports.
+	 */
+	void Open(const FHermesMapLink& Link);
+}
@@ -0,0 +1,264 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#include "HermesPreviewCache.h"
+
+#include "HermesContentEndpoint.h"
+
+#include <AssetRegistry/AssetRegistryModule.h>
+#include <Dom/JsonObject.h>
+#include <Editor.h>
+#include <HAL/FileManager.h>
+#include <HermesServer.h>
+#include <IImageWrapper.h>
+#include <IImageWrapperModule.h>
+#include <Misc/Base64.h>
+#include <Misc/FileHelper.h>
+#include <Misc/ObjectThumbnail.h>
+#include <Misc/PackageName.h>
+#include <Misc/Paths.h>
+#include <ObjectTools.h>
+#include <Policies/CondensedJsonPrintPolicy.h>
+#include <Serialization/JsonReader.h>
+#include <Serialization/JsonSerializer.h>
+#include <TimerManager.h>
+#include <UObject/Package.h>
+#if ENGINE_MAJOR_VERSION == 5 && ENGINE_MINOR_VERSION >= 1 || ENGINE_MAJOR_VERSION > 5
+#include <IO/IoHash.h>
+#endif
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Preview cache hits"), STAT_HermesPreviewCacheHits, STATGROUP_HermesServer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Preview cache misses"), STAT_HermesPreviewCacheMisses, STATGROUP_HermesServer);
+
+namespace HermesPreviewCachePrivate
+{
+	static const FName NAME_World(TEXT("World"));
+
+	/** Identifies the saved contents of a package, so that entries can be checked without opening the package */
+	static FString GetSavedHash(const IAssetRegistry& AssetRegistry, FName PackageName)
+	{
+#if ENGINE_MAJOR_VERSION == 5 && ENGINE_MINOR_VERSION >= 1 || ENGINE_MAJOR_VERSION > 5
+		const TOptional<FAssetPackageData> PackageData = AssetRegistry.GetAssetPackageDataCopy(PackageName);
+		return PackageData.IsSet() ? LexToString(PackageData->GetPackageSavedHash()) : FString();
+#else
+		PRAGMA_DISABLE_DEPRECATION_WARNINGS
+		const FAssetPackageData* PackageData = AssetRegistry.GetAssetPackageData(PackageName);
+		return PackageData != nullptr ? PackageData->PackageGuid.ToString() : FString();
+		PRAGMA_ENABLE_DEPRECATION_WARNINGS
+#endif
+	}
+
+	/** Read the thumbnail that was saved along with the asset, rather than rendering a new one */
+	static FString GetThumbnailDataUri(const FString& PackageFilename, const FAssetData& Asset)
+	{
+		const FName ObjectFullName(*Asset.GetFullName());
+		FThumbnailMap Thumbnails;
+		if (!ThumbnailTools::LoadThumbnailsFromPackage(PackageFilename, {ObjectFullName}, Thumbnails))
+		{
+			return FString();
+		}
+
+		FObjectThumbnail* Thumbnail = Thumbnails.Find(ObjectFullName);
+		if (Thumbnail == nullptr || Thumbnail->IsEmpty())
+		{
+			return FString();
+		}
+
+		const TArray<uint8>& Pixels = Thumbnail->GetUncompressedImageData();
+		IImageWrapperModule& ImageWrapperModule = FModuleManager::LoadModuleChecked<IImageWrapperModule>("ImageWrapper");
+		TSharedPtr<IImageWrapper> Png = ImageWrapperModule.CreateImageWrapper(EImageFormat::PNG);
+		if (!Png.IsValid() || !Png->SetRaw(Pixels.GetData(), Pixels.Num(), Thumbnail->GetImageWidth(),
+		                                   Thumbnail->GetImageHeight(), ERGBFormat::BGRA, 8))
+		{
+			return FString();
+		}
+
+		const TArray64<uint8> Compressed = Png->GetCompressed();
+		return TEXT("data:image/png;base64,") + FBase64::Encode(Compressed.GetData(), Compressed.Num());
+	}
+
+	static TSharedPtr<FJsonObject> ReadEntry(const FString& EntryFilename)
+	{
+		FString Json;
+		if (!FFileHelper::LoadFileToString(Json, *EntryFilename))
+		{
+			return nullptr;
+		}
+
+		TSharedPtr<FJsonObject> Entry;
+		const TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Json);
+		return FJsonSerializer::Deserialize(Reader, Entry) ? Entry : nullptr;
+	}
+
+	static FString GetStringField(const TSharedPtr<FJsonObject>& Entry, const TCHAR* Field)
+	{
+		FString Value;
+		Entry->TryGetStringField(Field, Value);
+		return Value;
+	}
+
+	/** Write to a temporary file first, so that nobody reading the cache ever sees half an entry */
+	static bool WriteEntry(const FString& EntryFilename, const TSharedRef<FJsonObject>& Entry)
+	{
+		FString Json;
+		const TSharedRef<TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>> Writer = TJsonWriterFactory<
+			TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&Json);
+		if (!FJsonSerializer::Serialize(Entry, Writer))
+		{
+			return false;
+		}
+
+		const FString TempFilename = EntryFilename + TEXT(".tmp");
+		return FFileHelper::SaveStringToFile(Json, *TempFilename, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM) &&
+			IFileManager::Get().Move(*EntryFilename, *TempFilename, /* Replace = */ true, /* EvenIfReadOnly = */ true);
+	}
+}
+
+void FHermesPreviewCache::Install()
+{
+#if ENGINE_MAJOR_VERSION >= 5
+	PackageSavedDelegateHandle = UPackage::PackageSavedWithContextEvent.AddRaw(
+		this, &FHermesPreviewCache::OnPackageSaved);
+#else
+	PackageSavedDelegateHandle = UPackage::PackageSavedEvent.AddRaw(this, &FHermesPreviewCache::OnPackageSaved);
+#endif
+}
+
+void FHermesPreviewCache::Uninstall()
+{
+	if (PackageSavedDelegateHandle.IsValid())
+	{
+#if ENGINE_MAJOR_VERSION >= 5
+		UPackage::PackageSavedWithContextEvent.Remove(PackageSavedDelegateHandle);
+#else
+		UPackage::PackageSavedEvent.Remove(PackageSavedDelegateHandle);
+#endif
+		PackageSavedDelegateHandle.Reset();
+	}
+
+	if (GEditor != nullptr)
+	{
+		GEditor->GetTimerManager()->ClearAllTimersForObject(this);
+	}
+	SavedPackages.Reset();
+}
+
+bool FHermesPreviewCache::Refresh(FName PackageName, const FString& SavedBy)
+{
+	using namespace HermesPreviewCachePrivate;
+
+	IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry").Get();
+	TArray<FAssetData> Assets;
+	AssetRegistry.GetAssetsByPackageName(PackageName, Assets);
+	if (Assets.Num() == 0)
+	{
+		return false;
+	}
+
+	const FAssetData* PrimaryAsset = Assets.FindByPredicate([](const FAssetData& Asset) { return Asset.IsUAsset(); });
+	if (PrimaryAsset == nullptr)
+	{
+		PrimaryAsset = &Assets[0];
+	}
+
+	const FName ClassName = GetAssetClassName(*PrimaryAsset);
+	const FString& Extension = ClassName == NAME_World
+		                           ? FPackageName::GetMapPackageExtension()
+		                           : FPackageName::GetAssetPackageExtension();
+	const FString PackageFilename = FPackageName::LongPackageNameToFilename(PackageName.ToString(), Extension);
+	const FString SavedAt = IFileManager::Get().GetTimeStamp(*PackageFilename).ToIso8601();
+	FString Key = GetSavedHash(AssetRegistry, PackageName);
+	if (Key.IsEmpty())
+	{
+		Key = SavedAt;
+	}
+
+	// Who saved a package is only known when it's saved in this editor, so hang on to that for as long as the file on
+	// disk is the one they saved
+	const FString EntryFilename = GetEntryFilename(PackageName);
+	FString LastSavedBy = SavedBy;
+	if (const TSharedPtr<FJsonObject> Existing = ReadEntry(EntryFilename))
+	{
+		const bool bSameFile = GetStringField(Existing, TEXT("savedAt")) == SavedAt;
+		if (bSameFile && GetStringField(Existing, TEXT("key")) == Key && SavedBy.IsEmpty())
+		{
+			INC_DWORD_STAT(STAT_HermesPreviewCacheHits);
+			return true;
+		}
+		if (bSameFile && LastSavedBy.IsEmpty())
+		{
+			LastSavedBy = GetStringField(Existing, TEXT("savedBy"));
+		}
+	}
+
+	INC_DWORD_STAT(STAT_HermesPreviewCacheMisses);
+	const double StartTime = FPlatformTime::Seconds();
+	const TSharedRef<FJsonObject> Entry = MakeShared<FJsonObject>();
+	Entry->SetStringField(TEXT("package"), PackageName.ToString());
+	Entry->SetStringField(TEXT("key"), Key);
+	Entry->SetStringField(TEXT("asset"), PrimaryAsset->AssetName.ToString());
+	Entry->SetStringField(TEXT("class"), ClassName.ToString());
+	Entry->SetNumberField(TEXT("diskSize"), FMath::Max<int64>(0, IFileManager::Get().FileSize(*PackageFilename)));
+	Entry->SetStringField(TEXT("savedAt"), SavedAt);
+	Entry->SetStringField(TEXT("savedBy"), LastSavedBy);
+	Entry->SetStringField(TEXT("thumbnail"), GetThumbnailDataUri(PackageFilename, *PrimaryAsset));
+	if (!WriteEntry(EntryFilename, Entry))
+	{
+		UE_LOG(LogHermesContentEndpoint, Error, TEXT("Couldn't write the preview of %s to %s"), *PackageName.ToString(),
+		       *EntryFilename);
+		return true;
+	}
+
+	UE_LOG(LogHermesContentEndpoint, Verbose, TEXT("Updated the preview of %s in %.2f ms"), *PackageName.ToString(),
+	       (FPlatformTime::Seconds() - StartTime) * 1000.0);
+	return true;
+}
+
+FString FHermesPreviewCache::GetEntryFilename(FName PackageName)
+{
+	// Package names start with a slash, so e.g. /Game/Maps/Entry ends up in Previews/Game/Maps/Entry.json
+	return FPaths::ProjectSavedDir() / TEXT("Hermes") / TEXT("Previews") + PackageName.ToString() + TEXT(".json");
+}
+
+#if ENGINE_MAJOR_VERSION >= 5
+void FHermesPreviewCache::OnPackageSaved(const FString& Filename, UPackage* Package, FObjectPostSaveContext SaveContext)
+{
+	if (SaveContext.IsProceduralSave())
+	{
+		return;
+	}
+#else
+void FHermesPreviewCache::OnPackageSaved(const FString& Filename, UObject* Outer)
+{
+	UPackage* Package = Cast<UPackage>(Outer);
+#endif
+
+	// Skip autosaves and anything else that isn't written to where the package lives
+	FString PackageName;
+	if (Package == nullptr || !FPackageName::TryConvertFilenameToLongPackageName(Filename, PackageName) ||
+		PackageName != Package->GetName())
+	{
+		return;
+	}
+
+	// Only entries that someone has asked for are kept up to date
+	if (!IFileManager::Get().FileExists(*GetEntryFilename(Package->GetFName())))
+	{
+		return;
+	}
+
+	if (SavedPackages.Num() == 0)
+	{
+		GEditor->GetTimerManager()->SetTimerForNextTick(
+			FTimerDelegate::CreateRaw(this, &FHermesPreviewCache::RefreshSavedPackages));
+	}
+	SavedPackages.Add(Package->GetFName());
+}
+
+void FHermesPreviewCache::RefreshSavedPackages()
+{
+	const FString SavedBy = FPlatformProcess::UserName(/* bOnlyAlphaNumeric = */ false);
+	for (const FName PackageName : SavedPackages)
+	{
+		Refresh(PackageName, SavedBy);
+	}
+	SavedPackages.Reset();
+}
@@ -0,0 +1,40 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#pragma once
+
+#include <CoreMinimal.h>
+#include <Runtime/Launch/Resources/Version.h>
+#if ENGINE_MAJOR_VERSION >= 5
+#include <UObject/ObjectSaveContext.h>
+#endif
+
+class UPackage;
+
+/**
+ * An on-disk cache of what content links point at, for chat integrations & bots that want to unfurl links without
+ * asking the editor to render anything. Each package gets a single JSON file under Saved/Hermes/Previews with its
+ * class, size, when & by whom it was last saved, and its thumbnail as a PNG data URI, so an entry can be served in one
+ * read. Entries are keyed by the package's saved hash, and are brought up to date whenever the package is saved.
+ */
+struct FHermesPreviewCache
+{
+	/** Start updating cached entries as packages are saved */
+	void Install();
+	void Uninstall();
+
+	/** Make sure the package's entry is up to date, returns false if there's no such package */
+	bool Refresh(FName PackageName, const FString& SavedBy = FString());
+
+	static FString GetEntryFilename(FName PackageName);
+
+private:
+#if ENGINE_MAJOR_VERSION >= 5
+	void OnPackageSaved(const FString& Filename, UPackage* Package, FObjectPostSaveContext SaveContext);
+#else
+	void OnPackageSaved(const FString& Filename, UObject* Package);
+#endif
+	void RefreshSavedPackages();
+
+	/** Packages that were saved this frame, refreshed on the next one once the asset registry has caught up */
+	TSet<FName> SavedPackages;
+	FDelegateHandle PackageSavedDelegateHandle;
+};
@@ -0,0 +1,261 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#include "HermesContentBenchmark.h"
+#include "HermesContentEndpoint.h"
+
+#include <AssetRegistry/AssetRegistryModule.h>
+#include <ContentBrowserModule.h>
+#include <HermesMemoryTransport.h>
+#include <HermesServer.h>
+#include <IContentBrowserSingleton.h>
+#include <Misc/AutomationTest.h>
+#include <Misc/CommandLine.h>
+#include <Misc/OutputDevice.h>
+#include <Misc/Parse.h>
+#include <Modules/ModuleManager.h>
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace HermesContentBenchmarkTestPrivate
+{
+	/** How long a single link gets to show up in the content browser before the test gives up */
+	static constexpr double REQUEST_TIMEOUT_SECONDS = 10.0;
+	/** How long the asset registry and the server get to finish starting up */
+	static constexpr double STARTUP_TIMEOUT_SECONDS = 120.0;
+	/** The links cycle through this many distinct packages, which is plenty to keep the content browser busy */
+	static constexpr int32 MAX_PACKAGES = 64;
+
+	/** Forwards everything the benchmark prints to the test's log, so that it ends up in the automation report */
+	class FAutomationOutputDevice : public FOutputDevice
+	{
+	public:
+		explicit FAutomationOutputDevice(FAutomationTestBase& InTest)
+			: Test(InTest)
+		{
+		}
+
+		virtual void Serialize(const TCHAR* V, ELogVerbosity::Type Verbosity, const FName& Category) override
+		{
+			Test.AddInfo(V);
+		}
+
+	private:
+		FAutomationTestBase& Test;
+	};
+
+	struct FRequestPathState
+	{
+		IHermesServerModule* Hermes = nullptr;
+		int32 NumRequests = 200;
+		FString ContentPath = TEXT("/Game");
+		/** Zero means "don't check" */
+		double MaxP99Ms = 0.0;
+
+		TArray<FName> Packages;
+		int32 NextRequest = 0;
+		double StartTime = 0.0;
+		double SentTime = 0.0;
+		bool bWaiting = false;
+		double FirstDuration = 0.0;
+		TArray<double> Durations;
+
+		void ParseCommandLine(const TCHAR* CommandLine)
+		{
+			FParse::Value(CommandLine, TEXT("-HermesContentBenchmarkRequests="), NumRequests);
+			FParse::Value(CommandLine, TEXT("-HermesContentBenchmarkPath="), ContentPath);
+			FParse::Value(CommandLine, TEXT("-HermesContentBenchmarkMaxP99Ms="), MaxP99Ms);
+			NumRequests = FMath::Max(NumRequests, 2);
+		}
+
+		/** Pick the packages to link to, skipping maps since opening those replaces the level that's open */
+		void GatherPackages(IAssetRegistry& AssetRegistry)
+		{
+			TArray<FAssetData> Assets;
+			AssetRegistry.GetAssetsByPath(FName(*ContentPath), Assets, true);
+			Assets.Sort([](const FAssetData& A, const FAssetData& B)
+			{
+				return A.PackageName.LexicalLess(B.PackageName);
+			});
+			for (const FAssetData& Asset : Assets)
+			{
+				if (Packages.Num() >= MAX_PACKAGES)
+				{
+					break;
+				}
+				if (!Asset.IsRedirector() && GetAssetClassName(Asset) != NAME_World)
+				{
+					Packages.AddUnique(Asset.PackageName);
+				}
+			}
+		}
+	};
+
+	static bool IsSelectedInContentBrowser(FName PackageName)
+	{
+		IContentBrowserSingleton& ContentBrowser = FModuleManager::LoadModuleChecked<FContentBrowserModule>(
+			"ContentBrowser").Get();
+		TArray<FAssetData> Selected;
+		ContentBrowser.GetSelectedAssets(Selected);
+		return Selected.ContainsByPredicate([PackageName](const FAssetData& Asset)
+		{
+			return Asset.PackageName == PackageName;
+		});
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FHermesContentResolveBenchmarkTest, "Hermes.Content.Benchmark.Resolve",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+/**
+ * Runs Hermes.Content.Benchmark with its default sizes. That only measures HermesContentResolver against a synthetic
+ * registry, see Hermes.Content.Benchmark.RequestPath for what a link costs from start to finish.
+ */
+bool FHermesContentResolveBenchmarkTest::RunTest(const FString& Parameters)
+{
+	using namespace HermesContentBenchmarkTestPrivate;
+
+	int32 NumAssets = 100000;
+	int32 NumRequests = 10000;
+	FParse::Value(FCommandLine::Get(), TEXT("-HermesContentBenchmarkAssets="), NumAssets);
+	FParse::Value(FCommandLine::Get(), TEXT("-HermesContentBenchmarkResolves="), NumRequests);
+
+	FAutomationOutputDevice Output(*this);
+	HermesContentBenchmark::Run(NumAssets, NumRequests, Output);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FHermesContentRequestPathBenchmarkTest, "Hermes.Content.Benchmark.RequestPath",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+/**
+ * Sends content links for real assets through the memory transport, one at a time, and measures how long it takes
+ * until each one is selected in the content browser. That covers the whole path a clicked link takes once it reaches
+ * the editor: duplicate filtering, queueing, the coalescing window, resolving against the asset registry, syncing the
+ * content browser, and the Slate tick that applies the sync. Links that open editors aren't covered.
+ *
+ * Needs the memory transport (-HermesMemoryTransport), and an editor with a content browser, so it doesn't run with
+ * -nullrhi. The assets come from -HermesContentBenchmarkPath (/Game by default).
+ */
+bool FHermesContentRequestPathBenchmarkTest::RunTest(const FString& Parameters)
+{
+	using namespace HermesContentBenchmarkTestPrivate;
+
+	const TSharedRef<FRequestPathState> State = MakeShared<FRequestPathState>();
+	State->Hermes = FModuleManager::GetModulePtr<IHermesServerModule>("HermesServer");
+	if (!TestNotNull(TEXT("HermesServer module"), State->Hermes))
+	{
+		return false;
+	}
+	if (State->Hermes->GetMemoryTransport() == nullptr)
+	{
+		AddError(TEXT("Run with -HermesMemoryTransport, so that links can be sent without going through the OS"));
+		return false;
+	}
+
+	State->ParseCommandLine(FCommandLine::Get());
+	State->StartTime = FPlatformTime::Seconds();
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, State]
+	{
+		const double Now = FPlatformTime::Seconds();
+		IHermesMemoryTransport* Transport = State->Hermes->GetMemoryTransport();
+		if (State->Packages.Num() == 0)
+		{
+			// The content endpoint holds on to links until the registry has loaded, which isn't what we're measuring
+			IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry").
+				Get();
+			if (AssetRegistry.IsLoadingAssets() || Transport->GetRegisteredScheme().IsEmpty())
+			{
+				if (Now - State->StartTime > STARTUP_TIMEOUT_SECONDS)
+				{
+					AddError(TEXT("Timed out waiting for the asset registry and the server to start"));
+					return true;
+				}
+				return false;
+			}
+
+			State->GatherPackages(AssetRegistry);
+			if (State->Packages.Num() < 2)
+			{
+				AddError(FString::Printf(TEXT("Need at least two assets under %s to link to, found %d"),
+				                         *State->ContentPath, State->Packages.Num()));
+				return true;
+			}
+			AddInfo(FString::Printf(TEXT("Sending %d link(s) to %d package(s) under %s"), State->NumRequests,
+			                        State->Packages.Num(), *State->ContentPath));
+		}
+
+		// Consecutive links go to different packages, so the selection always has to change. The query string keeps
+		// the duplicate filter from dropping links to a package we've linked to recently.
+		const FName PackageName = State->Packages[State->NextRequest % State->Packages.Num()];
+		if (!State->bWaiting)
+		{
+			const FString Uri = State->Hermes->GetUri(NAME_EndpointId, PackageName.ToString()) +
+				FString::Printf(TEXT("?hermesbenchmark=%d"), State->NextRequest);
+			State->SentTime = FPlatformTime::Seconds();
+			if (!Transport->Send(Uri))
+			{
+				AddError(FString::Printf(TEXT("Unable to send %s"), *Uri));
+				return true;
+			}
+			Transport->Flush();
+			for (const FHermesMemoryTransportResult& Result : Transport->ConsumeResults())
+			{
+				if (Result.Result != EHermesDispatchResult::Queued && Result.Result != EHermesDispatchResult::Dispatched)
+				{
+					AddError(FString::Printf(TEXT("%s wasn't accepted (%s)"), *Result.Uri, LexToString(Result.Result)));
+					return true;
+				}
+			}
+			State->bWaiting = true;
+			return false;
+		}
+
+		if (!IsSelectedInContentBrowser(PackageName))
+		{
+			if (Now - State->SentTime > REQUEST_TIMEOUT_SECONDS)
+			{
+				AddError(FString::Printf(TEXT("%s wasn't selected in the content browser after %.0f s"),
+				                         *PackageName.ToString(), REQUEST_TIMEOUT_SECONDS));
+				return true;
+			}
+			return false;
+		}
+
+		// The first link opens the content browser too, so it's reported on its own
+		const double Duration = (Now - State->SentTime) * 1000.0;
+		if (State->NextRequest == 0)
+		{
+			State->FirstDuration = Duration;
+		}
+		else
+		{
+			State->Durations.Add(Duration);
+		}
+		State->bWaiting = false;
+		if (++State->NextRequest < State->NumRequests)
+		{
+			return false;
+		}
+
+		TArray<double>& Durations = State->Durations;
+		Durations.Sort();
+		double Total = 0.0;
+		for (const double Value : Durations)
+		{
+			Total += Value;
+		}
+		const double P99 = Durations[FMath::Min(Durations.Num() - 1, Durations.Num() * 99 / 100)];
+		AddInfo(FString::Printf(TEXT("First link %.2f ms, then mean %.2f ms, p50 %.2f ms, p99 %.2f ms, max %.2f ms"),
+		                        State->FirstDuration, Total / Durations.Num(), Durations[Durations.Num() / 2], P99,
+		                        Durations.Last()));
+		AddInfo(TEXT("Every link waits for the coalescing window, and for the next frame after it's been handled"));
+		if (State->MaxP99Ms > 0.0 && P99 > State->MaxP99Ms)
+		{
+			AddError(FString::Printf(TEXT("p99 latency is %.2f ms, the limit is %.2f ms"), P99, State->MaxP99Ms));
+		}
+		return true;
+	}));
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,73 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#pragma once
+
+// The layout of the link index written by Hermes.Content.ExportIndex, shared with Tools/HermesLinkResolver. This header
+// doesn't depend on the engine.
+//
+// The file is meant to be memory-mapped and used as-is: a header, followed by an array of fixed-size entries sorted by
+// package name, followed by a blob of NUL-terminated UTF-8 strings that the entries point into. Everything is
+// little-endian. Finding the assets in a package is a binary search over the entries.
+
+#include <cstdint>
+
+namespace HermesLinkIndex
+{
+	static constexpr char MAGIC[8] = {'H', 'R', 'M', 'S', 'L', 'I', 'N', 'K'};
+	static constexpr uint32_t VERSION = 1;
+	/** Used for string offsets that don't point at anything */
+	static constexpr uint32_t NO_STRING = 0xFFFFFFFFu;
+
+	enum EEntryFlags : uint32_t
+	{
+		/** The asset is a redirector that was left behind by a rename, see FEntry::RedirectsTo */
+		Redirector = 1u << 0,
+		/** The asset is the package's primary asset, i.e. the one that gets opened for editing */
+		PrimaryAsset = 1u << 1,
+	};
+
+	struct FHeader
+	{
+		char Magic[8];
+		uint32_t Version;
+		uint32_t NumEntries;
+		/** Offsets from the start of the file */
+		uint64_t EntriesOffset;
+		uint64_t StringsOffset;
+		uint64_t StringsSize;
+		/** Seconds since the Unix epoch (UTC) when the index was exported */
+		int64_t ExportTime;
+	};
+	static_assert(sizeof(FHeader) == 48, "FHeader must have the same layout everywhere");
+
+	struct FEntry
+	{
+		/** Offsets into the string blob */
+		uint32_t PackageName;
+		uint32_t AssetName;
+		uint32_t ClassName;
+		/** The package a redirector points at, or NO_STRING */
+		uint32_t RedirectsTo;
+		/** Size of the package on disk in bytes, or 0 if it's not known */
+		uint64_t DiskSize;
+		uint32_t Flags;
+		uint32_t Reserved;
+	};
+	static_assert(sizeof(FEntry) == 32, "FEntry must have the same layout everywhere");
+
+	/**
+	 * The order entries are sorted in. Package names are case-insensitive, so this compares the UTF-8 bytes with ASCII
+	 * letters folded to lower case.
+	 */
+	inline int ComparePackageNames(const char* A, const char* B)
+	{
+		for (;; ++A, ++B)
+		{
+			const unsigned char CharA = static_cast<unsigned char>(*A >= 'A' && *A <= 'Z' ? *A - 'A' + 'a' : *A);
+			const unsigned char CharB = static_cast<unsigned char>(*B >= 'A' && *B <= 'Z' ? *B - 'A' + 'a' : *B);
+			if (CharA != CharB || CharA == 0)
+			{
+				return CharA < CharB ? -1 : CharA > CharB ? 1 : 0;
+			}
+		}
+	}
+}
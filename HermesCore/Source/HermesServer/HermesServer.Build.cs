@@ -11,14 +11,26 @@ public class HermesServer : ModuleRules
 		PrivateDependencyModuleNames.AddRange(
 			new[]
 			{
+				"AssetRegistry",
 				"CoreUObject",
 				"DeveloperSettings",
 				"Engine",
-				"HermesURLHandler",
 				"HTTP",
 				"Projects",
-				"UnrealEd",
+				"Sockets",
 			}
 		);
+
+		// Game builds can receive links too, but only the editor registers with the OS URL handler
+		if (Target.bBuildEditor)
+		{
+			PrivateDependencyModuleNames.AddRange(
+				new[]
+				{
+					"HermesURLHandler",
+					"UnrealEd",
+				}
+			);
+		}
 	}
 }
@@ -1,32 +1,236 @@
 // Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
 #include "GenericHermesServer.h"
 
+#include "HermesBlueprintEndpoints.h"
+#include "HermesLinkHistory.h"
+#include "HermesLoopbackServer.h"
+#include "HermesMemoryQueueTransport.h"
+#include "HermesPathParser.h"
 #include "HermesPluginSettings.h"
+#include "HermesPrefetcher.h"
+#include "HermesRequestJournal.h"
+#include "HermesRequestSpool.h"
 #include "HermesUriSchemeProvider.h"
+#if PLATFORM_UNIX
+#include "Unix/HermesUnixSocketTransport.h"
+#endif
 
+#include <AssetRegistry/AssetRegistryModule.h>
+#include <Async/Async.h>
+#include <Containers/Ticker.h>
 #include <Features/IModularFeatures.h>
+#include <HAL/IConsoleManager.h>
 #include <Misc/CommandLine.h>
 #include <Misc/ConfigCacheIni.h>
+#include <Modules/ModuleManager.h>
 #include <PlatformHttp.h>
 
+#if WITH_EDITOR
+#include <Editor.h>
+#endif
+
+#if ENGINE_MAJOR_VERSION >= 5
+typedef FTSTicker FHermesCoreTicker;
+#else
+typedef FTicker FHermesCoreTicker;
+#endif
+
 DEFINE_LOG_CATEGORY(LogHermesServer);
-DECLARE_STATS_GROUP(TEXT("HermesServer"), STATGROUP_HermesServer, STATCAT_Advanced);
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Requests received"), STAT_HermesRequestsReceived, STATGROUP_HermesServer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Requests dispatched"), STAT_HermesRequestsDispatched, STATGROUP_HermesServer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Requests queued"), STAT_HermesRequestsQueued, STATGROUP_HermesServer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Requests coalesced"), STAT_HermesRequestsCoalesced, STATGROUP_HermesServer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Requests deferred"), STAT_HermesRequestsDeferred, STATGROUP_HermesServer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Requests rejected"), STAT_HermesRequestsRejected, STATGROUP_HermesServer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Requests dropped"), STAT_HermesRequestsDropped, STATGROUP_HermesServer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Duplicate requests"), STAT_HermesRequestsDuplicate, STATGROUP_HermesServer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Requests without a handler"), STAT_HermesRequestsNoHandler,
+                               STATGROUP_HermesServer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Interactive queue depth"), STAT_HermesInteractiveQueueDepth,
+                               STATGROUP_HermesServer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Scripted queue depth"), STAT_HermesScriptedQueueDepth, STATGROUP_HermesServer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Background queue depth"), STAT_HermesBackgroundQueueDepth,
+                               STATGROUP_HermesServer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Deferred until PIE ends"), STAT_HermesDeferredDepth, STATGROUP_HermesServer);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Waiting for endpoint to load"), STAT_HermesParkedDepth, STATGROUP_HermesServer);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Handler calls"), STAT_HermesHandlerCalls, STATGROUP_HermesServer);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Handler time (ms)"), STAT_HermesHandlerTime, STATGROUP_HermesServer);
+
+// How long after startup we wait before prefetching, so that we're not competing with everything else that's starting
+static constexpr double PREFETCH_STARTUP_DELAY = 30.0;
+// Prefetching waits until this long after the last request, so that it doesn't slow down someone opening links
+static constexpr double PREFETCH_IDLE_TIME = 10.0;
+// How often the link history is saved, if it's changed. It's always saved on shutdown.
+static constexpr double LINK_HISTORY_SAVE_INTERVAL = 5.0 * 60.0;
+// How long to wait before trying to listen for the scheme again, when another process has the mailslot or socket. The
+// wait doubles after every attempt, up to SCHEME_RETRY_MAX_INTERVAL, since the other process is usually there to stay.
+static constexpr float SCHEME_RETRY_INTERVAL = 10.0f;
+static constexpr float SCHEME_RETRY_MAX_INTERVAL = 10.0f * 60.0f;
+
+/** True while a PIE or Simulate session is running, which can only happen in the editor */
+static bool IsPlaySessionInProgress()
+{
+#if WITH_EDITOR
+	return GEditor != nullptr && GEditor->IsPlaySessionInProgress();
+#else
+	return false;
+#endif
+}
+
+/** Game builds listen for links unless they're shipping builds, or they've been told not to with -NoHermes */
+static bool ShouldListen()
+{
+#if WITH_EDITOR
+	return true;
+#else
+	return !UE_BUILD_SHIPPING && !FParse::Param(FCommandLine::Get(), TEXT("NoHermes"));
+#endif
+}
+
+FGenericHermesServer::FGenericHermesServer() = default;
+FGenericHermesServer::~FGenericHermesServer() = default;
 
 void FGenericHermesServer::StartupModule()
 {
-	RefreshRegisteredScheme();
+	const double StartTime = FPlatformTime::Seconds();
+	IModularFeatures& Features = IModularFeatures::Get();
+	GameThreadTaskToken = MakeShared<bool, ESPMode::ThreadSafe>(true);
 
-	auto OnModularFeaturesChanged = [&](const FName& Type, class IModularFeature*)
+	// Endpoints can always register, but without any transports nothing will ever be dispatched to them
+	bListening = ShouldListen();
+	if (bListening)
 	{
-		if (Type == IHermesUriSchemeProvider::GetModularFeatureName())
+		StartLoopbackServer();
+		StartMemoryTransport();
+#if PLATFORM_UNIX
+		UnixSocketTransport = MakeUnique<FHermesUnixSocketTransport>();
+		Features.RegisterModularFeature(IHermesTransport::GetModularFeatureName(), UnixSocketTransport.Get());
+#endif
+#if WITH_EDITOR
+		// Tests drive the memory transport, and shouldn't pick up links that were meant for a real editor. Links are only
+		// spooled for an editor, since that's what the URL handler launches.
+		if (!MemoryTransport.IsValid())
 		{
-			RefreshRegisteredScheme();
+			RequestSpool = MakeUnique<FHermesRequestSpool>();
+			Features.RegisterModularFeature(IHermesTransport::GetModularFeatureName(), RequestSpool.Get());
 		}
-	};
+#endif
+	}
+	else
+	{
+		UE_LOG(LogHermesServer, Display, TEXT("Not listening for links in this build"));
+	}
 
-	IModularFeatures& Features = IModularFeatures::Get();
-	OnModularFeatureRegisteredHandle = Features.OnModularFeatureRegistered().AddLambda(OnModularFeaturesChanged);
-	OnModularFeatureUnregisteredHandle = Features.OnModularFeatureUnregistered().AddLambda(OnModularFeaturesChanged);
+	for (IHermesTransport* Transport : Features.GetModularFeatureImplementations<IHermesTransport>(
+		     IHermesTransport::GetModularFeatureName()))
+	{
+		StartTransport(*Transport);
+	}
+
+	OnModularFeatureRegisteredHandle = Features.OnModularFeatureRegistered().AddLambda(
+		[this](const FName& Type, IModularFeature* Feature)
+		{
+			if (Type == IHermesUriSchemeProvider::GetModularFeatureName())
+			{
+				RefreshRegisteredScheme();
+			}
+			else if (Type == IHermesTransport::GetModularFeatureName())
+			{
+				StartTransport(*static_cast<IHermesTransport*>(Feature));
+			}
+		});
+	OnModularFeatureUnregisteredHandle = Features.OnModularFeatureUnregistered().AddLambda(
+		[this](const FName& Type, IModularFeature* Feature)
+		{
+			if (Type == IHermesUriSchemeProvider::GetModularFeatureName())
+			{
+				RefreshRegisteredScheme();
+			}
+			else if (Type == IHermesTransport::GetModularFeatureName())
+			{
+				StopTransport(*static_cast<IHermesTransport*>(Feature));
+			}
+		});
+
+	Watchdog = MakeUnique<FHermesHandlerWatchdog>();
+
+#if WITH_EDITOR
+	LinkHistory = MakeUnique<FHermesLinkHistory>();
+	LinkHistory->Load(FHermesLinkHistory::GetDefaultFilename());
+#endif
+
+	IConsoleManager& ConsoleManager = IConsoleManager::Get();
+	ConsoleCommands.Add(ConsoleManager.RegisterConsoleCommand(
+		TEXT("Hermes.QueueCounters"),
+		TEXT("Print the backpressure counters for each of the Hermes request queues"),
+		FConsoleCommandWithOutputDeviceDelegate::CreateRaw(this, &FGenericHermesServer::DumpQueueCounters)));
+	ConsoleCommands.Add(ConsoleManager.RegisterConsoleCommand(
+		TEXT("Hermes.Stats"),
+		TEXT(
+			"Print how many requests each endpoint has handled, and percentiles of how long they took from arrival until they were handled"),
+		FConsoleCommandWithOutputDeviceDelegate::CreateRaw(this, &FGenericHermesServer::DumpStats)));
+	ConsoleCommands.Add(ConsoleManager.RegisterConsoleCommand(
+		TEXT("Hermes.StartupCost"),
+		TEXT("Print how much time the Hermes modules have added to editor startup, and what they've put off until later"),
+		FConsoleCommandWithOutputDeviceDelegate::CreateRaw(this, &FGenericHermesServer::DumpStartupCosts)));
+#if WITH_EDITOR
+	ConsoleCommands.Add(ConsoleManager.RegisterConsoleCommand(
+		TEXT("Hermes.LinkHistory"),
+		TEXT("Print the most popular links that can be prefetched, and what was prefetched after startup"),
+		FConsoleCommandWithOutputDeviceDelegate::CreateRaw(this, &FGenericHermesServer::DumpLinkHistory)));
+#endif
+	ConsoleCommands.Add(ConsoleManager.RegisterConsoleCommand(
+		TEXT("Hermes.HandlerTimings"),
+		TEXT("Print how long each endpoint's handler has been taking, and how often it's gone over its time budget"),
+		FConsoleCommandWithOutputDeviceDelegate::CreateLambda([this](FOutputDevice& Ar)
+		{
+			Watchdog->DumpTimings(Ar);
+		})));
+	ConsoleCommands.Add(ConsoleManager.RegisterConsoleCommand(
+		TEXT("Hermes.Journal.Start"),
+		TEXT("Start recording every Hermes request to a journal. Usage: Hermes.Journal.Start [Filename]"),
+		FConsoleCommandWithArgsDelegate::CreateLambda([this](const TArray<FString>& Args)
+		{
+			StartJournal(Args.Num() > 0 ? Args[0] : FString());
+		})));
+	ConsoleCommands.Add(ConsoleManager.RegisterConsoleCommand(
+		TEXT("Hermes.Journal.Stop"),
+		TEXT("Stop recording Hermes requests"),
+		FConsoleCommandDelegate::CreateRaw(this, &FGenericHermesServer::StopJournal)));
+	ConsoleCommands.Add(ConsoleManager.RegisterConsoleCommand(
+		TEXT("Hermes.Journal.Replay"),
+		TEXT(
+			"Dispatch the requests from a journal again. Usage: Hermes.Journal.Replay <Filename> [Speed], where a Speed of 2 replays at twice the original pace, and 0 replays as fast as possible"),
+		FConsoleCommandWithArgsDelegate::CreateLambda([this](const TArray<FString>& Args)
+		{
+			if (Args.Num() < 1)
+			{
+				UE_LOG(LogHermesServer, Error, TEXT("Usage: Hermes.Journal.Replay <Filename> [Speed]"));
+				return;
+			}
+			StartReplay(Args[0], Args.Num() > 1 ? FCString::Atod(*Args[1]) : 1.0);
+		})));
+
+	// Gives load tests an endpoint that measures the server itself rather than whatever a real handler does
+	if (FParse::Param(FCommandLine::Get(), TEXT("HermesNoopEndpoint")))
+	{
+		Register(TEXT("noop"), FHermesOnRequest::CreateLambda([](const FString&, const FHermesQueryParamsMap&) {}),
+		         FHermesEndpointOptions());
+		bRegisteredNoopEndpoint = true;
+	}
+
+	FString JournalFilename;
+	if (FParse::Value(FCommandLine::Get(), TEXT("-HermesJournal="), JournalFilename) ||
+		GetDefault<UHermesPluginSettings>()->bRecordJournal)
+	{
+		StartJournal(JournalFilename);
+	}
+
+	// The first tick finishes starting up, once every scheme provider & transport has had a chance to register
+	RequestTick();
+
+	ReportStartupCost(TEXT("HermesServer.StartupModule"), FPlatformTime::Seconds() - StartTime, false);
 }
 
 void FGenericHermesServer::ShutdownModule()
@@ -34,17 +238,108 @@ void FGenericHermesServer::ShutdownModule()
 	IModularFeatures& Features = IModularFeatures::Get();
 	Features.OnModularFeatureRegistered().Remove(OnModularFeatureRegisteredHandle);
 	Features.OnModularFeatureUnregistered().Remove(OnModularFeatureUnregisteredHandle);
+
+	for (IConsoleObject* Command : ConsoleCommands)
+	{
+		IConsoleManager::Get().UnregisterConsoleObject(Command);
+	}
+	ConsoleCommands.Reset();
+
+	if (bRegisteredNoopEndpoint)
+	{
+		Unregister(TEXT("noop"));
+		bRegisteredNoopEndpoint = false;
+	}
+
+	for (IHermesTransport* Transport : Transports)
+	{
+		Transport->Stop();
+	}
+	Transports.Reset();
+	TransportScheme.Reset();
+	CancelSchemeRetry();
+	SchemeToRetry.Empty();
+	if (LoopbackServer.IsValid())
+	{
+		Features.UnregisterModularFeature(IHermesTransport::GetModularFeatureName(), LoopbackServer.Get());
+		LoopbackServer.Reset();
+	}
+	if (MemoryTransport.IsValid())
+	{
+		Features.UnregisterModularFeature(IHermesTransport::GetModularFeatureName(), MemoryTransport.Get());
+		MemoryTransport.Reset();
+	}
+#if PLATFORM_UNIX
+	if (UnixSocketTransport.IsValid())
+	{
+		Features.UnregisterModularFeature(IHermesTransport::GetModularFeatureName(), UnixSocketTransport.Get());
+		UnixSocketTransport.Reset();
+	}
+#endif
+	if (RequestSpool.IsValid())
+	{
+		Features.UnregisterModularFeature(IHermesTransport::GetModularFeatureName(), RequestSpool.Get());
+		RequestSpool.Reset();
+	}
+
+	for (TArray<FQueuedRequest>& Deferred : DeferredRequests)
+	{
+		for (const FQueuedRequest& Queued : Deferred)
+		{
+			DropQueuedRequest(Queued);
+		}
+		Deferred.Reset();
+	}
+
+	Replay.Reset();
+	BlueprintEndpoints.Reset();
+	EndpointModulesToLoad.Reset();
+	TArray<FName> ParkedEndpoints;
+	ParkedRequests.GetKeys(ParkedEndpoints);
+	for (const FName& Endpoint : ParkedEndpoints)
+	{
+		DropParkedRequests(Endpoint);
+	}
+	StopJournal();
+	Watchdog.Reset();
+
+	Prefetcher.Reset();
+	PrefetchTime = 0.0;
+	if (LinkHistory.IsValid())
+	{
+		LinkHistory->Save(FHermesLinkHistory::GetDefaultFilename());
+		LinkHistory.Reset();
+	}
+
+	// Anything RunOnGameThread queued from another thread is skipped from here on
+	GameThreadTaskToken.Reset();
 }
 
 void FGenericHermesServer::Tick(float DeltaTime)
 {
 	if (!bFullyInitialized)
 	{
+		const double StartTime = FPlatformTime::Seconds();
 		bFullyInitialized = true;
 
-		// Any modular features should've been registered by now, so refresh the scheme and ignore the saved LastScheme
+		// Any modular features should've been registered by now, so this is the first time we register the scheme
 		RefreshRegisteredScheme();
 
+#if WITH_EDITOR
+		// Cooked builds don't have the Blueprint assets that this indexes, only their generated classes
+		BlueprintEndpoints = MakeShared<FHermesBlueprintEndpoints>(
+			*this, FHermesBlueprintEndpoints::FOnEndpointUnavailable::CreateRaw(
+				this, &FGenericHermesServer::DropParkedRequests));
+#endif
+
+		ReportStartupCost(TEXT("HermesServer first tick"), FPlatformTime::Seconds() - StartTime, true);
+
+		if (LinkHistory.IsValid() && GetDefault<UHermesPluginSettings>()->bPrefetchPopularLinks)
+		{
+			PrefetchTime = StartTime + PREFETCH_STARTUP_DELAY;
+		}
+		NextLinkHistorySaveTime = StartTime + LINK_HISTORY_SAVE_INTERVAL;
+
 		FString LaunchPath;
 		if (FParse::Value(FCommandLine::Get(), TEXT("-HermesPath="), LaunchPath))
 		{
@@ -52,6 +347,40 @@ void FGenericHermesServer::Tick(float DeltaTime)
 			HandlePath(LaunchPath);
 		}
 	}
+
+	// Indexing rather than iterating, since a request could end up loading a module that registers another transport
+	for (int32 Index = 0; Index < Transports.Num(); ++Index)
+	{
+		if (!Transports[Index]->IsEventDriven())
+		{
+			Transports[Index]->Tick();
+		}
+	}
+
+	LoadEndpointModules();
+	TickReplay();
+	ReleaseDeferredRequests();
+	DispatchQueuedRequests();
+	UpdateQueueDepthStats();
+	TickPrefetch();
+
+	if (Journal.IsValid())
+	{
+		Journal->Flush();
+	}
+
+	if (RecentPathTimes.Num() > 0)
+	{
+		const double Now = FPlatformTime::Seconds();
+		const double Window = GetDefault<UHermesPluginSettings>()->DuplicateRequestWindow;
+		for (auto It = RecentPathTimes.CreateIterator(); It; ++It)
+		{
+			if (Now - It.Value() >= Window)
+			{
+				It.RemoveCurrent();
+			}
+		}
+	}
 }
 
 TStatId FGenericHermesServer::GetStatId() const
@@ -61,225 +390,1245 @@ TStatId FGenericHermesServer::GetStatId() const
 
 bool FGenericHermesServer::IsTickable() const
 {
+#if WITH_EDITOR
 	return true;
+#else
+	if (!bFullyInitialized || EndpointModulesToLoad.Num() > 0 || Replay.IsValid() || RecentPathTimes.Num() > 0 ||
+		(Journal.IsValid() && Journal->HasPendingRecords()))
+	{
+		return true;
+	}
+
+	for (const TArray<FQueuedRequest>& Queue : RequestQueues)
+	{
+		if (Queue.Num() > 0)
+		{
+			return true;
+		}
+	}
+
+	return Transports.ContainsByPredicate([](const IHermesTransport* Transport)
+	{
+		return !Transport->IsEventDriven();
+	});
+#endif
 }
 
+#if WITH_EDITOR
 ETickableTickType FGenericHermesServer::GetTickableTickType() const
 {
 	return ETickableTickType::Always;
 }
+#endif
+
+void FGenericHermesServer::RequestTick()
+{
+#if !WITH_EDITOR
+	WakeUp();
+#endif
+}
 
-void FGenericHermesServer::Register(FName Endpoint, FHermesOnRequest Delegate)
+void FGenericHermesServer::Register(FName Endpoint, FHermesOnRequest Delegate, const FHermesEndpointOptions& Options)
 {
 	UE_LOG(LogHermesServer, Verbose, TEXT("Registering handler for endpoint %s"), *Endpoint.ToString());
-	if (!ensureAlwaysMsgf(!Endpoints.Contains(Endpoint),
-	                      TEXT(
-		                      "Registering duplicate delegate for endpoint %s, is this being unintentionally called twice (or are you forgetting to unregister)?"
-	                      ), *Endpoint.ToString()))
-	{
-		Endpoints.RemoveAll([Endpoint](const FRegisteredEndpoint& RegisteredEndpoint)
-		{
-			return RegisteredEndpoint == Endpoint;
-		});
-	}
+	FRegisteredEndpoint RegisteredEndpoint;
+	RegisteredEndpoint.Name = Endpoint;
+	RegisteredEndpoint.Delegate = MoveTemp(Delegate);
+	RegisteredEndpoint.Options = Options;
+	AddEndpoint(MoveTemp(RegisteredEndpoint));
+}
 
-	FRegisteredEndpoint& RegisteredEndpoint = Endpoints.Emplace_GetRef();
+void FGenericHermesServer::RegisterCoalescing(FName Endpoint, FHermesOnCoalescedRequests Delegate,
+                                              const FHermesEndpointOptions& Options)
+{
+	UE_LOG(LogHermesServer, Verbose, TEXT("Registering coalescing handler for endpoint %s"), *Endpoint.ToString());
+	FRegisteredEndpoint RegisteredEndpoint;
 	RegisteredEndpoint.Name = Endpoint;
-	RegisteredEndpoint.Delegate = Delegate;
+	RegisteredEndpoint.CoalescedDelegate = MoveTemp(Delegate);
+	RegisteredEndpoint.Options = Options;
+	AddEndpoint(MoveTemp(RegisteredEndpoint));
 }
 
-void FGenericHermesServer::Unregister(FName Endpoint)
+void FGenericHermesServer::AddEndpoint(FRegisteredEndpoint&& RegisteredEndpoint)
 {
-	UE_LOG(LogHermesServer, Verbose, TEXT("Unregistering handler for endpoint %s"), *Endpoint.ToString());
-	const int32 NumRemoved = Endpoints.RemoveAll([Endpoint](const FRegisteredEndpoint& RegisteredEndpoint)
+	const FName Endpoint = RegisteredEndpoint.Name;
+	const bool bReplaced = Endpoints.AddOrReplace(MoveTemp(RegisteredEndpoint));
+	ensureAlwaysMsgf(!bReplaced,
+	                 TEXT(
+		                 "Registering duplicate delegate for endpoint %s, is this being unintentionally called twice (or are you forgetting to unregister)?"
+	                 ), *Endpoint.ToString());
+
+	RunOnGameThread([this, Endpoint]
 	{
-		return RegisteredEndpoint == Endpoint;
+		ReleaseParkedRequests(Endpoint);
 	});
-	ensureAlwaysMsgf(NumRemoved > 0,
+}
+
+void FGenericHermesServer::Unregister(FName Endpoint)
+{
+	UE_LOG(LogHermesServer, Verbose, TEXT("Unregistering handler for endpoint %s"), *Endpoint.ToString());
+	const bool bRemoved = Endpoints.Remove(Endpoint);
+	ensureAlwaysMsgf(bRemoved,
 	                 TEXT(
 		                 "Unregistering endpoint %s which hasn't been registered, is this being unintentionally called twice (or are you forgetting to unregister)?"
 	                 ), *Endpoint.ToString());
+
+	// Nobody is around to handle these any more
+	RunOnGameThread([this, Endpoint]
+	{
+		for (TArray<FQueuedRequest>& Queue : RequestQueues)
+		{
+			for (int32 Index = Queue.Num() - 1; Index >= 0; --Index)
+			{
+				if (Queue[Index].Endpoint == Endpoint)
+				{
+					DropQueuedRequest(Queue[Index]);
+					Queue.RemoveAt(Index);
+				}
+			}
+		}
+
+		for (TArray<FQueuedRequest>& Deferred : DeferredRequests)
+		{
+			for (int32 Index = Deferred.Num() - 1; Index >= 0; --Index)
+			{
+				if (Deferred[Index].Endpoint == Endpoint)
+				{
+					DropQueuedRequest(Deferred[Index]);
+					Deferred.RemoveAt(Index);
+				}
+			}
+		}
+	});
+}
+
+void FGenericHermesServer::RunOnGameThread(TFunction<void()>&& Function)
+{
+	if (IsInGameThread())
+	{
+		Function();
+	}
+	else
+	{
+		// The module can be shut down and destroyed before the task runs, which happens on the game thread too
+		TWeakPtr<bool, ESPMode::ThreadSafe> WeakToken = GameThreadTaskToken;
+		AsyncTask(ENamedThreads::GameThread, [WeakToken, Function = MoveTemp(Function)]
+		{
+			if (WeakToken.IsValid())
+			{
+				Function();
+			}
+		});
+	}
 }
 
 FString FGenericHermesServer::GetUri(FName Endpoint, const FString& Path)
 {
-	if (PreviouslyRegisteredScheme.IsSet())
+	// The scheme isn't registered with the OS until the first tick, but links can be handed out before that. They'll
+	// work once we're registered, as long as no scheme provider that registers later changes the scheme.
+	TOptional<FString> Scheme = PreviouslyRegisteredScheme;
+	if (!Scheme.IsSet() && !bFullyInitialized)
+	{
+		Scheme = PickScheme();
+	}
+
+	if (Scheme.IsSet())
 	{
 		FString ModifiedPath(Path);
 		ModifiedPath.RemoveFromStart(TEXT("/"));
-		return FString::Printf(TEXT("%s://%s/%s"), *PreviouslyRegisteredScheme.GetValue(), *Endpoint.ToString(),
-		                       *ModifiedPath);
+		return FString::Printf(TEXT("%s://%s/%s"), *Scheme.GetValue(), *Endpoint.ToString(), *ModifiedPath);
 	}
 
 	return FString();
 }
 
-void FGenericHermesServer::HandlePath(const FString& FullPath) const
+void FGenericHermesServer::ParsePath(const FString& FullPath, FString& OutEndpointName, FHermesRequest& OutRequest)
 {
-	UE_LOG(LogHermesServer, Display, TEXT("Dispatching path '%s'"), *FullPath);
-
-	// Identify the endpoint -- the first path component -- which decides where we route this path.
-	const TCHAR* EndpointNameBeg = *FullPath;
-	if (*EndpointNameBeg == TEXT('/'))
+	using namespace HermesPathParser;
+	typedef TRange<TCHAR> FRange;
+	auto ToString = [](const FRange& Range)
 	{
-		EndpointNameBeg++;
-	}
-	const TCHAR* EndpointNameEnd = FCString::Strchr(EndpointNameBeg, TEXT('/'));
-	if (EndpointNameEnd == nullptr)
-	{
-		// If there's no specific path underneath the endpoint, we'll just pass an empty path to the handler
-		EndpointNameEnd = EndpointNameBeg + FCString::Strlen(EndpointNameBeg);
-	}
-	const FString EndpointName(EndpointNameEnd - EndpointNameBeg, EndpointNameBeg);
+		return FString(Range.Len(), Range.Begin);
+	};
 
-	// The rest of it is the endpoint-specific subpath, unless there's a query string (?foo=bar)
-	const TCHAR* PathBeg = EndpointNameEnd;
-	const TCHAR* PathEnd = FCString::Strchr(PathBeg, TEXT('?'));
-	if (PathEnd == nullptr)
-	{
-		// If there are no query parameters, use the rest of the string as the path
-		PathEnd = PathBeg + FCString::Strlen(PathBeg);
-	}
-	const FString Path = FPlatformHttp::UrlDecode(FString(PathEnd - PathBeg, PathBeg));
+	const TParsedPath<TCHAR> Parsed = Split(*FullPath, *FullPath + FullPath.Len());
+	OutEndpointName = ToString(Parsed.Endpoint);
+	OutRequest.Path = FPlatformHttp::UrlDecode(ToString(Parsed.Path));
 
 	// Extract the query parameters into a TMap, to make it easier for various endpoints to use them
-	TMap<FString, FString> QueryParameters;
-	if (*PathEnd == TEXT('?'))
+	FHermesQueryParamsMap& QueryParameters = OutRequest.QueryParams;
+	QueryParameters.Reset();
+	ForEachQueryParameter(Parsed.Query, [&QueryParameters, &ToString](const FRange& Key, const FRange& Value)
 	{
-		const FString QueryString(PathEnd + 1);
-		TArray<FString> QueryParameterComponents;
-		QueryString.ParseIntoArray(QueryParameterComponents, TEXT("&"), true);
-		for (const FString& QueryParameter : QueryParameterComponents)
-		{
-			int32 EndOfKey = INDEX_NONE;
-			// Support both foo=bar and just foo, the latter will just be an empty string in the map
-			if (!QueryParameter.FindChar(TEXT('='), EndOfKey))
-			{
-				QueryParameters.Emplace(FPlatformHttp::UrlDecode(QueryParameter).ToLower(), TEXT(""));
-			}
-			else
-			{
-				QueryParameters.Emplace(FPlatformHttp::UrlDecode(QueryParameter.Left(EndOfKey)).ToLower(),
-				                        FPlatformHttp::UrlDecode(QueryParameter.Mid(EndOfKey + 1)));
-			}
-		}
+		// Support both foo=bar and just foo, the latter will just be an empty string in the map
+		QueryParameters.Emplace(FPlatformHttp::UrlDecode(ToString(Key)).ToLower(),
+		                        FPlatformHttp::UrlDecode(ToString(Value)));
+	});
+}
+
+EHermesDispatchResult FGenericHermesServer::DispatchPath(const FString& FullPath, EHermesRequestPriority Priority)
+{
+	return HandlePath(FullPath, Priority);
+}
+
+EHermesDispatchResult FGenericHermesServer::HandlePath(const FString& FullPath, EHermesRequestPriority Priority)
+{
+	return RouteRequest(FullPath, Priority, true);
+}
+
+EHermesDispatchResult FGenericHermesServer::RouteRequest(const FString& FullPath, EHermesRequestPriority Priority,
+                                                         bool bFilterDuplicates)
+{
+	UE_LOG(LogHermesServer, Display, TEXT("Dispatching path '%s'"), *FullPath);
+
+	// Whatever happens to the request, there's likely something left to do on the next tick
+	RequestTick();
+	INC_DWORD_STAT(STAT_HermesRequestsReceived);
+	const double ArrivalTime = FPlatformTime::Seconds();
+	if (bFilterDuplicates && IsDuplicatePath(FullPath, ArrivalTime))
+	{
+		UE_LOG(LogHermesServer, Display, TEXT("Dropping '%s', an identical path was just handled"), *FullPath);
+		RecordRequest(FullPath, NAME_None, Priority, EHermesDispatchResult::Duplicate, ArrivalTime);
+		return EHermesDispatchResult::Duplicate;
 	}
 
+	FString EndpointName;
+	FHermesRequest Request;
+	ParsePath(FullPath, EndpointName, Request);
+
 	UE_LOG(LogHermesServer, Verbose, TEXT("Parsed path:\n  - Endpoint '%s'\n  - Subpath '%s'\n  - %i parameter(s):"),
-	       *EndpointName, *Path, QueryParameters.Num());
-	for (const auto& Pair : QueryParameters)
+	       *EndpointName, *Request.Path, Request.QueryParams.Num());
+	for (const auto& Pair : Request.QueryParams)
 	{
 		UE_LOG(LogHermesServer, Verbose, TEXT("    - '%s' = '%s'"), *Pair.Key, *Pair.Value);
 	}
 
-	const FRegisteredEndpoint* Endpoint = Endpoints.FindByKey(FName(*EndpointName));
+	// Holding on to the snapshot keeps the handler alive until we're done with it, even if it's unregistered meanwhile
+	const FName EndpointId(*EndpointName);
+	const TRefCountPtr<const FHermesEndpointSnapshot> Snapshot = Endpoints.Get();
+	const FRegisteredEndpoint* Endpoint = Snapshot->Find(EndpointId);
 	if (Endpoint == nullptr)
 	{
-		// TODO: If I implement blueprint handlers, we probably want to defer dispatch here if we haven't discovered
-		// all the blueprints yet.
+		// The endpoint might be handled by a module or Blueprint that hasn't been loaded yet
+		if (LoadEndpoint(EndpointId))
+		{
+			FQueuedRequest Parked;
+			Parked.Endpoint = EndpointId;
+			Parked.Request = MoveTemp(Request);
+			Parked.Priority = Priority;
+			Parked.ArrivalTime = ArrivalTime;
+			Parked.FullPath = FullPath;
+			return ParkRequest(MoveTemp(Parked));
+		}
+
 		UE_LOG(LogHermesServer, Error,
 		       TEXT("There is no handler registered for the endpoint '%s' in path '%s'"), *EndpointName, *FullPath);
+		RecordRequest(FullPath, EndpointId, Priority, EHermesDispatchResult::NoHandler, ArrivalTime);
+		return EHermesDispatchResult::NoHandler;
 	}
-	else
-	{
-		Endpoint->Delegate.Execute(Path, QueryParameters);
-	}
-}
 
-void FGenericHermesServer::RefreshRegisteredScheme()
-{
-	// Don't update the schema if we're shutting down.
-	if (!GIsRunning)
+	// The endpoint can ask for its requests to be treated as less urgent than the sender says they are
+	Priority = FMath::Max(Priority, Endpoint->Options.Priority);
+
+	// Interactive requests skip the queue entirely unless something is already waiting ahead of them, so that a
+	// human clicking a link never waits for a tick. Coalescing endpoints always wait for the rest of their batch.
+	const int32 PriorityIndex = static_cast<int32>(Priority);
+	const bool bDefer = ShouldDefer(*Endpoint);
+	if (Priority == EHermesRequestPriority::Interactive && !Endpoint->CoalescedDelegate.IsBound() &&
+		RequestQueues[PriorityIndex].Num() == 0 && !bDefer)
 	{
-		return;
+		++QueueCounters[PriorityIndex].Accepted;
+		++QueueCounters[PriorityIndex].Dispatched;
+		const double HandlerDuration = RunHandler(*Endpoint, FullPath, [Endpoint, &Request]
+		{
+			Endpoint->Delegate.Execute(Request.Path, Request.QueryParams);
+		});
+		RecordRequest(FullPath, EndpointId, Priority, EHermesDispatchResult::Dispatched, ArrivalTime, HandlerDuration);
+		return EHermesDispatchResult::Dispatched;
 	}
 
-	const FName FeatureName(IHermesUriSchemeProvider::GetModularFeatureName());
-	IModularFeatures& Features = IModularFeatures::Get();
-	TArray<IHermesUriSchemeProvider*> Providers = Features.GetModularFeatureImplementations<
-		IHermesUriSchemeProvider>(FeatureName);
+	FQueuedRequest Queued;
+	Queued.Endpoint = EndpointId;
+	Queued.Request = MoveTemp(Request);
+	Queued.Priority = Priority;
+	Queued.ArrivalTime = ArrivalTime;
+	Queued.FullPath = FullPath;
+	return bDefer ? DeferRequest(MoveTemp(Queued)) : EnqueueRequest(MoveTemp(Queued));
+}
 
-	FString LastScheme;
-	GConfig->GetString(
-		TEXT("/Script/HermesServer.HermesPluginSettings"), TEXT("LastScheme"), LastScheme,
-		GEditorPerProjectIni);
+EHermesDispatchResult FGenericHermesServer::EnqueueRequest(FQueuedRequest&& Queued)
+{
+	const auto* Settings = GetDefault<UHermesPluginSettings>();
+	const EHermesRequestPriority Priority = Queued.Priority;
+	const int32 PriorityIndex = static_cast<int32>(Priority);
+	TArray<FQueuedRequest>& Queue = RequestQueues[PriorityIndex];
+	FHermesQueueCounters& Counters = QueueCounters[PriorityIndex];
 
-	// First prefer providers, in order of registration
-	TOptional<FString> PickedScheme;
-	for (IHermesUriSchemeProvider* Provider : Providers)
+	const int32 MaxDepth = FMath::Max(1, Settings->GetMaxQueueDepth(Priority));
+	if (Queue.Num() >= MaxDepth)
 	{
-		TOptional<FString> Scheme = Provider->GetPreferredScheme();
-		if (Scheme.IsSet())
+		if (Settings->OverflowPolicy == EHermesOverflowPolicy::RejectNewest)
 		{
-			PickedScheme = Scheme;
-			break;
+			UE_LOG(LogHermesServer, Warning, TEXT("Rejecting request for endpoint %s, the %s queue is full (%d requests)"),
+			       *Queued.Endpoint.ToString(), LexToString(Priority), Queue.Num());
+			++Counters.Rejected;
+			RecordRequest(Queued.FullPath, Queued.Endpoint, Priority, EHermesDispatchResult::Rejected,
+			              Queued.ArrivalTime);
+			return EHermesDispatchResult::Rejected;
 		}
+
+		const int32 NumToDrop = Queue.Num() - MaxDepth + 1;
+		UE_LOG(LogHermesServer, Warning, TEXT("Dropping %d request(s) from the full %s queue"), NumToDrop,
+		       LexToString(Priority));
+		for (int32 Index = 0; Index < NumToDrop; ++Index)
+		{
+			DropQueuedRequest(Queue[Index]);
+		}
+		Queue.RemoveAt(0, NumToDrop);
 	}
 
-	// We only use the LastScheme if we're not fully initialized, so that we can do an "early initialization" until all
-	// the modular features have a chance to register.
-	if (!PickedScheme.IsSet() && !bFullyInitialized && !LastScheme.IsEmpty())
+	Queue.Emplace(MoveTemp(Queued));
+	RequestTick();
+
+	++Counters.Accepted;
+	Counters.PeakDepth = FMath::Max(Counters.PeakDepth, Queue.Num());
+	INC_DWORD_STAT(STAT_HermesRequestsQueued);
+	return EHermesDispatchResult::Queued;
+}
+
+bool FGenericHermesServer::LoadEndpoint(FName Endpoint)
+{
+	if (!GetDefault<UHermesPluginSettings>()->GetEndpointModule(Endpoint).IsNone())
 	{
-		PickedScheme = LastScheme;
+		EndpointModulesToLoad.AddUnique(Endpoint);
+		return true;
 	}
 
-	const auto* Settings = GetDefault<UHermesPluginSettings>();
+	return BlueprintEndpoints.IsValid() && BlueprintEndpoints->LoadEndpoint(Endpoint);
+}
 
-	// Finally, try using the hard coded setting
-	if (!PickedScheme.IsSet())
+void FGenericHermesServer::LoadEndpointModules()
+{
+	if (EndpointModulesToLoad.Num() == 0)
 	{
-		FString DefaultScheme = Settings->DefaultUriScheme;
-		if (DefaultScheme.IsEmpty())
-		{
-			DefaultScheme = TEXT("hunreal");
-		}
-
-		PickedScheme = DefaultScheme;
+		return;
 	}
 
-	// Unregister the scheme from our last boot if we're not using it any more,
-	// and update the 'last scheme' cached value for our next boot.
-	if (PickedScheme != LastScheme)
+	const auto* Settings = GetDefault<UHermesPluginSettings>();
+	for (const FName& Endpoint : TArray<FName>(MoveTemp(EndpointModulesToLoad)))
 	{
-		if (!LastScheme.IsEmpty())
-		{
-			UnregisterScheme(*LastScheme);
-		}
-
-		if (PickedScheme.IsSet())
+		// The module registers the endpoint from its StartupModule, which releases the parked requests
+		const FName ModuleName = Settings->GetEndpointModule(Endpoint);
+		UE_LOG(LogHermesServer, Display, TEXT("Loading module %s to handle the endpoint '%s'"), *ModuleName.ToString(),
+		       *Endpoint.ToString());
+		if (FModuleManager::Get().LoadModule(ModuleName) == nullptr)
 		{
-			GConfig->SetString(
-				TEXT("/Script/HermesServer.HermesPluginSettings"), TEXT("LastScheme"), **PickedScheme,
-				GEditorPerProjectIni);
+			UE_LOG(LogHermesServer, Error, TEXT("Unable to load module %s for the endpoint '%s'"), *ModuleName.ToString(),
+			       *Endpoint.ToString());
 		}
-		else
+		else if (Endpoints.Get()->Find(Endpoint) == nullptr)
 		{
-			GConfig->RemoveKey(
-				TEXT("/Script/HermesServer.HermesPluginSettings"), TEXT("LastScheme"), GEditorPerProjectIni);
+			UE_LOG(LogHermesServer, Error, TEXT("Module %s was loaded, but didn't register the endpoint '%s'"),
+			       *ModuleName.ToString(), *Endpoint.ToString());
 		}
+
+		// Anything still parked at this point has nobody to handle it
+		DropParkedRequests(Endpoint);
 	}
+}
+
+double FGenericHermesServer::GetHandlerBudget(const FRegisteredEndpoint& Endpoint)
+{
+	const float BudgetMs = Endpoint.Options.TimeBudgetMs > 0.0f
+		                       ? Endpoint.Options.TimeBudgetMs
+		                       : GetDefault<UHermesPluginSettings>()->HandlerTimeBudgetMs;
+	return BudgetMs / 1000.0;
+}
 
-	if (PickedScheme.IsSet())
+EHermesDispatchResult FGenericHermesServer::ParkRequest(FQueuedRequest&& Parked)
+{
+	TArray<FQueuedRequest>& EndpointRequests = ParkedRequests.FindOrAdd(Parked.Endpoint);
+	if (EndpointRequests.Num() >= FMath::Max(1, GetDefault<UHermesPluginSettings>()->GetMaxQueueDepth(Parked.Priority)))
 	{
-		UpdateScheme(*PickedScheme, Settings->bDebug);
+		UE_LOG(LogHermesServer, Warning, TEXT("Rejecting '%s', too many requests are waiting for the endpoint to load"),
+		       *Parked.FullPath);
+		++QueueCounters[static_cast<int32>(Parked.Priority)].Rejected;
+		RecordRequest(Parked.FullPath, Parked.Endpoint, Parked.Priority, EHermesDispatchResult::Rejected,
+		              Parked.ArrivalTime);
+		return EHermesDispatchResult::Rejected;
 	}
+
+	UE_LOG(LogHermesServer, Verbose, TEXT("Holding on to '%s' until the endpoint '%s' is loaded"), *Parked.FullPath,
+	       *Parked.Endpoint.ToString());
+	EndpointRequests.Emplace(MoveTemp(Parked));
+	return EHermesDispatchResult::Queued;
 }
 
-void FGenericHermesServer::UpdateScheme(const FString& Scheme, bool bDebug)
+void FGenericHermesServer::ReleaseParkedRequests(FName Endpoint)
 {
-	if (PreviouslyRegisteredScheme.IsSet())
+	TArray<FQueuedRequest> EndpointRequests;
+	if (!ParkedRequests.RemoveAndCopyValue(Endpoint, EndpointRequests))
 	{
-		if (PreviouslyRegisteredScheme == Scheme)
-		{
-			return;
-		}
-
-		UnregisterScheme(**PreviouslyRegisteredScheme);
-		PreviouslyRegisteredScheme.Reset();
+		return;
 	}
 
-	if (RegisterScheme(*Scheme, bDebug))
+	const TRefCountPtr<const FHermesEndpointSnapshot> Snapshot = Endpoints.Get();
+	const FRegisteredEndpoint* RegisteredEndpoint = Snapshot->Find(Endpoint);
+	if (RegisteredEndpoint == nullptr)
 	{
-		PreviouslyRegisteredScheme = Scheme;
+		// Registered from another thread, and unregistered again before we got around to it
+		ParkedRequests.Add(Endpoint, MoveTemp(EndpointRequests));
+		DropParkedRequests(Endpoint);
+		return;
+	}
+
+	for (FQueuedRequest& Parked : EndpointRequests)
+	{
+		Parked.Priority = FMath::Max(Parked.Priority, RegisteredEndpoint->Options.Priority);
+		EnqueueRequest(MoveTemp(Parked));
+	}
+}
+
+bool FGenericHermesServer::ShouldDefer(const FRegisteredEndpoint& Endpoint)
+{
+	return Endpoint.Options.bDeferDuringPIE && IsPlaySessionInProgress() &&
+		GetDefault<UHermesPluginSettings>()->bDeferDuringPIE;
+}
+
+EHermesDispatchResult FGenericHermesServer::DeferRequest(FQueuedRequest&& Deferred)
+{
+	const auto* Settings = GetDefault<UHermesPluginSettings>();
+	const EHermesRequestPriority Priority = Deferred.Priority;
+	TArray<FQueuedRequest>& Queue = DeferredRequests[static_cast<int32>(Priority)];
+	FHermesQueueCounters& Counters = QueueCounters[static_cast<int32>(Priority)];
+
+	// Each priority is bounded on its own, so that a flood of background requests can't crowd out interactive ones
+	const int32 MaxDepth = FMath::Max(1, Settings->GetMaxQueueDepth(Priority));
+	if (Queue.Num() >= MaxDepth)
+	{
+		if (Settings->OverflowPolicy == EHermesOverflowPolicy::RejectNewest)
+		{
+			UE_LOG(LogHermesServer, Warning,
+			       TEXT("Rejecting '%s', too many %s requests are waiting for the play session to end"),
+			       *Deferred.FullPath, LexToString(Priority));
+			++Counters.Rejected;
+			RecordRequest(Deferred.FullPath, Deferred.Endpoint, Priority, EHermesDispatchResult::Rejected,
+			              Deferred.ArrivalTime);
+			return EHermesDispatchResult::Rejected;
+		}
+
+		const int32 NumToDrop = Queue.Num() - MaxDepth + 1;
+		UE_LOG(LogHermesServer, Warning,
+		       TEXT("Dropping %d %s request(s) that were waiting for the play session to end"), NumToDrop,
+		       LexToString(Priority));
+		for (int32 Index = 0; Index < NumToDrop; ++Index)
+		{
+			DropQueuedRequest(Queue[Index]);
+		}
+		Queue.RemoveAt(0, NumToDrop);
+	}
+
+	UE_LOG(LogHermesServer, Display, TEXT("Holding on to '%s' until the play session ends"), *Deferred.FullPath);
+	++Counters.Deferred;
+	INC_DWORD_STAT(STAT_HermesRequestsDeferred);
+	Queue.Emplace(MoveTemp(Deferred));
+	return EHermesDispatchResult::Queued;
+}
+
+void FGenericHermesServer::ReleaseDeferredRequests()
+{
+	// The session is still in progress while EndPIE is broadcast, so this waits for the tick after it's torn down
+	const int32 NumDeferred = GetNumDeferredRequests();
+	if (NumDeferred == 0 || IsPlaySessionInProgress())
+	{
+		return;
+	}
+
+	UE_LOG(LogHermesServer, Display, TEXT("Play session ended, dispatching %d deferred request(s)"), NumDeferred);
+	for (TArray<FQueuedRequest>& Deferred : DeferredRequests)
+	{
+		TArray<FQueuedRequest> Released = MoveTemp(Deferred);
+		for (FQueuedRequest& Queued : Released)
+		{
+			EnqueueRequest(MoveTemp(Queued));
+		}
+	}
+}
+
+int32 FGenericHermesServer::GetNumDeferredRequests() const
+{
+	int32 NumDeferred = 0;
+	for (const TArray<FQueuedRequest>& Deferred : DeferredRequests)
+	{
+		NumDeferred += Deferred.Num();
+	}
+	return NumDeferred;
+}
+
+void FGenericHermesServer::DropParkedRequests(FName Endpoint)
+{
+	TArray<FQueuedRequest> EndpointRequests;
+	if (!ParkedRequests.RemoveAndCopyValue(Endpoint, EndpointRequests))
+	{
+		return;
+	}
+
+	for (const FQueuedRequest& Parked : EndpointRequests)
+	{
+		UE_LOG(LogHermesServer, Error,
+		       TEXT("There is no handler registered for the endpoint '%s' in path '%s'"), *Endpoint.ToString(),
+		       *Parked.FullPath);
+		RecordRequest(Parked.FullPath, Endpoint, Parked.Priority, EHermesDispatchResult::NoHandler, Parked.ArrivalTime);
+	}
+}
+
+void FGenericHermesServer::DropQueuedRequest(const FQueuedRequest& Queued)
+{
+	++QueueCounters[static_cast<int32>(Queued.Priority)].Dropped;
+	RecordRequest(Queued.FullPath, Queued.Endpoint, Queued.Priority, EHermesDispatchResult::Dropped,
+	              Queued.ArrivalTime);
+}
+
+bool FGenericHermesServer::IsDuplicatePath(const FString& FullPath, double Now)
+{
+	const double Window = GetDefault<UHermesPluginSettings>()->DuplicateRequestWindow;
+	if (Window <= 0.0)
+	{
+		return false;
+	}
+
+	// Treat "/content/Foo" and "content/Foo" the same, since the OS handler and the loopback server differ on this
+	FString Key(FullPath);
+	Key.RemoveFromStart(TEXT("/"));
+
+	double& LastSeen = RecentPathTimes.FindOrAdd(Key, -Window);
+	const bool bDuplicate = (Now - LastSeen) < Window;
+	LastSeen = Now;
+	return bDuplicate;
+}
+
+void FGenericHermesServer::DispatchQueuedRequests()
+{
+	const auto* Settings = GetDefault<UHermesPluginSettings>();
+	const double StartTime = FPlatformTime::Seconds();
+	const double Budget = Settings->DispatchBudgetMs / 1000.0;
+	const double CoalescingWindow = Settings->CoalescingWindow;
+
+	for (int32 PriorityIndex = 0; PriorityIndex < static_cast<int32>(EHermesRequestPriority::Num); ++PriorityIndex)
+	{
+		const bool bAlwaysDrain = PriorityIndex == static_cast<int32>(EHermesRequestPriority::Interactive);
+		TArray<FQueuedRequest>& Queue = RequestQueues[PriorityIndex];
+		FHermesQueueCounters& Counters = QueueCounters[PriorityIndex];
+
+		// Every queue gets to dispatch at least once per tick, even once the budget's been spent (or if it's zero),
+		// so that neither scripted nor background requests can be starved forever
+		bool bDispatchedFromQueue = false;
+		int32 Index = 0;
+		while (Index < Queue.Num())
+		{
+			const double Now = FPlatformTime::Seconds();
+			if (!bAlwaysDrain && bDispatchedFromQueue && Now - StartTime >= Budget)
+			{
+				break;
+			}
+
+			const FName EndpointId = Queue[Index].Endpoint;
+			const TRefCountPtr<const FHermesEndpointSnapshot> Snapshot = Endpoints.Get();
+			const FRegisteredEndpoint* Endpoint = Snapshot->Find(EndpointId);
+			if (Endpoint == nullptr)
+			{
+				// Shouldn't happen since Unregister purges the queues, but be defensive
+				DropQueuedRequest(Queue[Index]);
+				Queue.RemoveAt(Index);
+				continue;
+			}
+
+			// Queued before the play session started, so it waits in place until the session ends
+			if (ShouldDefer(*Endpoint))
+			{
+				++Index;
+				continue;
+			}
+
+			if (!Endpoint->CoalescedDelegate.IsBound())
+			{
+				const FQueuedRequest Queued = MoveTemp(Queue[Index]);
+				Queue.RemoveAt(Index);
+				++Counters.Dispatched;
+				bDispatchedFromQueue = true;
+				const double HandlerDuration = RunHandler(*Endpoint, Queued.FullPath, [Endpoint, &Queued]
+				{
+					Endpoint->Delegate.Execute(Queued.Request.Path, Queued.Request.QueryParams);
+				});
+				RecordRequest(Queued.FullPath, EndpointId, Queued.Priority, EHermesDispatchResult::Dispatched,
+				              Queued.ArrivalTime, HandlerDuration);
+				continue;
+			}
+
+			// Leave coalescing requests in the queue until the window has closed for the oldest one, so that the
+			// rest of the burst has a chance to arrive.
+			if (Now - Queue[Index].ArrivalTime < CoalescingWindow)
+			{
+				++Index;
+				continue;
+			}
+
+			// Take every request for this endpoint from the queue (in order), and hand them over as a single batch.
+			// Remove them before dispatching, in case the handler ends up queueing more requests.
+			TArray<FHermesRequest> Batch;
+			TArray<FQueuedRequest> BatchRecords;
+			for (int32 BatchIndex = Index; BatchIndex < Queue.Num();)
+			{
+				if (Queue[BatchIndex].Endpoint == EndpointId)
+				{
+					Batch.Emplace(MoveTemp(Queue[BatchIndex].Request));
+					BatchRecords.Emplace(MoveTemp(Queue[BatchIndex]));
+					Queue.RemoveAt(BatchIndex);
+				}
+				else
+				{
+					++BatchIndex;
+				}
+			}
+
+			UE_LOG(LogHermesServer, Verbose, TEXT("Dispatching %d coalesced request(s) to endpoint %s"), Batch.Num(),
+			       *EndpointId.ToString());
+			Counters.Dispatched += Batch.Num();
+			bDispatchedFromQueue = true;
+			if (Batch.Num() > 1)
+			{
+				INC_DWORD_STAT_BY(STAT_HermesRequestsCoalesced, Batch.Num());
+				EndpointStats.FindOrAdd(EndpointId).Coalesced += Batch.Num();
+			}
+			const FString BatchUri = BatchRecords.Num() > 1
+				                         ? FString::Printf(TEXT("%s (and %d more)"), *BatchRecords[0].FullPath,
+				                                           BatchRecords.Num() - 1)
+				                         : BatchRecords[0].FullPath;
+			const double HandlerDuration = RunHandler(*Endpoint, BatchUri, [Endpoint, &Batch]
+			{
+				Endpoint->CoalescedDelegate.Execute(Batch);
+			});
+
+			// Every request in the batch gets charged with the time it took to handle the whole batch
+			for (const FQueuedRequest& Queued : BatchRecords)
+			{
+				RecordRequest(Queued.FullPath, EndpointId, Queued.Priority, EHermesDispatchResult::Dispatched,
+				              Queued.ArrivalTime, HandlerDuration);
+			}
+		}
+	}
+}
+
+double FGenericHermesServer::RunHandler(const FRegisteredEndpoint& Endpoint, const FString& Uri,
+                                        TFunctionRef<void()> Handler)
+{
+	Watchdog->Begin(Endpoint.Name, Uri, GetHandlerBudget(Endpoint));
+	{
+#if STATS
+		TStatId* StatId = EndpointStatIds.Find(Endpoint.Name);
+		if (StatId == nullptr)
+		{
+			StatId = &EndpointStatIds.Add(Endpoint.Name, FDynamicStats::CreateStatId<FStatGroup_STATGROUP_HermesServer>(
+				                              TEXT("Endpoint: ") + Endpoint.Name.ToString()));
+		}
+		FScopeCycleCounter CycleCounter(*StatId);
+#endif
+		Handler();
+	}
+	const double Duration = Watchdog->End();
+
+	INC_DWORD_STAT(STAT_HermesHandlerCalls);
+	INC_FLOAT_STAT_BY(STAT_HermesHandlerTime, static_cast<float>(Duration * 1000.0));
+	EndpointStats.FindOrAdd(Endpoint.Name).HandlerSeconds += Duration;
+	return Duration;
+}
+
+void FGenericHermesServer::DumpQueueCounters(FOutputDevice& Ar) const
+{
+	Ar.Logf(TEXT("%-12s %8s %10s %10s %10s %10s %10s %10s"), TEXT("Priority"), TEXT("Depth"), TEXT("PeakDepth"),
+	        TEXT("Accepted"), TEXT("Dispatched"), TEXT("Rejected"), TEXT("Dropped"), TEXT("Deferred"));
+	for (int32 PriorityIndex = 0; PriorityIndex < static_cast<int32>(EHermesRequestPriority::Num); ++PriorityIndex)
+	{
+		const FHermesQueueCounters& Counters = QueueCounters[PriorityIndex];
+		Ar.Logf(TEXT("%-12s %8d %10d %10llu %10llu %10llu %10llu %10llu"),
+		        LexToString(static_cast<EHermesRequestPriority>(PriorityIndex)), RequestQueues[PriorityIndex].Num(),
+		        Counters.PeakDepth, Counters.Accepted, Counters.Dispatched, Counters.Rejected, Counters.Dropped,
+		        Counters.Deferred);
+	}
+	if (const int32 NumDeferred = GetNumDeferredRequests())
+	{
+		Ar.Logf(TEXT("%d request(s) are waiting for the play session to end"), NumDeferred);
+	}
+}
+
+void FGenericHermesServer::DumpStats(FOutputDevice& Ar) const
+{
+	TArray<FName> EndpointNames;
+	EndpointStats.GetKeys(EndpointNames);
+	EndpointNames.Sort(FNameLexicalLess());
+
+	Ar.Logf(TEXT("Latencies are from arrival until the handler returned, over the last %d requests to each endpoint"),
+	        FHermesHandlerTimings::WINDOW_SIZE);
+	Ar.Logf(TEXT("%-24s %10s %10s %8s %12s %10s %10s %10s %10s %10s"), TEXT("Endpoint"), TEXT("Dispatched"),
+	        TEXT("Coalesced"), TEXT("Failed"), TEXT("Handler (s)"), TEXT("Mean (ms)"), TEXT("p50 (ms)"),
+	        TEXT("p90 (ms)"), TEXT("p99 (ms)"), TEXT("Max (ms)"));
+	for (const FName& EndpointName : EndpointNames)
+	{
+		const FHermesEndpointStats& Stats = EndpointStats.FindChecked(EndpointName);
+		TArray<float> Sorted = Stats.Latency.RecentMs;
+		Sorted.Sort();
+		double Total = 0.0;
+		for (const float Latency : Sorted)
+		{
+			Total += Latency;
+		}
+
+		auto Percentile = [&Sorted](int32 Percent)
+		{
+			return Sorted.Num() > 0 ? Sorted[FMath::Min(Sorted.Num() - 1, Sorted.Num() * Percent / 100)] : 0.0f;
+		};
+		Ar.Logf(TEXT("%-24s %10llu %10llu %8llu %12.2f %10.2f %10.2f %10.2f %10.2f %10.2f"), *EndpointName.ToString(),
+		        Stats.Dispatched, Stats.Coalesced, Stats.Failed, Stats.HandlerSeconds,
+		        Sorted.Num() > 0 ? Total / Sorted.Num() : 0.0, Percentile(50), Percentile(90), Percentile(99),
+		        Stats.Latency.MaxMs);
+	}
+}
+
+void FGenericHermesServer::UpdateQueueDepthStats() const
+{
+	SET_DWORD_STAT(STAT_HermesInteractiveQueueDepth,
+	               RequestQueues[static_cast<int32>(EHermesRequestPriority::Interactive)].Num());
+	SET_DWORD_STAT(STAT_HermesScriptedQueueDepth,
+	               RequestQueues[static_cast<int32>(EHermesRequestPriority::Scripted)].Num());
+	SET_DWORD_STAT(STAT_HermesBackgroundQueueDepth,
+	               RequestQueues[static_cast<int32>(EHermesRequestPriority::Background)].Num());
+	SET_DWORD_STAT(STAT_HermesDeferredDepth, GetNumDeferredRequests());
+#if STATS
+	int32 NumParked = 0;
+	for (const TPair<FName, TArray<FQueuedRequest>>& Parked : ParkedRequests)
+	{
+		NumParked += Parked.Value.Num();
+	}
+	SET_DWORD_STAT(STAT_HermesParkedDepth, NumParked);
+#endif
+}
+
+void FGenericHermesServer::ReportStartupCost(const FString& What, double Seconds, bool bDeferred)
+{
+	UE_LOG(LogHermesServer, Log, TEXT("%s took %.2f ms%s"), *What, Seconds * 1000.0,
+	       bDeferred ? TEXT(" (after startup)") : TEXT(""));
+	StartupCosts.Add({What, Seconds, bDeferred});
+}
+
+IHermesMemoryTransport* FGenericHermesServer::GetMemoryTransport()
+{
+	return MemoryTransport.Get();
+}
+
+void FGenericHermesServer::DumpStartupCosts(FOutputDevice& Ar) const
+{
+	double Total[2] = {0.0, 0.0};
+	Ar.Logf(TEXT("%-56s %10s %8s"), TEXT("What"), TEXT("Time (ms)"), TEXT("When"));
+	for (const FHermesStartupCost& Cost : StartupCosts)
+	{
+		Ar.Logf(TEXT("%-56s %10.2f %8s"), *Cost.What, Cost.Seconds * 1000.0,
+		        Cost.bDeferred ? TEXT("Later") : TEXT("Startup"));
+		Total[Cost.bDeferred ? 1 : 0] += Cost.Seconds;
+	}
+	Ar.Logf(TEXT("Added %.2f ms to editor startup, and %.2f ms once it was needed"), Total[0] * 1000.0,
+	        Total[1] * 1000.0);
+}
+
+void FGenericHermesServer::DumpLinkHistory(FOutputDevice& Ar) const
+{
+	if (!LinkHistory.IsValid())
+	{
+		return;
+	}
+
+	const UHermesPluginSettings* Settings = GetDefault<UHermesPluginSettings>();
+	Ar.Logf(TEXT("%8s %s"), TEXT("Score"), TEXT("Path"));
+	for (const TPair<FString, double>& Link : LinkHistory->GetHottest(FHermesLinkHistory::MAX_ENTRIES,
+	                                                                  FDateTime::UtcNow()))
+	{
+		Ar.Logf(TEXT("%8.2f %s"), Link.Value, *Link.Key);
+	}
+	Ar.Logf(TEXT("Remembering %d link(s), the top %d are prefetched after startup"), LinkHistory->Num(),
+	        Settings->bPrefetchPopularLinks ? Settings->NumLinksToPrefetch : 0);
+
+	if (Prefetcher.IsValid())
+	{
+		Ar.Logf(TEXT("Prefetching: %d file(s) & %.1f MB read so far"), Prefetcher->GetFilesRead(),
+		        Prefetcher->GetBytesRead() / (1024.0 * 1024.0));
+	}
+	else if (PrefetchTime > 0.0)
+	{
+		Ar.Logf(TEXT("Prefetching will start once the editor is idle"));
+	}
+}
+
+void FGenericHermesServer::RecordLinkHistory(const FString& FullPath, FName Endpoint)
+{
+	const TRefCountPtr<const FHermesEndpointSnapshot> Snapshot = Endpoints.Get();
+	const FRegisteredEndpoint* RegisteredEndpoint = Snapshot->Find(Endpoint);
+	if (!LinkHistory.IsValid() || RegisteredEndpoint == nullptr || !RegisteredEndpoint->Options.Prefetch.IsBound())
+	{
+		return;
+	}
+
+	// The query string is mostly about what to do with what the path points at, so it's left out to count e.g. both
+	// revealing & editing an asset as the same link
+	const HermesPathParser::TParsedPath<TCHAR> Parsed = HermesPathParser::Split(*FullPath, *FullPath + FullPath.Len());
+	const FString Key = FString(Parsed.Endpoint.Len(), Parsed.Endpoint.Begin) +
+		FString(Parsed.Path.Len(), Parsed.Path.Begin);
+	LinkHistory->Record(Key, FDateTime::UtcNow());
+}
+
+void FGenericHermesServer::TickPrefetch()
+{
+	const double Now = FPlatformTime::Seconds();
+	if (LinkHistory.IsValid() && Now >= NextLinkHistorySaveTime)
+	{
+		NextLinkHistorySaveTime = Now + LINK_HISTORY_SAVE_INTERVAL;
+		LinkHistory->Save(FHermesLinkHistory::GetDefaultFilename());
+	}
+
+	if (Prefetcher.IsValid())
+	{
+		if (Prefetcher->IsDone())
+		{
+			UE_LOG(LogHermesServer, Display, TEXT("Prefetched %d file(s), %.1f MB, for the most popular links"),
+			       Prefetcher->GetFilesRead(), Prefetcher->GetBytesRead() / (1024.0 * 1024.0));
+			Prefetcher.Reset();
+		}
+		return;
+	}
+
+	// Wait until nothing else is going on, so that we're not competing with the asset registry scan, a play session, or
+	// someone opening links
+	if (PrefetchTime <= 0.0 || Now < PrefetchTime || Now - LastRequestTime < PREFETCH_IDLE_TIME ||
+		IsPlaySessionInProgress() || FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry").Get().IsLoadingAssets())
+	{
+		return;
+	}
+
+	PrefetchTime = 0.0;
+	StartPrefetch();
+}
+
+void FGenericHermesServer::StartPrefetch()
+{
+	const UHermesPluginSettings* Settings = GetDefault<UHermesPluginSettings>();
+	if (!LinkHistory.IsValid() || !Settings->bPrefetchPopularLinks)
+	{
+		return;
+	}
+
+	const TRefCountPtr<const FHermesEndpointSnapshot> Snapshot = Endpoints.Get();
+	TArray<FString> Filenames;
+	for (const TPair<FString, double>& Link : LinkHistory->GetHottest(Settings->NumLinksToPrefetch,
+	                                                                  FDateTime::UtcNow()))
+	{
+		FString EndpointId;
+		FHermesRequest Request;
+		ParsePath(Link.Key, EndpointId, Request);
+
+		const FRegisteredEndpoint* Endpoint = Snapshot->Find(FName(*EndpointId));
+		if (Endpoint != nullptr && Endpoint->Options.Prefetch.IsBound())
+		{
+			Endpoint->Options.Prefetch.Execute(Request, Filenames);
+		}
+	}
+
+	// Links often share files, e.g. a map & the assets in it, and the most popular links' files come first
+	TSet<FString> Seen;
+	Filenames.RemoveAll([&Seen](const FString& Filename)
+	{
+		bool bAlreadySeen = false;
+		Seen.Add(Filename, &bAlreadySeen);
+		return bAlreadySeen;
+	});
+	if (Filenames.Num() == 0)
+	{
+		return;
+	}
+
+	UE_LOG(LogHermesServer, Verbose, TEXT("Prefetching up to %d file(s) for the %d most popular links"),
+	       Filenames.Num(), Settings->NumLinksToPrefetch);
+	Prefetcher = MakeUnique<FHermesPrefetcher>(MoveTemp(Filenames),
+	                                           static_cast<int64>(Settings->PrefetchMemoryBudgetMB) * 1024 * 1024,
+	                                           Settings->PrefetchReadRateMBPerSecond * 1024.0 * 1024.0);
+}
+
+void FGenericHermesServer::RecordRequest(const FString& FullPath, FName Endpoint, EHermesRequestPriority Priority,
+                                        EHermesDispatchResult Result, double ArrivalTime, double HandlerDuration)
+{
+	switch (Result)
+	{
+		case EHermesDispatchResult::Dispatched:
+			INC_DWORD_STAT(STAT_HermesRequestsDispatched);
+			break;
+		case EHermesDispatchResult::NoHandler:
+			INC_DWORD_STAT(STAT_HermesRequestsNoHandler);
+			break;
+		case EHermesDispatchResult::Duplicate:
+			INC_DWORD_STAT(STAT_HermesRequestsDuplicate);
+			break;
+		case EHermesDispatchResult::Rejected:
+			INC_DWORD_STAT(STAT_HermesRequestsRejected);
+			break;
+		case EHermesDispatchResult::Dropped:
+			INC_DWORD_STAT(STAT_HermesRequestsDropped);
+			break;
+		default:
+			break;
+	}
+
+	LastRequestTime = FMath::Max(LastRequestTime, ArrivalTime);
+
+	// Duplicates are dropped before we know which endpoint they're for
+	if (!Endpoint.IsNone())
+	{
+		FHermesEndpointStats& Stats = EndpointStats.FindOrAdd(Endpoint);
+		if (Result == EHermesDispatchResult::Dispatched)
+		{
+			++Stats.Dispatched;
+			Stats.Latency.Add((FPlatformTime::Seconds() - ArrivalTime) * 1000.0, false);
+			RecordLinkHistory(FullPath, Endpoint);
+		}
+		else
+		{
+			++Stats.Failed;
+		}
+	}
+
+	if (!Journal.IsValid())
+	{
+		return;
+	}
+
+	FHermesJournalEntry Entry;
+	Entry.ArrivalOffset = Journal->GetOffset(ArrivalTime);
+	Entry.HandlerDuration = HandlerDuration;
+	Entry.Priority = Priority;
+	Entry.Result = Result;
+	Entry.Endpoint = Endpoint;
+	Entry.RawPath = FullPath;
+	Journal->Record(Entry);
+}
+
+void FGenericHermesServer::StartJournal(const FString& Filename)
+{
+	StopJournal();
+
+	TUniquePtr<FHermesRequestJournal> NewJournal = MakeUnique<FHermesRequestJournal>();
+	if (NewJournal->Open(Filename.IsEmpty() ? FHermesRequestJournal::MakeDefaultFilename() : Filename))
+	{
+		Journal = MoveTemp(NewJournal);
+	}
+}
+
+void FGenericHermesServer::StopJournal()
+{
+	Journal.Reset();
+}
+
+void FGenericHermesServer::StartReplay(const FString& Filename, double Speed)
+{
+	TUniquePtr<FHermesJournalReplay> NewReplay = MakeUnique<FHermesJournalReplay>();
+	FDateTime StartTime;
+	if (!FHermesRequestJournal::Read(Filename, NewReplay->Entries, StartTime))
+	{
+		return;
+	}
+
+	// Entries are recorded when they finish, so put them back in the order they arrived
+	NewReplay->Entries.StableSort([](const FHermesJournalEntry& A, const FHermesJournalEntry& B)
+	{
+		return A.ArrivalOffset < B.ArrivalOffset;
+	});
+	NewReplay->Speed = FMath::Max(Speed, 0.0);
+	NewReplay->StartSeconds = FPlatformTime::Seconds();
+
+	UE_LOG(LogHermesServer, Display, TEXT("Replaying %d request(s) recorded at %s from %s at %.2fx speed"),
+	       NewReplay->Entries.Num(), *StartTime.ToString(), *Filename, NewReplay->Speed);
+	Replay = MoveTemp(NewReplay);
+	RequestTick();
+}
+
+void FGenericHermesServer::TickReplay()
+{
+	if (!Replay.IsValid())
+	{
+		return;
+	}
+
+	const double Elapsed = FPlatformTime::Seconds() - Replay->StartSeconds;
+	while (!Replay->IsFinished())
+	{
+		const FHermesJournalEntry& Entry = Replay->Entries[Replay->NextEntry];
+		if (Replay->Speed > 0.0 && Entry.ArrivalOffset / Replay->Speed > Elapsed)
+		{
+			break;
+		}
+
+		++Replay->NextEntry;
+
+		// The duplicate filter works on wall clock time, so it would drop a different set of requests when the replay
+		// is sped up. Drop exactly the ones that were dropped while recording instead.
+		if (Entry.Result == EHermesDispatchResult::Duplicate)
+		{
+			INC_DWORD_STAT(STAT_HermesRequestsReceived);
+			RecordRequest(Entry.RawPath, NAME_None, Entry.Priority, EHermesDispatchResult::Duplicate,
+			              FPlatformTime::Seconds());
+			continue;
+		}
+		RouteRequest(Entry.RawPath, Entry.Priority, false);
+	}
+
+	if (Replay->IsFinished())
+	{
+		UE_LOG(LogHermesServer, Display, TEXT("Finished replaying %d request(s) in %.3f seconds"),
+		       Replay->Entries.Num(), Elapsed);
+		Replay.Reset();
+	}
+}
+
+FString FGenericHermesServer::PickScheme()
+{
+	const FName FeatureName(IHermesUriSchemeProvider::GetModularFeatureName());
+	IModularFeatures& Features = IModularFeatures::Get();
+	TArray<IHermesUriSchemeProvider*> Providers = Features.GetModularFeatureImplementations<
+		IHermesUriSchemeProvider>(FeatureName);
+
+	// First prefer providers, in order of registration
+	for (IHermesUriSchemeProvider* Provider : Providers)
+	{
+		TOptional<FString> Scheme = Provider->GetPreferredScheme();
+		if (Scheme.IsSet())
+		{
+			return Scheme.GetValue();
+		}
+	}
+
+	// Finally, try using the hard coded setting
+	const FString& DefaultScheme = GetDefault<UHermesPluginSettings>()->DefaultUriScheme;
+	return DefaultScheme.IsEmpty() ? FString(TEXT("hunreal")) : DefaultScheme;
+}
+
+void FGenericHermesServer::RefreshRegisteredScheme()
+{
+	// Don't update the schema if we're shutting down. Registering with the OS handler launches a process, so that's
+	// also left until the first tick, once the editor has finished starting up and every provider has registered.
+	if (!GIsRunning || !bFullyInitialized)
+	{
+		return;
+	}
+
+	const auto* Settings = GetDefault<UHermesPluginSettings>();
+	const FString PickedScheme = PickScheme();
+
+#if WITH_EDITOR
+	FString LastScheme;
+	GConfig->GetString(
+		TEXT("/Script/HermesServer.HermesPluginSettings"), TEXT("LastScheme"), LastScheme,
+		GEditorPerProjectIni);
+
+	// Unregister the scheme from our last boot if we're not using it any more,
+	// and update the 'last scheme' cached value for our next boot. The memory transport leaves the OS handler alone.
+	if (PickedScheme != LastScheme && !MemoryTransport.IsValid())
+	{
+		if (!LastScheme.IsEmpty())
+		{
+			UnregisterScheme(*LastScheme);
+		}
+
+		GConfig->SetString(
+			TEXT("/Script/HermesServer.HermesPluginSettings"), TEXT("LastScheme"), *PickedScheme,
+			GEditorPerProjectIni);
+	}
+#endif
+
+	UpdateScheme(PickedScheme, Settings->bDebug);
+}
+
+void FGenericHermesServer::UpdateScheme(const FString& Scheme, bool bDebug)
+{
+	if (PreviouslyRegisteredScheme.IsSet())
+	{
+		if (PreviouslyRegisteredScheme == Scheme)
+		{
+			return;
+		}
+
+		if (MemoryTransport.IsValid())
+		{
+			MemoryTransport->UnregisterScheme(*PreviouslyRegisteredScheme);
+		}
+#if WITH_EDITOR
+		else
+		{
+			UnregisterScheme(**PreviouslyRegisteredScheme);
+		}
+#endif
+		PreviouslyRegisteredScheme.Reset();
+	}
+
+	// Make sure we're listening before the OS handler is told to send us requests
+	const FString ListenScheme = GetTransportScheme(Scheme);
+	if (TransportScheme != ListenScheme)
+	{
+		TransportScheme = ListenScheme;
+		TArray<FString> FailedTransports;
+		for (IHermesTransport* Transport : Transports)
+		{
+			if (!Transport->SetScheme(ListenScheme))
+			{
+				FailedTransports.Add(Transport->GetTransportName().ToString());
+			}
+		}
+
+		if (FailedTransports.Num() > 0)
+		{
+			// Nobody would receive the links the OS handler sends us, so don't register. Whoever has the mailslot or
+			// socket might go away, so we try again in a bit. That's only worth a warning the first time around.
+			TransportScheme.Reset();
+			CancelSchemeRetry();
+			if (SchemeToRetry != Scheme)
+			{
+				UE_LOG(LogHermesServer, Warning,
+				       TEXT("Can't listen for %s links on these transports: %s. Another process is probably listening "
+				            "for them already, so we'll keep trying in the background."),
+				       *ListenScheme, *FString::Join(FailedTransports, TEXT(", ")));
+				SchemeToRetry = Scheme;
+				SchemeRetryInterval = SCHEME_RETRY_INTERVAL;
+			}
+			else
+			{
+				UE_LOG(LogHermesServer, Verbose, TEXT("Still can't listen for %s, trying again in %.0f seconds"),
+				       *ListenScheme, SchemeRetryInterval);
+			}
+
+			SchemeRetryTickerHandle = FHermesCoreTicker::GetCoreTicker().AddTicker(
+				FTickerDelegate::CreateRaw(this, &FGenericHermesServer::RetryScheme), SchemeRetryInterval);
+			SchemeRetryInterval = FMath::Min(SchemeRetryInterval * 2.0f, SCHEME_RETRY_MAX_INTERVAL);
+			return;
+		}
+	}
+
+	CancelSchemeRetry();
+	if (!SchemeToRetry.IsEmpty())
+	{
+		UE_LOG(LogHermesServer, Log, TEXT("Receiving links for %s now"), *ListenScheme);
+		SchemeToRetry.Empty();
+	}
+
+	if (MemoryTransport.IsValid())
+	{
+		MemoryTransport->RegisterScheme(Scheme);
+		PreviouslyRegisteredScheme = Scheme;
+	}
+#if WITH_EDITOR
+	else if (RegisterScheme(*Scheme, bDebug))
+	{
+		PreviouslyRegisteredScheme = Scheme;
+	}
+#else
+	else
+	{
+		// The OS handler launches the editor, so only the editor registers with it. A game build that's running on Linux
+		// gets the links that the handler forwards to its own socket, see GetTransportScheme.
+		PreviouslyRegisteredScheme = Scheme;
+	}
+#endif
+}
+
+bool FGenericHermesServer::RetryScheme(float DeltaTime)
+{
+	// Returning false removes us from the ticker, so the handle is stale from here on
+	SchemeRetryTickerHandle.Reset();
+	UpdateScheme(SchemeToRetry, GetDefault<UHermesPluginSettings>()->bDebug);
+	return false;
+}
+
+void FGenericHermesServer::CancelSchemeRetry()
+{
+	if (SchemeRetryTickerHandle.IsValid())
+	{
+		FHermesCoreTicker::GetCoreTicker().RemoveTicker(SchemeRetryTickerHandle);
+		SchemeRetryTickerHandle.Reset();
+	}
+}
+
+FString FGenericHermesServer::GetTransportScheme(const FString& Scheme)
+{
+#if WITH_EDITOR
+	return Scheme;
+#else
+	return Scheme + TEXT("-game");
+#endif
+}
+
+void FGenericHermesServer::StartLoopbackServer()
+{
+	const auto* Settings = GetDefault<UHermesPluginSettings>();
+
+	int32 Port = Settings->LoopbackServerPort;
+	const bool bPortOnCommandLine = FParse::Value(FCommandLine::Get(), TEXT("-HermesLoopbackPort="), Port);
+	if (!Settings->bEnableLoopbackServer && !bPortOnCommandLine)
+	{
+		return;
+	}
+
+	// Lets scripts that launch the editor pick the token, instead of reading it from the token file
+	FString Token;
+	FParse::Value(FCommandLine::Get(), TEXT("-HermesLoopbackToken="), Token);
+
+	LoopbackServer = MakeUnique<FHermesLoopbackServer>(Port, Token);
+	IModularFeatures::Get().RegisterModularFeature(IHermesTransport::GetModularFeatureName(), LoopbackServer.Get());
+}
+
+void FGenericHermesServer::StartMemoryTransport()
+{
+	if (!GetDefault<UHermesPluginSettings>()->bUseMemoryTransport &&
+		!FParse::Param(FCommandLine::Get(), TEXT("HermesMemoryTransport")))
+	{
+		return;
+	}
+
+	UE_LOG(LogHermesServer, Display, TEXT("Registering the scheme with the memory transport instead of the OS"));
+	MemoryTransport = MakeUnique<FHermesMemoryQueueTransport>();
+	IModularFeatures::Get().RegisterModularFeature(IHermesTransport::GetModularFeatureName(), MemoryTransport.Get());
+}
+
+void FGenericHermesServer::StartTransport(IHermesTransport& Transport)
+{
+	if (!bListening || Transports.Contains(&Transport))
+	{
+		return;
+	}
+
+	if (!Transport.Start(*this))
+	{
+		UE_LOG(LogHermesServer, Error, TEXT("Unable to start the %s transport"), *Transport.GetTransportName().ToString());
+		return;
+	}
+
+	UE_LOG(LogHermesServer, Verbose, TEXT("Started the %s transport"), *Transport.GetTransportName().ToString());
+	Transports.Add(&Transport);
+	if (!TransportScheme.IsEmpty() && !Transport.SetScheme(TransportScheme))
+	{
+		UE_LOG(LogHermesServer, Error, TEXT("The %s transport can't receive links for %s"),
+		       *Transport.GetTransportName().ToString(), *TransportScheme);
+	}
+	RequestTick();
+}
+
+void FGenericHermesServer::StopTransport(IHermesTransport& Transport)
+{
+	if (Transports.Remove(&Transport) > 0)
+	{
+		UE_LOG(LogHermesServer, Verbose, TEXT("Stopping the %s transport"), *Transport.GetTransportName().ToString());
+		Transport.Stop();
 	}
 }
@@ -1,44 +1,181 @@
 // Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
 #pragma once
+#include "HermesEndpointRegistry.h"
+#include "HermesHandlerWatchdog.h"
 #include "HermesServer.h"
+#include "HermesTransport.h"
 
+#include <Containers/Ticker.h>
 #include <Containers/UnrealString.h>
+#include <Runtime/Launch/Resources/Version.h>
+
+#if WITH_EDITOR
 #include <TickableEditorObject.h>
+/** The editor always ticks us, since there's almost always something going on */
+typedef FTickableEditorObject FHermesServerTickable;
+#else
+#include "HermesOnDemandTickable.h"
+/** Game builds only tick us while there's something to do, so that Hermes costs nothing per frame while it's idle */
+typedef FHermesOnDemandTickable FHermesServerTickable;
+#endif
+
+class FHermesBlueprintEndpoints;
+class FHermesLinkHistory;
+class FHermesLoopbackServer;
+class FHermesMemoryQueueTransport;
+class FHermesPrefetcher;
+class FHermesRequestJournal;
+class FHermesRequestSpool;
+class FHermesUnixSocketTransport;
+struct FHermesJournalReplay;
+class FOutputDevice;
+class IConsoleObject;
+
+/** A request that's waiting in one of the dispatch queues */
+struct FQueuedRequest
+{
+	FName Endpoint;
+	FHermesRequest Request;
+	EHermesRequestPriority Priority = EHermesRequestPriority::Interactive;
+	double ArrivalTime = 0.0;
+	/** The path as it was received, kept around for the request journal */
+	FString FullPath;
+};
+
+/** Backpressure counters for a single priority class */
+struct FHermesQueueCounters
+{
+	/** Requests that were accepted into the queue (or dispatched immediately) */
+	uint64 Accepted = 0;
+	uint64 Dispatched = 0;
+	/** Incoming requests that were turned away because the queue was full */
+	uint64 Rejected = 0;
+	/** Queued requests that were thrown out to make room for newer ones */
+	uint64 Dropped = 0;
+	/** Requests that were held back until a PIE session ended */
+	uint64 Deferred = 0;
+	/** The deepest this queue has been */
+	int32 PeakDepth = 0;
+};
 
-struct FRegisteredEndpoint
+/** What's happened to the requests for a single endpoint, for Hermes.Stats */
+struct FHermesEndpointStats
 {
-	FName Name;
-	FHermesOnRequest Delegate;
+	uint64 Dispatched = 0;
+	/** Requests that were dispatched as part of a batch of more than one */
+	uint64 Coalesced = 0;
+	/** Requests that never reached the handler, because they were rejected, dropped or nothing handled them */
+	uint64 Failed = 0;
+	/** How long the handler has spent on these requests in total */
+	double HandlerSeconds = 0.0;
+	/** From when the request arrived until its handler returned, for the most recent requests */
+	FHermesHandlerTimings Latency;
+};
 
-	bool operator==(const FName& Endpoint) const
-	{
-		return Name == Endpoint;
-	}
+/** Something a Hermes module spent time on while the editor was starting up, or put off until later */
+struct FHermesStartupCost
+{
+	FString What;
+	double Seconds = 0.0;
+	bool bDeferred = false;
 };
 
-class FGenericHermesServer : public IHermesServerModule, public FTickableEditorObject
+class FGenericHermesServer : public IHermesServerModule, public FHermesServerTickable, public IHermesRequestSink
 {
+public:
+	FGenericHermesServer();
+	virtual ~FGenericHermesServer() override;
+
 protected: // Implementation of IModuleInterface
 	virtual void StartupModule() override;
 	virtual void ShutdownModule() override;
 
-protected: // Implementation of FTickableEditorObject
+protected: // Implementation of FHermesServerTickable
 	virtual void Tick(float DeltaTime) override;
 	virtual TStatId GetStatId() const final override;
 	virtual bool IsTickable() const final override;
+#if WITH_EDITOR
 	virtual ETickableTickType GetTickableTickType() const final override;
+#endif
 
 protected: // Implementation of IHermesServerModule
-	virtual void Register(FName Endpoint, FHermesOnRequest Delegate) final override;
+	virtual void Register(FName Endpoint, FHermesOnRequest Delegate, const FHermesEndpointOptions& Options) final override;
+	virtual void RegisterCoalescing(FName Endpoint, FHermesOnCoalescedRequests Delegate,
+	                                const FHermesEndpointOptions& Options) final override;
 	virtual void Unregister(FName Endpoint) final override;
 	virtual FString GetUri(FName Endpoint, const FString& Path) final override;
+	virtual void ReportStartupCost(const FString& What, double Seconds, bool bDeferred) final override;
+	virtual IHermesMemoryTransport* GetMemoryTransport() final override;
+
+protected: // Implementation of IHermesRequestSink
+	virtual EHermesDispatchResult DispatchPath(const FString& FullPath, EHermesRequestPriority Priority) final override;
 
 private: // State
 	bool bFullyInitialized = false;
-	TArray<FRegisteredEndpoint> Endpoints;
+	/** False in builds that shouldn't receive links, in which case no transports are started */
+	bool bListening = false;
+	/** Set when -HermesNoopEndpoint registered the "noop" endpoint that load tests target */
+	bool bRegisteredNoopEndpoint = false;
+	/** Read without locking from any thread, see FHermesEndpointRegistry */
+	FHermesEndpointRegistry Endpoints;
+	/** When we last saw each path, used to drop duplicates that arrive within the duplicate request window */
+	TMap<FString, double> RecentPathTimes;
+	/** One queue per EHermesRequestPriority, most urgent first */
+	TArray<FQueuedRequest> RequestQueues[static_cast<int32>(EHermesRequestPriority::Num)];
+	FHermesQueueCounters QueueCounters[static_cast<int32>(EHermesRequestPriority::Num)];
+	TMap<FName, FHermesEndpointStats> EndpointStats;
+#if STATS
+	/** A cycle stat per endpoint, so that "stat HermesServer" shows how often each handler runs and for how long */
+	TMap<FName, TStatId> EndpointStatIds;
+#endif
+	TArray<IConsoleObject*> ConsoleCommands;
+	TUniquePtr<FHermesRequestJournal> Journal;
+	TUniquePtr<FHermesJournalReplay> Replay;
+	TUniquePtr<FHermesHandlerWatchdog> Watchdog;
 	TOptional<FString> PreviouslyRegisteredScheme;
+	TArray<FHermesStartupCost> StartupCosts;
 	FDelegateHandle OnModularFeatureRegisteredHandle;
 	FDelegateHandle OnModularFeatureUnregisteredHandle;
+	/** The transports that were successfully started, ticked in the order they were started */
+	TArray<IHermesTransport*> Transports;
+	/** The scheme the transports were last told about, which can differ from the one the OS handler knows about */
+	FString TransportScheme;
+	/** Set if the transports couldn't listen for this scheme, which RetryScheme tries again less and less often */
+	FString SchemeToRetry;
+	float SchemeRetryInterval = 0.0f;
+#if ENGINE_MAJOR_VERSION >= 5
+	FTSTicker::FDelegateHandle SchemeRetryTickerHandle;
+#else
+	FDelegateHandle SchemeRetryTickerHandle;
+#endif
+	TUniquePtr<FHermesLoopbackServer> LoopbackServer;
+	/** Set if the scheme is registered with the memory transport instead of the OS handler */
+	TUniquePtr<FHermesMemoryQueueTransport> MemoryTransport;
+#if PLATFORM_UNIX
+	TUniquePtr<FHermesUnixSocketTransport> UnixSocketTransport;
+#endif
+	/** Links that were opened while we weren't listening, registered after the other transports so it drains last */
+	TUniquePtr<FHermesRequestSpool> RequestSpool;
+	TSharedPtr<FHermesBlueprintEndpoints> BlueprintEndpoints;
+	/** Only valid between StartupModule and ShutdownModule, tasks from RunOnGameThread hold a weak pointer to it */
+	TSharedPtr<bool, ESPMode::ThreadSafe> GameThreadTaskToken;
+	/** Requests for endpoints that are still being loaded, dispatched once the endpoint registers */
+	TMap<FName, TArray<FQueuedRequest>> ParkedRequests;
+	/** Endpoints whose modules will be loaded on the next tick */
+	TArray<FName> EndpointModulesToLoad;
+	/**
+	 * Requests for endpoints that don't want to run during PIE, one list per priority, each bounded like its queue.
+	 * Moved into the dispatch queue for their priority, in arrival order, once the session ends.
+	 */
+	TArray<FQueuedRequest> DeferredRequests[static_cast<int32>(EHermesRequestPriority::Num)];
+	/** How often the paths for endpoints that support prefetching have been requested */
+	TUniquePtr<FHermesLinkHistory> LinkHistory;
+	double NextLinkHistorySaveTime = 0.0;
+	/** When we'll prefetch the most popular links, once we're idle, or 0 if we're not going to */
+	double PrefetchTime = 0.0;
+	TUniquePtr<FHermesPrefetcher> Prefetcher;
+	/** When the last request arrived, prefetching waits until they've stopped for a little while */
+	double LastRequestTime = 0.0;
 
 protected: // Interface for platform implementations
 	/** Register ourselves for the given scheme with the OS handler. */
@@ -47,18 +184,118 @@ protected: // Interface for platform implementations
 	virtual void UnregisterScheme(const TCHAR* Scheme) = 0;
 
 protected: // API for platform implementations
-	/** Dispatch the given path to the correct endpoint handler */
-	void HandlePath(const FString& FullPath) const;
+	/**
+	 * Dispatch the given path to the correct endpoint handler. Interactive requests are dispatched immediately when
+	 * possible, everything else goes through the dispatch queues.
+	 *
+	 * @param FullPath the path, starting with the endpoint id
+	 * @param Priority how urgent the sender says the request is, the endpoint might lower it
+	 */
+	EHermesDispatchResult HandlePath(const FString& FullPath,
+	                                 EHermesRequestPriority Priority = EHermesRequestPriority::Interactive);
 
 private: // Implementation details
+	/** Make sure we're ticked soon, which outside of the editor only happens when there's something to do */
+	void RequestTick();
+	/** HandlePath, but replayed requests skip the duplicate filter since they're not arriving in real time */
+	EHermesDispatchResult RouteRequest(const FString& FullPath, EHermesRequestPriority Priority, bool bFilterDuplicates);
+	/** Split a path into the endpoint id (the first path component), the endpoint-specific subpath, and the query */
+	static void ParsePath(const FString& FullPath, FString& OutEndpointName, FHermesRequest& OutRequest);
+	/** Add a new endpoint, replacing any existing one with the same name */
+	void AddEndpoint(FRegisteredEndpoint&& Endpoint);
+	/**
+	 * Run something that touches the dispatch queues, which only the game thread may do. Runs it right away when called
+	 * on the game thread, otherwise it's run on the game thread's next task flush, unless the module has been shut down.
+	 */
+	void RunOnGameThread(TFunction<void()>&& Function);
+	/** Returns true if we've seen this exact path within the duplicate request window, and records that we've seen it */
+	bool IsDuplicatePath(const FString& FullPath, double Now);
+	/** Admit a request into the queue for its priority, applying the overflow policy if it's full */
+	EHermesDispatchResult EnqueueRequest(FQueuedRequest&& Queued);
+	/**
+	 * Start loading whatever handles an endpoint that isn't registered, i.e. its module from the endpoint manifest in the
+	 * settings, or a Blueprint. Returns false if nothing is known to handle it.
+	 */
+	bool LoadEndpoint(FName Endpoint);
+	/** Load the modules requested by LoadEndpoint, outside of any dispatch */
+	void LoadEndpointModules();
+	/** How many seconds the endpoint's handler may take before the watchdog reports it as a hitch */
+	static double GetHandlerBudget(const FRegisteredEndpoint& Endpoint);
+	/** Hold on to a request for an endpoint that's being loaded, until it registers */
+	EHermesDispatchResult ParkRequest(FQueuedRequest&& Parked);
+	/** Returns true if requests for this endpoint should wait, because a PIE or Simulate session is running */
+	static bool ShouldDefer(const FRegisteredEndpoint& Endpoint);
+	/** Hold on to a request until the PIE session ends */
+	EHermesDispatchResult DeferRequest(FQueuedRequest&& Deferred);
+	/** Move the requests that were waiting for PIE to end into the dispatch queues, once it has */
+	void ReleaseDeferredRequests();
+	/** How many requests are waiting for PIE to end, across every priority */
+	int32 GetNumDeferredRequests() const;
+	/** Move the requests that were waiting for an endpoint to load into the dispatch queues */
+	void ReleaseParkedRequests(FName Endpoint);
+	/** Give up on the requests that were waiting for an endpoint that turned out to not exist */
+	void DropParkedRequests(FName Endpoint);
+	/** Run an endpoint's handler under the watchdog & its cycle stat, and return how many seconds it took */
+	double RunHandler(const FRegisteredEndpoint& Endpoint, const FString& Uri, TFunctionRef<void()> Handler);
+	/** Account for a queued request that's being thrown out without being dispatched */
+	void DropQueuedRequest(const FQueuedRequest& Queued);
+	/**
+	 * Dispatch queued requests, most urgent first. Interactive requests are always drained, the other queues are
+	 * only drained for as long as we're within the per-tick dispatch budget.
+	 */
+	void DispatchQueuedRequests();
+	/** Print the backpressure counters for each queue */
+	void DumpQueueCounters(FOutputDevice& Ar) const;
+	/** Print the totals & latency percentiles for each endpoint */
+	void DumpStats(FOutputDevice& Ar) const;
+	/** Update the queue depth stats */
+	void UpdateQueueDepthStats() const;
+	/** Print what each Hermes module has spent time on during and after editor startup */
+	void DumpStartupCosts(FOutputDevice& Ar) const;
+	/** Print the most popular links & their scores, and what's been prefetched */
+	void DumpLinkHistory(FOutputDevice& Ar) const;
+	/** Count a dispatched request in the link history, if its endpoint supports prefetching */
+	void RecordLinkHistory(const FString& FullPath, FName Endpoint);
+	/** Once we're idle after startup, start prefetching the most popular links, and report when it's done */
+	void TickPrefetch();
+	/** Ask the endpoints which files the most popular links need, and start reading them */
+	void StartPrefetch();
+	/** Account for what happened to a request in the stats, and add it to the journal if we're recording one */
+	void RecordRequest(const FString& FullPath, FName Endpoint, EHermesRequestPriority Priority,
+	                   EHermesDispatchResult Result, double ArrivalTime, double HandlerDuration = 0.0);
+	/** Start recording a journal, to the given path or the default location if it's empty */
+	void StartJournal(const FString& Filename);
+	void StopJournal();
+	/** Start feeding the requests in a journal back through the dispatcher */
+	void StartReplay(const FString& Filename, double Speed);
+	/** Dispatch any requests from the journal being replayed whose time has come */
+	void TickReplay();
 	/**
 	 * If it's different from our previously registered scheme, configure this one as our current one. Unregisters the
 	 * previous scheme, if one has been registered.
 	 */
 	void UpdateScheme(const FString& Scheme, bool bDebug);
 	/**
-	 * Pick the best scheme, preferring scheme providers first, then the scheme provider from our last run (if any),
-	 * then the scheme configured in the settings.
+	 * The name the transports listen for links to the scheme under. Game builds add a suffix, so that a game and an
+	 * editor never fight over the same mailslot or socket.
+	 */
+	static FString GetTransportScheme(const FString& Scheme);
+	/** Called by a one-shot ticker to listen for SchemeToRetry again, once the transports couldn't listen for it */
+	bool RetryScheme(float DeltaTime);
+	void CancelSchemeRetry();
+	/** The best scheme, preferring scheme providers first (in order of registration), then the one in the settings */
+	static FString PickScheme();
+	/**
+	 * Register the scheme from PickScheme if it's changed. Does nothing until we're fully initialized, so that every
+	 * scheme provider has had a chance to register, and registering with the OS doesn't slow down startup.
 	 */
 	void RefreshRegisteredScheme();
+	/** Start the loopback HTTP/WebSocket server if it's been enabled in the settings or on the command line. */
+	void StartLoopbackServer();
+	/** Start the memory transport if it's been enabled in the settings or on the command line. */
+	void StartMemoryTransport();
+	/** Start a transport that was registered as a modular feature, and start ticking it */
+	void StartTransport(IHermesTransport& Transport);
+	/** Stop a transport that's being unregistered, if we started it */
+	void StopTransport(IHermesTransport& Transport);
 };
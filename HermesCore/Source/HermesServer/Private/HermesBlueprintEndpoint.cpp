@@ -0,0 +1,35 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#include "HermesBlueprintEndpoint.h"
+
+#if WITH_EDITOR
+#include <Editor.h>
+#else
+#include <Engine/Engine.h>
+#endif
+
+UWorld* UHermesBlueprintEndpoint::GetWorld() const
+{
+#if WITH_EDITOR
+	// Returning null for the CDO is what lets the Blueprint editor know that instances have a world
+	if (HasAnyFlags(RF_ClassDefaultObject) || GEditor == nullptr)
+	{
+		return nullptr;
+	}
+
+	return GEditor->GetEditorWorldContext().World();
+#else
+	if (HasAnyFlags(RF_ClassDefaultObject) || GEngine == nullptr)
+	{
+		return nullptr;
+	}
+
+	for (const FWorldContext& Context : GEngine->GetWorldContexts())
+	{
+		if (Context.WorldType == EWorldType::Game)
+		{
+			return Context.World();
+		}
+	}
+	return nullptr;
+#endif
+}
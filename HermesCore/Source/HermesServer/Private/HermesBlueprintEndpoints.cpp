@@ -0,0 +1,232 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#include "HermesBlueprintEndpoints.h"
+
+#include "HermesBlueprintEndpoint.h"
+#include "HermesServer.h"
+
+#include <AssetRegistry/AssetRegistryModule.h>
+#include <Engine/Blueprint.h>
+#include <Misc/PackageName.h>
+#include <Runtime/Launch/Resources/Version.h>
+#include <UObject/Package.h>
+
+FHermesBlueprintEndpoints::FHermesBlueprintEndpoints(IHermesServerModule& InServer,
+                                                     FOnEndpointUnavailable InOnEndpointUnavailable)
+	: Server(InServer)
+	, OnEndpointUnavailable(MoveTemp(InOnEndpointUnavailable))
+{
+	IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry").Get();
+	OnAssetAddedHandle = AssetRegistry.OnAssetAdded().AddRaw(this, &FHermesBlueprintEndpoints::IndexAsset);
+	OnAssetRemovedHandle = AssetRegistry.OnAssetRemoved().AddRaw(this, &FHermesBlueprintEndpoints::UnindexAsset);
+	OnAssetRenamedHandle = AssetRegistry.OnAssetRenamed().AddRaw(this, &FHermesBlueprintEndpoints::OnAssetRenamed);
+
+	if (AssetRegistry.IsLoadingAssets())
+	{
+		UE_LOG(LogHermesServer, Verbose,
+		       TEXT("Asset registry is currently loading, deferring the Blueprint endpoint index until it finishes"));
+		OnFilesLoadedHandle = AssetRegistry.OnFilesLoaded().AddRaw(this, &FHermesBlueprintEndpoints::BuildIndex);
+	}
+	else
+	{
+		BuildIndex();
+	}
+}
+
+FHermesBlueprintEndpoints::~FHermesBlueprintEndpoints()
+{
+	if (IAssetRegistry* AssetRegistry = IAssetRegistry::Get())
+	{
+		AssetRegistry->OnFilesLoaded().Remove(OnFilesLoadedHandle);
+		AssetRegistry->OnAssetAdded().Remove(OnAssetAddedHandle);
+		AssetRegistry->OnAssetRemoved().Remove(OnAssetRemovedHandle);
+		AssetRegistry->OnAssetRenamed().Remove(OnAssetRenamedHandle);
+	}
+
+	for (const auto& Pair : LoadedClasses)
+	{
+		Server.Unregister(Pair.Key);
+	}
+}
+
+bool FHermesBlueprintEndpoints::LoadEndpoint(FName Endpoint)
+{
+	if (Loading.Contains(Endpoint))
+	{
+		return true;
+	}
+
+	if (!bIndexReady)
+	{
+		AwaitingIndex.Add(Endpoint);
+		return true;
+	}
+
+	if (const FIndexedBlueprint* Blueprint = Index.Find(Endpoint))
+	{
+		StartLoading(Endpoint, *Blueprint);
+		return true;
+	}
+
+	return false;
+}
+
+void FHermesBlueprintEndpoints::BuildIndex()
+{
+	IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry").Get();
+	AssetRegistry.OnFilesLoaded().Remove(OnFilesLoadedHandle);
+	OnFilesLoadedHandle.Reset();
+
+	// Only Blueprints that have an endpoint name tag, so this never looks at the vast majority of assets
+	FARFilter Filter;
+#if ENGINE_MAJOR_VERSION == 5 && ENGINE_MINOR_VERSION >= 1 || ENGINE_MAJOR_VERSION > 5
+	Filter.ClassPaths.Add(UBlueprint::StaticClass()->GetClassPathName());
+#else
+	Filter.ClassNames.Add(UBlueprint::StaticClass()->GetFName());
+#endif
+	Filter.bRecursiveClasses = true;
+	Filter.TagsAndValues.Add(GET_MEMBER_NAME_CHECKED(UHermesBlueprintEndpoint, EndpointName));
+
+	TArray<FAssetData> Assets;
+	AssetRegistry.GetAssets(Filter, Assets);
+
+	bIndexReady = true;
+	for (const FAssetData& AssetData : Assets)
+	{
+		IndexAsset(AssetData);
+	}
+	UE_LOG(LogHermesServer, Verbose, TEXT("Found %i Blueprint endpoint(s)"), Index.Num());
+
+	for (const FName& Endpoint : AwaitingIndex)
+	{
+		if (!LoadEndpoint(Endpoint))
+		{
+			OnEndpointUnavailable.ExecuteIfBound(Endpoint);
+		}
+	}
+	AwaitingIndex.Reset();
+}
+
+void FHermesBlueprintEndpoints::IndexAsset(const FAssetData& AssetData)
+{
+	// Assets discovered during the initial scan are picked up by BuildIndex in one go
+	if (!bIndexReady)
+	{
+		return;
+	}
+
+	FString EndpointName;
+	if (!AssetData.GetTagValue(GET_MEMBER_NAME_CHECKED(UHermesBlueprintEndpoint, EndpointName), EndpointName) ||
+		EndpointName.IsEmpty() || EndpointName == TEXT("None"))
+	{
+		return;
+	}
+
+	// Other Blueprints could have a property with the same name, so make sure this one is actually an endpoint. Native
+	// classes are always loaded, so this doesn't load anything.
+	FString NativeParentClassPath;
+	if (!AssetData.GetTagValue(FBlueprintTags::NativeParentClassPath, NativeParentClassPath))
+	{
+		return;
+	}
+	const UClass* NativeParentClass = FindObject<UClass>(
+		nullptr, *FPackageName::ExportTextPathToObjectPath(NativeParentClassPath));
+	if (NativeParentClass == nullptr || !NativeParentClass->IsChildOf(UHermesBlueprintEndpoint::StaticClass()))
+	{
+		return;
+	}
+
+	const FName Endpoint(*EndpointName);
+	FIndexedBlueprint& Blueprint = Index.FindOrAdd(Endpoint);
+	if (!Blueprint.PackageName.IsNone() && Blueprint.PackageName != AssetData.PackageName)
+	{
+		UE_LOG(LogHermesServer, Warning, TEXT("Both %s and %s handle the endpoint '%s', using the latter"),
+		       *Blueprint.PackageName.ToString(), *AssetData.PackageName.ToString(), *EndpointName);
+	}
+	Blueprint.PackageName = AssetData.PackageName;
+	Blueprint.AssetName = AssetData.AssetName;
+}
+
+void FHermesBlueprintEndpoints::UnindexAsset(const FAssetData& AssetData)
+{
+	for (auto It = Index.CreateIterator(); It; ++It)
+	{
+		if (It->Value.PackageName != AssetData.PackageName)
+		{
+			continue;
+		}
+
+		if (LoadedClasses.Remove(It->Key) > 0)
+		{
+			Server.Unregister(It->Key);
+		}
+		It.RemoveCurrent();
+	}
+}
+
+void FHermesBlueprintEndpoints::OnAssetRenamed(const FAssetData& AssetData, const FString& OldObjectPath)
+{
+	const FName OldPackageName(*FPackageName::ObjectPathToPackageName(OldObjectPath));
+	for (auto It = Index.CreateIterator(); It; ++It)
+	{
+		if (It->Value.PackageName == OldPackageName)
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	// A loaded Blueprint stays registered, the class that handles requests is the same object after a rename
+	IndexAsset(AssetData);
+}
+
+void FHermesBlueprintEndpoints::StartLoading(FName Endpoint, const FIndexedBlueprint& Blueprint)
+{
+	UE_LOG(LogHermesServer, Display, TEXT("Loading %s to handle the endpoint '%s'"), *Blueprint.PackageName.ToString(),
+	       *Endpoint.ToString());
+
+	Loading.Add(Endpoint);
+	LoadPackageAsync(Blueprint.PackageName.ToString(),
+	                 FLoadPackageAsyncDelegate::CreateSP(this, &FHermesBlueprintEndpoints::OnPackageLoaded, Endpoint,
+	                                                     Blueprint.AssetName));
+}
+
+void FHermesBlueprintEndpoints::OnPackageLoaded(const FName& PackageName, UPackage* Package,
+                                                EAsyncLoadingResult::Type Result, FName Endpoint, FName AssetName)
+{
+	Loading.Remove(Endpoint);
+
+	const UBlueprint* Blueprint = Package != nullptr && Result == EAsyncLoadingResult::Succeeded
+		                              ? FindObject<UBlueprint>(Package, *AssetName.ToString())
+		                              : nullptr;
+	UClass* Class = Blueprint != nullptr ? Blueprint->GeneratedClass.Get() : nullptr;
+	if (Class == nullptr || !Class->IsChildOf(UHermesBlueprintEndpoint::StaticClass()) ||
+		Class->HasAnyClassFlags(CLASS_Abstract))
+	{
+		UE_LOG(LogHermesServer, Error, TEXT("Unable to load a Blueprint endpoint from %s for the endpoint '%s'"),
+		       *PackageName.ToString(), *Endpoint.ToString());
+		OnEndpointUnavailable.ExecuteIfBound(Endpoint);
+		return;
+	}
+
+	// The tag we indexed could be out of date if the Blueprint was edited without being saved
+	const FName ActualEndpoint = Class->GetDefaultObject<UHermesBlueprintEndpoint>()->EndpointName;
+	if (ActualEndpoint != Endpoint)
+	{
+		UE_LOG(LogHermesServer, Error, TEXT("%s handles the endpoint '%s', not '%s'"), *PackageName.ToString(),
+		       *ActualEndpoint.ToString(), *Endpoint.ToString());
+		OnEndpointUnavailable.ExecuteIfBound(Endpoint);
+		return;
+	}
+
+	LoadedClasses.Emplace(Endpoint, Class);
+	Server.Register(Endpoint, FHermesOnRequest::CreateSP(this, &FHermesBlueprintEndpoints::OnRequest, Endpoint));
+}
+
+void FHermesBlueprintEndpoints::OnRequest(const FString& Path, const TMap<FString, FString>& QueryParams, FName Endpoint)
+{
+	const TStrongObjectPtr<UClass>* Class = LoadedClasses.Find(Endpoint);
+	if (ensure(Class != nullptr))
+	{
+		UHermesBlueprintEndpoint* Instance = NewObject<UHermesBlueprintEndpoint>(GetTransientPackage(), Class->Get());
+		Instance->HandleRequest(Path, QueryParams);
+	}
+}
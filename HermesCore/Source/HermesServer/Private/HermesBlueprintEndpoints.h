@@ -0,0 +1,66 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#pragma once
+
+#include <CoreMinimal.h>
+#include <UObject/StrongObjectPtr.h>
+#include <UObject/UObjectGlobals.h>
+
+struct FAssetData;
+struct IHermesServerModule;
+
+/**
+ * Keeps an index of which Blueprint handles which endpoint, built from the asset registry tags of
+ * UHermesBlueprintEndpoint subclasses, and loads those Blueprints on demand. Always owned by a shared pointer, so that
+ * loads that finish after it's been destroyed are ignored.
+ */
+class FHermesBlueprintEndpoints : public TSharedFromThis<FHermesBlueprintEndpoints>
+{
+public:
+	DECLARE_DELEGATE_OneParam(FOnEndpointUnavailable, FName /* Endpoint */);
+
+	/**
+	 * @param InServer where endpoints are registered once their Blueprint has loaded
+	 * @param InOnEndpointUnavailable called when an endpoint that LoadEndpoint accepted turned out to not be handled
+	 */
+	FHermesBlueprintEndpoints(IHermesServerModule& InServer, FOnEndpointUnavailable InOnEndpointUnavailable);
+	~FHermesBlueprintEndpoints();
+
+	/**
+	 * Start loading the Blueprint that handles the given endpoint, if any. Returns false if we know no Blueprint handles
+	 * it. While the asset registry is still discovering assets, this returns true and the lookup happens once it's done.
+	 */
+	bool LoadEndpoint(FName Endpoint);
+
+private:
+	struct FIndexedBlueprint
+	{
+		FName PackageName;
+		FName AssetName;
+	};
+
+	void BuildIndex();
+	void IndexAsset(const FAssetData& AssetData);
+	void UnindexAsset(const FAssetData& AssetData);
+	void OnAssetRenamed(const FAssetData& AssetData, const FString& OldObjectPath);
+
+	void StartLoading(FName Endpoint, const FIndexedBlueprint& Blueprint);
+	void OnPackageLoaded(const FName& PackageName, UPackage* Package, EAsyncLoadingResult::Type Result, FName Endpoint,
+	                     FName AssetName);
+	void OnRequest(const FString& Path, const TMap<FString, FString>& QueryParams, FName Endpoint);
+
+	IHermesServerModule& Server;
+	FOnEndpointUnavailable OnEndpointUnavailable;
+
+	bool bIndexReady = false;
+	TMap<FName, FIndexedBlueprint> Index;
+	/** Endpoints that were requested before the index was built */
+	TSet<FName> AwaitingIndex;
+	TSet<FName> Loading;
+	/** The classes of loaded Blueprints by endpoint, which also keeps them from being garbage collected */
+	TMap<FName, TStrongObjectPtr<UClass>> LoadedClasses;
+
+	FDelegateHandle OnFilesLoadedHandle;
+	FDelegateHandle OnAssetAddedHandle;
+	FDelegateHandle OnAssetRemovedHandle;
+	FDelegateHandle OnAssetRenamedHandle;
+};
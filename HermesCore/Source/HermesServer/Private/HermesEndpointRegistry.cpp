@@ -0,0 +1,80 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#include "HermesEndpointRegistry.h"
+
+#include <HAL/PlatformProcess.h>
+#include <Misc/ScopeLock.h>
+
+FHermesEndpointRegistry::FHermesEndpointRegistry()
+{
+	FHermesEndpointSnapshot* Empty = new FHermesEndpointSnapshot();
+	Empty->AddRef();
+	Current.store(Empty);
+}
+
+FHermesEndpointRegistry::~FHermesEndpointRegistry()
+{
+	Current.exchange(nullptr)->Release();
+}
+
+TRefCountPtr<const FHermesEndpointSnapshot> FHermesEndpointRegistry::Get() const
+{
+	// Announcing ourselves before loading the pointer is what keeps a writer from releasing the snapshot between our
+	// load and our AddRef. Everything is sequentially consistent, which this relies on.
+	++AcquiringReaders;
+	FHermesEndpointSnapshot* Snapshot = Current.load();
+	Snapshot->AddRef();
+	--AcquiringReaders;
+
+	return TRefCountPtr<const FHermesEndpointSnapshot>(Snapshot, /* bAddRef = */ false);
+}
+
+bool FHermesEndpointRegistry::AddOrReplace(FRegisteredEndpoint&& Endpoint)
+{
+	bool bReplaced = false;
+	Update([&Endpoint, &bReplaced](TArray<FRegisteredEndpoint>& Endpoints)
+	{
+		const FName Name = Endpoint.Name;
+		bReplaced = Endpoints.RemoveAll([Name](const FRegisteredEndpoint& Existing)
+		{
+			return Existing == Name;
+		}) > 0;
+		Endpoints.Emplace(MoveTemp(Endpoint));
+	});
+	return bReplaced;
+}
+
+bool FHermesEndpointRegistry::Remove(FName Endpoint)
+{
+	bool bRemoved = false;
+	Update([Endpoint, &bRemoved](TArray<FRegisteredEndpoint>& Endpoints)
+	{
+		bRemoved = Endpoints.RemoveAll([Endpoint](const FRegisteredEndpoint& Existing)
+		{
+			return Existing == Endpoint;
+		}) > 0;
+	});
+	return bRemoved;
+}
+
+template <typename MutatorType>
+void FHermesEndpointRegistry::Update(MutatorType&& Mutator)
+{
+	FScopeLock Lock(&WriteLock);
+
+	// Nobody else can publish while we hold the lock, so the current snapshot can't go away under us
+	FHermesEndpointSnapshot* Next = new FHermesEndpointSnapshot();
+	Next->Endpoints = Current.load()->Endpoints;
+	Mutator(Next->Endpoints);
+	Next->AddRef();
+
+	FHermesEndpointSnapshot* Previous = Current.exchange(Next);
+
+	// Any reader that could have loaded Previous has announced itself, so once the count drops to zero every reader
+	// either holds a reference to Previous, or will load Next. Readers only stay announced for a couple of
+	// instructions, so this is a very short wait.
+	while (AcquiringReaders.load() != 0)
+	{
+		FPlatformProcess::YieldThread();
+	}
+	Previous->Release();
+}
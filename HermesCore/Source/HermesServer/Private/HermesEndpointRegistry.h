@@ -0,0 +1,69 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#pragma once
+
+#include "HermesServer.h"
+
+#include <CoreMinimal.h>
+#include <HAL/CriticalSection.h>
+#include <Templates/RefCounting.h>
+
+#include <atomic>
+
+struct FRegisteredEndpoint
+{
+	FName Name;
+	FHermesOnRequest Delegate;
+	/** Only bound for endpoints that were registered with RegisterCoalescing */
+	FHermesOnCoalescedRequests CoalescedDelegate;
+	FHermesEndpointOptions Options;
+
+	bool operator==(const FName& Endpoint) const
+	{
+		return Name == Endpoint;
+	}
+};
+
+/** An immutable set of registered endpoints. Never modified after it's been published by FHermesEndpointRegistry. */
+class FHermesEndpointSnapshot : public FThreadSafeRefCountedObject
+{
+public:
+	TArray<FRegisteredEndpoint> Endpoints;
+
+	const FRegisteredEndpoint* Find(FName Endpoint) const
+	{
+		return Endpoints.FindByKey(Endpoint);
+	}
+};
+
+/**
+ * The set of registered endpoints, stored as an immutable snapshot that is replaced with an updated copy whenever an
+ * endpoint is registered or unregistered (read-copy-update).
+ *
+ * Readers on any thread get the current snapshot without taking a lock, and can keep using it for as long as they hold
+ * on to it, even if endpoints are unregistered in the meantime. Writers are serialized, and before dropping their
+ * reference to the snapshot they replaced they wait for any reader that's in the middle of acquiring it.
+ */
+class FHermesEndpointRegistry
+{
+public:
+	FHermesEndpointRegistry();
+	~FHermesEndpointRegistry();
+
+	/** The current set of endpoints. Safe to call from any thread. */
+	TRefCountPtr<const FHermesEndpointSnapshot> Get() const;
+
+	/** Add an endpoint, replacing any existing one with the same name. Returns true if one was replaced. */
+	bool AddOrReplace(FRegisteredEndpoint&& Endpoint);
+	/** Returns false if there was no such endpoint. */
+	bool Remove(FName Endpoint);
+
+private:
+	/** Publish a modified copy of the current snapshot */
+	template <typename MutatorType>
+	void Update(MutatorType&& Mutator);
+
+	std::atomic<FHermesEndpointSnapshot*> Current;
+	/** How many readers are between loading Current and adding their reference to it */
+	mutable std::atomic<int32> AcquiringReaders{0};
+	FCriticalSection WriteLock;
+};
@@ -0,0 +1,51 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#pragma once
+
+#include <Async/Async.h>
+#include <CoreMinimal.h>
+#include <Templates/SharedPointer.h>
+
+#include <atomic>
+
+/**
+ * Lets a background thread get something run on the game thread, e.g. a transport's Tick once a message has arrived.
+ * No matter how often it's woken up, there's only ever one game thread task waiting to run it. Wake ups that are still
+ * waiting when this is destroyed are skipped, so it must be destroyed on the game thread.
+ */
+class FHermesGameThreadWakeup
+{
+public:
+	explicit FHermesGameThreadWakeup(TFunction<void()>&& OnWakeup)
+		: State(MakeShared<FState, ESPMode::ThreadSafe>())
+	{
+		State->OnWakeup = MoveTemp(OnWakeup);
+	}
+
+	/** Run the function on the game thread soon, unless it's already going to. Can be called from any thread. */
+	void Wake()
+	{
+		if (State->bScheduled.exchange(true))
+		{
+			return;
+		}
+
+		AsyncTask(ENamedThreads::GameThread, [WeakState = TWeakPtr<FState, ESPMode::ThreadSafe>(State)]
+		{
+			if (const TSharedPtr<FState, ESPMode::ThreadSafe> PinnedState = WeakState.Pin())
+			{
+				// Cleared first, so that anything that arrives while it's running wakes us up again
+				PinnedState->bScheduled = false;
+				PinnedState->OnWakeup();
+			}
+		});
+	}
+
+private:
+	struct FState
+	{
+		std::atomic<bool> bScheduled{false};
+		TFunction<void()> OnWakeup;
+	};
+
+	TSharedRef<FState, ESPMode::ThreadSafe> State;
+};
@@ -0,0 +1,224 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#include "HermesHandlerWatchdog.h"
+
+#include "HermesServer.h"
+
+#include <HAL/PlatformStackWalk.h>
+#include <HAL/RunnableThread.h>
+#include <Misc/OutputDevice.h>
+#include <Misc/ScopeLock.h>
+
+// How many times a handler that keeps running is sampled, the last one at 2^(MAX_SAMPLES - 1) times its budget
+static constexpr int32 MAX_SAMPLES = 6;
+static constexpr int32 MAX_STACK_DEPTH = 64;
+
+void FHermesHandlerTimings::Add(double DurationMs, bool bOverran)
+{
+	++Calls;
+	Overruns += bOverran ? 1 : 0;
+	MaxMs = FMath::Max(MaxMs, DurationMs);
+
+	if (RecentMs.Num() < WINDOW_SIZE)
+	{
+		RecentMs.Add(static_cast<float>(DurationMs));
+	}
+	else
+	{
+		RecentMs[NextRecent] = static_cast<float>(DurationMs);
+		NextRecent = (NextRecent + 1) % WINDOW_SIZE;
+	}
+}
+
+FHermesHandlerWatchdog::FHermesHandlerWatchdog()
+{
+	WakeEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	Thread = FRunnableThread::Create(this, TEXT("HermesHandlerWatchdog"), 128 * 1024, TPri_AboveNormal);
+	UE_CLOG(Thread == nullptr, LogHermesServer, Warning,
+	        TEXT("Unable to start the handler watchdog thread, slow handlers won't be sampled"));
+}
+
+FHermesHandlerWatchdog::~FHermesHandlerWatchdog()
+{
+	if (Thread != nullptr)
+	{
+		Thread->Kill(true);
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+	WakeEvent = nullptr;
+}
+
+void FHermesHandlerWatchdog::Begin(FName Endpoint, const FString& Uri, double Budget)
+{
+	check(IsInGameThread());
+
+	FActiveHandler& Handler = ActiveHandlers.Emplace_GetRef();
+	Handler.Endpoint = Endpoint;
+	Handler.Uri = Uri;
+	Handler.Budget = Budget;
+	Handler.StartTime = FPlatformTime::Seconds();
+
+	if (ActiveHandlers.Num() == 1 && Budget > 0.0 && Thread != nullptr)
+	{
+		{
+			FScopeLock ScopeLock(&Lock);
+			++WatchedSequence;
+			bWatching = true;
+			Watched = Handler;
+			WatchedSamples = 0;
+			WatchedStack.Reset();
+		}
+		WakeEvent->Trigger();
+	}
+}
+
+double FHermesHandlerWatchdog::End()
+{
+	check(IsInGameThread());
+	check(ActiveHandlers.Num() > 0);
+
+	const FActiveHandler Handler = ActiveHandlers.Pop();
+	const double Duration = FPlatformTime::Seconds() - Handler.StartTime;
+	const bool bOverran = Handler.Budget > 0.0 && Duration > Handler.Budget;
+
+	// There's no need to wake the watchdog, it'll notice that nothing is being watched when its wait times out
+	FString Stack;
+	int32 Samples = 0;
+	if (ActiveHandlers.Num() == 0)
+	{
+		FScopeLock ScopeLock(&Lock);
+		if (bWatching)
+		{
+			++WatchedSequence;
+			bWatching = false;
+			Samples = WatchedSamples;
+			Stack = MoveTemp(WatchedStack);
+		}
+	}
+
+	Timings.FindOrAdd(Handler.Endpoint).Add(Duration * 1000.0, bOverran);
+
+	if (bOverran)
+	{
+		UE_LOG(LogHermesServer, Warning,
+		       TEXT("Hermes hitch: Endpoint=%s DurationMs=%.1f BudgetMs=%.1f Samples=%d Uri=\"%s\"%s%s"),
+		       *Handler.Endpoint.ToString(), Duration * 1000.0, Handler.Budget * 1000.0, Samples, *Handler.Uri,
+		       Stack.IsEmpty() ? TEXT("") : TEXT("\nGame thread callstack when the budget ran out:\n"), *Stack);
+	}
+
+	return Duration;
+}
+
+void FHermesHandlerWatchdog::DumpTimings(FOutputDevice& Ar) const
+{
+	TArray<FName> Endpoints;
+	Timings.GetKeys(Endpoints);
+	Endpoints.Sort(FNameLexicalLess());
+
+	Ar.Logf(TEXT("Durations are over the last %d calls to each endpoint"), FHermesHandlerTimings::WINDOW_SIZE);
+	Ar.Logf(TEXT("%-24s %10s %10s %10s %10s %10s %10s"), TEXT("Endpoint"), TEXT("Calls"), TEXT("Overruns"),
+	        TEXT("Mean (ms)"), TEXT("p50 (ms)"), TEXT("p95 (ms)"), TEXT("Max (ms)"));
+	for (const FName& Endpoint : Endpoints)
+	{
+		const FHermesHandlerTimings& EndpointTimings = Timings.FindChecked(Endpoint);
+
+		TArray<float> Sorted = EndpointTimings.RecentMs;
+		Sorted.Sort();
+		double Total = 0.0;
+		for (const float Duration : Sorted)
+		{
+			Total += Duration;
+		}
+
+		Ar.Logf(TEXT("%-24s %10llu %10llu %10.2f %10.2f %10.2f %10.2f"), *Endpoint.ToString(), EndpointTimings.Calls,
+		        EndpointTimings.Overruns, Total / Sorted.Num(), Sorted[Sorted.Num() / 2],
+		        Sorted[FMath::Min(Sorted.Num() - 1, Sorted.Num() * 95 / 100)], EndpointTimings.MaxMs);
+	}
+}
+
+uint32 FHermesHandlerWatchdog::Run()
+{
+	while (!bStopping)
+	{
+		uint32 WaitMs = MAX_uint32;
+		uint64 Sequence = 0;
+		bool bShouldSample = false;
+		{
+			FScopeLock ScopeLock(&Lock);
+			if (bWatching && WatchedSamples < MAX_SAMPLES)
+			{
+				// Sample once the budget runs out, and then each time the running time doubles
+				const double Deadline = Watched.StartTime + Watched.Budget * (1 << WatchedSamples);
+				const double Remaining = Deadline - FPlatformTime::Seconds();
+				bShouldSample = Remaining <= 0.0;
+				WaitMs = FMath::Max(1, FMath::CeilToInt(Remaining * 1000.0));
+				Sequence = WatchedSequence;
+			}
+		}
+
+		if (!bShouldSample)
+		{
+			WakeEvent->Wait(WaitMs);
+			continue;
+		}
+
+		FString Stack = CaptureGameThreadStack();
+
+		FActiveHandler Handler;
+		int32 Sample = 0;
+		{
+			FScopeLock ScopeLock(&Lock);
+			if (!bWatching || WatchedSequence != Sequence)
+			{
+				// The handler returned while we were sampling, so this stack belongs to something else
+				continue;
+			}
+
+			Sample = ++WatchedSamples;
+			Handler = Watched;
+			if (Sample == 1)
+			{
+				WatchedStack = MoveTemp(Stack);
+			}
+		}
+
+		// The first sample is logged with the hitch report, but a handler that's this far past its budget might never
+		// return, so log the rest of them right away.
+		if (Sample > 1)
+		{
+			UE_LOG(LogHermesServer, Warning,
+			       TEXT("Hermes endpoint '%s' is still handling \"%s\" after %.0f ms (budget %.0f ms), game thread callstack:\n%s"),
+			       *Handler.Endpoint.ToString(), *Handler.Uri, (FPlatformTime::Seconds() - Handler.StartTime) * 1000.0,
+			       Handler.Budget * 1000.0, *Stack);
+		}
+	}
+
+	return 0;
+}
+
+void FHermesHandlerWatchdog::Stop()
+{
+	bStopping = true;
+	WakeEvent->Trigger();
+}
+
+FString FHermesHandlerWatchdog::CaptureGameThreadStack()
+{
+	uint64 BackTrace[MAX_STACK_DEPTH];
+	const int32 Depth = static_cast<int32>(
+		FPlatformStackWalk::CaptureThreadStackBackTrace(GGameThreadId, BackTrace, MAX_STACK_DEPTH));
+
+	FString Stack;
+	for (int32 Index = 0; Index < Depth; ++Index)
+	{
+		ANSICHAR Symbol[1024];
+		Symbol[0] = '\0';
+		FPlatformStackWalk::ProgramCounterToHumanReadableString(Index, BackTrace[Index], Symbol, sizeof(Symbol));
+		Stack += TEXT("    ");
+		Stack += ANSI_TO_TCHAR(Symbol);
+		Stack += TEXT("\n");
+	}
+	return Stack;
+}
@@ -0,0 +1,94 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#pragma once
+
+#include <CoreMinimal.h>
+#include <HAL/CriticalSection.h>
+#include <HAL/Runnable.h>
+
+#include <atomic>
+
+class FEvent;
+class FOutputDevice;
+class FRunnableThread;
+
+/** Rolling statistics for how long an endpoint's handler takes */
+struct FHermesHandlerTimings
+{
+	/** How many of the most recent calls the percentiles are computed from */
+	static constexpr int32 WINDOW_SIZE = 256;
+
+	uint64 Calls = 0;
+	/** Calls that took longer than the endpoint's time budget */
+	uint64 Overruns = 0;
+	double MaxMs = 0.0;
+	/** The duration of the most recent calls, used as a ring buffer once it's full */
+	TArray<float> RecentMs;
+	int32 NextRecent = 0;
+
+	void Add(double DurationMs, bool bOverran);
+};
+
+/**
+ * Keeps an eye on endpoint handlers while they run on the game thread. If a handler runs past its time budget, a
+ * watchdog thread samples the game thread's callstack, and once the handler returns a hitch report is logged with the
+ * endpoint, the URI, how long it took and where the game thread was. Handlers that keep running are sampled again each
+ * time their running time doubles, so that one that never returns still leaves a trail in the log.
+ *
+ * Begin & End must be called on the game thread. Handlers that dispatch other requests while running are fine, only
+ * the outermost one is watched.
+ */
+class FHermesHandlerWatchdog : FRunnable
+{
+public:
+	FHermesHandlerWatchdog();
+	virtual ~FHermesHandlerWatchdog() override;
+
+	/**
+	 * Start watching a handler.
+	 *
+	 * @param Endpoint the endpoint whose handler is about to run
+	 * @param Uri what the handler was asked to do, for the hitch report
+	 * @param Budget how many seconds the handler may take before it counts as a hitch, 0 to never report it
+	 */
+	void Begin(FName Endpoint, const FString& Uri, double Budget);
+	/** Stop watching the handler that was last passed to Begin, and return how many seconds it took */
+	double End();
+
+	/** Print the rolling statistics for every endpoint that has handled a request */
+	void DumpTimings(FOutputDevice& Ar) const;
+
+private: // Implementation of FRunnable
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+private:
+	struct FActiveHandler
+	{
+		FName Endpoint;
+		FString Uri;
+		double Budget = 0.0;
+		double StartTime = 0.0;
+	};
+
+	/** Capture & symbolicate the game thread's callstack, returns an empty string if the platform can't */
+	static FString CaptureGameThreadStack();
+
+	/** Only touched on the game thread, the outermost handler is first */
+	TArray<FActiveHandler> ActiveHandlers;
+	TMap<FName, FHermesHandlerTimings> Timings;
+
+	/** Protects everything the watchdog thread looks at below */
+	FCriticalSection Lock;
+	/** Incremented whenever the outermost handler changes, so that a sample is never attributed to the wrong one */
+	uint64 WatchedSequence = 0;
+	bool bWatching = false;
+	FActiveHandler Watched;
+	/** How many times the watched handler has been sampled */
+	int32 WatchedSamples = 0;
+	/** The first sample of the watched handler, which goes in its hitch report */
+	FString WatchedStack;
+
+	FEvent* WakeEvent = nullptr;
+	FRunnableThread* Thread = nullptr;
+	std::atomic<bool> bStopping{false};
+};
@@ -0,0 +1,124 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#include "HermesLinkHistory.h"
+
+#include "HermesServer.h"
+
+#include <Misc/FileHelper.h>
+#include <Misc/Paths.h>
+
+// The score of a request halves once every this many days
+static constexpr double HALF_LIFE_DAYS = 7.0;
+static const TCHAR* HISTORY_HEADER = TEXT("HermesLinkHistory 1");
+
+double FHermesLinkHistory::GetScore(const FEntry& Entry, const FDateTime& Now)
+{
+	const double Days = FMath::Max(0.0, (Now - Entry.LastRequest).GetTotalDays());
+	return Entry.Score * FMath::Pow(0.5, Days / HALF_LIFE_DAYS);
+}
+
+void FHermesLinkHistory::Record(const FString& Path, const FDateTime& Now)
+{
+	FEntry& Entry = Entries.FindOrAdd(Path);
+	Entry.Score = GetScore(Entry, Now) + 1.0;
+	Entry.LastRequest = Now;
+	bDirty = true;
+
+	if (Entries.Num() <= MAX_ENTRIES)
+	{
+		return;
+	}
+
+	// Forget the lowest scoring path, which is never the one we just counted unless they're all tied at 1
+	const FString* Coldest = nullptr;
+	double ColdestScore = TNumericLimits<double>::Max();
+	for (const TPair<FString, FEntry>& Other : Entries)
+	{
+		const double Score = GetScore(Other.Value, Now);
+		if (Score < ColdestScore && Other.Key != Path)
+		{
+			Coldest = &Other.Key;
+			ColdestScore = Score;
+		}
+	}
+	if (Coldest != nullptr)
+	{
+		Entries.Remove(FString(*Coldest));
+	}
+}
+
+TArray<TPair<FString, double>> FHermesLinkHistory::GetHottest(int32 Num, const FDateTime& Now) const
+{
+	TArray<TPair<FString, double>> Hottest;
+	Hottest.Reserve(Entries.Num());
+	for (const TPair<FString, FEntry>& Entry : Entries)
+	{
+		Hottest.Emplace(Entry.Key, GetScore(Entry.Value, Now));
+	}
+
+	Hottest.Sort([](const TPair<FString, double>& A, const TPair<FString, double>& B)
+	{
+		return A.Value > B.Value;
+	});
+	if (Hottest.Num() > Num)
+	{
+		Hottest.SetNum(FMath::Max(0, Num));
+	}
+	return Hottest;
+}
+
+bool FHermesLinkHistory::Load(const FString& Filename)
+{
+	TArray<FString> Lines;
+	if (!FFileHelper::LoadFileToStringArray(Lines, *Filename) || Lines.Num() == 0 || Lines[0] != HISTORY_HEADER)
+	{
+		return false;
+	}
+
+	// One line per path: its score, when it was last requested (in ticks), and the path
+	Entries.Reset();
+	for (int32 Index = 1; Index < Lines.Num(); ++Index)
+	{
+		TArray<FString> Fields;
+		if (Lines[Index].ParseIntoArray(Fields, TEXT("\t"), false) != 3 || Fields[2].IsEmpty())
+		{
+			UE_LOG(LogHermesServer, Warning, TEXT("Skipping malformed line %d in %s"), Index + 1, *Filename);
+			continue;
+		}
+
+		FEntry& Entry = Entries.Add(Fields[2]);
+		Entry.Score = FCString::Atod(*Fields[0]);
+		Entry.LastRequest = FDateTime(FCString::Strtoui64(*Fields[1], nullptr, 10));
+	}
+	bDirty = false;
+	return true;
+}
+
+bool FHermesLinkHistory::Save(const FString& Filename)
+{
+	if (!bDirty)
+	{
+		return true;
+	}
+
+	TArray<FString> Lines;
+	Lines.Reserve(Entries.Num() + 1);
+	Lines.Add(HISTORY_HEADER);
+	for (const TPair<FString, FEntry>& Entry : Entries)
+	{
+		Lines.Add(FString::Printf(TEXT("%f\t%lld\t%s"), Entry.Value.Score, Entry.Value.LastRequest.GetTicks(),
+		                          *Entry.Key));
+	}
+
+	if (!FFileHelper::SaveStringArrayToFile(Lines, *Filename, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM))
+	{
+		UE_LOG(LogHermesServer, Warning, TEXT("Unable to save the link history to %s"), *Filename);
+		return false;
+	}
+	bDirty = false;
+	return true;
+}
+
+FString FHermesLinkHistory::GetDefaultFilename()
+{
+	return FPaths::ProjectSavedDir() / TEXT("Hermes") / TEXT("LinkHistory.txt");
+}
@@ -0,0 +1,45 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#pragma once
+
+#include <CoreMinimal.h>
+
+/**
+ * How often each path has been requested, as a score that halves every week, so that it follows what people are
+ * working on rather than what they worked on months ago. Only the highest scoring paths are kept, and the history is
+ * saved to Saved/Hermes so that it carries over between editor sessions.
+ */
+class FHermesLinkHistory
+{
+public:
+	/** How many paths are remembered, the lowest scoring ones are forgotten first */
+	static constexpr int32 MAX_ENTRIES = 256;
+
+	/** Count a request for the path, at the given UTC time */
+	void Record(const FString& Path, const FDateTime& Now);
+	/** Up to Num of the highest scoring paths, highest first */
+	TArray<TPair<FString, double>> GetHottest(int32 Num, const FDateTime& Now) const;
+
+	bool Load(const FString& Filename);
+	/** Write the history to disk if it's changed since it was loaded or last saved */
+	bool Save(const FString& Filename);
+	static FString GetDefaultFilename();
+
+	int32 Num() const
+	{
+		return Entries.Num();
+	}
+
+private:
+	struct FEntry
+	{
+		/** The score as of LastRequest */
+		double Score = 0.0;
+		FDateTime LastRequest;
+	};
+
+	/** The entry's score at the given time */
+	static double GetScore(const FEntry& Entry, const FDateTime& Now);
+
+	TMap<FString, FEntry> Entries;
+	bool bDirty = false;
+};
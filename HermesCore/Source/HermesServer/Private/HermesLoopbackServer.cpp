@@ -0,0 +1,906 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#include "HermesLoopbackServer.h"
+
+#include <HAL/FileManager.h>
+#include <HAL/Runnable.h>
+#include <HAL/RunnableThread.h>
+#include <IPAddress.h>
+#include <Misc/Base64.h>
+#include <Misc/FileHelper.h>
+#include <Misc/Paths.h>
+#include <Misc/ScopeLock.h>
+#include <Misc/SecureHash.h>
+#include <SocketSubsystem.h>
+#include <Sockets.h>
+
+#include <atomic>
+
+// Same limit as the OS handler's messages: around the maximum path size (32k), plus room for the request line & headers.
+static constexpr int32 MAX_REQUEST_SIZE = 64 * 1024;
+// Limit on how many tools can be connected at the same time, to avoid a misbehaving client exhausting our handles.
+static constexpr int32 MAX_CONNECTIONS = 64;
+// How much we try to read from a single connection in a single Recv call.
+static constexpr int32 RECEIVE_CHUNK_SIZE = 16 * 1024;
+// How long the threads block before checking whether they've been asked to stop, they're normally woken up sooner.
+static constexpr int32 WAIT_INTERVAL_MS = 100;
+
+// From RFC6455, the GUID that's appended to Sec-WebSocket-Key to generate Sec-WebSocket-Accept
+static const ANSICHAR* WEBSOCKET_ACCEPT_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+namespace WebSocketOpcode
+{
+	static constexpr uint8 Continuation = 0x0;
+	static constexpr uint8 Text = 0x1;
+	static constexpr uint8 Binary = 0x2;
+	static constexpr uint8 Close = 0x8;
+	static constexpr uint8 Ping = 0x9;
+	static constexpr uint8 Pong = 0xA;
+}
+
+/**
+ * Reads and parses requests from one client on its own thread, and posts them to the game thread. Responses are sent
+ * from the game thread, and anything the socket wouldn't take right away is sent from here once there's room.
+ */
+struct FHermesLoopbackServer::FConnection : FRunnable, TSharedFromThis<FConnection, ESPMode::ThreadSafe>
+{
+	FConnection(FHermesLoopbackServer& InServer, FSocket* InSocket);
+	virtual ~FConnection() override;
+
+	/** Separate from the constructor, since the thread needs AsShared to work */
+	bool StartThread();
+
+	bool IsFinished() const
+	{
+		return bFinished;
+	}
+
+	/** Game thread only, sends the response to a request that was posted by this connection */
+	void SendResponse(const TArray<uint8>& Response);
+
+private: // Implementation of FRunnable
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+private:
+	/** Returns false if the client is done sending */
+	bool ReceiveFromSocket();
+	bool HasPendingSend();
+	/** Sends as much as the socket will take, SendLock must be held. Returns false if the connection is broken. */
+	bool FlushLocked();
+
+	void ProcessHttpRequests();
+	void ProcessWebSocketFrames();
+	void PostReply(TArray<uint8>&& Response, bool bClose);
+	void PostDispatch(EPendingRequestKind Kind, const FString& Path, EHermesRequestPriority Priority, bool bClose);
+	void PostHttpResponse(int32 StatusCode, const FString& Body, bool bClose);
+	void PostWebSocketFrame(uint8 Opcode, const uint8* Payload, int32 PayloadSize, bool bClose);
+
+	FHermesLoopbackServer& Server;
+	FSocket* Socket;
+	FRunnableThread* Thread = nullptr;
+	/** Triggered whenever the game thread has sent a response */
+	FEvent* ResponseEvent;
+	std::atomic<bool> bStopping{false};
+	std::atomic<bool> bFinished{false};
+	/** Requests we've posted that the game thread hasn't answered yet */
+	std::atomic<int32> NumOutstanding{0};
+
+	FCriticalSection SendLock;
+	TArray<uint8> SendBuffer;
+	/** Set once the socket has been closed, after which nothing is sent. Protected by SendLock. */
+	bool bClosed = false;
+	bool bSendFailed = false;
+
+	// Only touched by the connection's thread
+	TArray<uint8> ReceiveBuffer;
+	/** Once the connection has been upgraded, everything we receive is parsed as WebSocket frames */
+	bool bWebSocket = false;
+	/** Set once we've posted a response that closes the connection, nothing after it is read */
+	bool bClosing = false;
+	/** Payload of a fragmented WebSocket message that we're still receiving continuation frames for */
+	TArray<uint8> FragmentedMessage;
+	/** Priority for every message on a WebSocket connection, decided by the handshake */
+	EHermesRequestPriority WebSocketPriority = EHermesRequestPriority::Scripted;
+};
+
+/** Accepts connections on its own thread, and owns them until their threads are done. */
+class FHermesLoopbackServer::FAcceptor : FRunnable
+{
+public:
+	explicit FAcceptor(FHermesLoopbackServer& InServer);
+	/** Stops accepting, and closes every connection once its thread has exited */
+	virtual ~FAcceptor() override;
+
+	bool IsRunning() const
+	{
+		return Thread != nullptr;
+	}
+
+private: // Implementation of FRunnable
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+private:
+	FHermesLoopbackServer& Server;
+	FRunnableThread* Thread = nullptr;
+	std::atomic<bool> bStopping{false};
+	TArray<TSharedPtr<FConnection, ESPMode::ThreadSafe>> Connections;
+};
+
+static FString Utf8BytesToString(const uint8* Data, int32 Num)
+{
+	FUTF8ToTCHAR Conversion(reinterpret_cast<const ANSICHAR*>(Data), Num);
+	return FString(Conversion.Length(), Conversion.Get());
+}
+
+FHermesLoopbackServer::FHermesLoopbackServer(int32 InPort, const FString& InToken)
+	: Port(InPort)
+	, Token(InToken)
+	, Wakeup([this]
+	{
+		Tick();
+	})
+{
+	if (Token.IsEmpty())
+	{
+		Token = FGuid::NewGuid().ToString(EGuidFormats::Digits);
+	}
+}
+
+FHermesLoopbackServer::~FHermesLoopbackServer()
+{
+	Stop();
+}
+
+FString FHermesLoopbackServer::GetTokenFilename(int32 Port)
+{
+	return FPaths::ProjectSavedDir() / TEXT("Hermes") / FString::Printf(TEXT("LoopbackToken-%d.txt"), Port);
+}
+
+FName FHermesLoopbackServer::GetTransportName() const
+{
+	return TEXT("Loopback");
+}
+
+bool FHermesLoopbackServer::Start(IHermesRequestSink& InSink)
+{
+	check(ListenSocket == nullptr);
+
+	ISocketSubsystem* SocketSubsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+	if (SocketSubsystem == nullptr)
+	{
+		UE_LOG(LogHermesServer, Error, TEXT("No socket subsystem available, unable to start loopback server"));
+		return false;
+	}
+
+	// Only ever bind to the loopback interface, we don't want to expose endpoints to the network.
+	TSharedRef<FInternetAddr> Address = SocketSubsystem->CreateInternetAddr();
+	Address->SetLoopbackAddress();
+	Address->SetPort(Port);
+
+	FSocket* Socket = SocketSubsystem->CreateSocket(NAME_Stream, TEXT("HermesLoopbackServer"), Address->GetProtocolType());
+	if (Socket == nullptr)
+	{
+		UE_LOG(LogHermesServer, Error, TEXT("Unable to create socket for loopback server"));
+		return false;
+	}
+
+	if (!Socket->SetNonBlocking(true) || !Socket->Bind(*Address) || !Socket->Listen(16))
+	{
+		UE_LOG(LogHermesServer, Error, TEXT("Unable to listen on %s for loopback server: %s"),
+		       *Address->ToString(true), SocketSubsystem->GetSocketError(SocketSubsystem->GetLastErrorCode()));
+		SocketSubsystem->DestroySocket(Socket);
+		return false;
+	}
+
+	ListenSocket = Socket;
+	Sink = &InSink;
+	Acceptor = MakeUnique<FAcceptor>(*this);
+	if (!Acceptor->IsRunning())
+	{
+		UE_LOG(LogHermesServer, Error, TEXT("Unable to start the loopback server's thread"));
+		Stop();
+		return false;
+	}
+
+	Port = Socket->GetPortNo();
+	Address->SetPort(Port);
+	const FString TokenFilename = GetTokenFilename(Port);
+	bWroteTokenFile = FFileHelper::SaveStringToFile(Token, *TokenFilename);
+	if (!bWroteTokenFile)
+	{
+		UE_LOG(LogHermesServer, Warning, TEXT("Unable to write the loopback server token to %s"), *TokenFilename);
+	}
+
+	UE_LOG(LogHermesServer, Display, TEXT("Loopback server listening on http://%s/, token is in %s"),
+	       *Address->ToString(true), *FPaths::ConvertRelativePathToFull(TokenFilename));
+	return true;
+}
+
+void FHermesLoopbackServer::Stop()
+{
+	// Waits for every thread, so nothing is posted after this
+	Acceptor.Reset();
+	PendingRequests.Empty();
+
+	if (ListenSocket != nullptr)
+	{
+		ListenSocket->Close();
+		ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(ListenSocket);
+		ListenSocket = nullptr;
+	}
+	Sink = nullptr;
+
+	if (bWroteTokenFile)
+	{
+		IFileManager::Get().Delete(*GetTokenFilename(Port), false, false, true);
+		bWroteTokenFile = false;
+	}
+}
+
+void FHermesLoopbackServer::Tick()
+{
+	FPendingRequest Request;
+	while (Sink != nullptr && PendingRequests.Dequeue(Request))
+	{
+		TArray<uint8> Response = MoveTemp(Request.Response);
+		if (Request.Kind == EPendingRequestKind::Http)
+		{
+			const int32 StatusCode = GetStatusCode(Sink->DispatchPath(Request.Path, Request.Priority));
+			AppendHttpResponse(Response, StatusCode, GetStatusText(StatusCode), Request.bClose);
+		}
+		else if (Request.Kind == EPendingRequestKind::WebSocket)
+		{
+			const int32 StatusCode = GetStatusCode(Sink->DispatchPath(Request.Path, Request.Priority));
+			const FTCHARToUTF8 Reply(*FString::Printf(TEXT("%d %s"), StatusCode, GetStatusText(StatusCode)));
+			AppendWebSocketFrame(Response, WebSocketOpcode::Text, reinterpret_cast<const uint8*>(Reply.Get()),
+			                     Reply.Length());
+		}
+
+		Request.Connection->SendResponse(Response);
+	}
+}
+
+bool FHermesLoopbackServer::IsEventDriven() const
+{
+	return Acceptor.IsValid();
+}
+
+void FHermesLoopbackServer::PostRequest(FPendingRequest&& Request)
+{
+	PendingRequests.Enqueue(MoveTemp(Request));
+	Wakeup.Wake();
+}
+
+FHermesLoopbackServer::FAcceptor::FAcceptor(FHermesLoopbackServer& InServer)
+	: Server(InServer)
+{
+	Thread = FRunnableThread::Create(this, TEXT("HermesLoopbackAcceptor"), 64 * 1024, TPri_BelowNormal);
+}
+
+FHermesLoopbackServer::FAcceptor::~FAcceptor()
+{
+	if (Thread != nullptr)
+	{
+		Thread->Kill(true);
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	// Requests that are still waiting for the game thread keep their connection alive, but its thread is gone
+	Connections.Reset();
+}
+
+uint32 FHermesLoopbackServer::FAcceptor::Run()
+{
+	const FTimespan WaitInterval = FTimespan::FromMilliseconds(WAIT_INTERVAL_MS);
+	FSocket* ListenSocket = Server.ListenSocket;
+	while (!bStopping)
+	{
+		Connections.RemoveAll([](const TSharedPtr<FConnection, ESPMode::ThreadSafe>& Connection)
+		{
+			return Connection->IsFinished();
+		});
+
+		bool bHasPendingConnection = false;
+		if (!ListenSocket->WaitForPendingConnection(bHasPendingConnection, WaitInterval) || !bHasPendingConnection)
+		{
+			continue;
+		}
+
+		FSocket* Socket = ListenSocket->Accept(TEXT("HermesLoopbackConnection"));
+		if (Socket == nullptr)
+		{
+			continue;
+		}
+
+		if (Connections.Num() >= MAX_CONNECTIONS)
+		{
+			UE_LOG(LogHermesServer, Warning, TEXT("Rejecting loopback connection, already have %d connections open"),
+			       Connections.Num());
+			Socket->Close();
+			ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(Socket);
+			continue;
+		}
+
+		Socket->SetNonBlocking(true);
+		Socket->SetNoDelay(true);
+
+		TSharedRef<FConnection, ESPMode::ThreadSafe> Connection = MakeShared<FConnection, ESPMode::ThreadSafe>(
+			Server, Socket);
+		if (!Connection->StartThread())
+		{
+			UE_LOG(LogHermesServer, Warning, TEXT("Rejecting loopback connection, unable to start its thread"));
+			continue;
+		}
+		Connections.Add(Connection);
+		UE_LOG(LogHermesServer, Verbose, TEXT("Accepted loopback connection"));
+	}
+
+	return 0;
+}
+
+void FHermesLoopbackServer::FAcceptor::Stop()
+{
+	bStopping = true;
+}
+
+FHermesLoopbackServer::FConnection::FConnection(FHermesLoopbackServer& InServer, FSocket* InSocket)
+	: Server(InServer)
+	, Socket(InSocket)
+	, ResponseEvent(FPlatformProcess::GetSynchEventFromPool(false))
+{
+}
+
+FHermesLoopbackServer::FConnection::~FConnection()
+{
+	if (Thread != nullptr)
+	{
+		Thread->Kill(true);
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	Socket->Close();
+	ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(Socket);
+	FPlatformProcess::ReturnSynchEventToPool(ResponseEvent);
+}
+
+bool FHermesLoopbackServer::FConnection::StartThread()
+{
+	// Enough stack for the receive chunk, the parsing is all on the heap
+	Thread = FRunnableThread::Create(this, TEXT("HermesLoopbackConnection"), 128 * 1024, TPri_BelowNormal);
+	return Thread != nullptr;
+}
+
+void FHermesLoopbackServer::FConnection::SendResponse(const TArray<uint8>& Response)
+{
+	{
+		FScopeLock Lock(&SendLock);
+		SendBuffer.Append(Response);
+		FlushLocked();
+	}
+
+	// Only once the response is in the buffer, otherwise the connection thread might hang up before it's been sent
+	--NumOutstanding;
+	ResponseEvent->Trigger();
+}
+
+uint32 FHermesLoopbackServer::FConnection::Run()
+{
+	const FTimespan WaitInterval = FTimespan::FromMilliseconds(WAIT_INTERVAL_MS);
+	bool bReading = true;
+	while (!bStopping)
+	{
+		if (bReading)
+		{
+			// Wakes up as soon as the client sends something, or there's room for what the game thread couldn't send
+			const ESocketWaitConditions::Type Condition = HasPendingSend()
+				                                              ? ESocketWaitConditions::WaitForReadOrWrite
+				                                              : ESocketWaitConditions::WaitForRead;
+			Socket->Wait(Condition, WaitInterval);
+
+			// Even if the client hung up, answer anything it managed to send us before closing
+			const bool bPeerOpen = ReceiveFromSocket();
+			if (bWebSocket)
+			{
+				ProcessWebSocketFrames();
+			}
+			else
+			{
+				ProcessHttpRequests();
+			}
+			bReading = bPeerOpen && !bClosing;
+		}
+		else if (HasPendingSend())
+		{
+			Socket->Wait(ESocketWaitConditions::WaitForWrite, WaitInterval);
+		}
+		else if (NumOutstanding > 0)
+		{
+			ResponseEvent->Wait(WAIT_INTERVAL_MS);
+		}
+
+		FScopeLock Lock(&SendLock);
+		if (!FlushLocked() || (!bReading && NumOutstanding == 0 && SendBuffer.Num() == 0))
+		{
+			break;
+		}
+	}
+
+	{
+		FScopeLock Lock(&SendLock);
+		bClosed = true;
+		Socket->Close();
+	}
+	bFinished = true;
+	return 0;
+}
+
+void FHermesLoopbackServer::FConnection::Stop()
+{
+	bStopping = true;
+	ResponseEvent->Trigger();
+
+	// Gets the thread out of Wait, and the game thread can't be sending while we hold the lock
+	FScopeLock Lock(&SendLock);
+	if (!bClosed)
+	{
+		Socket->Shutdown(ESocketShutdownMode::ReadWrite);
+	}
+}
+
+bool FHermesLoopbackServer::FConnection::ReceiveFromSocket()
+{
+	uint8 Chunk[RECEIVE_CHUNK_SIZE];
+	while (true)
+	{
+		int32 BytesRead = 0;
+		const bool bSuccess = Socket->Recv(Chunk, RECEIVE_CHUNK_SIZE, BytesRead);
+		if (BytesRead > 0)
+		{
+			ReceiveBuffer.Append(Chunk, BytesRead);
+		}
+
+		// Recv reports failure both when the peer hung up and for real errors
+		if (!bSuccess)
+		{
+			return false;
+		}
+
+		if (BytesRead < RECEIVE_CHUNK_SIZE)
+		{
+			return true;
+		}
+	}
+}
+
+bool FHermesLoopbackServer::FConnection::HasPendingSend()
+{
+	FScopeLock Lock(&SendLock);
+	return SendBuffer.Num() > 0;
+}
+
+bool FHermesLoopbackServer::FConnection::FlushLocked()
+{
+	while (SendBuffer.Num() > 0 && !bClosed && !bSendFailed)
+	{
+		int32 BytesSent = 0;
+		if (!Socket->Send(SendBuffer.GetData(), SendBuffer.Num(), BytesSent))
+		{
+			// A full send buffer is reported as a failure too, the connection thread sends the rest once there's room
+			if (ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->GetLastErrorCode() == SE_EWOULDBLOCK)
+			{
+				break;
+			}
+
+			bSendFailed = true;
+			SendBuffer.Reset();
+			break;
+		}
+
+		if (BytesSent <= 0)
+		{
+			break;
+		}
+
+		SendBuffer.RemoveAt(0, BytesSent);
+	}
+
+	return !bSendFailed;
+}
+
+void FHermesLoopbackServer::FConnection::PostReply(TArray<uint8>&& Response, bool bClose)
+{
+	FPendingRequest Request;
+	Request.Connection = AsShared();
+	Request.Response = MoveTemp(Response);
+	Request.bClose = bClose;
+	bClosing |= bClose;
+	++NumOutstanding;
+	Server.PostRequest(MoveTemp(Request));
+}
+
+void FHermesLoopbackServer::FConnection::PostDispatch(EPendingRequestKind Kind, const FString& Path,
+                                                      EHermesRequestPriority Priority, bool bClose)
+{
+	FPendingRequest Request;
+	Request.Connection = AsShared();
+	Request.Kind = Kind;
+	Request.Path = Path;
+	Request.Priority = Priority;
+	Request.bClose = bClose;
+	bClosing |= bClose;
+	++NumOutstanding;
+	Server.PostRequest(MoveTemp(Request));
+}
+
+void FHermesLoopbackServer::FConnection::PostHttpResponse(int32 StatusCode, const FString& Body, bool bClose)
+{
+	TArray<uint8> Response;
+	AppendHttpResponse(Response, StatusCode, Body, bClose);
+	PostReply(MoveTemp(Response), bClose);
+}
+
+void FHermesLoopbackServer::FConnection::PostWebSocketFrame(uint8 Opcode, const uint8* Payload, int32 PayloadSize,
+                                                            bool bClose)
+{
+	TArray<uint8> Response;
+	AppendWebSocketFrame(Response, Opcode, Payload, PayloadSize);
+	PostReply(MoveTemp(Response), bClose);
+}
+
+void FHermesLoopbackServer::FConnection::ProcessHttpRequests()
+{
+	static const uint8 HeaderTerminator[] = {'\r', '\n', '\r', '\n'};
+	static constexpr int32 HeaderTerminatorSize = UE_ARRAY_COUNT(HeaderTerminator);
+
+	// Keep going for as long as there are complete requests in the buffer, that's what allows for pipelining
+	while (!bWebSocket && !bClosing)
+	{
+		const TArray<uint8>& Buffer = ReceiveBuffer;
+		int32 HeaderEnd = INDEX_NONE;
+		for (int32 Index = 0; Index + HeaderTerminatorSize <= Buffer.Num(); ++Index)
+		{
+			if (FMemory::Memcmp(Buffer.GetData() + Index, HeaderTerminator, HeaderTerminatorSize) == 0)
+			{
+				HeaderEnd = Index;
+				break;
+			}
+		}
+
+		if (HeaderEnd == INDEX_NONE)
+		{
+			if (Buffer.Num() > MAX_REQUEST_SIZE)
+			{
+				PostHttpResponse(431, TEXT("Request header is too large"), true);
+			}
+			return;
+		}
+
+		TArray<FString> Lines;
+		Utf8BytesToString(Buffer.GetData(), HeaderEnd).ParseIntoArray(Lines, TEXT("\r\n"), false);
+
+		TArray<FString> RequestLine;
+		if (Lines.Num() == 0 || Lines[0].ParseIntoArray(RequestLine, TEXT(" "), true) != 3)
+		{
+			PostHttpResponse(400, TEXT("Malformed request line"), true);
+			return;
+		}
+
+		const FString& Method = RequestLine[0];
+		const FString& Target = RequestLine[1];
+		const FString& Version = RequestLine[2];
+
+		TMap<FString, FString> Headers;
+		for (int32 LineIndex = 1; LineIndex < Lines.Num(); ++LineIndex)
+		{
+			int32 Colon = INDEX_NONE;
+			if (Lines[LineIndex].FindChar(TEXT(':'), Colon))
+			{
+				Headers.Emplace(Lines[LineIndex].Left(Colon).TrimStartAndEnd().ToLower(),
+				                Lines[LineIndex].Mid(Colon + 1).TrimStartAndEnd());
+			}
+		}
+
+		if (Headers.Contains(TEXT("transfer-encoding")))
+		{
+			PostHttpResponse(501, TEXT("Chunked request bodies are not supported"), true);
+			return;
+		}
+
+		// We don't use the request body for anything, but we need to skip past it to get to the next request
+		const FString* ContentLengthHeader = Headers.Find(TEXT("content-length"));
+		const int64 ContentLength = ContentLengthHeader ? FCString::Atoi64(**ContentLengthHeader) : 0;
+		if (ContentLength < 0 || ContentLength > MAX_REQUEST_SIZE)
+		{
+			PostHttpResponse(413, TEXT("Request body is too large"), true);
+			return;
+		}
+
+		const int32 RequestSize = HeaderEnd + HeaderTerminatorSize + static_cast<int32>(ContentLength);
+		if (Buffer.Num() < RequestSize)
+		{
+			// Wait for the rest of the body
+			return;
+		}
+		ReceiveBuffer.RemoveAt(0, RequestSize);
+
+		const FString* ConnectionHeader = Headers.Find(TEXT("connection"));
+		const bool bHttp11 = Version == TEXT("HTTP/1.1");
+		const bool bClose = ConnectionHeader
+			                    ? ConnectionHeader->Contains(TEXT("close"))
+			                    : !bHttp11;
+
+		// We don't want a random web page to be able to drive the editor, see CheckRequestIsTrusted
+		if (const TCHAR* Reason = Server.CheckRequestIsTrusted(Headers))
+		{
+			PostHttpResponse(403, Reason, true);
+			return;
+		}
+
+		if (Method != TEXT("GET") && Method != TEXT("POST"))
+		{
+			PostHttpResponse(405, TEXT("Only GET and POST are supported"), bClose);
+			continue;
+		}
+
+		const FString* Upgrade = Headers.Find(TEXT("upgrade"));
+		if (Upgrade && Upgrade->Equals(TEXT("websocket"), ESearchCase::IgnoreCase))
+		{
+			const FString* Key = Headers.Find(TEXT("sec-websocket-key"));
+			if (Key == nullptr || !bHttp11 || Method != TEXT("GET"))
+			{
+				PostHttpResponse(400, TEXT("Invalid WebSocket handshake"), true);
+				return;
+			}
+
+			const FTCHARToUTF8 KeyUtf8(**Key);
+			TArray<uint8> AcceptInput(reinterpret_cast<const uint8*>(KeyUtf8.Get()), KeyUtf8.Length());
+			AcceptInput.Append(reinterpret_cast<const uint8*>(WEBSOCKET_ACCEPT_GUID),
+			                   FCStringAnsi::Strlen(WEBSOCKET_ACCEPT_GUID));
+			TArray<uint8> AcceptHash;
+			AcceptHash.SetNumUninitialized(20);
+			FSHA1::HashBuffer(AcceptInput.GetData(), AcceptInput.Num(), AcceptHash.GetData());
+
+			const FString Response = FString::Printf(
+				TEXT("HTTP/1.1 101 Switching Protocols\r\n")
+				TEXT("Upgrade: websocket\r\n")
+				TEXT("Connection: Upgrade\r\n")
+				TEXT("Sec-WebSocket-Accept: %s\r\n\r\n"), *FBase64::Encode(AcceptHash));
+			const FTCHARToUTF8 ResponseUtf8(*Response);
+			PostReply(TArray<uint8>(reinterpret_cast<const uint8*>(ResponseUtf8.Get()), ResponseUtf8.Length()), false);
+
+			UE_LOG(LogHermesServer, Verbose, TEXT("Upgraded loopback connection to WebSocket"));
+			bWebSocket = true;
+			WebSocketPriority = ParsePriority(Headers.Find(TEXT("x-hermes-priority")));
+			ProcessWebSocketFrames();
+			return;
+		}
+
+		const EHermesRequestPriority Priority = ParsePriority(Headers.Find(TEXT("x-hermes-priority")));
+		PostDispatch(EPendingRequestKind::Http, Target, Priority, bClose);
+	}
+}
+
+void FHermesLoopbackServer::FConnection::ProcessWebSocketFrames()
+{
+	while (!bClosing)
+	{
+		const TArray<uint8>& Buffer = ReceiveBuffer;
+		if (Buffer.Num() < 2)
+		{
+			return;
+		}
+
+		const bool bFinal = (Buffer[0] & 0x80) != 0;
+		const uint8 Opcode = Buffer[0] & 0x0F;
+		const bool bMasked = (Buffer[1] & 0x80) != 0;
+		uint64 PayloadSize = Buffer[1] & 0x7F;
+		int32 HeaderSize = 2;
+
+		if (PayloadSize == 126)
+		{
+			if (Buffer.Num() < 4)
+			{
+				return;
+			}
+			PayloadSize = (uint64(Buffer[2]) << 8) | Buffer[3];
+			HeaderSize = 4;
+		}
+		else if (PayloadSize == 127)
+		{
+			if (Buffer.Num() < 10)
+			{
+				return;
+			}
+			PayloadSize = 0;
+			for (int32 Index = 2; Index < 10; ++Index)
+			{
+				PayloadSize = (PayloadSize << 8) | Buffer[Index];
+			}
+			HeaderSize = 10;
+		}
+
+		// Clients are required to mask all their frames (RFC6455 section 5.1)
+		if (!bMasked || PayloadSize + FragmentedMessage.Num() > MAX_REQUEST_SIZE)
+		{
+			const uint8 CloseCode[] = {0x03, uint8(bMasked ? 0xF1 : 0xEA)}; // 1009 (too big) or 1002 (protocol error)
+			PostWebSocketFrame(WebSocketOpcode::Close, CloseCode, UE_ARRAY_COUNT(CloseCode), true);
+			return;
+		}
+
+		const int32 FrameSize = HeaderSize + 4 + static_cast<int32>(PayloadSize);
+		if (Buffer.Num() < FrameSize)
+		{
+			return;
+		}
+
+		const uint8* Mask = Buffer.GetData() + HeaderSize;
+		TArray<uint8> Payload(Buffer.GetData() + HeaderSize + 4, static_cast<int32>(PayloadSize));
+		for (int32 Index = 0; Index < Payload.Num(); ++Index)
+		{
+			Payload[Index] ^= Mask[Index % 4];
+		}
+		ReceiveBuffer.RemoveAt(0, FrameSize);
+
+		switch (Opcode)
+		{
+			case WebSocketOpcode::Continuation:
+			case WebSocketOpcode::Text:
+			case WebSocketOpcode::Binary:
+			{
+				FragmentedMessage.Append(Payload);
+				if (bFinal)
+				{
+					const FString Path = Utf8BytesToString(FragmentedMessage.GetData(), FragmentedMessage.Num());
+					FragmentedMessage.Reset();
+					PostDispatch(EPendingRequestKind::WebSocket, Path, WebSocketPriority, false);
+				}
+				break;
+			}
+			case WebSocketOpcode::Ping:
+				PostWebSocketFrame(WebSocketOpcode::Pong, Payload.GetData(), Payload.Num(), false);
+				break;
+			case WebSocketOpcode::Pong:
+				break;
+			case WebSocketOpcode::Close:
+			default:
+				// Echo the close frame (or reject the unknown opcode) and hang up
+				PostWebSocketFrame(WebSocketOpcode::Close, Payload.GetData(), FMath::Min(Payload.Num(), 2), true);
+				break;
+		}
+	}
+}
+
+void FHermesLoopbackServer::AppendHttpResponse(TArray<uint8>& Out, int32 StatusCode, const FString& Body, bool bClose)
+{
+	const FTCHARToUTF8 BodyUtf8(*Body);
+	const FString Header = FString::Printf(
+		TEXT("HTTP/1.1 %d %s\r\n")
+		TEXT("Content-Type: text/plain; charset=utf-8\r\n")
+		TEXT("Content-Length: %d\r\n")
+		TEXT("%s\r\n"), StatusCode, GetStatusText(StatusCode), BodyUtf8.Length(),
+		bClose ? TEXT("Connection: close\r\n") : TEXT(""));
+	const FTCHARToUTF8 HeaderUtf8(*Header);
+
+	Out.Append(reinterpret_cast<const uint8*>(HeaderUtf8.Get()), HeaderUtf8.Length());
+	Out.Append(reinterpret_cast<const uint8*>(BodyUtf8.Get()), BodyUtf8.Length());
+}
+
+void FHermesLoopbackServer::AppendWebSocketFrame(TArray<uint8>& Out, uint8 Opcode, const uint8* Payload,
+                                                 int32 PayloadSize)
+{
+	// Server frames are always sent unfragmented and unmasked
+	Out.Add(0x80 | Opcode);
+	if (PayloadSize < 126)
+	{
+		Out.Add(static_cast<uint8>(PayloadSize));
+	}
+	else if (PayloadSize <= 0xFFFF)
+	{
+		Out.Add(126);
+		Out.Add(static_cast<uint8>(PayloadSize >> 8));
+		Out.Add(static_cast<uint8>(PayloadSize));
+	}
+	else
+	{
+		Out.Add(127);
+		for (int32 Shift = 56; Shift >= 0; Shift -= 8)
+		{
+			Out.Add(static_cast<uint8>(uint64(PayloadSize) >> Shift));
+		}
+	}
+	Out.Append(Payload, PayloadSize);
+}
+
+EHermesRequestPriority FHermesLoopbackServer::ParsePriority(const FString* Header)
+{
+	if (Header != nullptr)
+	{
+		for (int32 Index = 0; Index < static_cast<int32>(EHermesRequestPriority::Num); ++Index)
+		{
+			const EHermesRequestPriority Priority = static_cast<EHermesRequestPriority>(Index);
+			if (Header->Equals(LexToString(Priority), ESearchCase::IgnoreCase))
+			{
+				return Priority;
+			}
+		}
+	}
+
+	return EHermesRequestPriority::Scripted;
+}
+
+const TCHAR* FHermesLoopbackServer::CheckRequestIsTrusted(const TMap<FString, FString>& Headers) const
+{
+	// Browsers send these on everything they make, including simple requests (e.g. an <img> tag or a navigation)
+	// that don't carry an Origin header. Local tools have no reason to send any of them.
+	if (Headers.Contains(TEXT("origin")) || Headers.Contains(TEXT("sec-fetch-site")) ||
+		Headers.Contains(TEXT("sec-fetch-mode")))
+	{
+		return TEXT("Requests from browsers are not allowed");
+	}
+
+	// Older browsers don't send Sec-Fetch-*, but they can't attach a custom header without a preflight (which we
+	// refuse, since we don't support OPTIONS), and a page that rebinds its own host name to 127.0.0.1 can't know
+	// the token.
+	const FString* RequestToken = Headers.Find(TEXT("x-hermes-token"));
+	if (RequestToken == nullptr || !RequestToken->Equals(Token, ESearchCase::CaseSensitive))
+	{
+		return TEXT("Missing or invalid X-Hermes-Token header");
+	}
+
+	return nullptr;
+}
+
+int32 FHermesLoopbackServer::GetStatusCode(EHermesDispatchResult Result)
+{
+	switch (Result)
+	{
+		case EHermesDispatchResult::Dispatched:
+			return 200;
+		case EHermesDispatchResult::NoHandler:
+			return 404;
+		case EHermesDispatchResult::Queued:
+			return 202;
+		case EHermesDispatchResult::Duplicate:
+			return 208;
+		case EHermesDispatchResult::Rejected:
+		case EHermesDispatchResult::Dropped:
+			return 503;
+	}
+
+	checkNoEntry();
+	return 500;
+}
+
+const TCHAR* FHermesLoopbackServer::GetStatusText(int32 StatusCode)
+{
+	switch (StatusCode)
+	{
+		case 200:
+			return TEXT("OK");
+		case 202:
+			return TEXT("Accepted");
+		case 208:
+			return TEXT("Already Reported");
+		case 400:
+			return TEXT("Bad Request");
+		case 403:
+			return TEXT("Forbidden");
+		case 404:
+			return TEXT("Not Found");
+		case 405:
+			return TEXT("Method Not Allowed");
+		case 413:
+			return TEXT("Payload Too Large");
+		case 431:
+			return TEXT("Request Header Fields Too Large");
+		case 501:
+			return TEXT("Not Implemented");
+		case 503:
+			return TEXT("Service Unavailable");
+		default:
+			return TEXT("Internal Server Error");
+	}
+}
@@ -0,0 +1,114 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#pragma once
+
+#include "HermesGameThreadWakeup.h"
+#include "HermesTransport.h"
+
+#include <Containers/Queue.h>
+#include <CoreMinimal.h>
+
+class FSocket;
+
+/**
+ * A minimal HTTP/1.1 and WebSocket server that only listens on the loopback interface. It lets local tools dispatch
+ * paths to Hermes endpoints without going through the OS URL handler (and without a process launch per request).
+ *
+ * Connections are persistent, and pipelined requests are answered in the order they were received. WebSocket clients
+ * send one path per text message, and receive one status message per path in return.
+ *
+ * Requests are treated as scripted unless the client sends an `X-Hermes-Priority` header (on each HTTP request, or
+ * on the WebSocket handshake) with the value `interactive`, `scripted` or `background`.
+ *
+ * Every request (and every WebSocket handshake) has to carry the session's token in an `X-Hermes-Token` header. A web
+ * page can't send a custom header without a CORS preflight, which we never answer, and can't learn the token either.
+ * The token is written to a file in Saved/Hermes while the server is listening, see GetTokenFilename.
+ *
+ * Connections are accepted, read and parsed on background threads (one per connection, since FSocket can't wait on
+ * more than one socket at a time), so the server is never ticked. Paths are still dispatched on the game thread, which
+ * picks them up the next time it runs its tasks, and sends the responses straight back.
+ */
+class FHermesLoopbackServer : public IHermesTransport
+{
+public:
+	/**
+	 * @param InPort the port to listen on (on 127.0.0.1) once started, or 0 to pick any free port
+	 * @param InToken the token that clients have to send, a random one is generated if this is empty
+	 */
+	FHermesLoopbackServer(int32 InPort, const FString& InToken);
+	virtual ~FHermesLoopbackServer() override;
+
+	bool IsListening() const
+	{
+		return ListenSocket != nullptr;
+	}
+
+	/** The port we're listening on, which is only known once we've started if we were asked for any free port */
+	int32 GetPort() const
+	{
+		return Port;
+	}
+
+	const FString& GetToken() const
+	{
+		return Token;
+	}
+
+	/** Where the token for the server on the given port is written, for local tools to read. */
+	static FString GetTokenFilename(int32 Port);
+
+public: // Implementation of IHermesTransport
+	virtual FName GetTransportName() const override;
+	virtual bool Start(IHermesRequestSink& InSink) override;
+	/** Close the listening socket and all open connections, waiting for their threads to exit. */
+	virtual void Stop() override;
+	/** Dispatch & respond to the requests the connection threads have received. Never blocks. */
+	virtual void Tick() override;
+	virtual bool IsEventDriven() const override;
+
+private:
+	struct FConnection;
+	class FAcceptor;
+
+	enum class EPendingRequestKind : uint8
+	{
+		/** Response is sent as is */
+		Reply,
+		/** Path is dispatched, and answered with an HTTP response */
+		Http,
+		/** Path is dispatched, and answered with a WebSocket text message */
+		WebSocket,
+	};
+
+	/** Something a connection received, everything goes through the game thread so that responses stay in order */
+	struct FPendingRequest
+	{
+		TSharedPtr<FConnection, ESPMode::ThreadSafe> Connection;
+		EPendingRequestKind Kind = EPendingRequestKind::Reply;
+		FString Path;
+		EHermesRequestPriority Priority = EHermesRequestPriority::Scripted;
+		TArray<uint8> Response;
+		bool bClose = false;
+	};
+
+	/** Called from the connection threads */
+	void PostRequest(FPendingRequest&& Request);
+
+	static void AppendHttpResponse(TArray<uint8>& Out, int32 StatusCode, const FString& Body, bool bClose);
+	static void AppendWebSocketFrame(TArray<uint8>& Out, uint8 Opcode, const uint8* Payload, int32 PayloadSize);
+	static EHermesRequestPriority ParsePriority(const FString* Header);
+	/** Returns the reason to refuse the request, or nullptr if it's from a local tool that knows our token. */
+	const TCHAR* CheckRequestIsTrusted(const TMap<FString, FString>& Headers) const;
+	static int32 GetStatusCode(EHermesDispatchResult Result);
+	static const TCHAR* GetStatusText(int32 StatusCode);
+
+	int32 Port;
+	FString Token;
+	/** Set if we wrote the token file, so that we only delete our own */
+	bool bWroteTokenFile = false;
+	IHermesRequestSink* Sink = nullptr;
+	FSocket* ListenSocket = nullptr;
+	/** Owns the connections, null unless we're listening */
+	TUniquePtr<FAcceptor> Acceptor;
+	TQueue<FPendingRequest, EQueueMode::Mpsc> PendingRequests;
+	FHermesGameThreadWakeup Wakeup;
+};
@@ -0,0 +1,100 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#include "HermesMemoryQueueTransport.h"
+
+#include "HermesPathParser.h"
+
+void FHermesMemoryQueueTransport::RegisterScheme(const FString& Scheme)
+{
+	UE_LOG(LogHermesServer, Verbose, TEXT("Registered %s:// with the memory transport"), *Scheme);
+	RegisteredScheme = Scheme;
+}
+
+void FHermesMemoryQueueTransport::UnregisterScheme(const FString& Scheme)
+{
+	if (RegisteredScheme.Equals(Scheme, ESearchCase::IgnoreCase))
+	{
+		UE_LOG(LogHermesServer, Verbose, TEXT("Unregistered %s:// from the memory transport"), *Scheme);
+		RegisteredScheme.Reset();
+	}
+}
+
+FName FHermesMemoryQueueTransport::GetTransportName() const
+{
+	return TEXT("Memory");
+}
+
+bool FHermesMemoryQueueTransport::Start(IHermesRequestSink& InSink)
+{
+	Sink = &InSink;
+	return true;
+}
+
+void FHermesMemoryQueueTransport::Stop()
+{
+	Pending.Reset();
+	Results.Reset();
+	RegisteredScheme.Reset();
+	Sink = nullptr;
+}
+
+void FHermesMemoryQueueTransport::Tick()
+{
+	Flush();
+}
+
+FString FHermesMemoryQueueTransport::GetRegisteredScheme() const
+{
+	return RegisteredScheme;
+}
+
+bool FHermesMemoryQueueTransport::Send(const FString& Uri, EHermesRequestPriority Priority)
+{
+	const TCHAR* Begin = *Uri;
+	const TCHAR* End = Begin + Uri.Len();
+	const TCHAR* PathBegin = HermesPathParser::SkipScheme(Begin, End);
+	if (PathBegin != Begin)
+	{
+		// PathBegin is past the "://", which isn't part of the scheme
+		const FString Scheme = Uri.Left(static_cast<int32>(PathBegin - Begin) - 3);
+		if (RegisteredScheme.IsEmpty() || !Scheme.Equals(RegisteredScheme, ESearchCase::IgnoreCase))
+		{
+			UE_LOG(LogHermesServer, Warning, TEXT("Not sending %s, %s:// isn't registered with the memory transport"),
+			       *Uri, *Scheme);
+			return false;
+		}
+	}
+
+	FPendingUri& Sent = Pending.AddDefaulted_GetRef();
+	Sent.Uri = Uri;
+	Sent.PathStart = static_cast<int32>(PathBegin - Begin);
+	Sent.Priority = Priority;
+	return true;
+}
+
+void FHermesMemoryQueueTransport::Flush()
+{
+	if (Sink == nullptr)
+	{
+		return;
+	}
+
+	// Handlers can send more URIs, those are dispatched as part of this flush too, after everything sent before them
+	for (int32 Index = 0; Index < Pending.Num(); ++Index)
+	{
+		FHermesMemoryTransportResult Result;
+		Result.Uri = Pending[Index].Uri;
+		Result.Result = Sink->DispatchPath(Result.Uri.Mid(Pending[Index].PathStart), Pending[Index].Priority);
+		Results.Add(MoveTemp(Result));
+	}
+	Pending.Reset();
+}
+
+int32 FHermesMemoryQueueTransport::GetNumPending() const
+{
+	return Pending.Num();
+}
+
+TArray<FHermesMemoryTransportResult> FHermesMemoryQueueTransport::ConsumeResults()
+{
+	return MoveTemp(Results);
+}
@@ -0,0 +1,46 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#pragma once
+
+#include "HermesMemoryTransport.h"
+#include "HermesTransport.h"
+
+#include <CoreMinimal.h>
+
+/**
+ * Keeps URIs in a queue in memory, and stands in for the OS handler's scheme registration, so that automation tests
+ * can exercise everything from scheme registration to the endpoint handlers without leaving the process.
+ */
+class FHermesMemoryQueueTransport : public IHermesTransport, public IHermesMemoryTransport
+{
+public:
+	/** Register the scheme in place of the OS handler, URIs with any other scheme are refused by Send */
+	void RegisterScheme(const FString& Scheme);
+	void UnregisterScheme(const FString& Scheme);
+
+public: // Implementation of IHermesTransport
+	virtual FName GetTransportName() const override;
+	virtual bool Start(IHermesRequestSink& InSink) override;
+	virtual void Stop() override;
+	virtual void Tick() override;
+
+public: // Implementation of IHermesMemoryTransport
+	virtual FString GetRegisteredScheme() const override;
+	virtual bool Send(const FString& Uri, EHermesRequestPriority Priority) override;
+	virtual void Flush() override;
+	virtual int32 GetNumPending() const override;
+	virtual TArray<FHermesMemoryTransportResult> ConsumeResults() override;
+
+private:
+	struct FPendingUri
+	{
+		FString Uri;
+		/** Where the path starts in Uri, i.e. past the "scheme://" if it has one */
+		int32 PathStart = 0;
+		EHermesRequestPriority Priority = EHermesRequestPriority::Interactive;
+	};
+
+	IHermesRequestSink* Sink = nullptr;
+	FString RegisteredScheme;
+	TArray<FPendingUri> Pending;
+	TArray<FHermesMemoryTransportResult> Results;
+};
@@ -0,0 +1,44 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#include "HermesOnDemandTickable.h"
+
+#if ENGINE_MAJOR_VERSION >= 5
+typedef FTSTicker FHermesCoreTicker;
+#else
+typedef FTicker FHermesCoreTicker;
+#endif
+
+FHermesOnDemandTickable::~FHermesOnDemandTickable()
+{
+	if (TickerHandle.IsValid())
+	{
+		FHermesCoreTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+		TickerHandle.Reset();
+	}
+}
+
+void FHermesOnDemandTickable::WakeUp()
+{
+	check(IsInGameThread());
+	if (!TickerHandle.IsValid())
+	{
+		TickerHandle = FHermesCoreTicker::GetCoreTicker().AddTicker(
+			FTickerDelegate::CreateRaw(this, &FHermesOnDemandTickable::TickFromTicker));
+	}
+}
+
+bool FHermesOnDemandTickable::TickFromTicker(float DeltaTime)
+{
+	{
+		FScopeCycleCounter Scope(GetStatId());
+		Tick(DeltaTime);
+	}
+
+	if (IsTickable())
+	{
+		return true;
+	}
+
+	// Returning false removes us from the ticker, so the handle is stale from here on
+	TickerHandle.Reset();
+	return false;
+}
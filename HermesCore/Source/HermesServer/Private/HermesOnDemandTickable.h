@@ -0,0 +1,36 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#pragma once
+
+#include <Containers/Ticker.h>
+#include <CoreMinimal.h>
+#include <Runtime/Launch/Resources/Version.h>
+#include <Stats/Stats.h>
+
+/**
+ * Something that's ticked by the core ticker, but only while it has something to do. It starts ticking when WakeUp is
+ * called and keeps going until IsTickable returns false, so while it's idle it adds nothing at all to a frame. Used
+ * instead of a tickable object outside of the editor, where Hermes has to be cheap enough to leave on in performance
+ * test builds.
+ */
+class FHermesOnDemandTickable
+{
+public:
+	virtual ~FHermesOnDemandTickable();
+
+	virtual void Tick(float DeltaTime) = 0;
+	virtual TStatId GetStatId() const = 0;
+	/** Checked after every tick, returning false stops ticking until the next WakeUp */
+	virtual bool IsTickable() const = 0;
+
+	/** Start ticking, if we aren't already. Game thread only. */
+	void WakeUp();
+
+private:
+	bool TickFromTicker(float DeltaTime);
+
+#if ENGINE_MAJOR_VERSION >= 5
+	FTSTicker::FDelegateHandle TickerHandle;
+#else
+	FDelegateHandle TickerHandle;
+#endif
+};
@@ -4,6 +4,7 @@
 #include "Hermes.h"
 
 #include <Misc/App.h>
+#include <Misc/ConfigCacheIni.h>
 
 UHermesPluginSettings::UHermesPluginSettings(const FObjectInitializer& ObjectInitializer)
 	: Super(ObjectInitializer)
@@ -11,3 +12,21 @@ UHermesPluginSettings::UHermesPluginSettings(const FObjectInitializer& ObjectIni
 	const TOptional<FString> ProjectScheme = Hermes::SanitizeScheme(FApp::GetProjectName());
 	DefaultUriScheme = ProjectScheme.Get("hunreal");
 }
+
+void UHermesPluginSettings::PostInitProperties()
+{
+	Super::PostInitProperties();
+
+#if WITH_EDITOR
+	// These settings used to be in the editor config, which cooked games don't load. Keep using them until they've been
+	// moved, so that upgrading doesn't quietly change the scheme.
+	const FString Section = GetClass()->GetPathName();
+	if (HasAnyFlags(RF_ClassDefaultObject) && GConfig->DoesSectionExist(*Section, GEditorIni))
+	{
+		LoadConfig(GetClass(), *GEditorIni);
+		UE_LOG(LogHermesServer, Warning,
+		       TEXT("[%s] should be moved from DefaultEditor.ini to DefaultGame.ini, or game builds won't use it"),
+		       *Section);
+	}
+#endif
+}
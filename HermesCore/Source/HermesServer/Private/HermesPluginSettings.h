@@ -1,11 +1,37 @@
 // Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
 #pragma once
 
+#include "HermesServer.h"
+
 #include <CoreMinimal.h>
 #include <Engine/DeveloperSettings.h>
 #include "HermesPluginSettings.generated.h"
 
-UCLASS(Config=Editor, DefaultConfig, meta = (DisplayName = "Hermes URLs"))
+UENUM()
+enum class EHermesOverflowPolicy : uint8
+{
+	/** Turn away the incoming request, and keep everything that's already queued */
+	RejectNewest UMETA(DisplayName = "Reject Newest"),
+	/** Throw out the oldest queued request to make room for the incoming one */
+	DropOldest UMETA(DisplayName = "Drop Oldest"),
+};
+
+/** An endpoint whose module is only loaded once a request for it arrives */
+USTRUCT()
+struct FHermesEndpointModule
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, Category = "Hermes", meta = (ToolTip = "The endpoint id, i.e. the first component of the path"))
+	FName Endpoint;
+
+	UPROPERTY(EditAnywhere, Category = "Hermes", meta = (
+		ToolTip = "The module that registers the endpoint when it starts up. Set its LoadingPhase to None so it isn't loaded at startup"))
+	FName Module;
+};
+
+/** Kept in the game config rather than the editor's, so that cooked game builds pick the same scheme as the editor */
+UCLASS(Config=Game, DefaultConfig, meta = (DisplayName = "Hermes URLs"))
 class UHermesPluginSettings : public UDeveloperSettings
 {
 	GENERATED_BODY()
@@ -20,15 +46,161 @@ public:
 
 	UPROPERTY(Config, EditAnywhere, Category = "Hermes", AdvancedDisplay, meta = (
 		DisplayName = "Enable Debug Logging",
-		ToolTip = "Log debug messages about URL handling to hermes.log next to hermes_urls.exe",
+		ToolTip = "Log debug messages about URL handling to hermes.log next to hermes_urls.exe (or to stderr on Linux)",
 		ConfigRestartRequired = true))
 	bool bDebug = false;
 
+	UPROPERTY(Config, EditAnywhere, Category = "Dispatch", meta = (
+		DisplayName = "Duplicate Request Window",
+		ToolTip =
+		"Identical paths that arrive within this many seconds of each other are only dispatched once (e.g. when a link is double-clicked). 0 disables de-duplication.",
+		ClampMin = 0.0, Units = "s"))
+	float DuplicateRequestWindow = 0.5f;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Dispatch", meta = (
+		DisplayName = "Coalescing Window",
+		ToolTip =
+		"How many seconds requests for endpoints that support coalescing are held, so that they can be handled as a single batch",
+		ClampMin = 0.0, Units = "s"))
+	float CoalescingWindow = 0.1f;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Dispatch", meta = (
+		DisplayName = "Max Queued Interactive Requests",
+		ToolTip = "How many interactive requests (e.g. links clicked by a person) can be waiting to be dispatched",
+		ClampMin = 1))
+	int32 MaxQueuedInteractiveRequests = 64;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Dispatch", meta = (
+		DisplayName = "Max Queued Scripted Requests",
+		ToolTip = "How many scripted requests (e.g. from tools using the loopback server) can be waiting to be dispatched",
+		ClampMin = 1))
+	int32 MaxQueuedScriptedRequests = 256;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Dispatch", meta = (
+		DisplayName = "Max Queued Background Requests",
+		ToolTip = "How many background requests can be waiting to be dispatched",
+		ClampMin = 1))
+	int32 MaxQueuedBackgroundRequests = 1024;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Dispatch", meta = (
+		DisplayName = "Overflow Policy",
+		ToolTip = "What to do with a request when the queue for its priority is full, or when too many requests of its priority are waiting for a play session to end"))
+	EHermesOverflowPolicy OverflowPolicy = EHermesOverflowPolicy::RejectNewest;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Dispatch", meta = (
+		DisplayName = "Dispatch Budget",
+		ToolTip =
+		"How many milliseconds per tick we spend dispatching scripted and background requests. Interactive requests are always dispatched right away, and at least one scripted and one background request is dispatched every tick, even when this is 0.",
+		ClampMin = 0.0, Units = "ms"))
+	float DispatchBudgetMs = 4.0f;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Dispatch", meta = (
+		DisplayName = "Defer Requests During PIE",
+		ToolTip =
+		"Hold on to requests for endpoints that would get in the way of a running game (like opening an asset editor) while Play-In-Editor or Simulate is running, and dispatch them once it ends"))
+	bool bDeferDuringPIE = true;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Dispatch", meta = (
+		DisplayName = "On-Demand Endpoint Modules",
+		ToolTip =
+		"Endpoints whose modules are loaded the first time they're requested, instead of at startup. Requests that arrive while the module is loading are dispatched once it has registered the endpoint.",
+		TitleProperty = "Endpoint"))
+	TArray<FHermesEndpointModule> EndpointModules;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Diagnostics", meta = (
+		DisplayName = "Record Request Journal",
+		ToolTip =
+		"Record every request to a journal in Saved/Hermes, which can be replayed with Hermes.Journal.Replay. Can also be enabled with -HermesJournal=<filename>",
+		ConfigRestartRequired = true))
+	bool bRecordJournal = false;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Diagnostics", meta = (
+		DisplayName = "Handler Time Budget",
+		ToolTip =
+		"Endpoint handlers that take longer than this many milliseconds are reported as hitches in the log, along with where the game thread was when the budget ran out. Endpoints can set their own budget. 0 disables hitch reports for endpoints that don't.",
+		ClampMin = 0.0, Units = "ms"))
+	float HandlerTimeBudgetMs = 100.0f;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Diagnostics", meta = (
+		DisplayName = "Use Memory Transport",
+		ToolTip =
+		"Register the scheme with an in-process transport instead of the OS, so that automation tests can send URIs without another process being involved. Can also be enabled with -HermesMemoryTransport",
+		ConfigRestartRequired = true))
+	bool bUseMemoryTransport = false;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Prefetch", meta = (
+		DisplayName = "Prefetch Popular Links",
+		ToolTip =
+		"Keep a history of how often each link is opened, and once the editor is idle after starting up, read the files that the most popular ones need into the OS file cache so that they open quickly. Only applies to endpoints that support it, like content links."))
+	bool bPrefetchPopularLinks = true;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Prefetch", meta = (
+		DisplayName = "Links To Prefetch",
+		ToolTip = "How many of the most popular links to prefetch",
+		ClampMin = 1, ClampMax = 256,
+		EditCondition = "bPrefetchPopularLinks"))
+	int32 NumLinksToPrefetch = 32;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Prefetch", meta = (
+		DisplayName = "Prefetch Memory Budget",
+		ToolTip =
+		"The most that's read when prefetching, which is how much of the OS file cache prefetching can take up. Links are prefetched most popular first, so the least popular ones are left out when this runs out.",
+		ClampMin = 1, Units = "MB",
+		EditCondition = "bPrefetchPopularLinks"))
+	int32 PrefetchMemoryBudgetMB = 512;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Prefetch", meta = (
+		DisplayName = "Prefetch Read Rate (MB/s)",
+		ToolTip = "How fast prefetching reads from disk, so that it doesn't get in the way of the editor",
+		ClampMin = 1,
+		EditCondition = "bPrefetchPopularLinks"))
+	int32 PrefetchReadRateMBPerSecond = 32;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Loopback Server", meta = (
+		DisplayName = "Enable Loopback Server",
+		ToolTip =
+		"Listen for HTTP and WebSocket requests on 127.0.0.1, so that local tools can call endpoints without going through the OS URL handler. Can also be enabled with -HermesLoopbackPort=<port>",
+		ConfigRestartRequired = true))
+	bool bEnableLoopbackServer = false;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Loopback Server", meta = (
+		DisplayName = "Loopback Server Port",
+		ToolTip = "The port the loopback server listens on",
+		ClampMin = 1, ClampMax = 65535,
+		EditCondition = "bEnableLoopbackServer",
+		ConfigRestartRequired = true))
+	int32 LoopbackServerPort = 41230;
+
 public:
 	UHermesPluginSettings(const FObjectInitializer& ObjectInitializer);
+	virtual void PostInitProperties() override;
 
 	virtual FName GetCategoryName() const override
 	{
 		return FName(TEXT("Plugins"));
 	}
+
+	/** The module that registers the given endpoint when loaded, or NAME_None if it's not loaded on demand */
+	FName GetEndpointModule(FName Endpoint) const
+	{
+		const FHermesEndpointModule* EndpointModule = EndpointModules.FindByPredicate(
+			[Endpoint](const FHermesEndpointModule& Entry)
+			{
+				return Entry.Endpoint == Endpoint;
+			});
+		return EndpointModule != nullptr ? EndpointModule->Module : NAME_None;
+	}
+
+	int32 GetMaxQueueDepth(EHermesRequestPriority Priority) const
+	{
+		switch (Priority)
+		{
+			case EHermesRequestPriority::Interactive:
+				return MaxQueuedInteractiveRequests;
+			case EHermesRequestPriority::Scripted:
+				return MaxQueuedScriptedRequests;
+			default:
+				return MaxQueuedBackgroundRequests;
+		}
+	}
 };
@@ -0,0 +1,91 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#include "HermesPrefetcher.h"
+
+#include "HermesServer.h"
+
+#include <HAL/Event.h>
+#include <HAL/PlatformFileManager.h>
+#include <HAL/RunnableThread.h>
+
+// How much is read at a time, which is also how often we check whether we're ahead of the rate we're allowed
+static constexpr int64 READ_CHUNK_SIZE = 1024 * 1024;
+
+FHermesPrefetcher::FHermesPrefetcher(TArray<FString>&& InFilenames, int64 InByteBudget, double InBytesPerSecond)
+	: Filenames(MoveTemp(InFilenames))
+	, ByteBudget(InByteBudget)
+	, BytesPerSecond(FMath::Max(InBytesPerSecond, 1.0))
+{
+	WakeEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	Thread = FRunnableThread::Create(this, TEXT("HermesPrefetcher"), 64 * 1024, TPri_Lowest);
+	if (Thread == nullptr)
+	{
+		UE_LOG(LogHermesServer, Warning, TEXT("Unable to start the prefetch thread, nothing will be prefetched"));
+		bDone = true;
+	}
+}
+
+FHermesPrefetcher::~FHermesPrefetcher()
+{
+	if (Thread != nullptr)
+	{
+		Thread->Kill(true);
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+	WakeEvent = nullptr;
+}
+
+uint32 FHermesPrefetcher::Run()
+{
+	const double StartTime = FPlatformTime::Seconds();
+	for (const FString& Filename : Filenames)
+	{
+		if (bStopping || BytesRead >= ByteBudget)
+		{
+			break;
+		}
+		ReadFile(Filename, StartTime);
+	}
+
+	bDone = true;
+	return 0;
+}
+
+void FHermesPrefetcher::ReadFile(const FString& Filename, double StartTime)
+{
+	TUniquePtr<IFileHandle> File(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*Filename));
+	if (!File.IsValid())
+	{
+		return;
+	}
+
+	TArray<uint8> Buffer;
+	Buffer.SetNumUninitialized(READ_CHUNK_SIZE);
+	int64 Remaining = File->Size();
+	while (Remaining > 0 && !bStopping)
+	{
+		const int64 ChunkSize = FMath::Min3(Remaining, READ_CHUNK_SIZE, ByteBudget - BytesRead.load());
+		if (ChunkSize <= 0 || !File->Read(Buffer.GetData(), ChunkSize))
+		{
+			break;
+		}
+		Remaining -= ChunkSize;
+		BytesRead += ChunkSize;
+
+		// If we're ahead of the rate we're allowed to read at, wait until we're not
+		const double AheadBy = BytesRead / BytesPerSecond - (FPlatformTime::Seconds() - StartTime);
+		if (AheadBy > 0.0)
+		{
+			WakeEvent->Wait(FTimespan::FromSeconds(AheadBy));
+		}
+	}
+	++FilesRead;
+}
+
+void FHermesPrefetcher::Stop()
+{
+	bStopping = true;
+	WakeEvent->Trigger();
+}
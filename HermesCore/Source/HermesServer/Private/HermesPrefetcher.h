@@ -0,0 +1,63 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#pragma once
+
+#include <CoreMinimal.h>
+#include <HAL/Runnable.h>
+
+#include <atomic>
+
+class FEvent;
+class FRunnableThread;
+
+/**
+ * Reads files on a low priority thread and throws away what it read, so that they're in the OS file cache by the time
+ * someone opens them. Reads are throttled to a rate and stop after a number of bytes, so that prefetching never
+ * competes with the editor for the disk or evicts much of what's already cached.
+ */
+class FHermesPrefetcher : FRunnable
+{
+public:
+	/**
+	 * Start reading the files, in order. Files that don't exist are skipped.
+	 *
+	 * @param ByteBudget stop once this many bytes have been read
+	 * @param BytesPerSecond how fast to read, on average
+	 */
+	FHermesPrefetcher(TArray<FString>&& InFilenames, int64 InByteBudget, double InBytesPerSecond);
+	/** Stops reading, if it's not already done */
+	virtual ~FHermesPrefetcher() override;
+
+	bool IsDone() const
+	{
+		return bDone;
+	}
+
+	int32 GetFilesRead() const
+	{
+		return FilesRead;
+	}
+
+	int64 GetBytesRead() const
+	{
+		return BytesRead;
+	}
+
+private: // Implementation of FRunnable
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+private:
+	/** Read a whole file, or as much of it as the budget allows */
+	void ReadFile(const FString& Filename, double StartTime);
+
+	const TArray<FString> Filenames;
+	const int64 ByteBudget;
+	const double BytesPerSecond;
+
+	std::atomic<int32> FilesRead{0};
+	std::atomic<int64> BytesRead{0};
+	std::atomic<bool> bDone{false};
+	std::atomic<bool> bStopping{false};
+	FEvent* WakeEvent = nullptr;
+	FRunnableThread* Thread = nullptr;
+};
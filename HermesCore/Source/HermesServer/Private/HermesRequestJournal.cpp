@@ -0,0 +1,292 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#include "HermesRequestJournal.h"
+
+#include "GenericHermesServer.h"
+
+#include <Async/MappedFileHandle.h>
+#include <HAL/Event.h>
+#include <HAL/FileManager.h>
+#include <HAL/PlatformFileManager.h>
+#include <HAL/RunnableThread.h>
+#include <Misc/Paths.h>
+
+static constexpr uint32 JOURNAL_MAGIC = 0x4A4D5248; // 'HRMJ'
+static constexpr uint32 JOURNAL_VERSION = 1;
+// How often the writer thread makes sure that what it's written has reached the disk, if anything's been written
+static constexpr double JOURNAL_SYNC_INTERVAL = 1.0;
+
+namespace HermesJournalPrivate
+{
+	template <typename T>
+	static void Write(TArray<uint8>& Bytes, const T& Value)
+	{
+		Bytes.Append(reinterpret_cast<const uint8*>(&Value), sizeof(T));
+	}
+
+	static void WriteString(TArray<uint8>& Bytes, const FString& Value)
+	{
+		const FTCHARToUTF8 Utf8(*Value);
+		Write<uint32>(Bytes, Utf8.Length());
+		Bytes.Append(reinterpret_cast<const uint8*>(Utf8.Get()), Utf8.Length());
+	}
+
+	/** Bounds-checked reader over a memory mapped journal */
+	struct FReader
+	{
+		const uint8* Data;
+		int64 Size;
+		int64 Offset = 0;
+
+		template <typename T>
+		bool Read(T& OutValue)
+		{
+			if (Offset + int64(sizeof(T)) > Size)
+			{
+				return false;
+			}
+			FMemory::Memcpy(&OutValue, Data + Offset, sizeof(T));
+			Offset += sizeof(T);
+			return true;
+		}
+
+		bool ReadString(FString& OutValue)
+		{
+			uint32 Length = 0;
+			if (!Read(Length) || Offset + Length > Size)
+			{
+				return false;
+			}
+			const FUTF8ToTCHAR Conversion(reinterpret_cast<const ANSICHAR*>(Data + Offset), Length);
+			OutValue = FString(Conversion.Length(), Conversion.Get());
+			Offset += Length;
+			return true;
+		}
+	};
+}
+
+FHermesRequestJournal::~FHermesRequestJournal()
+{
+	Close();
+}
+
+bool FHermesRequestJournal::Open(const FString& InFilename)
+{
+	Close();
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*FPaths::GetPath(InFilename));
+	FileHandle.Reset(PlatformFile.OpenWrite(*InFilename, /* bAppend = */ false, /* bAllowRead = */ true));
+	if (!FileHandle.IsValid())
+	{
+		UE_LOG(LogHermesServer, Error, TEXT("Unable to open request journal %s for writing"), *InFilename);
+		return false;
+	}
+
+	Filename = InFilename;
+	StartSeconds = FPlatformTime::Seconds();
+
+	HermesJournalPrivate::Write(PendingBytes, JOURNAL_MAGIC);
+	HermesJournalPrivate::Write(PendingBytes, JOURNAL_VERSION);
+	HermesJournalPrivate::Write(PendingBytes, FDateTime::UtcNow().GetTicks());
+	Flush();
+
+	bStopping = false;
+	WakeEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	Thread = FRunnableThread::Create(this, TEXT("HermesRequestJournal"), 64 * 1024, TPri_BelowNormal);
+	if (Thread == nullptr)
+	{
+		UE_LOG(LogHermesServer, Error, TEXT("Unable to start the writer thread for request journal %s"), *Filename);
+		Close();
+		return false;
+	}
+
+	UE_LOG(LogHermesServer, Display, TEXT("Recording requests to %s"), *Filename);
+	return true;
+}
+
+void FHermesRequestJournal::Close()
+{
+	if (FileHandle.IsValid())
+	{
+		Flush();
+		if (Thread != nullptr)
+		{
+			// The writer thread writes out whatever's left before it exits
+			Thread->Kill(true);
+			delete Thread;
+			Thread = nullptr;
+			UE_LOG(LogHermesServer, Display, TEXT("Stopped recording requests to %s"), *Filename);
+		}
+		FileHandle.Reset();
+	}
+
+	if (WakeEvent != nullptr)
+	{
+		FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+		WakeEvent = nullptr;
+	}
+
+	TArray<uint8> Discarded;
+	while (QueuedBytes.Dequeue(Discarded))
+	{
+	}
+	PendingBytes.Reset();
+	Filename.Reset();
+}
+
+void FHermesRequestJournal::Record(const FHermesJournalEntry& Entry)
+{
+	if (!FileHandle.IsValid())
+	{
+		return;
+	}
+
+	using namespace HermesJournalPrivate;
+
+	// Reserve room for the record size, and fill it in once we know it
+	const int32 RecordStart = PendingBytes.Num();
+	Write<uint32>(PendingBytes, 0);
+	Write(PendingBytes, Entry.ArrivalOffset);
+	Write(PendingBytes, Entry.HandlerDuration);
+	Write(PendingBytes, static_cast<uint8>(Entry.Priority));
+	Write(PendingBytes, static_cast<uint8>(Entry.Result));
+	WriteString(PendingBytes, Entry.Endpoint.ToString());
+	WriteString(PendingBytes, Entry.RawPath);
+
+	const uint32 RecordSize = PendingBytes.Num() - RecordStart - sizeof(uint32);
+	FMemory::Memcpy(PendingBytes.GetData() + RecordStart, &RecordSize, sizeof(RecordSize));
+}
+
+void FHermesRequestJournal::Flush()
+{
+	if (!FileHandle.IsValid() || PendingBytes.Num() == 0)
+	{
+		return;
+	}
+
+	QueuedBytes.Enqueue(MoveTemp(PendingBytes));
+	PendingBytes.Reset();
+	if (WakeEvent != nullptr)
+	{
+		WakeEvent->Trigger();
+	}
+}
+
+uint32 FHermesRequestJournal::Run()
+{
+	double LastSyncTime = FPlatformTime::Seconds();
+	bool bNeedsSync = false;
+	while (!bStopping)
+	{
+		WakeEvent->Wait(FTimespan::FromSeconds(JOURNAL_SYNC_INTERVAL));
+
+		if (!QueuedBytes.IsEmpty())
+		{
+			WriteQueuedBytes();
+			bNeedsSync = true;
+		}
+
+		// Syncing is the expensive part, so it's only done every so often rather than every time we're woken up
+		const double Now = FPlatformTime::Seconds();
+		if (bNeedsSync && Now - LastSyncTime >= JOURNAL_SYNC_INTERVAL)
+		{
+			FileHandle->Flush();
+			LastSyncTime = Now;
+			bNeedsSync = false;
+		}
+	}
+
+	WriteQueuedBytes();
+	FileHandle->Flush();
+	return 0;
+}
+
+void FHermesRequestJournal::Stop()
+{
+	bStopping = true;
+	WakeEvent->Trigger();
+}
+
+void FHermesRequestJournal::WriteQueuedBytes()
+{
+	TArray<uint8> Bytes;
+	while (QueuedBytes.Dequeue(Bytes))
+	{
+		if (!FileHandle->Write(Bytes.GetData(), Bytes.Num()))
+		{
+			UE_LOG(LogHermesServer, Error, TEXT("Failed to write %d bytes to request journal %s"), Bytes.Num(),
+			       *Filename);
+		}
+	}
+}
+
+bool FHermesRequestJournal::Read(const FString& Filename, TArray<FHermesJournalEntry>& OutEntries,
+                                 FDateTime& OutStartTime)
+{
+	OutEntries.Reset();
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	TUniquePtr<IMappedFileHandle> MappedFile(PlatformFile.OpenMapped(*Filename));
+	if (!MappedFile.IsValid())
+	{
+		UE_LOG(LogHermesServer, Error, TEXT("Unable to open request journal %s"), *Filename);
+		return false;
+	}
+
+	TUniquePtr<IMappedFileRegion> Region(MappedFile->MapRegion(0, MappedFile->GetFileSize()));
+	if (!Region.IsValid())
+	{
+		UE_LOG(LogHermesServer, Error, TEXT("Unable to map request journal %s"), *Filename);
+		return false;
+	}
+
+	HermesJournalPrivate::FReader Reader{Region->GetMappedPtr(), Region->GetMappedSize()};
+
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	int64 StartTicks = 0;
+	if (!Reader.Read(Magic) || !Reader.Read(Version) || !Reader.Read(StartTicks) || Magic != JOURNAL_MAGIC ||
+		Version != JOURNAL_VERSION)
+	{
+		UE_LOG(LogHermesServer, Error, TEXT("%s is not a request journal, or was written by a different version"),
+		       *Filename);
+		return false;
+	}
+	OutStartTime = FDateTime(StartTicks);
+
+	uint32 RecordSize = 0;
+	while (Reader.Read(RecordSize))
+	{
+		const int64 RecordEnd = Reader.Offset + RecordSize;
+
+		FHermesJournalEntry Entry;
+		uint8 Priority = 0;
+		uint8 Result = 0;
+		FString Endpoint;
+		if (RecordEnd > Reader.Size || !Reader.Read(Entry.ArrivalOffset) || !Reader.Read(Entry.HandlerDuration) ||
+			!Reader.Read(Priority) || !Reader.Read(Result) || !Reader.ReadString(Endpoint) ||
+			!Reader.ReadString(Entry.RawPath) || Priority >= static_cast<uint8>(EHermesRequestPriority::Num))
+		{
+			// A truncated record at the end is expected if the editor died while recording
+			UE_LOG(LogHermesServer, Warning, TEXT("Ignoring truncated or corrupt record at offset %lld in %s"),
+			       Reader.Offset, *Filename);
+			break;
+		}
+
+		Entry.Priority = static_cast<EHermesRequestPriority>(Priority);
+		Entry.Result = static_cast<EHermesDispatchResult>(Result);
+		Entry.Endpoint = FName(*Endpoint);
+		OutEntries.Emplace(MoveTemp(Entry));
+
+		// Skip any fields added by future versions
+		Reader.Offset = RecordEnd;
+	}
+
+	return true;
+}
+
+FString FHermesRequestJournal::MakeDefaultFilename()
+{
+	return FPaths::ProjectSavedDir() / TEXT("Hermes") /
+		FString::Printf(TEXT("Requests-%s.hjournal"), *FDateTime::Now().ToString());
+}
@@ -0,0 +1,115 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#pragma once
+
+#include "HermesServer.h"
+
+#include <Containers/Queue.h>
+#include <CoreMinimal.h>
+#include <HAL/Runnable.h>
+
+#include <atomic>
+
+class FEvent;
+class FRunnableThread;
+class IFileHandle;
+
+/** A single request as recorded in a journal */
+struct FHermesJournalEntry
+{
+	/** When the request arrived, in seconds since the journal was started */
+	double ArrivalOffset = 0.0;
+	/** How long the endpoint's handler took, zero if it never ran */
+	double HandlerDuration = 0.0;
+	EHermesRequestPriority Priority = EHermesRequestPriority::Interactive;
+	EHermesDispatchResult Result{};
+	FName Endpoint;
+	/** The path exactly as it was received from the transport */
+	FString RawPath;
+};
+
+/**
+ * An append-only binary log of every request the server handles. Entries are buffered in memory and handed to a writer
+ * thread once per tick, so recording never blocks the game thread on disk I/O.
+ *
+ * The file starts with a header (magic, version, and the UTC time the journal was started), followed by one
+ * length-prefixed record per request. Journals are read back by memory mapping the whole file.
+ */
+class FHermesRequestJournal : FRunnable
+{
+public:
+	virtual ~FHermesRequestJournal() override;
+
+	/** Start a new journal at the given path, replacing any existing file. */
+	bool Open(const FString& InFilename);
+	/** Waits for everything that's been recorded to be written out */
+	void Close();
+
+	bool IsOpen() const
+	{
+		return FileHandle.IsValid();
+	}
+
+	const FString& GetFilename() const
+	{
+		return Filename;
+	}
+
+	/** Seconds since the journal was opened, in the same time base as FPlatformTime::Seconds() */
+	double GetOffset(double PlatformSeconds) const
+	{
+		return PlatformSeconds - StartSeconds;
+	}
+
+	void Record(const FHermesJournalEntry& Entry);
+	/** Hand any buffered records to the writer thread */
+	void Flush();
+
+	/** True if there are records that haven't been handed to the writer thread yet */
+	bool HasPendingRecords() const
+	{
+		return PendingBytes.Num() > 0;
+	}
+
+	/** Read every record from a journal, returns false if the file is missing or isn't a valid journal. */
+	static bool Read(const FString& Filename, TArray<FHermesJournalEntry>& OutEntries, FDateTime& OutStartTime);
+
+	/** Default location for new journals, in Saved/Hermes */
+	static FString MakeDefaultFilename();
+
+private: // Implementation of FRunnable
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+private:
+	/** Write everything the game thread has handed over. Only called on the writer thread. */
+	void WriteQueuedBytes();
+
+	FString Filename;
+	/** Only written to by the writer thread while it's running */
+	TUniquePtr<IFileHandle> FileHandle;
+	/** Records since the last Flush, only touched by the game thread */
+	TArray<uint8> PendingBytes;
+	double StartSeconds = 0.0;
+
+	TQueue<TArray<uint8>, EQueueMode::Spsc> QueuedBytes;
+	std::atomic<bool> bStopping{false};
+	FEvent* WakeEvent = nullptr;
+	FRunnableThread* Thread = nullptr;
+};
+
+/**
+ * Feeds the requests from a journal back through the dispatcher, at the original pace, or sped up by a given factor.
+ */
+struct FHermesJournalReplay
+{
+	TArray<FHermesJournalEntry> Entries;
+	int32 NextEntry = 0;
+	double StartSeconds = 0.0;
+	/** 1 replays at the original speed, 2 at double speed, etc. 0 replays everything as fast as possible. */
+	double Speed = 1.0;
+
+	bool IsFinished() const
+	{
+		return NextEntry >= Entries.Num();
+	}
+};
@@ -0,0 +1,176 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#include "HermesRequestSpool.h"
+
+#if PLATFORM_UNIX
+#include "Unix/HermesUnixSocketTransport.h"
+#endif
+
+#include <HAL/FileManager.h>
+#include <HAL/PlatformProcess.h>
+#include <HAL/PlatformTime.h>
+#include <Misc/FileHelper.h>
+#include <Misc/Paths.h>
+
+#if PLATFORM_UNIX
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// How often we look for requests that were spooled while we weren't listening, e.g. during a recompile
+static constexpr double POLL_INTERVAL = 1.0;
+// Links that have been waiting for longer than this were most likely meant for an editor session that's long gone
+static constexpr double MAX_REQUEST_AGE = 30.0 * 60.0;
+// Same limit as the other transports: around the maximum path size (32k), plus room for the scheme and query string.
+static constexpr int64 MAX_REQUEST_SIZE = 64 * 1024;
+
+FHermesRequestSpool::~FHermesRequestSpool()
+{
+	Stop();
+}
+
+FString FHermesRequestSpool::GetSpoolDirectory(const FString& Scheme)
+{
+#if PLATFORM_UNIX
+	// Next to the socket, in the directory that's only accessible to the current user
+	return FPaths::GetPath(FHermesUnixSocketTransport::GetSocketPath(Scheme)) / Scheme + TEXT(".spool");
+#else
+	return FPaths::Combine(FPlatformProcess::UserTempDir(), TEXT("Hermes"), Scheme + TEXT(".spool"));
+#endif
+}
+
+FName FHermesRequestSpool::GetTransportName() const
+{
+	return TEXT("Spool");
+}
+
+bool FHermesRequestSpool::Start(IHermesRequestSink& InSink)
+{
+	// The spool is per scheme, so there's nothing to drain until we're given one
+	Sink = &InSink;
+	return true;
+}
+
+void FHermesRequestSpool::Stop()
+{
+	ReleaseLaunchLock();
+	SpoolDirectory.Reset();
+	Sink = nullptr;
+}
+
+bool FHermesRequestSpool::SetScheme(const FString& Scheme)
+{
+	ReleaseLaunchLock();
+	SpoolDirectory = GetSpoolDirectory(Scheme);
+	// Drain on the next tick, which is when the transports that are listening for new links have been told the scheme
+	NextPollTime = 0.0;
+
+#if PLATFORM_UNIX
+	const FString LockPath = FPaths::GetPath(FHermesUnixSocketTransport::GetSocketPath(Scheme)) / Scheme +
+		TEXT(".lock");
+	LaunchLock = open(TCHAR_TO_UTF8(*LockPath), O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
+	if (LaunchLock != -1 && flock(LaunchLock, LOCK_EX | LOCK_NB) != 0)
+	{
+		// The URL handler that launched us passes its lock on to us, so we're most likely holding it already
+		UE_LOG(LogHermesServer, Verbose, TEXT("Launch lock %s is already held: %s"), *LockPath,
+		       UTF8_TO_TCHAR(strerror(errno)));
+		close(LaunchLock);
+		LaunchLock = -1;
+	}
+#endif
+	return true;
+}
+
+void FHermesRequestSpool::ReleaseLaunchLock()
+{
+#if PLATFORM_UNIX
+	if (LaunchLock != -1)
+	{
+		close(LaunchLock);
+		LaunchLock = -1;
+	}
+#endif
+}
+
+void FHermesRequestSpool::Tick()
+{
+	if (SpoolDirectory.IsEmpty())
+	{
+		return;
+	}
+
+	const double Now = FPlatformTime::Seconds();
+	if (Now < NextPollTime)
+	{
+		return;
+	}
+	NextPollTime = Now + POLL_INTERVAL;
+
+	Drain();
+}
+
+void FHermesRequestSpool::Drain()
+{
+#if PLATFORM_UNIX
+	// Anyone who can write to the spool can make us open links, so it has to be ours and private to us
+	struct stat Stat;
+	if (lstat(TCHAR_TO_UTF8(*SpoolDirectory), &Stat) != 0 || !S_ISDIR(Stat.st_mode) || Stat.st_uid != getuid() ||
+		(Stat.st_mode & (S_IRWXG | S_IRWXO)) != 0)
+	{
+		return;
+	}
+#endif
+
+	TArray<FString> Filenames;
+	IFileManager::Get().FindFiles(Filenames, *(SpoolDirectory / TEXT("*.req")), true, false);
+	if (Filenames.Num() == 0)
+	{
+		return;
+	}
+
+	// The names start with the zero-padded arrival time, so this puts them in the order they were opened
+	Filenames.Sort();
+	UE_LOG(LogHermesServer, Display, TEXT("Dispatching %d spooled request(s) from %s"), Filenames.Num(),
+	       *SpoolDirectory);
+	for (const FString& Filename : Filenames)
+	{
+		FString Path;
+		if (ClaimRequest(SpoolDirectory / Filename, Path))
+		{
+			// Whoever spooled this clicked a link, and has been waiting for the editor ever since
+			Sink->DispatchPath(Path, EHermesRequestPriority::Interactive);
+		}
+	}
+}
+
+bool FHermesRequestSpool::ClaimRequest(const FString& Filename, FString& OutPath) const
+{
+	IFileManager& FileManager = IFileManager::Get();
+
+	// Renaming is atomic, so only one editor gets to claim each request
+	const FString Claimed = FString::Printf(TEXT("%s.%u"), *Filename, FPlatformProcess::GetCurrentProcessId());
+	if (!FileManager.Move(*Claimed, *Filename, /* Replace = */ false, /* EvenIfReadOnly = */ false,
+	                      /* Attributes = */ false, /* bDoNotRetryOrError = */ true))
+	{
+		return false;
+	}
+
+	const double Age = (FDateTime::UtcNow() - FileManager.GetTimeStamp(*Claimed)).GetTotalSeconds();
+	TArray<uint8> Contents;
+	const bool bLoaded = Age <= MAX_REQUEST_AGE && FileManager.FileSize(*Claimed) <= MAX_REQUEST_SIZE &&
+		FFileHelper::LoadFileToArray(Contents, *Claimed);
+	FileManager.Delete(*Claimed, /* RequireExists = */ false, /* EvenReadOnly = */ true, /* Quiet = */ true);
+	if (!bLoaded)
+	{
+		UE_LOG(LogHermesServer, Warning, TEXT("Dropping spooled request %s, it's too old or too large"), *Filename);
+		return false;
+	}
+
+	// The URL handler writes the path exactly like it would've sent it over the socket, as UTF-8
+	const FUTF8ToTCHAR Conversion(reinterpret_cast<const ANSICHAR*>(Contents.GetData()), Contents.Num());
+	OutPath = FString(Conversion.Length(), Conversion.Get()).TrimEnd();
+	return !OutPath.IsEmpty();
+}
@@ -0,0 +1,46 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#pragma once
+
+#include "HermesTransport.h"
+
+#include <CoreMinimal.h>
+
+/**
+ * Picks up links that were opened while no editor was listening, e.g. because it was starting up, had crashed or was
+ * recompiling. The URL handler writes each of them to its own file in a per-scheme spool directory (to a temporary
+ * name first, and then renames it to "<arrival time>-<pid>.req"), and they're dispatched in the order they arrived as
+ * soon as we know the scheme, and then whenever new ones show up. Every file is claimed with a rename before it's read,
+ * so each link is handled once even if more than one editor is draining the same spool.
+ *
+ * On Unix-like platforms, we also hold the scheme's launch lock for as long as we're running, which tells the URL
+ * handler that an editor is on its way and that it should spool the link rather than launch another one.
+ */
+class FHermesRequestSpool : public IHermesTransport
+{
+public:
+	virtual ~FHermesRequestSpool() override;
+
+	/** Where the URL handler spools links for the given scheme, this needs to match what the URL handler writes to */
+	static FString GetSpoolDirectory(const FString& Scheme);
+
+public: // Implementation of IHermesTransport
+	virtual FName GetTransportName() const override;
+	virtual bool Start(IHermesRequestSink& InSink) override;
+	virtual void Stop() override;
+	virtual void Tick() override;
+	virtual bool SetScheme(const FString& Scheme) override;
+
+private:
+	/** Dispatch every request in the spool, oldest first */
+	void Drain();
+	/** Returns false if the file is stale or someone else claimed it first */
+	bool ClaimRequest(const FString& Filename, FString& OutPath) const;
+	void ReleaseLaunchLock();
+
+	IHermesRequestSink* Sink = nullptr;
+	FString SpoolDirectory;
+	double NextPollTime = 0.0;
+#if PLATFORM_UNIX
+	int LaunchLock = -1;
+#endif
+};
@@ -0,0 +1,170 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#include "GenericHermesServer.h"
+#include "Unix/HermesUnixSocketTransport.h"
+
+#include <HAL/FileManager.h>
+#include <HAL/PlatformMisc.h>
+#include <Interfaces/IPluginManager.h>
+#include <Misc/FileHelper.h>
+#include <Misc/Paths.h>
+#include <Modules/ModuleManager.h>
+
+/**
+ * On Linux, the scheme is registered with the desktop through an XDG desktop entry that runs hermes_urls, which forwards
+ * links to the Unix domain socket transport that the generic server starts (or launches an editor, if none is running).
+ */
+struct FLinuxHermesServerModule : FGenericHermesServer
+{
+private: // Implementation of FHermesServerTickable
+	virtual void Tick(float DeltaTime) override final;
+
+private: // Implementation of FGenericHermesServer
+	virtual bool RegisterScheme(const TCHAR* Scheme, bool bDebug) override final;
+	virtual void UnregisterScheme(const TCHAR* Scheme) override final;
+
+	FProcHandle RegistrationHandle;
+};
+
+IMPLEMENT_MODULE(FLinuxHermesServerModule, HermesServer)
+
+static FString GetHermesHandlerExe()
+{
+	const TSharedPtr<IPlugin> HermesCorePlugin = IPluginManager::Get().FindPlugin("HermesCore");
+	checkf(HermesCorePlugin != nullptr, TEXT("Unable to look up ourselves!"));
+	return FPaths::ConvertRelativePathToFull(
+		HermesCorePlugin->GetBaseDir() / TEXT("Binaries") / FPlatformProcess::GetBinariesSubdirectory() / TEXT(
+			"hermes_urls"));
+}
+
+/** Where the desktop entry for the scheme goes, i.e. $XDG_DATA_HOME/applications */
+static FString GetDesktopEntryPath(const TCHAR* Scheme)
+{
+	FString DataHome = FPlatformMisc::GetEnvironmentVariable(TEXT("XDG_DATA_HOME"));
+	if (DataHome.IsEmpty())
+	{
+		DataHome = FPlatformMisc::GetEnvironmentVariable(TEXT("HOME")) / TEXT(".local/share");
+	}
+	return DataHome / TEXT("applications") / FString::Printf(TEXT("hermes-%s.desktop"), Scheme);
+}
+
+/** Quote an argument for the Exec key of a desktop entry, which has its own escaping rules on top of the quoting */
+static FString QuoteExecArgument(const FString& Argument)
+{
+	FString Quoted = TEXT("\"");
+	for (const TCHAR Character : Argument)
+	{
+		if (Character == TEXT('"') || Character == TEXT('`') || Character == TEXT('$'))
+		{
+			// The backslash that escapes the character inside the quotes needs to be escaped in the desktop entry too
+			Quoted += TEXT("\\\\");
+			Quoted += Character;
+		}
+		else if (Character == TEXT('\\'))
+		{
+			// Escaped inside the quotes, and both of those backslashes escaped again in the desktop entry
+			Quoted += TEXT("\\\\\\\\");
+		}
+		else if (Character == TEXT('%'))
+		{
+			Quoted += TEXT("%%");
+		}
+		else
+		{
+			Quoted += Character;
+		}
+	}
+	return Quoted + TEXT("\"");
+}
+
+bool FLinuxHermesServerModule::RegisterScheme(const TCHAR* Scheme, bool bDebug)
+{
+	const FString HermesHandlerExe = GetHermesHandlerExe();
+	if (!FPaths::FileExists(HermesHandlerExe))
+	{
+		UE_LOG(LogHermesServer, Error,
+		       TEXT("Unable to register %s:// because %s hasn't been built, links will only reach the editor through %s"),
+		       Scheme, *HermesHandlerExe, *FHermesUnixSocketTransport::GetSocketPath(Scheme));
+		return false;
+	}
+
+	const FString EditorPath = FPaths::ConvertRelativePathToFull(
+		FPlatformProcess::GetModulesDirectory() / FPlatformProcess::ExecutableName(false));
+	const FString Exec = FString::Printf(
+		TEXT("%s%s %s %s %s %%u"), *QuoteExecArgument(HermesHandlerExe), bDebug ? TEXT(" --debug") : TEXT(""),
+		*QuoteExecArgument(Scheme), *QuoteExecArgument(EditorPath),
+		*QuoteExecArgument(FPaths::ConvertRelativePathToFull(FPaths::GetProjectFilePath())));
+
+	const FString DesktopEntryPath = GetDesktopEntryPath(Scheme);
+	const FString DesktopEntry = FString::Printf(
+		TEXT("[Desktop Entry]\nType=Application\nName=Hermes URLs (%s://)\nExec=%s\nMimeType=x-scheme-handler/%s;\n")
+		TEXT("NoDisplay=true\nTerminal=false\n"), Scheme, *Exec, Scheme);
+	if (!FFileHelper::SaveStringToFile(DesktopEntry, *DesktopEntryPath,
+	                                   FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM))
+	{
+		UE_LOG(LogHermesServer, Error, TEXT("Unable to register %s://, couldn't write %s"), Scheme, *DesktopEntryPath);
+		return false;
+	}
+
+	// xdg-mime is a shell script that can take a moment, so it's run in the background like the Windows registration
+	const FString Arguments = FString::Printf(TEXT("xdg-mime default %s x-scheme-handler/%s"),
+	                                          *FPaths::GetCleanFilename(DesktopEntryPath), Scheme);
+	UE_LOG(LogHermesServer, Verbose, TEXT("Attempting to register %s:// using %s and %s"), Scheme, *DesktopEntryPath,
+	       *Arguments);
+	RegistrationHandle = FPlatformProcess::CreateProc(TEXT("/usr/bin/env"), *Arguments, true, false, false,
+	                                                  nullptr, 0, nullptr, nullptr, nullptr);
+	if (!RegistrationHandle.IsValid())
+	{
+		UE_LOG(LogHermesServer, Error, TEXT("Unable to register %s:// using %s"), Scheme, *Arguments);
+		return false;
+	}
+
+	return true;
+}
+
+void FLinuxHermesServerModule::UnregisterScheme(const TCHAR* Scheme)
+{
+	if (RegistrationHandle.IsValid())
+	{
+		FPlatformProcess::WaitForProc(RegistrationHandle);
+	}
+
+	// The default in mimeapps.list is left behind, but desktops ignore defaults whose desktop entry is gone
+	const FString DesktopEntryPath = GetDesktopEntryPath(Scheme);
+	UE_LOG(LogHermesServer, Verbose, TEXT("Attempting to unregister %s:// by removing %s"), Scheme, *DesktopEntryPath);
+	if (FPaths::FileExists(DesktopEntryPath) && !IFileManager::Get().Delete(*DesktopEntryPath))
+	{
+		UE_LOG(LogHermesServer, Warning, TEXT("Unregistration of %s:// failed, couldn't remove %s"), Scheme,
+		       *DesktopEntryPath);
+	}
+}
+
+void FLinuxHermesServerModule::Tick(float DeltaTime)
+{
+	FGenericHermesServer::Tick(DeltaTime);
+
+	if (RegistrationHandle.IsValid())
+	{
+		if (!FPlatformProcess::IsProcRunning(RegistrationHandle))
+		{
+			int32 ReturnCode = INDEX_NONE;
+			if (FPlatformProcess::GetProcReturnCode(RegistrationHandle, &ReturnCode))
+			{
+				if (ReturnCode != 0)
+				{
+					UE_LOG(LogHermesServer, Error, TEXT("URL Registration failed with status code %i"), ReturnCode);
+				}
+				else
+				{
+					UE_LOG(LogHermesServer, Verbose, TEXT("URL Registration completed successfully"));
+				}
+			}
+			else
+			{
+				UE_LOG(LogHermesServer, Error, TEXT("Unable to poll return code for completed registration"));
+			}
+
+			FPlatformProcess::CloseProc(RegistrationHandle);
+			RegistrationHandle.Reset();
+		}
+	}
+}
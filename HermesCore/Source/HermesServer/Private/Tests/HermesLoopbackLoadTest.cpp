@@ -0,0 +1,515 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#include "HermesLoopbackServer.h"
+#include "HermesServer.h"
+
+#include <Async/Async.h>
+#include <Features/IModularFeatures.h>
+#include <IPAddress.h>
+#include <Math/RandomStream.h>
+#include <Misc/AutomationTest.h>
+#include <Misc/CommandLine.h>
+#include <Misc/FileHelper.h>
+#include <Misc/Parse.h>
+#include <Modules/ModuleManager.h>
+#include <SocketSubsystem.h>
+#include <Sockets.h>
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace HermesLoopbackLoadTestPrivate
+{
+	static const FName NAME_LoadTestEndpoint(TEXT("hermesloadtest"));
+	/** How long a connection waits for a response before it gives up on the server */
+	static constexpr double RESPONSE_TIMEOUT_SECONDS = 30.0;
+
+	/**
+	 * Log-linear histogram in the style of HdrHistogram: values below 2 * SUB_BUCKET_COUNT are recorded exactly, and
+	 * above that every power of two is split into SUB_BUCKET_COUNT linear buckets, so percentiles are within ~1% over
+	 * the whole range with a fixed amount of memory. Same layout as the one in Tools/HermesLoadGenerator.
+	 */
+	class FLatencyHistogram
+	{
+	public:
+		static constexpr int32 SUB_BUCKET_BITS = 7;
+		static constexpr uint64 SUB_BUCKET_COUNT = uint64(1) << SUB_BUCKET_BITS;
+
+		FLatencyHistogram()
+		{
+			Counts.SetNumZeroed(2 * SUB_BUCKET_COUNT + (64 - SUB_BUCKET_BITS - 1) * SUB_BUCKET_COUNT);
+		}
+
+		void Record(uint64 Value)
+		{
+			++Counts[IndexOf(Value)];
+			++TotalCount;
+			MaxValue = FMath::Max(MaxValue, Value);
+		}
+
+		void Merge(const FLatencyHistogram& Other)
+		{
+			for (int32 Index = 0; Index < Counts.Num(); ++Index)
+			{
+				Counts[Index] += Other.Counts[Index];
+			}
+			TotalCount += Other.TotalCount;
+			MaxValue = FMath::Max(MaxValue, Other.MaxValue);
+		}
+
+		/** The highest value recorded at or below the given percentile (0-100), reported as the top of its bucket */
+		uint64 ValueAtPercentile(double Percentile) const
+		{
+			const uint64 Target = FMath::Max<uint64>(1, uint64(Percentile / 100.0 * double(TotalCount) + 0.5));
+			uint64 Seen = 0;
+			for (int32 Index = 0; Index < Counts.Num(); ++Index)
+			{
+				Seen += Counts[Index];
+				if (Seen >= Target)
+				{
+					return FMath::Min(HighestValueIn(Index), MaxValue);
+				}
+			}
+			return MaxValue;
+		}
+
+		uint64 GetTotalCount() const
+		{
+			return TotalCount;
+		}
+
+		uint64 GetMax() const
+		{
+			return MaxValue;
+		}
+
+	private:
+		static int32 IndexOf(uint64 Value)
+		{
+			if (Value < 2 * SUB_BUCKET_COUNT)
+			{
+				return static_cast<int32>(Value);
+			}
+
+			// Shift the value down so that it lands in [SUB_BUCKET_COUNT, 2 * SUB_BUCKET_COUNT)
+			const int32 Shift = static_cast<int32>(FMath::FloorLog2_64(Value)) - SUB_BUCKET_BITS;
+			return static_cast<int32>(2 * SUB_BUCKET_COUNT + (Shift - 1) * SUB_BUCKET_COUNT +
+				((Value >> Shift) - SUB_BUCKET_COUNT));
+		}
+
+		static uint64 HighestValueIn(int32 InIndex)
+		{
+			const uint64 Index = static_cast<uint64>(InIndex);
+			if (Index < 2 * SUB_BUCKET_COUNT)
+			{
+				return Index;
+			}
+
+			const uint64 Shift = (Index - 2 * SUB_BUCKET_COUNT) / SUB_BUCKET_COUNT + 1;
+			const uint64 SubBucket = (Index - 2 * SUB_BUCKET_COUNT) % SUB_BUCKET_COUNT + SUB_BUCKET_COUNT;
+			return ((SubBucket + 1) << Shift) - 1;
+		}
+
+		TArray<uint64> Counts;
+		uint64 TotalCount = 0;
+		uint64 MaxValue = 0;
+	};
+
+	/** Everything that can be configured from the command line, see the README for what each option does */
+	struct FLoadTestOptions
+	{
+		int32 Connections = 4;
+		int32 Pipeline = 8;
+		int32 RequestsPerConnection = 2000;
+		int32 WarmupPerConnection = 100;
+		FString Priority = TEXT("interactive");
+		/** The request mix, with each path repeated as many times as its weight */
+		TArray<FString> Mix;
+
+		// Absolute thresholds in microseconds (and requests per second), zero means "don't check"
+		double MaxP50Us = 0.0;
+		double MaxP99Us = 0.0;
+		double MinRequestsPerSecond = 0.0;
+
+		/** Fail if results regress by more than Tolerance compared to this, in the load generator's baseline format */
+		FString BaselineFile;
+		FString WriteBaselineFile;
+		double Tolerance = 0.10;
+
+		void ParseCommandLine(const TCHAR* CommandLine)
+		{
+			FParse::Value(CommandLine, TEXT("-HermesLoadTestConnections="), Connections);
+			FParse::Value(CommandLine, TEXT("-HermesLoadTestPipeline="), Pipeline);
+			FParse::Value(CommandLine, TEXT("-HermesLoadTestRequests="), RequestsPerConnection);
+			FParse::Value(CommandLine, TEXT("-HermesLoadTestWarmup="), WarmupPerConnection);
+			FParse::Value(CommandLine, TEXT("-HermesLoadTestPriority="), Priority);
+			FParse::Value(CommandLine, TEXT("-HermesLoadTestMaxP50Us="), MaxP50Us);
+			FParse::Value(CommandLine, TEXT("-HermesLoadTestMaxP99Us="), MaxP99Us);
+			FParse::Value(CommandLine, TEXT("-HermesLoadTestMinRps="), MinRequestsPerSecond);
+			FParse::Value(CommandLine, TEXT("-HermesLoadTestBaseline="), BaselineFile);
+			FParse::Value(CommandLine, TEXT("-HermesLoadTestWriteBaseline="), WriteBaselineFile);
+			FParse::Value(CommandLine, TEXT("-HermesLoadTestTolerance="), Tolerance);
+			Connections = FMath::Max(Connections, 1);
+			Pipeline = FMath::Max(Pipeline, 1);
+			RequestsPerConnection = FMath::Max(RequestsPerConnection, 1);
+			WarmupPerConnection = FMath::Max(WarmupPerConnection, 0);
+
+			// e.g. -HermesLoadTestPaths=hermesloadtest@9,content/Game/Maps/Entry
+			FString Paths;
+			TArray<FString> WeightedPaths;
+			if (FParse::Value(CommandLine, TEXT("-HermesLoadTestPaths="), Paths, false))
+			{
+				Paths.ParseIntoArray(WeightedPaths, TEXT(","));
+			}
+			for (FString& WeightedPath : WeightedPaths)
+			{
+				int32 Weight = 1;
+				int32 At = INDEX_NONE;
+				if (WeightedPath.FindLastChar(TEXT('@'), At))
+				{
+					Weight = FMath::Max(FCString::Atoi(*WeightedPath.Mid(At + 1)), 1);
+					WeightedPath.LeftInline(At);
+				}
+				if (!WeightedPath.StartsWith(TEXT("/")))
+				{
+					WeightedPath.InsertAt(0, TEXT('/'));
+				}
+				for (int32 Index = 0; Index < Weight; ++Index)
+				{
+					Mix.Add(WeightedPath);
+				}
+			}
+			if (Mix.Num() == 0)
+			{
+				Mix.Add(TEXT("/") + NAME_LoadTestEndpoint.ToString());
+			}
+		}
+	};
+
+	struct FConnectionResults
+	{
+		FLatencyHistogram Latency;
+		TMap<int32, uint64> StatusCounts;
+		uint64 Errors = 0;
+		FString FatalError;
+	};
+
+	/** Find the end of the first complete HTTP response in Buffer, returns INDEX_NONE if it isn't complete yet */
+	static int32 ParseResponse(const TArray<uint8>& Buffer, int32& OutStatusCode)
+	{
+		static const uint8 HeaderTerminator[] = {'\r', '\n', '\r', '\n'};
+		int32 HeaderEnd = INDEX_NONE;
+		for (int32 Index = 0; Index + 4 <= Buffer.Num(); ++Index)
+		{
+			if (FMemory::Memcmp(Buffer.GetData() + Index, HeaderTerminator, 4) == 0)
+			{
+				HeaderEnd = Index;
+				break;
+			}
+		}
+		if (HeaderEnd == INDEX_NONE)
+		{
+			return INDEX_NONE;
+		}
+
+		// The loopback server only ever sends ASCII headers
+		const FString Header(HeaderEnd, reinterpret_cast<const ANSICHAR*>(Buffer.GetData()));
+		OutStatusCode = Header.Len() > 12 ? FCString::Atoi(*Header.Mid(9, 3)) : 0;
+
+		int32 ContentLength = 0;
+		const int32 ContentLengthStart = Header.Find(TEXT("content-length:"), ESearchCase::IgnoreCase);
+		if (ContentLengthStart != INDEX_NONE)
+		{
+			ContentLength = FCString::Atoi(*Header + ContentLengthStart + 15);
+		}
+
+		const int32 ResponseEnd = HeaderEnd + 4 + ContentLength;
+		return Buffer.Num() >= ResponseEnd ? ResponseEnd : INDEX_NONE;
+	}
+
+	/**
+	 * Runs on its own thread: opens a connection to the loopback server, keeps Pipeline requests in flight until every
+	 * request has been answered, and records how long each one took from being sent to its response arriving.
+	 */
+	static FConnectionResults RunConnection(const FLoadTestOptions& Options, int32 Port, const FString& Token,
+	                                        int32 ConnectionIndex)
+	{
+		FConnectionResults Results;
+		ISocketSubsystem* SocketSubsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+		TSharedRef<FInternetAddr> Address = SocketSubsystem->CreateInternetAddr();
+		Address->SetLoopbackAddress();
+		Address->SetPort(Port);
+
+		FSocket* Socket = SocketSubsystem->CreateSocket(NAME_Stream, TEXT("HermesLoadTest"), Address->GetProtocolType());
+		if (Socket == nullptr || !Socket->Connect(*Address))
+		{
+			Results.FatalError = FString::Printf(TEXT("Unable to connect to the loopback server on port %d"), Port);
+			if (Socket != nullptr)
+			{
+				SocketSubsystem->DestroySocket(Socket);
+			}
+			return Results;
+		}
+		Socket->SetNoDelay(true);
+
+		FRandomStream Random(ConnectionIndex + 1);
+		const int32 TotalRequests = Options.WarmupPerConnection + Options.RequestsPerConnection;
+		int32 NumSent = 0;
+		int32 NumAnswered = 0;
+		// Responses come back in the order the requests were sent, so this is a FIFO of when each was sent
+		TArray<double> SendTimes;
+		SendTimes.SetNumUninitialized(TotalRequests);
+		TArray<uint8> Received;
+		uint8 Chunk[16 * 1024];
+
+		while (NumAnswered < TotalRequests && Results.FatalError.IsEmpty())
+		{
+			// Top up the pipeline, as a single send
+			FString Outgoing;
+			while (NumSent < TotalRequests && NumSent - NumAnswered < Options.Pipeline)
+			{
+				// Every path is unique, so that the server's duplicate request filter doesn't drop any of them
+				const FString& Path = Options.Mix[Random.RandHelper(Options.Mix.Num())];
+				Outgoing += FString::Printf(
+					TEXT("GET %s%shermesloadtest=%d-%d HTTP/1.1\r\nX-Hermes-Token: %s\r\nX-Hermes-Priority: %s\r\n\r\n"),
+					*Path, Path.Contains(TEXT("?")) ? TEXT("&") : TEXT("?"), ConnectionIndex, NumSent, *Token,
+					*Options.Priority);
+				SendTimes[NumSent++] = FPlatformTime::Seconds();
+			}
+
+			const FTCHARToUTF8 OutgoingUtf8(*Outgoing);
+			int32 Offset = 0;
+			while (Offset < OutgoingUtf8.Length())
+			{
+				int32 BytesSent = 0;
+				if (!Socket->Send(reinterpret_cast<const uint8*>(OutgoingUtf8.Get()) + Offset,
+				                  OutgoingUtf8.Length() - Offset, BytesSent))
+				{
+					Results.FatalError = TEXT("The loopback server closed the connection");
+					break;
+				}
+				Offset += BytesSent;
+			}
+
+			// Wait for at least one response, and take every response that's arrived
+			int32 BytesRead = 0;
+			if (!Socket->Wait(ESocketWaitConditions::WaitForRead, FTimespan::FromSeconds(RESPONSE_TIMEOUT_SECONDS)) ||
+				!Socket->Recv(Chunk, sizeof(Chunk), BytesRead) || BytesRead <= 0)
+			{
+				Results.FatalError = FString::Printf(TEXT("No response from the loopback server after %d request(s)"),
+				                                     NumAnswered);
+				break;
+			}
+			Received.Append(Chunk, BytesRead);
+
+			int32 StatusCode = 0;
+			int32 ResponseEnd;
+			while ((ResponseEnd = ParseResponse(Received, StatusCode)) != INDEX_NONE)
+			{
+				if (NumAnswered >= Options.WarmupPerConnection)
+				{
+					const double LatencyUs = (FPlatformTime::Seconds() - SendTimes[NumAnswered]) * 1000000.0;
+					Results.Latency.Record(static_cast<uint64>(LatencyUs));
+					++Results.StatusCounts.FindOrAdd(StatusCode);
+					Results.Errors += StatusCode != 200 ? 1 : 0;
+				}
+				++NumAnswered;
+				Received.RemoveAt(0, ResponseEnd);
+			}
+		}
+
+		Socket->Close();
+		SocketSubsystem->DestroySocket(Socket);
+		return Results;
+	}
+
+	/** Read a baseline written by this test or the load generator: one "key value" pair per line */
+	static TMap<FString, double> ReadBaseline(const FString& Filename)
+	{
+		TMap<FString, double> Values;
+		TArray<FString> Lines;
+		FFileHelper::LoadFileToStringArray(Lines, *Filename);
+		for (const FString& Line : Lines)
+		{
+			FString Key;
+			FString Value;
+			if (Line.Split(TEXT(" "), &Key, &Value))
+			{
+				Values.Add(Key, FCString::Atod(*Value));
+			}
+		}
+		return Values;
+	}
+
+	struct FLoadTestState
+	{
+		FLoadTestOptions Options;
+		TUniquePtr<FHermesLoopbackServer> Server;
+		TArray<TFuture<FConnectionResults>> Connections;
+		double StartTime = 0.0;
+
+		~FLoadTestState()
+		{
+			// Never leave the test endpoint or server behind, even if the test bailed out early
+			if (Server.IsValid())
+			{
+				IModularFeatures::Get().UnregisterModularFeature(IHermesTransport::GetModularFeatureName(),
+				                                                 Server.Get());
+			}
+			if (IHermesServerModule* Hermes = FModuleManager::GetModulePtr<IHermesServerModule>("HermesServer"))
+			{
+				Hermes->Unregister(NAME_LoadTestEndpoint);
+			}
+		}
+	};
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FHermesLoopbackLoadTest, "Hermes.Server.LoopbackLoad",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+/**
+ * Pushes a mix of pipelined requests through a loopback server into an endpoint that does nothing, and reports
+ * throughput and latency percentiles. This is the same thing that Tools/HermesLoadGenerator does from outside the
+ * editor, but runs as part of an automation pass.
+ */
+bool FHermesLoopbackLoadTest::RunTest(const FString& Parameters)
+{
+	using namespace HermesLoopbackLoadTestPrivate;
+
+	IHermesServerModule* Hermes = FModuleManager::GetModulePtr<IHermesServerModule>("HermesServer");
+	if (!TestNotNull(TEXT("HermesServer module"), Hermes))
+	{
+		return false;
+	}
+
+	const TSharedRef<FLoadTestState> State = MakeShared<FLoadTestState>();
+	State->Options.ParseCommandLine(FCommandLine::Get());
+	Hermes->Register(NAME_LoadTestEndpoint,
+	                 FHermesOnRequest::CreateLambda([](const FString&, const FHermesQueryParamsMap&) {}));
+
+	// Any free port, so that this can run next to an editor that has the loopback server enabled
+	State->Server = MakeUnique<FHermesLoopbackServer>(0, FString());
+	IModularFeatures::Get().RegisterModularFeature(IHermesTransport::GetModularFeatureName(), State->Server.Get());
+	if (!State->Server->IsListening())
+	{
+		AddError(TEXT("The loopback server didn't start, see the log for why"));
+		return false;
+	}
+
+	AddInfo(FString::Printf(TEXT("Sending %d %s request(s) over %d connection(s), %d in flight per connection"),
+	                        State->Options.RequestsPerConnection * State->Options.Connections, *State->Options.Priority,
+	                        State->Options.Connections, State->Options.Pipeline));
+	State->StartTime = FPlatformTime::Seconds();
+	for (int32 Index = 0; Index < State->Options.Connections; ++Index)
+	{
+		const int32 Port = State->Server->GetPort();
+		const FString Token = State->Server->GetToken();
+		State->Connections.Add(Async(EAsyncExecution::Thread, [Options = State->Options, Port, Token, Index]
+		{
+			return RunConnection(Options, Port, Token, Index);
+		}));
+	}
+
+	// Requests are dispatched on the game thread, so wait for the connections from a latent command
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, State]
+	{
+		for (const TFuture<FConnectionResults>& Connection : State->Connections)
+		{
+			if (!Connection.IsReady())
+			{
+				return false;
+			}
+		}
+
+		const double ElapsedSeconds = FPlatformTime::Seconds() - State->StartTime;
+		const FLoadTestOptions& Options = State->Options;
+		FLatencyHistogram Latency;
+		TMap<int32, uint64> StatusCounts;
+		uint64 Errors = 0;
+		for (const TFuture<FConnectionResults>& Connection : State->Connections)
+		{
+			const FConnectionResults& Results = Connection.Get();
+			if (!Results.FatalError.IsEmpty())
+			{
+				AddError(Results.FatalError);
+				return true;
+			}
+			Latency.Merge(Results.Latency);
+			Errors += Results.Errors;
+			for (const TPair<int32, uint64>& Pair : Results.StatusCounts)
+			{
+				StatusCounts.FindOrAdd(Pair.Key) += Pair.Value;
+			}
+		}
+
+		// Same keys as the load generator, so that the two can share baselines. The elapsed time includes warmup.
+		TMap<FString, double> Measured;
+		Measured.Add(TEXT("rps"), double(Latency.GetTotalCount()) / ElapsedSeconds);
+		Measured.Add(TEXT("p50_us"), double(Latency.ValueAtPercentile(50.0)));
+		Measured.Add(TEXT("p95_us"), double(Latency.ValueAtPercentile(95.0)));
+		Measured.Add(TEXT("p99_us"), double(Latency.ValueAtPercentile(99.0)));
+		Measured.Add(TEXT("p999_us"), double(Latency.ValueAtPercentile(99.9)));
+		Measured.Add(TEXT("max_us"), double(Latency.GetMax()));
+
+		AddInfo(FString::Printf(TEXT("%llu request(s) in %.3f s, %.1f req/s"), Latency.GetTotalCount(),
+		                        ElapsedSeconds, Measured[TEXT("rps")]));
+		AddInfo(FString::Printf(TEXT("Latency p50 %.0f us, p95 %.0f us, p99 %.0f us, p99.9 %.0f us, max %.0f us"),
+		                        Measured[TEXT("p50_us")], Measured[TEXT("p95_us")], Measured[TEXT("p99_us")],
+		                        Measured[TEXT("p999_us")], Measured[TEXT("max_us")]));
+		for (const TPair<int32, uint64>& Pair : StatusCounts)
+		{
+			AddInfo(FString::Printf(TEXT("Status %d: %llu"), Pair.Key, Pair.Value));
+		}
+
+		if (Errors > 0)
+		{
+			AddError(FString::Printf(TEXT("%llu request(s) were not answered with 200 OK"), Errors));
+		}
+		auto CheckLimit = [this](const TCHAR* What, double Actual, double Limit, bool bHigherIsWorse)
+		{
+			if (Limit > 0.0 && (bHigherIsWorse ? Actual > Limit : Actual < Limit))
+			{
+				AddError(FString::Printf(TEXT("%s is %.1f, the limit is %.1f"), What, Actual, Limit));
+			}
+		};
+		CheckLimit(TEXT("p50 latency (us)"), Measured[TEXT("p50_us")], Options.MaxP50Us, true);
+		CheckLimit(TEXT("p99 latency (us)"), Measured[TEXT("p99_us")], Options.MaxP99Us, true);
+		CheckLimit(TEXT("Throughput (req/s)"), Measured[TEXT("rps")], Options.MinRequestsPerSecond, false);
+
+		if (!Options.BaselineFile.IsEmpty())
+		{
+			const TMap<FString, double> Baseline = ReadBaseline(Options.BaselineFile);
+			if (Baseline.Num() == 0)
+			{
+				AddError(FString::Printf(TEXT("Unable to read a baseline from %s"), *Options.BaselineFile));
+			}
+			for (const TPair<FString, double>& Pair : Baseline)
+			{
+				// Throughput regresses by going down, latencies by going up. The maximum is too noisy to compare.
+				const double* Current = Measured.Find(Pair.Key);
+				if (Current == nullptr || Pair.Key == TEXT("max_us"))
+				{
+					continue;
+				}
+				const bool bThroughput = Pair.Key == TEXT("rps");
+				const double Limit = Pair.Value * (bThroughput ? 1.0 - Options.Tolerance : 1.0 + Options.Tolerance);
+				CheckLimit(*(Pair.Key + TEXT(" vs. baseline")), *Current, Limit, !bThroughput);
+			}
+		}
+
+		if (!Options.WriteBaselineFile.IsEmpty())
+		{
+			FString Baseline;
+			for (const TPair<FString, double>& Pair : Measured)
+			{
+				Baseline += FString::Printf(TEXT("%s %f\n"), *Pair.Key, Pair.Value);
+			}
+			FFileHelper::SaveStringToFile(Baseline, *Options.WriteBaselineFile);
+			AddInfo(FString::Printf(TEXT("Wrote baseline to %s"), *Options.WriteBaselineFile));
+		}
+
+		return true;
+	}));
+
+	return true;
+}
+
+#endif
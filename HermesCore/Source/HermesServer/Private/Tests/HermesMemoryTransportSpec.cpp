@@ -0,0 +1,390 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#include "HermesMemoryQueueTransport.h"
+#include "HermesPluginSettings.h"
+#include "HermesServer.h"
+
+#include <Containers/Ticker.h>
+#include <Features/IModularFeatures.h>
+#include <Misc/AutomationTest.h>
+#include <Misc/CommandLine.h>
+#include <Misc/Guid.h>
+#include <Misc/Parse.h>
+#include <Modules/ModuleManager.h>
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace HermesMemoryTransportSpecPrivate
+{
+#if ENGINE_MAJOR_VERSION >= 5
+	typedef FTSTicker FHermesCoreTicker;
+#else
+	typedef FTicker FHermesCoreTicker;
+#endif
+
+	static const FName NAME_SpecEndpoint(TEXT("hermesspec"));
+	static const FName NAME_SpecCoalescingEndpoint(TEXT("hermesspeccoalescing"));
+	static const FName NAME_SpecMissingEndpoint(TEXT("hermesspecmissing"));
+	/** How long a latent spec waits for the server to dispatch what it's been sent */
+	static constexpr double WAIT_TIMEOUT_SECONDS = 5.0;
+	static constexpr int32 THROUGHPUT_REQUESTS = 10000;
+}
+
+BEGIN_DEFINE_SPEC(FHermesMemoryTransportSpec, "Hermes.Server.MemoryTransport",
+                  EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+	IHermesServerModule* Hermes = nullptr;
+	IHermesMemoryTransport* Transport = nullptr;
+	/** Only set if the server doesn't have a memory transport of its own, i.e. without -HermesMemoryTransport */
+	TUniquePtr<FHermesMemoryQueueTransport> OwnedTransport;
+	/** Every path starts with this, so that the duplicate filter never sees a path from an earlier run */
+	FString RunId;
+	/** The labels of the requests the endpoints have handled, in the order they were handled */
+	TArray<FString> Handled;
+	TArray<TArray<FString>> Batches;
+#if ENGINE_MAJOR_VERSION >= 5
+	FTSTicker::FDelegateHandle WaitHandle;
+#else
+	FDelegateHandle WaitHandle;
+#endif
+
+	float PreviousDuplicateWindow = 0.0f;
+	float PreviousCoalescingWindow = 0.0f;
+	float PreviousDispatchBudgetMs = 0.0f;
+
+	FString MakePath(FName Endpoint, const FString& Label) const;
+	FString GetLabel(const FString& Path) const;
+	/** Send every path with the given priority, flush, and return what happened to each one */
+	TArray<EHermesDispatchResult> SendAndFlush(const TArray<FString>& Paths, EHermesRequestPriority Priority);
+	void TestResults(const TCHAR* What, const TArray<EHermesDispatchResult>& Actual,
+	                 const TArray<EHermesDispatchResult>& Expected);
+	/** Call Then once Condition holds, checking on every tick, or fail once we've waited long enough */
+	void WaitUntil(TFunction<bool()> Condition, TFunction<void()> Then, const FDoneDelegate& Done);
+END_DEFINE_SPEC(FHermesMemoryTransportSpec)
+
+/**
+ * Drives the dispatcher through IHermesMemoryTransport, without the OS handler or any other process. Runs in a
+ * -nullrhi editor, e.g. `UnrealEditor-Cmd Project.uproject -nullrhi -ExecCmds="Automation RunTests
+ * Hermes.Server.MemoryTransport;Quit"`. Uses the server's memory transport if it has one, or registers its own.
+ */
+void FHermesMemoryTransportSpec::Define()
+{
+	using namespace HermesMemoryTransportSpecPrivate;
+
+	BeforeEach([this]
+	{
+		Hermes = FModuleManager::GetModulePtr<IHermesServerModule>("HermesServer");
+		TestNotNull(TEXT("HermesServer module"), Hermes);
+
+		Transport = Hermes != nullptr ? Hermes->GetMemoryTransport() : nullptr;
+		if (Transport == nullptr)
+		{
+			OwnedTransport = MakeUnique<FHermesMemoryQueueTransport>();
+			IModularFeatures::Get().RegisterModularFeature(IHermesTransport::GetModularFeatureName(),
+			                                               OwnedTransport.Get());
+			Transport = OwnedTransport.Get();
+		}
+		Transport->ConsumeResults();
+
+		RunId = FGuid::NewGuid().ToString(EGuidFormats::Digits);
+		Handled.Reset();
+		Batches.Reset();
+
+		if (Hermes != nullptr)
+		{
+			Hermes->Register(NAME_SpecEndpoint, FHermesOnRequest::CreateLambda(
+				                 [this](const FString& Path, const FHermesQueryParamsMap&)
+				                 {
+					                 Handled.Add(GetLabel(Path));
+				                 }));
+			Hermes->RegisterCoalescing(NAME_SpecCoalescingEndpoint, FHermesOnCoalescedRequests::CreateLambda(
+				                           [this](const TArray<FHermesRequest>& Requests)
+				                           {
+					                           TArray<FString>& Batch = Batches.AddDefaulted_GetRef();
+					                           for (const FHermesRequest& Request : Requests)
+					                           {
+						                           Batch.Add(GetLabel(Request.Path));
+					                           }
+				                           }));
+		}
+
+		// Pin the settings that decide what the specs expect, in case the project has changed them
+		auto* Settings = GetMutableDefault<UHermesPluginSettings>();
+		PreviousDuplicateWindow = Settings->DuplicateRequestWindow;
+		PreviousCoalescingWindow = Settings->CoalescingWindow;
+		PreviousDispatchBudgetMs = Settings->DispatchBudgetMs;
+		Settings->DuplicateRequestWindow = 0.5f;
+		Settings->CoalescingWindow = 0.1f;
+		// Large enough that everything queued is dispatched in a single tick, so the order is deterministic
+		Settings->DispatchBudgetMs = 1000.0f;
+	});
+
+	AfterEach([this]
+	{
+		if (WaitHandle.IsValid())
+		{
+			FHermesCoreTicker::GetCoreTicker().RemoveTicker(WaitHandle);
+			WaitHandle.Reset();
+		}
+
+		auto* Settings = GetMutableDefault<UHermesPluginSettings>();
+		Settings->DuplicateRequestWindow = PreviousDuplicateWindow;
+		Settings->CoalescingWindow = PreviousCoalescingWindow;
+		Settings->DispatchBudgetMs = PreviousDispatchBudgetMs;
+
+		if (Hermes != nullptr)
+		{
+			Hermes->Unregister(NAME_SpecEndpoint);
+			Hermes->Unregister(NAME_SpecCoalescingEndpoint);
+		}
+		if (OwnedTransport.IsValid())
+		{
+			IModularFeatures::Get().UnregisterModularFeature(IHermesTransport::GetModularFeatureName(),
+			                                                 OwnedTransport.Get());
+			OwnedTransport.Reset();
+		}
+		Transport = nullptr;
+		Hermes = nullptr;
+	});
+
+	Describe(TEXT("Dispatch"), [this]
+	{
+		It(TEXT("should dispatch an interactive request before Flush returns"), [this]
+		{
+			const TArray<EHermesDispatchResult> Results = SendAndFlush(
+				{MakePath(NAME_SpecEndpoint, TEXT("a"))}, EHermesRequestPriority::Interactive);
+			TestResults(TEXT("Results"), Results, {EHermesDispatchResult::Dispatched});
+			TestEqual(TEXT("Handled"), Handled, TArray<FString>{TEXT("a")});
+		});
+
+		It(TEXT("should pass the query parameters to the handler"), [this]
+		{
+			FHermesQueryParamsMap Received;
+			Hermes->Unregister(NAME_SpecEndpoint);
+			Hermes->Register(NAME_SpecEndpoint, FHermesOnRequest::CreateLambda(
+				                 [&Received](const FString&, const FHermesQueryParamsMap& QueryParams)
+				                 {
+					                 Received = QueryParams;
+				                 }));
+
+			SendAndFlush({MakePath(NAME_SpecEndpoint, TEXT("a?Key=Hello%20World&flag"))},
+			             EHermesRequestPriority::Interactive);
+			const FString* Key = Received.Find(TEXT("key"));
+			TestTrue(TEXT("Has key"), Key != nullptr && *Key == TEXT("Hello World"));
+			TestTrue(TEXT("Has flag"), Received.Contains(TEXT("flag")));
+		});
+
+		It(TEXT("should report paths without a handler"), [this]
+		{
+			AddExpectedError(TEXT("There is no handler registered"), EAutomationExpectedErrorFlags::Contains, 1);
+			const TArray<EHermesDispatchResult> Results = SendAndFlush(
+				{MakePath(NAME_SpecMissingEndpoint, TEXT("a"))}, EHermesRequestPriority::Interactive);
+			TestResults(TEXT("Results"), Results, {EHermesDispatchResult::NoHandler});
+		});
+
+		It(TEXT("should refuse URIs for a scheme that isn't registered with it"), [this]
+		{
+			AddExpectedError(TEXT("isn't registered with the memory transport"), EAutomationExpectedErrorFlags::Contains,
+			                 1);
+			TestFalse(TEXT("Sent"), Transport->Send(TEXT("hermesspecbogus://") + MakePath(NAME_SpecEndpoint, TEXT("a"))));
+			TestEqual(TEXT("Pending"), Transport->GetNumPending(), 0);
+		});
+	});
+
+	Describe(TEXT("Priorities"), [this]
+	{
+		LatentIt(TEXT("should dispatch queued requests by priority, then in the order they were sent"),
+		         [this](const FDoneDelegate& Done)
+		         {
+			         TArray<EHermesDispatchResult> Results;
+			         Results.Append(SendAndFlush({MakePath(NAME_SpecEndpoint, TEXT("b1"))},
+			                                     EHermesRequestPriority::Background));
+			         Results.Append(SendAndFlush({MakePath(NAME_SpecEndpoint, TEXT("s1"))},
+			                                     EHermesRequestPriority::Scripted));
+			         Results.Append(SendAndFlush({MakePath(NAME_SpecEndpoint, TEXT("b2"))},
+			                                     EHermesRequestPriority::Background));
+			         Results.Append(SendAndFlush({MakePath(NAME_SpecEndpoint, TEXT("s2"))},
+			                                     EHermesRequestPriority::Scripted));
+			         Results.Append(SendAndFlush({MakePath(NAME_SpecEndpoint, TEXT("i1"))},
+			                                     EHermesRequestPriority::Interactive));
+			         TestResults(TEXT("Results"), Results, {
+				                     EHermesDispatchResult::Queued, EHermesDispatchResult::Queued,
+				                     EHermesDispatchResult::Queued, EHermesDispatchResult::Queued,
+				                     EHermesDispatchResult::Dispatched
+			                     });
+
+			         WaitUntil([this] { return Handled.Num() >= 5; }, [this]
+			         {
+				         TestEqual(TEXT("Handled"), Handled, TArray<FString>{
+					                   TEXT("i1"), TEXT("s1"), TEXT("s2"), TEXT("b1"), TEXT("b2")
+				                   });
+			         }, Done);
+		         });
+	});
+
+	Describe(TEXT("Duplicates"), [this]
+	{
+		It(TEXT("should drop a path that was just dispatched"), [this]
+		{
+			const FString Path = MakePath(NAME_SpecEndpoint, TEXT("a"));
+			const TArray<EHermesDispatchResult> Results = SendAndFlush({Path, Path}, EHermesRequestPriority::Interactive);
+			TestResults(TEXT("Results"), Results, {EHermesDispatchResult::Dispatched, EHermesDispatchResult::Duplicate});
+			TestEqual(TEXT("Handled"), Handled, TArray<FString>{TEXT("a")});
+		});
+
+		It(TEXT("should treat paths with different query strings as different"), [this]
+		{
+			const TArray<EHermesDispatchResult> Results = SendAndFlush(
+				{MakePath(NAME_SpecEndpoint, TEXT("a?n=1")), MakePath(NAME_SpecEndpoint, TEXT("a?n=2"))},
+				EHermesRequestPriority::Interactive);
+			TestResults(TEXT("Results"), Results, {EHermesDispatchResult::Dispatched, EHermesDispatchResult::Dispatched});
+		});
+
+		It(TEXT("should not filter anything when the window is 0"), [this]
+		{
+			GetMutableDefault<UHermesPluginSettings>()->DuplicateRequestWindow = 0.0f;
+			const FString Path = MakePath(NAME_SpecEndpoint, TEXT("a"));
+			const TArray<EHermesDispatchResult> Results = SendAndFlush({Path, Path}, EHermesRequestPriority::Interactive);
+			TestResults(TEXT("Results"), Results, {EHermesDispatchResult::Dispatched, EHermesDispatchResult::Dispatched});
+		});
+	});
+
+	Describe(TEXT("Coalescing"), [this]
+	{
+		LatentIt(TEXT("should hand a burst of requests to the handler as a single batch"), [this](const FDoneDelegate& Done)
+		{
+			const TArray<EHermesDispatchResult> Results = SendAndFlush({
+				MakePath(NAME_SpecCoalescingEndpoint, TEXT("a")),
+				MakePath(NAME_SpecCoalescingEndpoint, TEXT("b")),
+				MakePath(NAME_SpecCoalescingEndpoint, TEXT("c")),
+			}, EHermesRequestPriority::Interactive);
+			TestResults(TEXT("Results"), Results, {
+				            EHermesDispatchResult::Queued, EHermesDispatchResult::Queued,
+				            EHermesDispatchResult::Queued
+			            });
+			TestEqual(TEXT("Batches before the window closes"), Batches.Num(), 0);
+
+			WaitUntil([this] { return Batches.Num() > 0; }, [this]
+			{
+				TestEqual(TEXT("Batches"), Batches.Num(), 1);
+				TestEqual(TEXT("Batch"), Batches[0], TArray<FString>{TEXT("a"), TEXT("b"), TEXT("c")});
+			}, Done);
+		});
+	});
+
+	Describe(TEXT("Throughput"), [this]
+	{
+		It(TEXT("should dispatch interactive requests without falling behind"), [this]
+		{
+			TArray<FString> Paths;
+			Paths.Reserve(THROUGHPUT_REQUESTS);
+			for (int32 Index = 0; Index < THROUGHPUT_REQUESTS; ++Index)
+			{
+				Paths.Add(MakePath(NAME_SpecEndpoint, FString::FromInt(Index)));
+			}
+
+			// Every dispatch is logged, which would be most of what we measure
+			const ELogVerbosity::Type PreviousVerbosity = LogHermesServer.GetVerbosity();
+			LogHermesServer.SetVerbosity(ELogVerbosity::Warning);
+			const double StartTime = FPlatformTime::Seconds();
+			const TArray<EHermesDispatchResult> Results = SendAndFlush(Paths, EHermesRequestPriority::Interactive);
+			const double Elapsed = FPlatformTime::Seconds() - StartTime;
+			LogHermesServer.SetVerbosity(PreviousVerbosity);
+
+			const int32 NumDispatched = Results.FilterByPredicate([](EHermesDispatchResult Result)
+			{
+				return Result == EHermesDispatchResult::Dispatched;
+			}).Num();
+			TestEqual(TEXT("Dispatched"), NumDispatched, THROUGHPUT_REQUESTS);
+			TestEqual(TEXT("Handled"), Handled.Num(), THROUGHPUT_REQUESTS);
+
+			const double RequestsPerSecond = THROUGHPUT_REQUESTS / FMath::Max(Elapsed, 1e-6);
+			AddInfo(FString::Printf(TEXT("Dispatched %d request(s) in %.3f s, %.0f req/s"), THROUGHPUT_REQUESTS, Elapsed,
+			                        RequestsPerSecond));
+
+			double MinRequestsPerSecond = 0.0;
+			if (FParse::Value(FCommandLine::Get(), TEXT("-HermesMemoryTransportMinRps="), MinRequestsPerSecond) &&
+				RequestsPerSecond < MinRequestsPerSecond)
+			{
+				AddError(FString::Printf(TEXT("Throughput is %.0f req/s, the limit is %.0f req/s"), RequestsPerSecond,
+				                         MinRequestsPerSecond));
+			}
+		});
+	});
+}
+
+FString FHermesMemoryTransportSpec::MakePath(FName Endpoint, const FString& Label) const
+{
+	return FString::Printf(TEXT("%s/%s/%s"), *Endpoint.ToString(), *RunId, *Label);
+}
+
+FString FHermesMemoryTransportSpec::GetLabel(const FString& Path) const
+{
+	FString Label = Path;
+	Label.RemoveFromStart(TEXT("/") + RunId + TEXT("/"));
+	return Label;
+}
+
+TArray<EHermesDispatchResult> FHermesMemoryTransportSpec::SendAndFlush(const TArray<FString>& Paths,
+                                                                      EHermesRequestPriority Priority)
+{
+	for (const FString& Path : Paths)
+	{
+		Transport->Send(Path, Priority);
+	}
+	Transport->Flush();
+	if (Transport->GetNumPending() > 0)
+	{
+		AddError(TEXT("The server didn't take anything from the memory transport, is it running with -NoHermes?"));
+	}
+
+	TArray<EHermesDispatchResult> Results;
+	for (const FHermesMemoryTransportResult& Result : Transport->ConsumeResults())
+	{
+		Results.Add(Result.Result);
+	}
+	return Results;
+}
+
+void FHermesMemoryTransportSpec::TestResults(const TCHAR* What, const TArray<EHermesDispatchResult>& Actual,
+                                             const TArray<EHermesDispatchResult>& Expected)
+{
+	auto ToString = [](const TArray<EHermesDispatchResult>& Results)
+	{
+		TArray<FString> Names;
+		for (const EHermesDispatchResult Result : Results)
+		{
+			Names.Add(LexToString(Result));
+		}
+		return FString::Join(Names, TEXT(", "));
+	};
+	TestEqual(What, ToString(Actual), ToString(Expected));
+}
+
+void FHermesMemoryTransportSpec::WaitUntil(TFunction<bool()> Condition, TFunction<void()> Then,
+                                           const FDoneDelegate& Done)
+{
+	using namespace HermesMemoryTransportSpecPrivate;
+
+	const double Deadline = FPlatformTime::Seconds() + WAIT_TIMEOUT_SECONDS;
+	WaitHandle = FHermesCoreTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda(
+		[this, Condition = MoveTemp(Condition), Then = MoveTemp(Then), Done, Deadline](float)
+		{
+			if (Condition())
+			{
+				Then();
+			}
+			else if (FPlatformTime::Seconds() < Deadline)
+			{
+				return true;
+			}
+			else
+			{
+				AddError(TEXT("Timed out waiting for the server to dispatch the queued requests"));
+			}
+
+			WaitHandle.Reset();
+			Done.Execute();
+			return false;
+		}));
+}
+
+#endif
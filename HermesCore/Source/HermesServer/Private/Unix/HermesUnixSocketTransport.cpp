@@ -0,0 +1,441 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#include "HermesUnixSocketTransport.h"
+
+#include "HermesGameThreadWakeup.h"
+
+#include <HAL/PlatformMisc.h>
+#include <HAL/Runnable.h>
+#include <HAL/RunnableThread.h>
+#include <Misc/Paths.h>
+
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Same limit as the other transports: around the maximum path size (32k), plus room for the scheme and query string.
+static constexpr int32 MAX_LINE_SIZE = 64 * 1024;
+// Limit on how many clients can be connected at the same time, to avoid a misbehaving client exhausting our handles.
+static constexpr int32 MAX_CONNECTIONS = 64;
+static constexpr int32 RECEIVE_CHUNK_SIZE = 16 * 1024;
+static constexpr int32 MAX_EVENTS_PER_WAIT = 16;
+
+/**
+ * Waits for the transport's sockets on a background thread, and ticks the transport on the game thread once one of them
+ * is ready. Sockets are watched edge triggered, which works because Tick always accepts, reads & sends until it would
+ * block.
+ */
+class FHermesUnixSocketWaiter : FRunnable
+{
+public:
+	explicit FHermesUnixSocketWaiter(TFunction<void()>&& OnReady);
+	virtual ~FHermesUnixSocketWaiter() override;
+
+	bool IsWaiting() const
+	{
+		return bWaiting;
+	}
+
+	/** Wake up whenever the socket can be read from or written to, until it's closed */
+	void Watch(int Socket) const;
+
+private: // Implementation of FRunnable
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+private:
+	int Epoll = -1;
+	/** Written to by Stop, to get Run out of epoll_wait */
+	int StopEvent = -1;
+	std::atomic<bool> bWaiting{false};
+	std::atomic<bool> bStopping{false};
+	FHermesGameThreadWakeup Wakeup;
+	FRunnableThread* Thread = nullptr;
+};
+
+FHermesUnixSocketWaiter::FHermesUnixSocketWaiter(TFunction<void()>&& OnReady)
+	: Wakeup(MoveTemp(OnReady))
+{
+	Epoll = epoll_create1(EPOLL_CLOEXEC);
+	StopEvent = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+	epoll_event Event = {};
+	Event.events = EPOLLIN;
+	Event.data.fd = StopEvent;
+	if (Epoll == -1 || StopEvent == -1 || epoll_ctl(Epoll, EPOLL_CTL_ADD, StopEvent, &Event) != 0)
+	{
+		UE_LOG(LogHermesServer, Warning, TEXT("Unable to wait on Unix sockets, they'll be polled every tick: %s"),
+		       UTF8_TO_TCHAR(strerror(errno)));
+		return;
+	}
+
+	bWaiting = true;
+	Thread = FRunnableThread::Create(this, TEXT("HermesUnixSocketWaiter"), 64 * 1024, TPri_BelowNormal);
+	if (Thread == nullptr)
+	{
+		UE_LOG(LogHermesServer, Warning, TEXT("Unable to start the Unix socket thread, sockets will be polled every tick"));
+		bWaiting = false;
+	}
+}
+
+FHermesUnixSocketWaiter::~FHermesUnixSocketWaiter()
+{
+	if (Thread != nullptr)
+	{
+		Thread->Kill(true);
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	if (StopEvent != -1)
+	{
+		close(StopEvent);
+	}
+	if (Epoll != -1)
+	{
+		close(Epoll);
+	}
+}
+
+void FHermesUnixSocketWaiter::Watch(int Socket) const
+{
+	if (!bWaiting)
+	{
+		return;
+	}
+
+	epoll_event Event = {};
+	Event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+	Event.data.fd = Socket;
+	if (epoll_ctl(Epoll, EPOLL_CTL_ADD, Socket, &Event) != 0)
+	{
+		UE_LOG(LogHermesServer, Warning, TEXT("Unable to wait on Unix socket: %s"), UTF8_TO_TCHAR(strerror(errno)));
+	}
+}
+
+uint32 FHermesUnixSocketWaiter::Run()
+{
+	epoll_event Events[MAX_EVENTS_PER_WAIT];
+	while (!bStopping)
+	{
+		const int NumEvents = epoll_wait(Epoll, Events, MAX_EVENTS_PER_WAIT, -1);
+		if (NumEvents < 0 && errno != EINTR)
+		{
+			UE_LOG(LogHermesServer, Error, TEXT("Stopped waiting on Unix sockets, they'll be polled every tick: %s"),
+			       UTF8_TO_TCHAR(strerror(errno)));
+			break;
+		}
+
+		if (NumEvents > 0 && !bStopping)
+		{
+			Wakeup.Wake();
+		}
+	}
+
+	bWaiting = false;
+	return 0;
+}
+
+void FHermesUnixSocketWaiter::Stop()
+{
+	bStopping = true;
+	const uint64 Value = 1;
+	if (write(StopEvent, &Value, sizeof(Value)) < 0)
+	{
+		UE_LOG(LogHermesServer, Warning, TEXT("Unable to wake up the Unix socket thread: %s"),
+		       UTF8_TO_TCHAR(strerror(errno)));
+	}
+}
+
+static bool SetNonBlocking(int Socket)
+{
+	const int Flags = fcntl(Socket, F_GETFL, 0);
+	return Flags != -1 && fcntl(Socket, F_SETFL, Flags | O_NONBLOCK) != -1 && fcntl(Socket, F_SETFD, FD_CLOEXEC) != -1;
+}
+
+/** Make sure the directory exists, and that it's a real directory that only we have access to */
+static bool EnsurePrivateDirectory(const FString& Directory)
+{
+	const FTCHARToUTF8 DirectoryUtf8(*Directory);
+	if (mkdir(DirectoryUtf8.Get(), S_IRWXU) != 0 && errno != EEXIST)
+	{
+		UE_LOG(LogHermesServer, Error, TEXT("Unable to create %s: %s"), *Directory, UTF8_TO_TCHAR(strerror(errno)));
+		return false;
+	}
+
+	struct stat Stat;
+	if (lstat(DirectoryUtf8.Get(), &Stat) != 0 || !S_ISDIR(Stat.st_mode) || Stat.st_uid != getuid() ||
+		(Stat.st_mode & (S_IRWXG | S_IRWXO)) != 0)
+	{
+		UE_LOG(LogHermesServer, Error, TEXT("%s is not a directory that's private to the current user"), *Directory);
+		return false;
+	}
+	return true;
+}
+
+FHermesUnixSocketTransport::~FHermesUnixSocketTransport()
+{
+	Stop();
+}
+
+FString FHermesUnixSocketTransport::GetSocketPath(const FString& Scheme)
+{
+	const FString RuntimeDirectory = FPlatformMisc::GetEnvironmentVariable(TEXT("XDG_RUNTIME_DIR"));
+	const FString Directory = RuntimeDirectory.IsEmpty()
+		                          ? FString::Printf(TEXT("/tmp/hermes-%u"), static_cast<uint32>(getuid()))
+		                          : RuntimeDirectory / TEXT("hermes");
+	return Directory / Scheme + TEXT(".sock");
+}
+
+FName FHermesUnixSocketTransport::GetTransportName() const
+{
+	return TEXT("UnixSocket");
+}
+
+bool FHermesUnixSocketTransport::Start(IHermesRequestSink& InSink)
+{
+	// We don't know where to listen until we're given a scheme
+	Sink = &InSink;
+	Waiter = MakeUnique<FHermesUnixSocketWaiter>([this]
+	{
+		Tick();
+	});
+	return true;
+}
+
+void FHermesUnixSocketTransport::Stop()
+{
+	// Stopped first, so that nothing ticks us once the sockets are gone
+	Waiter.Reset();
+	CloseListener();
+	for (const FConnection& Connection : Connections)
+	{
+		close(Connection.Socket);
+	}
+	Connections.Reset();
+	Sink = nullptr;
+}
+
+bool FHermesUnixSocketTransport::IsEventDriven() const
+{
+	return Waiter.IsValid() && Waiter->IsWaiting();
+}
+
+bool FHermesUnixSocketTransport::SetScheme(const FString& Scheme)
+{
+	const FString Path = GetSocketPath(Scheme);
+	if (Path == SocketPath && ListenSocket != -1)
+	{
+		return true;
+	}
+
+	CloseListener();
+	if (!Listen(Path))
+	{
+		return false;
+	}
+
+	SocketPath = Path;
+	return true;
+}
+
+bool FHermesUnixSocketTransport::Listen(const FString& Path)
+{
+	if (!EnsurePrivateDirectory(FPaths::GetPath(Path)))
+	{
+		return false;
+	}
+
+	const FTCHARToUTF8 PathUtf8(*Path);
+	sockaddr_un Address = {};
+	Address.sun_family = AF_UNIX;
+	if (PathUtf8.Length() >= static_cast<int32>(sizeof(Address.sun_path)))
+	{
+		UE_LOG(LogHermesServer, Error, TEXT("Socket path %s is too long"), *Path);
+		return false;
+	}
+	FMemory::Memcpy(Address.sun_path, PathUtf8.Get(), PathUtf8.Length());
+
+	// A socket file that nobody is listening on is left over from a process that didn't shut down cleanly. If someone
+	// is listening, another editor (or game) is handling this scheme, and we don't want to steal its requests.
+	const int Probe = socket(AF_UNIX, SOCK_STREAM, 0);
+	const bool bInUse = Probe != -1 && connect(Probe, reinterpret_cast<const sockaddr*>(&Address), sizeof(Address)) == 0;
+	if (Probe != -1)
+	{
+		close(Probe);
+	}
+	if (bInUse)
+	{
+		UE_LOG(LogHermesServer, Error, TEXT("Another process is already listening on %s"), *Path);
+		return false;
+	}
+	unlink(PathUtf8.Get());
+
+	const int Socket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (Socket == -1)
+	{
+		UE_LOG(LogHermesServer, Error, TEXT("Unable to create socket: %s"), UTF8_TO_TCHAR(strerror(errno)));
+		return false;
+	}
+
+	if (!SetNonBlocking(Socket) || bind(Socket, reinterpret_cast<const sockaddr*>(&Address), sizeof(Address)) != 0 ||
+		listen(Socket, 16) != 0)
+	{
+		UE_LOG(LogHermesServer, Error, TEXT("Unable to listen on %s: %s"), *Path, UTF8_TO_TCHAR(strerror(errno)));
+		close(Socket);
+		return false;
+	}
+
+	UE_LOG(LogHermesServer, Verbose, TEXT("Listening on %s"), *Path);
+	ListenSocket = Socket;
+	if (Waiter.IsValid())
+	{
+		Waiter->Watch(Socket);
+	}
+	return true;
+}
+
+void FHermesUnixSocketTransport::CloseListener()
+{
+	if (ListenSocket == -1)
+	{
+		return;
+	}
+
+	close(ListenSocket);
+	ListenSocket = -1;
+	unlink(TCHAR_TO_UTF8(*SocketPath));
+	SocketPath.Reset();
+}
+
+void FHermesUnixSocketTransport::Tick()
+{
+	if (ListenSocket != -1)
+	{
+		AcceptConnections();
+	}
+
+	for (int32 Index = Connections.Num() - 1; Index >= 0; --Index)
+	{
+		FConnection& Connection = Connections[Index];
+		if (!Connection.bCloseAfterFlush)
+		{
+			// Even if the client is done sending, answer everything it sent us before closing
+			Connection.bCloseAfterFlush = !ReceiveFromConnection(Connection);
+			ProcessLines(Connection);
+		}
+
+		if (!FlushConnection(Connection) || (Connection.bCloseAfterFlush && Connection.SendBuffer.Num() == 0))
+		{
+			close(Connection.Socket);
+			Connections.RemoveAtSwap(Index);
+		}
+	}
+}
+
+void FHermesUnixSocketTransport::AcceptConnections()
+{
+	while (true)
+	{
+		const int Socket = accept(ListenSocket, nullptr, nullptr);
+		if (Socket == -1)
+		{
+			// Keep going unless there's nothing left to accept, we might not be woken up again for what's left
+			if (errno == EINTR || errno == ECONNABORTED)
+			{
+				continue;
+			}
+			return;
+		}
+
+		if (Connections.Num() >= MAX_CONNECTIONS || !SetNonBlocking(Socket))
+		{
+			UE_LOG(LogHermesServer, Warning, TEXT("Rejecting Unix socket connection, %d connections open"),
+			       Connections.Num());
+			close(Socket);
+			continue;
+		}
+
+		Connections.AddDefaulted_GetRef().Socket = Socket;
+		if (Waiter.IsValid())
+		{
+			Waiter->Watch(Socket);
+		}
+	}
+}
+
+bool FHermesUnixSocketTransport::ReceiveFromConnection(FConnection& Connection)
+{
+	uint8 Chunk[RECEIVE_CHUNK_SIZE];
+	while (true)
+	{
+		const ssize_t BytesRead = recv(Connection.Socket, Chunk, RECEIVE_CHUNK_SIZE, 0);
+		if (BytesRead > 0)
+		{
+			Connection.ReceiveBuffer.Append(Chunk, static_cast<int32>(BytesRead));
+			continue;
+		}
+
+		// Zero means the client shut down its end, anything but "try again later" means it's gone
+		return BytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+	}
+}
+
+bool FHermesUnixSocketTransport::FlushConnection(FConnection& Connection)
+{
+	while (Connection.SendBuffer.Num() > 0)
+	{
+		const ssize_t BytesSent = send(Connection.Socket, Connection.SendBuffer.GetData(), Connection.SendBuffer.Num(),
+		                               MSG_NOSIGNAL);
+		if (BytesSent < 0)
+		{
+			// The client not reading its responses fast enough isn't an error, try again next tick
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+		}
+
+		Connection.SendBuffer.RemoveAt(0, static_cast<int32>(BytesSent));
+	}
+
+	return true;
+}
+
+void FHermesUnixSocketTransport::ProcessLines(FConnection& Connection)
+{
+	int32 LineStart = 0;
+	for (int32 Index = 0; Index < Connection.ReceiveBuffer.Num(); ++Index)
+	{
+		if (Connection.ReceiveBuffer[Index] != '\n')
+		{
+			continue;
+		}
+
+		FUTF8ToTCHAR Conversion(reinterpret_cast<const ANSICHAR*>(Connection.ReceiveBuffer.GetData() + LineStart),
+		                        Index - LineStart);
+		const FString Path = FString(Conversion.Length(), Conversion.Get()).TrimEnd();
+		LineStart = Index + 1;
+		if (Path.IsEmpty())
+		{
+			continue;
+		}
+
+		// Whoever's on the other end of this is standing in for someone clicking a link
+		const FString Response = FString(LexToString(Sink->DispatchPath(Path, EHermesRequestPriority::Interactive))) +
+			TEXT("\n");
+		const FTCHARToUTF8 ResponseUtf8(*Response);
+		Connection.SendBuffer.Append(reinterpret_cast<const uint8*>(ResponseUtf8.Get()), ResponseUtf8.Length());
+	}
+	Connection.ReceiveBuffer.RemoveAt(0, LineStart);
+
+	if (Connection.ReceiveBuffer.Num() > MAX_LINE_SIZE)
+	{
+		UE_LOG(LogHermesServer, Warning, TEXT("Closing Unix socket connection that sent a line that's too long"));
+		Connection.ReceiveBuffer.Reset();
+		Connection.bCloseAfterFlush = true;
+	}
+}
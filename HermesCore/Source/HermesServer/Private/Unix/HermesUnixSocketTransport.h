@@ -0,0 +1,60 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#pragma once
+
+#include "HermesTransport.h"
+
+#include <CoreMinimal.h>
+
+class FHermesUnixSocketWaiter;
+
+/**
+ * Receives paths over a Unix domain socket whose name is derived from the URI scheme, which is how a URL handler on
+ * Unix-like platforms finds a running editor (the equivalent of the mailslot on Windows).
+ *
+ * Clients send one path per line, and get one line back per path with the outcome, e.g. "Dispatched" or "NoHandler".
+ * Only the current user can connect, the socket lives in a directory that's only accessible to them.
+ *
+ * The sockets are waited on by a background thread, so the transport is only ticked when one of them is ready.
+ */
+class FHermesUnixSocketTransport : public IHermesTransport
+{
+public:
+	virtual ~FHermesUnixSocketTransport() override;
+
+	/** Where we listen for the given scheme, this needs to match what the URL handler connects to */
+	static FString GetSocketPath(const FString& Scheme);
+
+public: // Implementation of IHermesTransport
+	virtual FName GetTransportName() const override;
+	virtual bool Start(IHermesRequestSink& InSink) override;
+	virtual void Stop() override;
+	virtual void Tick() override;
+	virtual bool IsEventDriven() const override;
+	virtual bool SetScheme(const FString& Scheme) override;
+
+private:
+	struct FConnection
+	{
+		int Socket = -1;
+		TArray<uint8> ReceiveBuffer;
+		TArray<uint8> SendBuffer;
+		/** Set once the client is done sending, we close the connection once it's been answered */
+		bool bCloseAfterFlush = false;
+	};
+
+	bool Listen(const FString& Path);
+	void CloseListener();
+	void AcceptConnections();
+	/** Returns false if the client is done sending */
+	static bool ReceiveFromConnection(FConnection& Connection);
+	/** Returns false if the connection should be closed immediately */
+	static bool FlushConnection(FConnection& Connection);
+	void ProcessLines(FConnection& Connection);
+
+	IHermesRequestSink* Sink = nullptr;
+	int ListenSocket = -1;
+	FString SocketPath;
+	TArray<FConnection> Connections;
+	/** Null if we couldn't start waiting on the sockets, in which case we're ticked like any other transport */
+	TUniquePtr<FHermesUnixSocketWaiter> Waiter;
+};
@@ -1,29 +1,96 @@
 // Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
 #include "GenericHermesServer.h"
+#include "HermesGameThreadWakeup.h"
+#include "HermesTransport.h"
 
+#include <Containers/Queue.h>
+#include <Features/IModularFeatures.h>
+#include <HAL/Runnable.h>
+#include <HAL/RunnableThread.h>
 #include <Interfaces/IPluginManager.h>
 #include <Misc/Paths.h>
 #include <Modules/ModuleManager.h>
 
+#include <atomic>
+
 #include <Windows/AllowWindowsPlatformTypes.h>
 
 #include "accctrl.h"
 #include "aclapi.h"
 
+/**
+ * Reads from the mailslot on a background thread, so that the transport is only ticked once a message has arrived. It
+ * blocks in ReadFile, and Stop wakes it up by sending a message of its own.
+ */
+class FWindowsMailslotReader : FRunnable
+{
+public:
+	FWindowsMailslotReader(HANDLE InMailslot, const FString& InMailslotName, TFunction<void()>&& OnMessage);
+	virtual ~FWindowsMailslotReader() override;
+
+	bool IsReading() const
+	{
+		return bReading;
+	}
+
+	/** Take the oldest message that's been read, returns false if there's none. Game thread only. */
+	bool Dequeue(FString& OutMessage)
+	{
+		return Messages.Dequeue(OutMessage);
+	}
+
+private: // Implementation of FRunnable
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+private:
+	HANDLE Mailslot;
+	FString MailslotName;
+	TQueue<FString, EQueueMode::Spsc> Messages;
+	std::atomic<bool> bReading{false};
+	std::atomic<bool> bStopping{false};
+	FHermesGameThreadWakeup Wakeup;
+	FRunnableThread* Thread = nullptr;
+};
+
+/**
+ * Receives paths from hermes_urls.exe, which the OS launches for our scheme, through a mailslot named after the scheme.
+ */
+struct FWindowsMailslotTransport : IHermesTransport
+{
+	virtual ~FWindowsMailslotTransport() override;
+
+public: // Implementation of IHermesTransport
+	virtual FName GetTransportName() const override final;
+	virtual bool Start(IHermesRequestSink& InSink) override final;
+	virtual void Stop() override final;
+	virtual void Tick() override final;
+	virtual bool IsEventDriven() const override final;
+	virtual bool SetScheme(const FString& Scheme) override final;
+
+private:
+	void CloseMailslot();
+
+	IHermesRequestSink* Sink = nullptr;
+	HANDLE ServerHandle = INVALID_HANDLE_VALUE;
+	/** Null if the reader thread couldn't be started, in which case we're ticked like any other transport */
+	TUniquePtr<FWindowsMailslotReader> Reader;
+};
+
 struct FWindowsHermesServerModule : FGenericHermesServer
 {
 private: // Implementation of IModuleInterface
+	virtual void StartupModule() override final;
 	virtual void ShutdownModule() override final;
 
-private: // Implementation of FTickableEditorObject
+private: // Implementation of FHermesServerTickable
 	virtual void Tick(float DeltaTime) override final;
 
 private: // Implementation of FGenericHermesServer
 	virtual bool RegisterScheme(const TCHAR* Scheme, bool bDebug) override final;
 	virtual void UnregisterScheme(const TCHAR* Scheme) override final;
 
-	FString ServerScheme;
-	HANDLE ServerHandle = INVALID_HANDLE_VALUE;
+	FWindowsMailslotTransport MailslotTransport;
 	FProcHandle RegistrationHandle;
 };
 
@@ -31,6 +98,9 @@ IMPLEMENT_MODULE(FWindowsHermesServerModule, HermesServer)
 
 // Max message size is around the maximum path size (32k), plus 256 bytes for scheme, host, and query string.
 static constexpr int32 MAX_MESSAGE_SIZE = 32 * 1024 + 256;
+// How long the reader thread waits for a message before checking whether it should stop. Stop normally wakes it up
+// right away, this is only in case that fails.
+static constexpr DWORD READ_TIMEOUT_MS = 5000;
 
 static FString GetHermesHandlerExe()
 {
@@ -182,10 +252,126 @@ FHermesSID HermesPrivate_GetCurrentUserSID()
 	return UserSID;
 }
 
-bool FWindowsHermesServerModule::RegisterScheme(const TCHAR* Scheme, bool bDebug)
+FWindowsMailslotReader::FWindowsMailslotReader(HANDLE InMailslot, const FString& InMailslotName,
+                                               TFunction<void()>&& OnMessage)
+	: Mailslot(InMailslot)
+	, MailslotName(InMailslotName)
+	, Wakeup(MoveTemp(OnMessage))
+{
+	bReading = true;
+	Thread = FRunnableThread::Create(this, TEXT("HermesMailslotReader"), 64 * 1024, TPri_BelowNormal);
+	if (Thread == nullptr)
+	{
+		UE_LOG(LogHermesServer, Warning, TEXT("Unable to start the mailslot thread, it'll be polled every tick"));
+		bReading = false;
+	}
+}
+
+FWindowsMailslotReader::~FWindowsMailslotReader()
+{
+	if (Thread != nullptr)
+	{
+		Thread->Kill(true);
+		delete Thread;
+		Thread = nullptr;
+	}
+}
+
+uint32 FWindowsMailslotReader::Run()
+{
+	TArray<UTF8CHAR> Data;
+	Data.SetNumUninitialized(MAX_MESSAGE_SIZE);
+	while (!bStopping)
+	{
+		DWORD BytesRead = 0;
+		if (!ReadFile(Mailslot, Data.GetData(), Data.Num(), &BytesRead, nullptr))
+		{
+			const DWORD Error = GetLastError();
+			if (Error == ERROR_SEM_TIMEOUT)
+			{
+				continue;
+			}
+
+			TCHAR ErrorMsg[1024];
+			FPlatformMisc::GetSystemErrorMessage(ErrorMsg, UE_ARRAY_COUNT(ErrorMsg), Error);
+			UE_LOG(LogHermesServer, Error, TEXT("Unable to read from mailslot, it'll be polled every tick: %s"),
+			       ErrorMsg);
+			break;
+		}
+
+		if (bStopping)
+		{
+			break;
+		}
+
+		TStringConversion<FUTF8ToTCHAR_Convert> Conversion((FUTF8ToTCHAR_Convert::FromType*)Data.GetData(), BytesRead);
+		Messages.Enqueue(FString(Conversion.Length(), Conversion.Get()));
+		Wakeup.Wake();
+	}
+
+	bReading = false;
+	return 0;
+}
+
+void FWindowsMailslotReader::Stop()
 {
-	checkf(ServerHandle == INVALID_HANDLE_VALUE,
-	       TEXT("Called RegisterScheme(\"%s\"), but mailslot already initialized for %s://"), Scheme, *ServerScheme);
+	bStopping = true;
+
+	// Any message gets ReadFile to return, and the reader checks whether it's stopping before looking at it
+	HANDLE Client = CreateFile(*MailslotName, GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+	                           FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (Client != INVALID_HANDLE_VALUE)
+	{
+		const uint8 Nudge = 0;
+		DWORD BytesWritten = 0;
+		WriteFile(Client, &Nudge, sizeof(Nudge), &BytesWritten, nullptr);
+		CloseHandle(Client);
+	}
+}
+
+FWindowsMailslotTransport::~FWindowsMailslotTransport()
+{
+	Stop();
+}
+
+FName FWindowsMailslotTransport::GetTransportName() const
+{
+	return TEXT("Mailslot");
+}
+
+bool FWindowsMailslotTransport::Start(IHermesRequestSink& InSink)
+{
+	// The mailslot is named after the scheme, so it's not created until we're given one
+	Sink = &InSink;
+	return true;
+}
+
+void FWindowsMailslotTransport::Stop()
+{
+	CloseMailslot();
+	Sink = nullptr;
+}
+
+bool FWindowsMailslotTransport::IsEventDriven() const
+{
+	// There's nothing to read until we're given a scheme
+	return ServerHandle == INVALID_HANDLE_VALUE || (Reader.IsValid() && Reader->IsReading());
+}
+
+void FWindowsMailslotTransport::CloseMailslot()
+{
+	// The reader has to be done with the handle before it's closed
+	Reader.Reset();
+	if (ServerHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(ServerHandle);
+		ServerHandle = INVALID_HANDLE_VALUE;
+	}
+}
+
+bool FWindowsMailslotTransport::SetScheme(const FString& Scheme)
+{
+	CloseMailslot();
 
 	SECURITY_ATTRIBUTES SecurityAttributes = {};
 	SecurityAttributes.nLength = sizeof(SECURITY_ATTRIBUTES);
@@ -208,9 +394,9 @@ bool FWindowsHermesServerModule::RegisterScheme(const TCHAR* Scheme, bool bDebug
 		}
 	}
 
-	const FString MailslotName = FString::Printf(TEXT("\\\\.\\mailslot\\bitSpatter\\Hermes\\%s"), Scheme);
+	const FString MailslotName = FString::Printf(TEXT("\\\\.\\mailslot\\bitSpatter\\Hermes\\%s"), *Scheme);
 	UE_LOG(LogHermesServer, Verbose, TEXT("Attempting to create Mailslot %s"), *MailslotName);
-	ServerHandle = CreateMailslot(*MailslotName, MAX_MESSAGE_SIZE, 0, &SecurityAttributes);
+	ServerHandle = CreateMailslot(*MailslotName, MAX_MESSAGE_SIZE, READ_TIMEOUT_MS, &SecurityAttributes);
 	if (ServerHandle == INVALID_HANDLE_VALUE)
 	{
 		TCHAR ErrorMsg[1024];
@@ -219,6 +405,76 @@ bool FWindowsHermesServerModule::RegisterScheme(const TCHAR* Scheme, bool bDebug
 		return false;
 	}
 
+	Reader = MakeUnique<FWindowsMailslotReader>(ServerHandle, MailslotName, [this]
+	{
+		Tick();
+	});
+	return true;
+}
+
+void FWindowsMailslotTransport::Tick()
+{
+	if (ServerHandle == INVALID_HANDLE_VALUE)
+	{
+		return;
+	}
+
+	if (Reader.IsValid())
+	{
+		FString Message;
+		while (Reader->Dequeue(Message))
+		{
+			Sink->DispatchPath(Message, EHermesRequestPriority::Interactive);
+		}
+
+		// If the reader gave up, we fall back to polling the mailslot ourselves
+		if (Reader->IsReading())
+		{
+			return;
+		}
+	}
+
+	// Immediate timeout (0ms)
+	DWORD ReadTimeout = 0;
+	// No maximum message size
+	const LPDWORD MaximumMessageSizePtr = nullptr;
+	// We don't care about how many are left, we only process one each tick
+	const LPDWORD NumMessagesRemainingPtr = nullptr;
+	DWORD PendingMessageSize = 0;
+	BOOL Success = GetMailslotInfo(
+		ServerHandle,
+		MaximumMessageSizePtr,
+		&PendingMessageSize,
+		NumMessagesRemainingPtr,
+		&ReadTimeout
+	);
+	if (!Success || PendingMessageSize == MAILSLOT_NO_MESSAGE)
+	{
+		return;
+	}
+
+	TArray<UTF8CHAR> Data;
+	Data.SetNumUninitialized(PendingMessageSize);
+
+	DWORD BytesRead = 0;
+	Success = ReadFile(ServerHandle, Data.GetData(), PendingMessageSize, &BytesRead, nullptr);
+	if (Success)
+	{
+		TStringConversion<FUTF8ToTCHAR_Convert> Conversion((FUTF8ToTCHAR_Convert::FromType*)Data.GetData(), BytesRead);
+		const FString StrData(Conversion.Length(), Conversion.Get());
+		Sink->DispatchPath(StrData, EHermesRequestPriority::Interactive);
+	}
+	else
+	{
+		TCHAR ErrorMsg[1024];
+		FPlatformMisc::GetSystemErrorMessage(ErrorMsg, UE_ARRAY_COUNT(ErrorMsg), 0);
+		UE_LOG(LogHermesServer, Error, TEXT("Unable to read message of %i bytes from mailslot: %s"), PendingMessageSize,
+		       ErrorMsg);
+	}
+}
+
+bool FWindowsHermesServerModule::RegisterScheme(const TCHAR* Scheme, bool bDebug)
+{
 	const FString EditorPath = FPaths::ConvertRelativePathToFull(
 		FPlatformProcess::GetModulesDirectory() / FPlatformProcess::ExecutableName(false));
 	const TCHAR* RegisterArgument = bDebug ? TEXT("--debug register --register-with-debugging") : TEXT("register");
@@ -234,26 +490,16 @@ bool FWindowsHermesServerModule::RegisterScheme(const TCHAR* Scheme, bool bDebug
 	                                                  nullptr, 0, nullptr, nullptr, nullptr);
 	if (!RegistrationHandle.IsValid())
 	{
-		CloseHandle(ServerHandle);
-		ServerHandle = INVALID_HANDLE_VALUE;
 		UE_LOG(LogHermesServer, Error, TEXT("Unable to register %s:// using %s %s"), Scheme, *HermesHandlerExe,
 		       *Arguments);
 		return false;
 	}
 
-	ServerScheme = Scheme;
 	return true;
 }
 
 void FWindowsHermesServerModule::UnregisterScheme(const TCHAR* Scheme)
 {
-	if (ServerScheme == Scheme && ServerHandle != INVALID_HANDLE_VALUE)
-	{
-		CloseHandle(ServerHandle);
-		ServerScheme = TEXT("");
-		ServerHandle = INVALID_HANDLE_VALUE;
-	}
-
 	if (RegistrationHandle.IsValid())
 	{
 		FPlatformProcess::WaitForProc(RegistrationHandle);
@@ -274,16 +520,25 @@ void FWindowsHermesServerModule::UnregisterScheme(const TCHAR* Scheme)
 	}
 }
 
-void FWindowsHermesServerModule::ShutdownModule()
+void FWindowsHermesServerModule::StartupModule()
 {
-	if (ServerHandle != INVALID_HANDLE_VALUE)
-	{
-		CloseHandle(ServerHandle);
-		ServerScheme = TEXT("");
-		ServerHandle = INVALID_HANDLE_VALUE;
-	}
+#if WITH_EDITOR
+	// Registered before the generic startup, so the mailslot exists by the time we register the scheme with the OS.
+	// hermes_urls.exe only ever writes to the editor's mailslot, so game builds get their links through the loopback
+	// server instead.
+	IModularFeatures::Get().RegisterModularFeature(IHermesTransport::GetModularFeatureName(), &MailslotTransport);
+#endif
+
+	FGenericHermesServer::StartupModule();
+}
 
+void FWindowsHermesServerModule::ShutdownModule()
+{
 	FGenericHermesServer::ShutdownModule();
+
+#if WITH_EDITOR
+	IModularFeatures::Get().UnregisterModularFeature(IHermesTransport::GetModularFeatureName(), &MailslotTransport);
+#endif
 }
 
 void FWindowsHermesServerModule::Tick(float DeltaTime)
@@ -315,44 +570,6 @@ void FWindowsHermesServerModule::Tick(float DeltaTime)
 			RegistrationHandle.Reset();
 		}
 	}
-
-	// Immediate timeout (0ms)
-	DWORD ReadTimeout = 0;
-	// No maximum message size
-	const LPDWORD MaximumMessageSizePtr = nullptr;
-	// We don't care about how many are left, we only process one each tick
-	const LPDWORD NumMessagesRemainingPtr = nullptr;
-	DWORD PendingMessageSize = 0;
-	BOOL Success = GetMailslotInfo(
-		ServerHandle,
-		MaximumMessageSizePtr,
-		&PendingMessageSize,
-		NumMessagesRemainingPtr,
-		&ReadTimeout
-	);
-	if (!Success || PendingMessageSize == MAILSLOT_NO_MESSAGE)
-	{
-		return;
-	}
-
-	TArray<UTF8CHAR> Data;
-	Data.SetNumUninitialized(PendingMessageSize);
-
-	DWORD BytesRead = 0;
-	Success = ReadFile(ServerHandle, Data.GetData(), PendingMessageSize, &BytesRead, nullptr);
-	if (Success)
-	{
-		TStringConversion<FUTF8ToTCHAR_Convert> Conversion((FUTF8ToTCHAR_Convert::FromType*)Data.GetData(), BytesRead);
-		const FString StrData(Conversion.Length(), Conversion.Get());
-		HandlePath(StrData);
-	}
-	else
-	{
-		TCHAR ErrorMsg[1024];
-		FPlatformMisc::GetSystemErrorMessage(ErrorMsg, UE_ARRAY_COUNT(ErrorMsg), 0);
-		UE_LOG(LogHermesServer, Error, TEXT("Unable to read message of %i bytes from mailslot: %s"), PendingMessageSize,
-		       ErrorMsg);
-	}
 }
 
 #include <Windows/HideWindowsPlatformTypes.h>
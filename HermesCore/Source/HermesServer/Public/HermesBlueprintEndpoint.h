@@ -0,0 +1,40 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#pragma once
+
+#include <CoreMinimal.h>
+#include <UObject/Object.h>
+#include "HermesBlueprintEndpoint.generated.h"
+
+/**
+ * Base class for endpoints implemented in Blueprints. Create a Blueprint deriving from this, set its EndpointName, and
+ * implement HandleRequest -- there's no need to load it at startup or register it anywhere.
+ *
+ * The endpoint name is exported as an asset registry tag, so Hermes knows which Blueprint handles which endpoint without
+ * loading any of them. A Blueprint is only loaded (asynchronously) the first time its endpoint is requested, and
+ * requests that arrive while it's loading are dispatched once it's ready. A new instance handles each request.
+ */
+UCLASS(Abstract, Blueprintable, meta = (DisplayName = "Hermes Endpoint"))
+class UHermesBlueprintEndpoint : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	/** The endpoint this handles, i.e. "foo" for hermes URLs like project://foo/some/path?bar=baz */
+	UPROPERTY(EditDefaultsOnly, AssetRegistrySearchable, Category = "Hermes")
+	FName EndpointName;
+
+	/**
+	 * Called for every request for this endpoint.
+	 *
+	 * @param Path the part of the URL after the endpoint name, e.g. "/some/path"
+	 * @param QueryParams the query parameters of the URL, with lowercase keys, e.g. "bar" => "baz"
+	 */
+	UFUNCTION(BlueprintImplementableEvent, Category = "Hermes")
+	void HandleRequest(const FString& Path, const TMap<FString, FString>& QueryParams);
+
+	/**
+	 * Endpoints run in the context of the editor world (or the game world outside of the editor), so they can use nodes
+	 * that need a world
+	 */
+	virtual UWorld* GetWorld() const override;
+};
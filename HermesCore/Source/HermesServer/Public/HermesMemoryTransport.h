@@ -0,0 +1,48 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#pragma once
+
+#include "HermesServer.h"
+
+/** What happened to a URI that was sent through the memory transport */
+struct FHermesMemoryTransportResult
+{
+	FString Uri;
+	EHermesDispatchResult Result = EHermesDispatchResult::NoHandler;
+};
+
+/**
+ * An in-process stand-in for the OS URL handler, for automation tests. When it's enabled (with -HermesMemoryTransport
+ * or the "Use Memory Transport" setting), the scheme is registered with it instead of with the OS, and URIs sent
+ * through it are dispatched in the order they were sent, without any other process being involved.
+ *
+ * All methods must be called on the game thread.
+ *
+ * @see IHermesServerModule::GetMemoryTransport
+ */
+struct IHermesMemoryTransport
+{
+	virtual ~IHermesMemoryTransport()
+	{
+	}
+
+	/** The scheme the server has registered, empty until the server has finished starting up */
+	virtual FString GetRegisteredScheme() const = 0;
+
+	/**
+	 * Queue up a URI, to be dispatched on the next tick or by Flush. Like the OS handler, a full URI like
+	 * "hunreal://content/Game/Maps/Entry" is only accepted if its scheme is the registered one, while a bare path
+	 * like "content/Game/Maps/Entry" is always accepted.
+	 *
+	 * @return false if the URI's scheme isn't registered, in which case it's not queued
+	 */
+	virtual bool Send(const FString& Uri, EHermesRequestPriority Priority = EHermesRequestPriority::Interactive) = 0;
+
+	/** Dispatch everything that's been sent so far, in the order it was sent */
+	virtual void Flush() = 0;
+
+	/** How many URIs have been sent but not dispatched yet */
+	virtual int32 GetNumPending() const = 0;
+
+	/** Returns what happened to every URI that's been dispatched since the last call, in the order they were sent */
+	virtual TArray<FHermesMemoryTransportResult> ConsumeResults() = 0;
+};
@@ -0,0 +1,122 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#pragma once
+
+// This header doesn't depend on the engine, so that tools that deal with Hermes links outside the editor (like
+// Tools/HermesLinkResolver) split them up exactly the same way the server does.
+
+namespace HermesPathParser
+{
+	/** A range of characters in a string that's owned by someone else */
+	template <typename CharType>
+	struct TRange
+	{
+		const CharType* Begin = nullptr;
+		const CharType* End = nullptr;
+
+		int Len() const
+		{
+			return static_cast<int>(End - Begin);
+		}
+
+		bool IsEmpty() const
+		{
+			return Begin == End;
+		}
+	};
+
+	/** The components of a path like "/endpoint/some/path?key=value&flag" */
+	template <typename CharType>
+	struct TParsedPath
+	{
+		/** The first path component, which decides which endpoint handles the path */
+		TRange<CharType> Endpoint;
+		/** Everything after the endpoint up to the query string, including the leading slash. Still URL encoded. */
+		TRange<CharType> Path;
+		/** Everything after the '?', empty if there is no query string. Still URL encoded. */
+		TRange<CharType> Query;
+	};
+
+	template <typename CharType>
+	const CharType* Find(const CharType* Begin, const CharType* End, CharType Character)
+	{
+		while (Begin != End && *Begin != Character)
+		{
+			++Begin;
+		}
+		return Begin;
+	}
+
+	/**
+	 * Skip past the "scheme://" of a full URI, if there is one. The server is only ever handed the part after it, but
+	 * tools usually start out with the whole link.
+	 */
+	template <typename CharType>
+	const CharType* SkipScheme(const CharType* Begin, const CharType* End)
+	{
+		for (const CharType* Character = Begin; Character != End; ++Character)
+		{
+			if (*Character == CharType(':'))
+			{
+				return End - Character >= 3 && Character[1] == CharType('/') && Character[2] == CharType('/')
+					       ? Character + 3
+					       : Begin;
+			}
+			if (*Character == CharType('/') || *Character == CharType('?'))
+			{
+				break;
+			}
+		}
+		return Begin;
+	}
+
+	/** Split a path into the endpoint id (the first path component), the endpoint-specific subpath, and the query */
+	template <typename CharType>
+	TParsedPath<CharType> Split(const CharType* Begin, const CharType* End)
+	{
+		TParsedPath<CharType> Parsed;
+
+		if (Begin != End && *Begin == CharType('/'))
+		{
+			++Begin;
+		}
+
+		// If there's no specific path underneath the endpoint, the handler just gets an empty path
+		Parsed.Endpoint.Begin = Begin;
+		Parsed.Endpoint.End = Find(Begin, End, CharType('/'));
+		// Query strings can follow the endpoint directly, e.g. "/endpoint?key=value"
+		const CharType* QueryStart = Find(Begin, Parsed.Endpoint.End, CharType('?'));
+		if (QueryStart != Parsed.Endpoint.End)
+		{
+			Parsed.Endpoint.End = QueryStart;
+		}
+
+		Parsed.Path.Begin = Parsed.Endpoint.End;
+		Parsed.Path.End = Find(Parsed.Path.Begin, End, CharType('?'));
+
+		Parsed.Query.Begin = Parsed.Path.End != End ? Parsed.Path.End + 1 : End;
+		Parsed.Query.End = End;
+		return Parsed;
+	}
+
+	/**
+	 * Call Visitor(Key, Value) with each of the '&'-separated parameters in a query string. Parameters without a '='
+	 * get an empty value, and empty parameters are skipped. Keys and values are still URL encoded.
+	 */
+	template <typename CharType, typename VisitorType>
+	void ForEachQueryParameter(const TRange<CharType>& Query, VisitorType&& Visitor)
+	{
+		const CharType* ParameterBegin = Query.Begin;
+		while (ParameterBegin != Query.End)
+		{
+			const CharType* ParameterEnd = Find(ParameterBegin, Query.End, CharType('&'));
+			if (ParameterBegin != ParameterEnd)
+			{
+				const CharType* Equals = Find(ParameterBegin, ParameterEnd, CharType('='));
+				TRange<CharType> Key{ParameterBegin, Equals};
+				TRange<CharType> Value{Equals != ParameterEnd ? Equals + 1 : ParameterEnd, ParameterEnd};
+				Visitor(Key, Value);
+			}
+			ParameterBegin = ParameterEnd != Query.End ? ParameterEnd + 1 : Query.End;
+		}
+	}
+}
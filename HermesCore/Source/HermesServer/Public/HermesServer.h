@@ -3,12 +3,124 @@
 
 #include <CoreMinimal.h>
 #include <Modules/ModuleInterface.h>
+#include <Stats/Stats.h>
+
+struct IHermesMemoryTransport;
 
 DECLARE_LOG_CATEGORY_EXTERN(LogHermesServer, Log, All);
+/** Shown by "stat HermesServer", endpoints can add their own stats to it too */
+DECLARE_STATS_GROUP(TEXT("HermesServer"), STATGROUP_HermesServer, STATCAT_Advanced);
 
 typedef TMap<FString, FString> FHermesQueryParamsMap;
 DECLARE_DELEGATE_TwoParams(FHermesOnRequest, const FString& /* Path */, const FHermesQueryParamsMap& /* QueryParams */);
 
+/** A single request for an endpoint, i.e. the parts of the URI that follow the endpoint id */
+struct FHermesRequest
+{
+	FString Path;
+	FHermesQueryParamsMap QueryParams;
+};
+DECLARE_DELEGATE_OneParam(FHermesOnCoalescedRequests, const TArray<FHermesRequest>& /* Requests */);
+
+/** How urgently a request needs to be handled, from most to least urgent */
+enum class EHermesRequestPriority : uint8
+{
+	/** Someone clicked a link and is waiting for the editor to react */
+	Interactive,
+	/** A tool or script is driving the editor */
+	Scripted,
+	/** Work that can be done whenever the editor has time to spare */
+	Background,
+
+	Num
+};
+
+inline const TCHAR* LexToString(EHermesRequestPriority Priority)
+{
+	switch (Priority)
+	{
+		case EHermesRequestPriority::Interactive:
+			return TEXT("Interactive");
+		case EHermesRequestPriority::Scripted:
+			return TEXT("Scripted");
+		case EHermesRequestPriority::Background:
+			return TEXT("Background");
+		default:
+			return TEXT("Invalid");
+	}
+}
+
+/** What happened to a path that was handed to the server, e.g. by a transport */
+enum class EHermesDispatchResult : uint8
+{
+	/** The path was handed to the endpoint's handler */
+	Dispatched,
+	/** There was no endpoint registered for the path */
+	NoHandler,
+	/** The path was queued, and will be dispatched on a later tick (possibly as part of a coalesced batch) */
+	Queued,
+	/** An identical path was handled within the duplicate request window, so this one was dropped */
+	Duplicate,
+	/** The queue for the request's priority was full, so it was rejected */
+	Rejected,
+	/** The request was queued, but was thrown out before it could be dispatched */
+	Dropped,
+};
+
+inline const TCHAR* LexToString(EHermesDispatchResult Result)
+{
+	switch (Result)
+	{
+		case EHermesDispatchResult::Dispatched:
+			return TEXT("Dispatched");
+		case EHermesDispatchResult::NoHandler:
+			return TEXT("NoHandler");
+		case EHermesDispatchResult::Queued:
+			return TEXT("Queued");
+		case EHermesDispatchResult::Duplicate:
+			return TEXT("Duplicate");
+		case EHermesDispatchResult::Rejected:
+			return TEXT("Rejected");
+		case EHermesDispatchResult::Dropped:
+			return TEXT("Dropped");
+		default:
+			return TEXT("Invalid");
+	}
+}
+
+/** Add the files that a request will read once it's dispatched to OutFilenames, so that they can be read ahead of time */
+DECLARE_DELEGATE_TwoParams(FHermesOnPrefetch, const FHermesRequest& /* Request */, TArray<FString>& /* OutFilenames */);
+
+/** Optional settings for how requests for an endpoint are dispatched */
+struct FHermesEndpointOptions
+{
+	/**
+	 * Requests for this endpoint are never handled more urgently than this, regardless of how urgent the sender says
+	 * they are. E.g. an endpoint that kicks off a long-running job might want to use Background.
+	 */
+	EHermesRequestPriority Priority = EHermesRequestPriority::Interactive;
+
+	/**
+	 * How many milliseconds the handler may take before it's reported as a hitch, with a sample of the game thread's
+	 * callstack. 0 uses the "Handler Time Budget" from the plugin settings.
+	 */
+	float TimeBudgetMs = 0.0f;
+
+	/**
+	 * Hold on to requests that arrive during a Play-In-Editor or Simulate session, and dispatch them once it ends. Use
+	 * this for endpoints that open editors, move windows around or otherwise get in the way of a running game.
+	 */
+	bool bDeferDuringPIE = false;
+
+	/**
+	 * Bind this for endpoints whose requests are slow the first time because of what they read from disk. Hermes then
+	 * keeps a decaying history of how often each of the endpoint's paths is requested, and during idle time after
+	 * startup it reads the files that the most requested ones need into the OS file cache, within the "Prefetch"
+	 * budget in the plugin settings.
+	 */
+	FHermesOnPrefetch Prefetch;
+};
+
 struct IHermesServerModule : IModuleInterface
 {
 	/**
@@ -17,9 +129,25 @@ struct IHermesServerModule : IModuleInterface
 	 *
 	 * @param Endpoint an identifier for your endpoint, must be unique
 	 * @param Delegate the callback that is invoked when there's an URI opened
+	 * @param Options controls how requests for this endpoint are dispatched
 	 * @see Unregister
 	 */
-	virtual void Register(FName Endpoint, FHermesOnRequest Delegate) = 0;
+	virtual void Register(FName Endpoint, FHermesOnRequest Delegate,
+	                      const FHermesEndpointOptions& Options = FHermesEndpointOptions()) = 0;
+
+	/**
+	 * Register a handler for a specific endpoint that opts into coalescing. Rather than being invoked once per request,
+	 * requests are held for a short window (see the "Coalescing Window" setting) and then passed to the handler as a
+	 * single batch, in the order they arrived. This lets e.g. a burst of links be handled with a single UI update.
+	 *
+	 * @param Endpoint an identifier for your endpoint, must be unique
+	 * @param Delegate the callback that is invoked with every request received during the window
+	 * @param Options controls how requests for this endpoint are dispatched
+	 * @see Register
+	 * @see Unregister
+	 */
+	virtual void RegisterCoalescing(FName Endpoint, FHermesOnCoalescedRequests Delegate,
+	                                const FHermesEndpointOptions& Options = FHermesEndpointOptions()) = 0;
 
 	/**
 	* Unregister a handler for a specific endpoint. Will ensure if the endpoint hasn't been unregistered
@@ -36,4 +164,20 @@ struct IHermesServerModule : IModuleInterface
 	 * @param Path a path that is passed to the endpoint, can be empty
 	 */
 	virtual FString GetUri(FName Endpoint, const FString& Path = TEXT("")) = 0;
+
+	/**
+	 * Record how long part of a module's startup took, so that Hermes.StartupCost can show what Hermes adds to editor
+	 * boot time. Work that's put off until it's first needed should be reported too, as deferred.
+	 *
+	 * @param What a short description, e.g. "HermesContentEndpoint.StartupModule"
+	 * @param Seconds how long it took
+	 * @param bDeferred true if it happened after the editor finished starting up
+	 */
+	virtual void ReportStartupCost(const FString& What, double Seconds, bool bDeferred = false) = 0;
+
+	/**
+	 * The in-process transport that automation tests send URIs through, or nullptr unless it's been enabled with
+	 * -HermesMemoryTransport or the "Use Memory Transport" setting.
+	 */
+	virtual IHermesMemoryTransport* GetMemoryTransport() = 0;
 };
@@ -0,0 +1,83 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+#pragma once
+
+#include "HermesServer.h"
+
+#include <Features/IModularFeature.h>
+
+/**
+ * Where a transport delivers the paths it receives. Every transport feeds the same sink, so requests go through the
+ * same duplicate filtering, priority queues and journal no matter how they arrived.
+ */
+struct IHermesRequestSink
+{
+	virtual ~IHermesRequestSink()
+	{
+	}
+
+	/**
+	 * Dispatch a path to the endpoint it's for. Must be called on the game thread.
+	 *
+	 * @param FullPath the path, starting with the endpoint id, e.g. "content/Game/Maps/Entry"
+	 * @param Priority how urgent the sender says the request is, the endpoint might lower it
+	 */
+	virtual EHermesDispatchResult DispatchPath(const FString& FullPath, EHermesRequestPriority Priority) = 0;
+};
+
+/**
+ * An interface for modular feature implementations that receive paths from somewhere outside the editor, e.g. from the
+ * OS URL handler or from a socket. Any number of transports can be active at once, the server starts every transport
+ * that's registered (including ones registered after startup), and stops them when they're unregistered.
+ *
+ * All methods are called on the game thread.
+ */
+struct IHermesTransport : IModularFeature
+{
+	virtual ~IHermesTransport()
+	{
+	}
+
+	/**
+	 * Feature name -- use this to register an implementation of IHermesTransport through IModularFeatures.
+	 *
+	 * @see IModularFeatures
+	 */
+	static FName GetModularFeatureName()
+	{
+		static FName HermesTransportFeatureName(TEXT("HermesTransport"));
+		return HermesTransportFeatureName;
+	}
+
+	/** A short name for this transport, used in logs */
+	virtual FName GetTransportName() const = 0;
+
+	/**
+	 * Start receiving paths, and deliver them to the given sink. The sink outlives the transport, or at least until
+	 * Stop has been called. Return false if the transport couldn't be started, in which case it won't be ticked.
+	 */
+	virtual bool Start(IHermesRequestSink& Sink) = 0;
+	/** Stop receiving paths, and release anything that was acquired by Start or SetScheme */
+	virtual void Stop() = 0;
+	/** Receive & dispatch any pending paths. Called every tick unless the transport is event driven, must never block. */
+	virtual void Tick() = 0;
+
+	/**
+	 * Return true if the transport gets itself onto the game thread when something arrives (e.g. by waiting on a
+	 * background thread and scheduling a game thread task), rather than relying on being ticked. Outside of the editor,
+	 * the server doesn't tick at all while every transport is event driven and there's nothing queued.
+	 */
+	virtual bool IsEventDriven() const
+	{
+		return false;
+	}
+
+	/**
+	 * Called after Start, and whenever the URI scheme we handle changes, for transports whose address depends on the
+	 * scheme (e.g. because that's how the OS URL handler finds us). Returns false if the transport can't receive links for
+	 * the scheme, in which case the scheme isn't registered with the OS URL handler.
+	 */
+	virtual bool SetScheme(const FString& Scheme)
+	{
+		return true;
+	}
+};
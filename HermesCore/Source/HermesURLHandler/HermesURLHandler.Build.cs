@@ -8,7 +8,15 @@ public class HermesURLHandler : ModuleRules
     {
         Type = ModuleType.External;
 
-		RuntimeDependencies.Add(Path.Combine("$(BinaryOutputDir)", "hermes_urls.exe"), Path.Combine(ModuleDirectory, "hermes_urls-win64.exe"));
-		RuntimeDependencies.Add(Path.Combine("$(BinaryOutputDir)", "hermes_urls.pdb"), Path.Combine(ModuleDirectory, "hermes_urls-win64.pdb"));
+		if (Target.Platform == UnrealTargetPlatform.Win64)
+		{
+			RuntimeDependencies.Add(Path.Combine("$(BinaryOutputDir)", "hermes_urls.exe"), Path.Combine(ModuleDirectory, "hermes_urls-win64.exe"));
+			RuntimeDependencies.Add(Path.Combine("$(BinaryOutputDir)", "hermes_urls.pdb"), Path.Combine(ModuleDirectory, "hermes_urls-win64.pdb"));
+		}
+		else if (Target.Platform == UnrealTargetPlatform.Linux)
+		{
+			// Built from Linux/HermesURLHandler.cpp by Linux/build.sh
+			RuntimeDependencies.Add(Path.Combine("$(BinaryOutputDir)", "hermes_urls"), Path.Combine(ModuleDirectory, "hermes_urls-linux"));
+		}
 	}
 }
@@ -0,0 +1,355 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+//
+// The URL handler for Linux, i.e. what the desktop runs when a link with our scheme is opened. It forwards the link to
+// a running editor through the Unix domain socket that HermesServer listens on, or to a running development game build
+// if no editor is listening. If neither is, it spools the link for the next editor that comes up, and launches one
+// unless another handler already has. The editor registers it for the scheme through an XDG desktop entry.
+//
+// Usage: hermes_urls [--debug] [--timeout-ms=<ms>] <scheme> <editor> <project> <uri>
+//
+// This runs for every link that's clicked, so it sticks to libc and does as little as possible before the write. It
+// doesn't depend on the engine, and the plugin ships it prebuilt as ../hermes_urls-linux, which build.sh rebuilds.
+
+#include "../../HermesServer/Public/HermesPathParser.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+/** How long to keep trying when the editor is too busy to accept the connection, before giving up on it */
+static constexpr int DEFAULT_TIMEOUT_MS = 500;
+/** How long to wait between attempts to connect to a busy editor */
+static constexpr int RETRY_INTERVAL_MS = 5;
+
+static bool GDebug = false;
+
+static double GetMilliseconds()
+{
+	timespec Now;
+	clock_gettime(CLOCK_MONOTONIC, &Now);
+	return Now.tv_sec * 1000.0 + Now.tv_nsec / 1000000.0;
+}
+
+static void DebugLog(const char* Format, const char* Argument, double StartTime)
+{
+	if (GDebug)
+	{
+		fprintf(stderr, "hermes_urls: [%.3f ms] ", GetMilliseconds() - StartTime);
+		fprintf(stderr, Format, Argument);
+		fputc('\n', stderr);
+	}
+}
+
+/** Game builds listen under the scheme with this appended, see FGenericHermesServer::GetTransportScheme */
+static constexpr const char* GAME_SCHEME_SUFFIX = "-game";
+
+/** Build the socket path the same way FHermesUnixSocketTransport::GetSocketPath does, returns false if it's too long */
+static bool GetSocketAddress(const char* Scheme, sockaddr_un& OutAddress, char* OutDirectory, size_t DirectorySize)
+{
+	const char* RuntimeDirectory = getenv("XDG_RUNTIME_DIR");
+	const int DirectoryLength = RuntimeDirectory != nullptr && RuntimeDirectory[0] != '\0'
+		                            ? snprintf(OutDirectory, DirectorySize, "%s/hermes", RuntimeDirectory)
+		                            : snprintf(OutDirectory, DirectorySize, "/tmp/hermes-%u",
+		                                       static_cast<unsigned>(getuid()));
+	if (DirectoryLength < 0 || static_cast<size_t>(DirectoryLength) >= DirectorySize)
+	{
+		return false;
+	}
+
+	OutAddress = {};
+	OutAddress.sun_family = AF_UNIX;
+	const int PathLength = snprintf(OutAddress.sun_path, sizeof(OutAddress.sun_path), "%s/%s.sock", OutDirectory,
+	                                Scheme);
+	return PathLength > 0 && static_cast<size_t>(PathLength) < sizeof(OutAddress.sun_path);
+}
+
+/**
+ * Make sure the directory exists, and that it's private to the user. The editor only listens & reads the spool in a
+ * directory like that, anything else could be someone else's socket that's trying to catch our links.
+ */
+static bool EnsurePrivateDirectory(const char* Directory)
+{
+	struct stat Stat;
+	return (mkdir(Directory, S_IRWXU) == 0 || errno == EEXIST) && lstat(Directory, &Stat) == 0 &&
+		S_ISDIR(Stat.st_mode) && Stat.st_uid == getuid() && (Stat.st_mode & (S_IRWXG | S_IRWXO)) == 0;
+}
+
+/**
+ * Connect to the editor listening on the socket. Returns -1 right away if nobody is listening, and only keeps trying
+ * (for up to TimeoutMs) if someone is, but their backlog is full.
+ */
+static int Connect(const sockaddr_un& Address, int TimeoutMs, double StartTime)
+{
+	while (true)
+	{
+		const int Socket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (Socket == -1)
+		{
+			return -1;
+		}
+
+		if (connect(Socket, reinterpret_cast<const sockaddr*>(&Address), sizeof(Address)) == 0)
+		{
+			return Socket;
+		}
+
+		const int Error = errno;
+		close(Socket);
+		if ((Error != EAGAIN && Error != EINTR) || GetMilliseconds() - StartTime >= TimeoutMs)
+		{
+			DebugLog("no editor is listening: %s", strerror(Error), StartTime);
+			return -1;
+		}
+
+		const timespec Interval = {0, RETRY_INTERVAL_MS * 1000000L};
+		nanosleep(&Interval, nullptr);
+	}
+}
+
+/** Send the path (and the newline that ends it) in a single write, unless the path is larger than the socket buffer */
+static bool Forward(int Socket, const char* Path, size_t PathLength)
+{
+	char* Message = static_cast<char*>(malloc(PathLength + 1));
+	if (Message == nullptr)
+	{
+		return false;
+	}
+	memcpy(Message, Path, PathLength);
+	Message[PathLength] = '\n';
+
+	size_t Offset = 0;
+	while (Offset < PathLength + 1)
+	{
+		const ssize_t Written = send(Socket, Message + Offset, PathLength + 1 - Offset, MSG_NOSIGNAL);
+		if (Written < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (Written <= 0)
+		{
+			break;
+		}
+		Offset += static_cast<size_t>(Written);
+	}
+
+	free(Message);
+	return Offset == PathLength + 1;
+}
+
+/** Print the editor's response (e.g. "Dispatched" or "NoHandler") for --debug, the handler doesn't wait for it otherwise */
+static void PrintResponse(int Socket, int TimeoutMs, double StartTime)
+{
+	pollfd Poll = {Socket, POLLIN, 0};
+	char Response[64];
+	if (poll(&Poll, 1, TimeoutMs) == 1)
+	{
+		const ssize_t Received = recv(Socket, Response, sizeof(Response) - 1, 0);
+		if (Received > 0)
+		{
+			Response[Received] = '\0';
+			Response[strcspn(Response, "\n")] = '\0';
+			DebugLog("editor responded with %s", Response, StartTime);
+			return;
+		}
+	}
+	DebugLog("editor didn't respond within the timeout%s", "", StartTime);
+}
+
+/**
+ * Write the path to its own file in the spool, which the editor drains (in the order of the file names) once it's up.
+ * It's written to a temporary file first, so that the editor never sees half a request.
+ */
+static bool Spool(const char* Directory, const char* Scheme, const char* Path, size_t PathLength, double StartTime)
+{
+	char SpoolDirectory[PATH_MAX];
+	char TempFilename[PATH_MAX];
+	char Filename[PATH_MAX];
+	timespec Now;
+	clock_gettime(CLOCK_REALTIME, &Now);
+	const unsigned long long ArrivalTime = Now.tv_sec * 1000000000ull + Now.tv_nsec;
+	if (snprintf(SpoolDirectory, sizeof(SpoolDirectory), "%s/%s.spool", Directory, Scheme) >= PATH_MAX ||
+		snprintf(TempFilename, sizeof(TempFilename), "%s/.%d.tmp", SpoolDirectory, getpid()) >= PATH_MAX ||
+		snprintf(Filename, sizeof(Filename), "%s/%020llu-%d.req", SpoolDirectory, ArrivalTime, getpid()) >= PATH_MAX ||
+		!EnsurePrivateDirectory(SpoolDirectory))
+	{
+		return false;
+	}
+
+	const int File = open(TempFilename, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+	if (File == -1)
+	{
+		return false;
+	}
+	const bool bWritten = write(File, Path, PathLength) == static_cast<ssize_t>(PathLength);
+	if (close(File) != 0 || !bWritten || rename(TempFilename, Filename) != 0)
+	{
+		unlink(TempFilename);
+		return false;
+	}
+
+	DebugLog("spooled to %s", Filename, StartTime);
+	return true;
+}
+
+/**
+ * Take the lock that says an editor is on its way. It's inherited by the editor we launch, and held by every running
+ * editor, so it's only released when the editor exits (or crashes).
+ */
+static bool TakeLaunchLock(const char* Directory, const char* Scheme)
+{
+	char LockFilename[PATH_MAX];
+	if (snprintf(LockFilename, sizeof(LockFilename), "%s/%s.lock", Directory, Scheme) >= PATH_MAX)
+	{
+		return false;
+	}
+
+	// Deliberately not O_CLOEXEC, so that the editor we launch keeps holding it
+	const int Lock = open(LockFilename, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+	if (Lock == -1)
+	{
+		// Launching an editor too many is better than not launching one at all
+		return true;
+	}
+	if (flock(Lock, LOCK_EX | LOCK_NB) != 0)
+	{
+		close(Lock);
+		return false;
+	}
+	return true;
+}
+
+/** Forward the path to whoever is listening on the socket, returns false if nobody is or the write failed */
+static bool ForwardToListener(const sockaddr_un& Address, const char* Path, size_t PathLength, int TimeoutMs,
+                              double StartTime)
+{
+	const int Socket = Connect(Address, TimeoutMs, StartTime);
+	if (Socket == -1)
+	{
+		return false;
+	}
+
+	const bool bForwarded = Forward(Socket, Path, PathLength);
+	if (bForwarded)
+	{
+		DebugLog("forwarded to %s", Address.sun_path, StartTime);
+		if (GDebug)
+		{
+			PrintResponse(Socket, TimeoutMs, StartTime);
+		}
+	}
+	close(Socket);
+	return bForwarded;
+}
+
+static int PrintUsage()
+{
+	fprintf(stderr, "Usage: hermes_urls [--debug] [--timeout-ms=<ms>] <scheme> <editor> <project> <uri>\n");
+	return 2;
+}
+
+int main(int ArgC, char** ArgV)
+{
+	const double StartTime = GetMilliseconds();
+
+	int TimeoutMs = DEFAULT_TIMEOUT_MS;
+	int Argument = 1;
+	for (; Argument < ArgC && strncmp(ArgV[Argument], "--", 2) == 0; ++Argument)
+	{
+		if (strcmp(ArgV[Argument], "--debug") == 0)
+		{
+			GDebug = true;
+		}
+		else if (strncmp(ArgV[Argument], "--timeout-ms=", 13) == 0)
+		{
+			TimeoutMs = atoi(ArgV[Argument] + 13);
+		}
+		else
+		{
+			return PrintUsage();
+		}
+	}
+	if (ArgC - Argument != 4)
+	{
+		return PrintUsage();
+	}
+
+	const char* Scheme = ArgV[Argument];
+	const char* Editor = ArgV[Argument + 1];
+	const char* Project = ArgV[Argument + 2];
+	const char* Uri = ArgV[Argument + 3];
+
+	// The editor is only ever handed what follows the "scheme://"
+	const char* UriEnd = Uri + strlen(Uri);
+	const char* Path = HermesPathParser::SkipScheme(Uri, UriEnd);
+	if (Path == Uri)
+	{
+		fprintf(stderr, "hermes_urls: '%s' isn't a URI\n", Uri);
+		return 2;
+	}
+	DebugLog("forwarding %s", Path, StartTime);
+
+	sockaddr_un Address;
+	char Directory[sizeof(Address.sun_path)] = "";
+	const bool bPrivate = GetSocketAddress(Scheme, Address, Directory, sizeof(Directory)) &&
+		EnsurePrivateDirectory(Directory);
+	if (bPrivate)
+	{
+		if (ForwardToListener(Address, Path, static_cast<size_t>(UriEnd - Path), TimeoutMs, StartTime))
+		{
+			return 0;
+		}
+
+		// The editor always gets the link if it's running, a game only gets the ones nobody else is around for
+		char GameScheme[NAME_MAX];
+		sockaddr_un GameAddress;
+		char GameDirectory[sizeof(GameAddress.sun_path)] = "";
+		if (snprintf(GameScheme, sizeof(GameScheme), "%s%s", Scheme, GAME_SCHEME_SUFFIX) < NAME_MAX &&
+			GetSocketAddress(GameScheme, GameAddress, GameDirectory, sizeof(GameDirectory)) &&
+			ForwardToListener(GameAddress, Path, static_cast<size_t>(UriEnd - Path), TimeoutMs, StartTime))
+		{
+			return 0;
+		}
+	}
+	else
+	{
+		DebugLog("%s isn't a directory that's private to the current user", Directory, StartTime);
+	}
+
+	// Nobody answered, so leave the link for the next editor that comes up, and start one if nobody else has
+	const bool bSpooled = bPrivate && Spool(Directory, Scheme, Path, static_cast<size_t>(UriEnd - Path), StartTime);
+	if (bSpooled && !TakeLaunchLock(Directory, Scheme))
+	{
+		DebugLog("an editor is already on its way%s", "", StartTime);
+		return 0;
+	}
+
+	// If the link couldn't be spooled, the editor is told about it on its command line instead
+	char* PathArgument = nullptr;
+	if (!bSpooled)
+	{
+		const size_t PathArgumentSize = strlen("-HermesPath=") + static_cast<size_t>(UriEnd - Path) + 1;
+		PathArgument = static_cast<char*>(malloc(PathArgumentSize));
+		if (PathArgument == nullptr)
+		{
+			return 1;
+		}
+		snprintf(PathArgument, PathArgumentSize, "-HermesPath=%s", Path);
+	}
+
+	DebugLog("launching %s", Editor, StartTime);
+	char* const EditorArguments[] = {const_cast<char*>(Editor), const_cast<char*>(Project), PathArgument, nullptr};
+	execv(Editor, EditorArguments);
+
+	fprintf(stderr, "hermes_urls: unable to launch %s: %s\n", Editor, strerror(errno));
+	return 1;
+}
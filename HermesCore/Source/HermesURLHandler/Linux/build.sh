@@ -0,0 +1,6 @@
+#!/bin/sh
+# Rebuilds ../hermes_urls-linux from HermesURLHandler.cpp, run it after changing either that or HermesPathParser.h.
+# It's linked statically, so the one binary runs on any x86-64 distribution regardless of its glibc version.
+set -e
+cd "$(dirname "$0")"
+${CXX:-c++} -O2 -std=c++17 -Wall -static -s -o ../hermes_urls-linux HermesURLHandler.cpp
@@ -0,0 +1,543 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+//
+// Offline resolver for Hermes content links. Memory-maps a link index written by the editor's Hermes.Content.ExportIndex
+// command and answers which assets a link points at, following redirectors the same way the content endpoint does,
+// without starting the engine. Links are split with the same parser the server uses, so anything that resolves here
+// resolves in the editor given the same index.
+//
+// This is a standalone tool that doesn't depend on the engine, build it with e.g.:
+//   c++ -O2 -std=c++17 HermesLinkResolver.cpp -o hermes_resolve
+//   cl /O2 /std:c++17 /EHsc HermesLinkResolver.cpp
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "../../HermesCore/Source/HermesContentEndpoint/Public/HermesLinkIndexFormat.h"
+#include "../../HermesCore/Source/HermesServer/Public/HermesPathParser.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using FClock = std::chrono::steady_clock;
+
+/** Redirectors can point at other redirectors, but a chain longer than this is most likely a cycle */
+static constexpr int MAX_REDIRECTOR_DEPTH = 8;
+
+/** A read-only mapping of a whole file */
+class FMappedFile
+{
+public:
+	~FMappedFile()
+	{
+#ifdef _WIN32
+		if (Data != nullptr)
+			UnmapViewOfFile(Data);
+		if (Mapping != nullptr)
+			CloseHandle(Mapping);
+		if (File != INVALID_HANDLE_VALUE)
+			CloseHandle(File);
+#else
+		if (Data != nullptr)
+			munmap(const_cast<uint8_t*>(Data), Size);
+#endif
+	}
+
+	bool Open(const char* Filename)
+	{
+#ifdef _WIN32
+		File = CreateFileA(Filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+		                   nullptr);
+		LARGE_INTEGER FileSize;
+		if (File == INVALID_HANDLE_VALUE || !GetFileSizeEx(File, &FileSize) || FileSize.QuadPart == 0)
+			return false;
+		Size = size_t(FileSize.QuadPart);
+		Mapping = CreateFileMappingA(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (Mapping == nullptr)
+			return false;
+		Data = static_cast<const uint8_t*>(MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0));
+		return Data != nullptr;
+#else
+		const int Descriptor = open(Filename, O_RDONLY);
+		if (Descriptor < 0)
+			return false;
+		struct stat Stat;
+		if (fstat(Descriptor, &Stat) != 0 || Stat.st_size == 0)
+		{
+			close(Descriptor);
+			return false;
+		}
+		Size = size_t(Stat.st_size);
+		void* Mapped = mmap(nullptr, Size, PROT_READ, MAP_PRIVATE, Descriptor, 0);
+		close(Descriptor);
+		if (Mapped == MAP_FAILED)
+			return false;
+		Data = static_cast<const uint8_t*>(Mapped);
+		return true;
+#endif
+	}
+
+	const uint8_t* GetData() const
+	{
+		return Data;
+	}
+
+	size_t GetSize() const
+	{
+		return Size;
+	}
+
+private:
+	const uint8_t* Data = nullptr;
+	size_t Size = 0;
+#ifdef _WIN32
+	HANDLE File = INVALID_HANDLE_VALUE;
+	HANDLE Mapping = nullptr;
+#endif
+};
+
+/** The link index, used straight out of the mapping */
+class FLinkIndex
+{
+public:
+	bool Open(const char* Filename, std::string& OutError)
+	{
+		using namespace HermesLinkIndex;
+
+		if (!File.Open(Filename))
+		{
+			OutError = std::string("unable to map ") + Filename;
+			return false;
+		}
+
+		if (File.GetSize() < sizeof(FHeader))
+		{
+			OutError = "the file is too small to be a link index";
+			return false;
+		}
+		std::memcpy(&Header, File.GetData(), sizeof(Header));
+		if (std::memcmp(Header.Magic, MAGIC, sizeof(MAGIC)) != 0)
+		{
+			OutError = "the file is not a link index";
+			return false;
+		}
+		if (Header.Version != VERSION)
+		{
+			OutError = "the link index is version " + std::to_string(Header.Version) + ", expected " +
+				std::to_string(VERSION) + ", export it again";
+			return false;
+		}
+		if (Header.EntriesOffset % alignof(FEntry) != 0 ||
+			Header.EntriesOffset + uint64_t(Header.NumEntries) * sizeof(FEntry) > Header.StringsOffset ||
+			Header.StringsOffset + Header.StringsSize > File.GetSize() || Header.StringsSize == 0 ||
+			File.GetData()[Header.StringsOffset + Header.StringsSize - 1] != 0)
+		{
+			OutError = "the link index is truncated or corrupt";
+			return false;
+		}
+
+		Entries = reinterpret_cast<const FEntry*>(File.GetData() + Header.EntriesOffset);
+		Strings = reinterpret_cast<const char*>(File.GetData() + Header.StringsOffset);
+		for (uint32_t Index = 0; Index < Header.NumEntries; ++Index)
+		{
+			const FEntry& Entry = Entries[Index];
+			if (Entry.PackageName >= Header.StringsSize || Entry.AssetName >= Header.StringsSize ||
+				Entry.ClassName >= Header.StringsSize ||
+				(Entry.RedirectsTo != NO_STRING && Entry.RedirectsTo >= Header.StringsSize))
+			{
+				OutError = "the link index has an entry that points outside of its strings";
+				return false;
+			}
+		}
+		return true;
+	}
+
+	const HermesLinkIndex::FHeader& GetHeader() const
+	{
+		return Header;
+	}
+
+	const char* GetString(uint32_t Offset) const
+	{
+		return Strings + Offset;
+	}
+
+	/** Find the entries for a package, which are next to each other with the primary asset first */
+	std::pair<const HermesLinkIndex::FEntry*, const HermesLinkIndex::FEntry*> FindPackage(const char* PackageName) const
+	{
+		return std::equal_range(Entries, Entries + Header.NumEntries, PackageName, FCompare{Strings});
+	}
+
+private:
+	struct FCompare
+	{
+		const char* Strings;
+
+		bool operator()(const HermesLinkIndex::FEntry& Entry, const char* PackageName) const
+		{
+			return HermesLinkIndex::ComparePackageNames(Strings + Entry.PackageName, PackageName) < 0;
+		}
+
+		bool operator()(const char* PackageName, const HermesLinkIndex::FEntry& Entry) const
+		{
+			return HermesLinkIndex::ComparePackageNames(PackageName, Strings + Entry.PackageName) < 0;
+		}
+	};
+
+	FMappedFile File;
+	HermesLinkIndex::FHeader Header = {};
+	const HermesLinkIndex::FEntry* Entries = nullptr;
+	const char* Strings = nullptr;
+};
+
+/** Percent-decode a URL component, treating '+' as a space like the server does */
+static std::string UrlDecode(const HermesPathParser::TRange<char>& Range)
+{
+	auto HexValue = [](char Character) -> int
+	{
+		if (Character >= '0' && Character <= '9')
+			return Character - '0';
+		if (Character >= 'a' && Character <= 'f')
+			return Character - 'a' + 10;
+		if (Character >= 'A' && Character <= 'F')
+			return Character - 'A' + 10;
+		return -1;
+	};
+
+	std::string Decoded;
+	Decoded.reserve(size_t(Range.Len()));
+	for (const char* Character = Range.Begin; Character != Range.End; ++Character)
+	{
+		if (*Character == '%' && Range.End - Character >= 3 && HexValue(Character[1]) >= 0 && HexValue(Character[2]) >= 0)
+		{
+			Decoded += char(HexValue(Character[1]) * 16 + HexValue(Character[2]));
+			Character += 2;
+		}
+		else
+		{
+			Decoded += *Character == '+' ? ' ' : *Character;
+		}
+	}
+	return Decoded;
+}
+
+static void AppendJsonString(std::string& Out, const std::string& String)
+{
+	Out += '"';
+	for (const char Character : String)
+	{
+		switch (Character)
+		{
+		case '"':
+			Out += "\\\"";
+			break;
+		case '\\':
+			Out += "\\\\";
+			break;
+		case '\n':
+			Out += "\\n";
+			break;
+		case '\r':
+			Out += "\\r";
+			break;
+		case '\t':
+			Out += "\\t";
+			break;
+		default:
+			if (static_cast<unsigned char>(Character) < 0x20)
+			{
+				char Escaped[8];
+				std::snprintf(Escaped, sizeof(Escaped), "\\u%04x", Character);
+				Out += Escaped;
+			}
+			else
+			{
+				Out += Character;
+			}
+		}
+	}
+	Out += '"';
+}
+
+struct FResolvedLink
+{
+	enum class EStatus
+	{
+		Found,
+		Missing,
+		Unsupported,
+	};
+
+	EStatus Status = EStatus::Missing;
+	std::string Endpoint;
+	std::string PackageName;
+	bool bEdit = false;
+	/** The packages that were redirected away from, in order */
+	std::vector<std::string> RedirectedFrom;
+	const HermesLinkIndex::FEntry* Begin = nullptr;
+	const HermesLinkIndex::FEntry* End = nullptr;
+	double ResolveUs = 0.0;
+};
+
+static FResolvedLink Resolve(const FLinkIndex& Index, const std::string& Uri)
+{
+	using namespace HermesLinkIndex;
+
+	const FClock::time_point Start = FClock::now();
+	FResolvedLink Link;
+
+	const char* const UriEnd = Uri.data() + Uri.size();
+	const HermesPathParser::TParsedPath<char> Parsed =
+		HermesPathParser::Split(HermesPathParser::SkipScheme(Uri.data(), UriEnd), UriEnd);
+	// The server doesn't decode endpoint names either
+	Link.Endpoint.assign(Parsed.Endpoint.Begin, Parsed.Endpoint.End);
+	std::transform(Link.Endpoint.begin(), Link.Endpoint.end(), Link.Endpoint.begin(),
+	               [](char Character) { return char(std::tolower(static_cast<unsigned char>(Character))); });
+	if (Link.Endpoint != "content")
+	{
+		Link.Status = FResolvedLink::EStatus::Unsupported;
+		return Link;
+	}
+
+	HermesPathParser::ForEachQueryParameter(Parsed.Query,
+		[&Link](const HermesPathParser::TRange<char>& Key, const HermesPathParser::TRange<char>&)
+		{
+			std::string Name = UrlDecode(Key);
+			std::transform(Name.begin(), Name.end(), Name.begin(),
+			               [](char Character) { return char(std::tolower(static_cast<unsigned char>(Character))); });
+			Link.bEdit |= Name == "edit";
+		});
+
+	// Links to assets that have since been renamed point at the redirector that was left behind
+	Link.PackageName = UrlDecode(Parsed.Path);
+	std::tie(Link.Begin, Link.End) = Index.FindPackage(Link.PackageName.c_str());
+	for (int Depth = 0; Depth < MAX_REDIRECTOR_DEPTH && Link.End - Link.Begin == 1 &&
+	     (Link.Begin->Flags & Redirector) != 0 && Link.Begin->RedirectsTo != NO_STRING;
+	     ++Depth)
+	{
+		const char* Destination = Index.GetString(Link.Begin->RedirectsTo);
+		if (ComparePackageNames(Destination, Link.PackageName.c_str()) == 0)
+		{
+			break;
+		}
+
+		Link.RedirectedFrom.push_back(Link.PackageName);
+		Link.PackageName = Destination;
+		std::tie(Link.Begin, Link.End) = Index.FindPackage(Destination);
+	}
+
+	if (Link.Begin != Link.End)
+	{
+		// Report the package name the way it's spelled in the index rather than how the link spelled it
+		Link.PackageName = Index.GetString(Link.Begin->PackageName);
+		Link.Status = FResolvedLink::EStatus::Found;
+	}
+
+	Link.ResolveUs = std::chrono::duration<double, std::micro>(FClock::now() - Start).count();
+	return Link;
+}
+
+static const char* LexToString(FResolvedLink::EStatus Status)
+{
+	switch (Status)
+	{
+	case FResolvedLink::EStatus::Found:
+		return "found";
+	case FResolvedLink::EStatus::Missing:
+		return "missing";
+	case FResolvedLink::EStatus::Unsupported:
+		return "unsupported";
+	}
+	return "unknown";
+}
+
+static void PrintText(const FLinkIndex& Index, const std::string& Uri, const FResolvedLink& Link)
+{
+	switch (Link.Status)
+	{
+	case FResolvedLink::EStatus::Unsupported:
+		std::printf("%s: the '%s' endpoint can only be resolved by a running editor\n", Uri.c_str(),
+		            Link.Endpoint.c_str());
+		return;
+	case FResolvedLink::EStatus::Missing:
+		std::printf("%s: no assets in %s (%.1f us)\n", Uri.c_str(), Link.PackageName.c_str(), Link.ResolveUs);
+		return;
+	case FResolvedLink::EStatus::Found:
+		break;
+	}
+
+	std::printf("%s: %s %s, %" PRIu64 " bytes (%.1f us)\n", Uri.c_str(), Link.bEdit ? "edit" : "reveal",
+	            Link.PackageName.c_str(), Link.Begin->DiskSize, Link.ResolveUs);
+	for (const std::string& RedirectedFrom : Link.RedirectedFrom)
+	{
+		std::printf("  redirected from %s\n", RedirectedFrom.c_str());
+	}
+
+	// Editing only opens the primary asset, revealing selects all of them
+	const HermesLinkIndex::FEntry* End = Link.bEdit ? Link.Begin + 1 : Link.End;
+	for (const HermesLinkIndex::FEntry* Entry = Link.Begin; Entry != End; ++Entry)
+	{
+		std::printf("  %s (%s)\n", Index.GetString(Entry->AssetName), Index.GetString(Entry->ClassName));
+	}
+}
+
+static void PrintJson(const FLinkIndex& Index, const std::string& Uri, const FResolvedLink& Link)
+{
+	std::string Json = "{\"uri\":";
+	AppendJsonString(Json, Uri);
+	Json += ",\"status\":\"";
+	Json += LexToString(Link.Status);
+	Json += "\",\"endpoint\":";
+	AppendJsonString(Json, Link.Endpoint);
+
+	if (Link.Status != FResolvedLink::EStatus::Unsupported)
+	{
+		Json += ",\"action\":";
+		Json += Link.bEdit ? "\"edit\"" : "\"reveal\"";
+		Json += ",\"package\":";
+		AppendJsonString(Json, Link.PackageName);
+		Json += ",\"redirected_from\":[";
+		for (size_t Redirect = 0; Redirect < Link.RedirectedFrom.size(); ++Redirect)
+		{
+			Json += Redirect > 0 ? "," : "";
+			AppendJsonString(Json, Link.RedirectedFrom[Redirect]);
+		}
+		Json += "]";
+	}
+
+	if (Link.Status == FResolvedLink::EStatus::Found)
+	{
+		Json += ",\"size\":" + std::to_string(Link.Begin->DiskSize) + ",\"assets\":[";
+		const HermesLinkIndex::FEntry* End = Link.bEdit ? Link.Begin + 1 : Link.End;
+		for (const HermesLinkIndex::FEntry* Entry = Link.Begin; Entry != End; ++Entry)
+		{
+			Json += Entry != Link.Begin ? ",{\"name\":" : "{\"name\":";
+			AppendJsonString(Json, Index.GetString(Entry->AssetName));
+			Json += ",\"class\":";
+			AppendJsonString(Json, Index.GetString(Entry->ClassName));
+			Json += "}";
+		}
+		Json += "]";
+	}
+
+	char ResolveUs[32];
+	std::snprintf(ResolveUs, sizeof(ResolveUs), "%.3f", Link.ResolveUs);
+	Json += ",\"resolve_us\":";
+	Json += ResolveUs;
+	Json += "}\n";
+	std::fputs(Json.c_str(), stdout);
+}
+
+static void PrintUsage()
+{
+	std::fprintf(stderr,
+		"Usage: hermes_resolve [options] <index> [uri...]\n"
+		"  Resolves each uri, or each line on stdin if none are given. URIs can be full links\n"
+		"  (\"scheme://content/Game/Foo\") or paths (\"/content/Game/Foo?edit\").\n"
+		"  --json                     Print one JSON object per link instead of text\n"
+		"  --info                     Print information about the index and exit\n");
+}
+
+int main(int ArgC, char** ArgV)
+{
+	bool bJson = false;
+	bool bInfo = false;
+	const char* IndexFilename = nullptr;
+	std::vector<std::string> Uris;
+	for (int Index = 1; Index < ArgC; ++Index)
+	{
+		const std::string Arg = ArgV[Index];
+		if (Arg == "--json")
+			bJson = true;
+		else if (Arg == "--info")
+			bInfo = true;
+		else if (Arg.size() > 1 && Arg[0] == '-' && Arg[1] == '-')
+		{
+			PrintUsage();
+			return 2;
+		}
+		else if (IndexFilename == nullptr)
+			IndexFilename = ArgV[Index];
+		else
+			Uris.push_back(Arg);
+	}
+
+	if (IndexFilename == nullptr)
+	{
+		PrintUsage();
+		return 2;
+	}
+
+	FLinkIndex LinkIndex;
+	std::string Error;
+	const FClock::time_point OpenStart = FClock::now();
+	if (!LinkIndex.Open(IndexFilename, Error))
+	{
+		std::fprintf(stderr, "error: %s\n", Error.c_str());
+		return 2;
+	}
+
+	if (bInfo)
+	{
+		const HermesLinkIndex::FHeader& Header = LinkIndex.GetHeader();
+		std::printf("%-12s %12" PRIu32 "\n", "entries", Header.NumEntries);
+		std::printf("%-12s %12" PRIu64 " bytes\n", "strings", Header.StringsSize);
+		std::printf("%-12s %12" PRId64 " (unix time)\n", "exported", Header.ExportTime);
+		std::printf("%-12s %12.1f us\n", "open", std::chrono::duration<double, std::micro>(FClock::now() - OpenStart).count());
+		return 0;
+	}
+
+	int NumMissing = 0;
+	auto ResolveAndPrint = [&](const std::string& Uri)
+	{
+		const FResolvedLink Link = Resolve(LinkIndex, Uri);
+		NumMissing += Link.Status == FResolvedLink::EStatus::Found ? 0 : 1;
+		if (bJson)
+			PrintJson(LinkIndex, Uri, Link);
+		else
+			PrintText(LinkIndex, Uri, Link);
+	};
+
+	if (!Uris.empty())
+	{
+		for (const std::string& Uri : Uris)
+		{
+			ResolveAndPrint(Uri);
+		}
+	}
+	else
+	{
+		std::string Line;
+		while (std::getline(std::cin, Line))
+		{
+			while (!Line.empty() && (Line.back() == '\r' || Line.back() == ' '))
+			{
+				Line.pop_back();
+			}
+			if (!Line.empty())
+			{
+				ResolveAndPrint(Line);
+				std::fflush(stdout);
+			}
+		}
+	}
+
+	// Like grep, exit with 1 if anything didn't resolve so scripts can check links in bulk
+	return NumMissing > 0 ? 1 : 0;
+}
@@ -0,0 +1,799 @@
+// Copyright (c) Jørgen Tjernø <jorgen@tjer.no>. All rights reserved.
+//
+// Load generator for the Hermes loopback server. Opens a number of persistent connections to a running editor, pushes a
+// configurable mix of pipelined requests through them, and reports throughput and latency percentiles from an
+// HDR-style histogram. Exits with a non-zero status if the results don't meet the given thresholds or regress beyond
+// the given tolerance of a saved baseline, so it can gate a build.
+//
+// This is a standalone tool that doesn't depend on the engine, build it with e.g.:
+//   c++ -O2 -std=c++17 -pthread HermesLoadGenerator.cpp -o hermes_loadgen
+//   cl /O2 /std:c++17 /EHsc HermesLoadGenerator.cpp ws2_32.lib
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <intrin.h>
+using ssize_t = int;
+#define MSG_NOSIGNAL 0
+#define close closesocket
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using FClock = std::chrono::steady_clock;
+
+/**
+ * Log-linear histogram in the style of HdrHistogram: values below 2 * SubBucketCount are recorded exactly, and above
+ * that every power of two is split into SubBucketCount linear buckets, giving ~3 significant digits of precision over
+ * the whole 64-bit range with a fixed amount of memory.
+ */
+class FLatencyHistogram
+{
+public:
+	static constexpr int SubBucketBits = 10;
+	static constexpr uint64_t SubBucketCount = uint64_t(1) << SubBucketBits;
+
+	FLatencyHistogram()
+		: Counts(2 * SubBucketCount + (64 - SubBucketBits - 1) * SubBucketCount, 0)
+	{
+	}
+
+	void Record(uint64_t Value)
+	{
+		++Counts[IndexOf(Value)];
+		++TotalCount;
+		MaxValue = std::max(MaxValue, Value);
+		MinValue = std::min(MinValue, Value);
+	}
+
+	void Merge(const FLatencyHistogram& Other)
+	{
+		for (size_t Index = 0; Index < Counts.size(); ++Index)
+		{
+			Counts[Index] += Other.Counts[Index];
+		}
+		TotalCount += Other.TotalCount;
+		MaxValue = std::max(MaxValue, Other.MaxValue);
+		MinValue = std::min(MinValue, Other.MinValue);
+	}
+
+	/** The highest value recorded at or below the given percentile (0-100), reported as the top of its bucket */
+	uint64_t ValueAtPercentile(double Percentile) const
+	{
+		if (TotalCount == 0)
+		{
+			return 0;
+		}
+
+		const uint64_t Target = std::max<uint64_t>(1, uint64_t(Percentile / 100.0 * double(TotalCount) + 0.5));
+		uint64_t Seen = 0;
+		for (size_t Index = 0; Index < Counts.size(); ++Index)
+		{
+			Seen += Counts[Index];
+			if (Seen >= Target)
+			{
+				return std::min(HighestValueIn(Index), MaxValue);
+			}
+		}
+		return MaxValue;
+	}
+
+	uint64_t GetTotalCount() const
+	{
+		return TotalCount;
+	}
+
+	uint64_t GetMax() const
+	{
+		return MaxValue;
+	}
+
+	uint64_t GetMin() const
+	{
+		return TotalCount ? MinValue : 0;
+	}
+
+private:
+	static size_t IndexOf(uint64_t Value)
+	{
+		if (Value < 2 * SubBucketCount)
+		{
+			return size_t(Value);
+		}
+
+		// Shift the value down so that it lands in [SubBucketCount, 2 * SubBucketCount)
+#ifdef _WIN32
+		unsigned long HighestBit;
+		_BitScanReverse64(&HighestBit, Value);
+#else
+		const int HighestBit = 63 - __builtin_clzll(Value);
+#endif
+		const int Shift = HighestBit - SubBucketBits;
+		return size_t(2 * SubBucketCount + (Shift - 1) * SubBucketCount + ((Value >> Shift) - SubBucketCount));
+	}
+
+	static uint64_t HighestValueIn(size_t Index)
+	{
+		if (Index < 2 * SubBucketCount)
+		{
+			return Index;
+		}
+
+		const uint64_t Shift = (Index - 2 * SubBucketCount) / SubBucketCount + 1;
+		const uint64_t SubBucket = (Index - 2 * SubBucketCount) % SubBucketCount + SubBucketCount;
+		return ((SubBucket + 1) << Shift) - 1;
+	}
+
+	std::vector<uint64_t> Counts;
+	uint64_t TotalCount = 0;
+	uint64_t MaxValue = 0;
+	uint64_t MinValue = UINT64_MAX;
+};
+
+struct FWeightedPath
+{
+	std::string Path;
+	uint32_t Weight = 1;
+};
+
+struct FOptions
+{
+	std::string Host = "127.0.0.1";
+	int Port = 41230;
+	int Connections = 4;
+	int Pipeline = 8;
+	uint64_t RequestsPerConnection = 10000;
+	uint64_t WarmupPerConnection = 100;
+	std::vector<FWeightedPath> Mix;
+	/**
+	 * Interactive by default, since that's the only priority that's answered once the handler has run. Lower priorities
+	 * are answered with a 202 as soon as they're queued, so they only measure the transport.
+	 */
+	std::string Priority = "interactive";
+	/** Sent as X-Hermes-Token, the loopback server refuses requests without it */
+	std::string Token;
+	bool bWebSocket = false;
+	bool bAllowErrors = false;
+	/** Append a unique query parameter to every path, so the server's duplicate request filter doesn't drop them */
+	bool bUniquePaths = true;
+
+	// Absolute thresholds, zero means "don't check"
+	double MaxP50Us = 0.0;
+	double MaxP95Us = 0.0;
+	double MaxP99Us = 0.0;
+	double MaxUs = 0.0;
+	double MinRequestsPerSecond = 0.0;
+
+	// Regression checks against a previous run
+	std::string BaselineFile;
+	std::string WriteBaselineFile;
+	double Tolerance = 0.10;
+};
+
+struct FResults
+{
+	FLatencyHistogram Latency;
+	std::map<int, uint64_t> StatusCounts;
+	uint64_t Errors = 0;
+	double ElapsedSeconds = 0.0;
+	std::string FatalError;
+};
+
+static void PrintUsage()
+{
+	std::fprintf(stderr,
+		"Usage: hermes_loadgen [options]\n"
+		"  --host <addr>              Address of the loopback server (default 127.0.0.1)\n"
+		"  --port <port>              Port of the loopback server (default 41230)\n"
+		"  --connections <n>          Number of concurrent connections (default 4)\n"
+		"  --pipeline <n>             Requests in flight per connection (default 8)\n"
+		"  --requests <n>             Measured requests per connection (default 10000)\n"
+		"  --warmup <n>               Unmeasured requests per connection before measuring (default 100)\n"
+		"  --path <path>[@weight]     Add a path to the request mix, may be repeated (default /noop)\n"
+		"  --priority <priority>      Send X-Hermes-Priority: interactive (default), scripted or background\n"
+		"  --token <token>            Token to send in X-Hermes-Token (e.g. from -HermesLoopbackToken=<token>)\n"
+		"  --token-file <file>        Read the token from a file, e.g. Saved/Hermes/LoopbackToken-41230.txt\n"
+		"  --no-unique                Send paths exactly as given, which lets the server drop them as duplicates\n"
+		"  --websocket                Send requests as WebSocket messages instead of HTTP requests\n"
+		"  --allow-errors             Don't fail if any request gets a non-2xx status\n"
+		"  --max-p50-us <us>          Fail if the median latency is higher than this\n"
+		"  --max-p95-us <us>          Fail if the 95th percentile latency is higher than this\n"
+		"  --max-p99-us <us>          Fail if the 99th percentile latency is higher than this\n"
+		"  --max-us <us>              Fail if the maximum latency is higher than this\n"
+		"  --min-rps <n>              Fail if the throughput is lower than this\n"
+		"  --baseline <file>          Fail if results regress by more than --tolerance compared to this file\n"
+		"  --tolerance <fraction>     Allowed regression against the baseline (default 0.10)\n"
+		"  --write-baseline <file>    Save the results as a baseline for later runs\n");
+}
+
+static bool ParseOptions(int ArgC, char** ArgV, FOptions& Options)
+{
+	for (int Index = 1; Index < ArgC; ++Index)
+	{
+		const std::string Arg = ArgV[Index];
+		auto NextValue = [&]() -> const char*
+		{
+			if (Index + 1 >= ArgC)
+			{
+				std::fprintf(stderr, "Missing value for %s\n", Arg.c_str());
+				std::exit(2);
+			}
+			return ArgV[++Index];
+		};
+
+		if (Arg == "--host")
+			Options.Host = NextValue();
+		else if (Arg == "--port")
+			Options.Port = std::atoi(NextValue());
+		else if (Arg == "--connections")
+			Options.Connections = std::max(1, std::atoi(NextValue()));
+		else if (Arg == "--pipeline")
+			Options.Pipeline = std::max(1, std::atoi(NextValue()));
+		else if (Arg == "--requests")
+			Options.RequestsPerConnection = std::strtoull(NextValue(), nullptr, 10);
+		else if (Arg == "--warmup")
+			Options.WarmupPerConnection = std::strtoull(NextValue(), nullptr, 10);
+		else if (Arg == "--path")
+		{
+			std::string Value = NextValue();
+			FWeightedPath Path;
+			const size_t At = Value.rfind('@');
+			if (At != std::string::npos)
+			{
+				Path.Weight = uint32_t(std::max(1, std::atoi(Value.c_str() + At + 1)));
+				Value.resize(At);
+			}
+			Path.Path = Value.empty() || Value[0] != '/' ? "/" + Value : Value;
+			Options.Mix.push_back(Path);
+		}
+		else if (Arg == "--priority")
+			Options.Priority = NextValue();
+		else if (Arg == "--token")
+			Options.Token = NextValue();
+		else if (Arg == "--token-file")
+		{
+			const char* Filename = NextValue();
+			std::ifstream File(Filename);
+			if (!std::getline(File, Options.Token))
+			{
+				std::fprintf(stderr, "Unable to read token from %s\n", Filename);
+				return false;
+			}
+		}
+		else if (Arg == "--no-unique")
+			Options.bUniquePaths = false;
+		else if (Arg == "--websocket")
+			Options.bWebSocket = true;
+		else if (Arg == "--allow-errors")
+			Options.bAllowErrors = true;
+		else if (Arg == "--max-p50-us")
+			Options.MaxP50Us = std::atof(NextValue());
+		else if (Arg == "--max-p95-us")
+			Options.MaxP95Us = std::atof(NextValue());
+		else if (Arg == "--max-p99-us")
+			Options.MaxP99Us = std::atof(NextValue());
+		else if (Arg == "--max-us")
+			Options.MaxUs = std::atof(NextValue());
+		else if (Arg == "--min-rps")
+			Options.MinRequestsPerSecond = std::atof(NextValue());
+		else if (Arg == "--baseline")
+			Options.BaselineFile = NextValue();
+		else if (Arg == "--tolerance")
+			Options.Tolerance = std::atof(NextValue());
+		else if (Arg == "--write-baseline")
+			Options.WriteBaselineFile = NextValue();
+		else
+		{
+			PrintUsage();
+			return false;
+		}
+	}
+
+	if (Options.Token.empty())
+	{
+		std::fprintf(stderr, "One of --token or --token-file is required\n");
+		return false;
+	}
+
+	if (Options.Mix.empty())
+	{
+		Options.Mix.push_back({"/noop", 1});
+	}
+	return true;
+}
+
+/** A single connection to the loopback server, speaking either pipelined HTTP/1.1 or WebSocket */
+class FConnection
+{
+public:
+	explicit FConnection(const FOptions& InOptions)
+		: Options(InOptions)
+	{
+	}
+
+	~FConnection()
+	{
+		if (IsValidSocket())
+		{
+			close(Socket);
+		}
+	}
+
+	bool Connect(std::string& OutError)
+	{
+		addrinfo Hints = {};
+		Hints.ai_family = AF_UNSPEC;
+		Hints.ai_socktype = SOCK_STREAM;
+		addrinfo* Addresses = nullptr;
+		if (getaddrinfo(Options.Host.c_str(), std::to_string(Options.Port).c_str(), &Hints, &Addresses) != 0)
+		{
+			OutError = "Unable to resolve " + Options.Host;
+			return false;
+		}
+
+		for (addrinfo* Address = Addresses; Address != nullptr && !IsValidSocket(); Address = Address->ai_next)
+		{
+			Socket = socket(Address->ai_family, Address->ai_socktype, Address->ai_protocol);
+			if (IsValidSocket() && connect(Socket, Address->ai_addr, int(Address->ai_addrlen)) != 0)
+			{
+				close(Socket);
+				Socket = decltype(Socket)(-1);
+			}
+		}
+		freeaddrinfo(Addresses);
+
+		if (!IsValidSocket())
+		{
+			OutError = "Unable to connect to " + Options.Host + ":" + std::to_string(Options.Port) + ": " +
+				std::strerror(errno);
+			return false;
+		}
+
+		const int NoDelay = 1;
+		setsockopt(Socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&NoDelay), sizeof(NoDelay));
+
+		if (Options.bWebSocket)
+		{
+			std::string Handshake = "GET / HTTP/1.1\r\nHost: " + Options.Host +
+				"\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+				"Sec-WebSocket-Key: aGVybWVzLWxvYWRnZW4tMDE=\r\nSec-WebSocket-Version: 13\r\n";
+			if (!Options.Priority.empty())
+			{
+				Handshake += "X-Hermes-Priority: " + Options.Priority + "\r\n";
+			}
+			Handshake += "X-Hermes-Token: " + Options.Token + "\r\n\r\n";
+			if (!SendAll(Handshake))
+			{
+				OutError = "Failed to send WebSocket handshake";
+				return false;
+			}
+
+			size_t HeaderEnd;
+			while ((HeaderEnd = Received.find("\r\n\r\n")) == std::string::npos)
+			{
+				if (!ReceiveSome())
+				{
+					OutError = "Connection closed during WebSocket handshake";
+					return false;
+				}
+			}
+			if (Received.compare(0, 12, "HTTP/1.1 101") != 0)
+			{
+				OutError = "WebSocket handshake was refused: " + Received.substr(0, Received.find("\r\n"));
+				return false;
+			}
+			Received.erase(0, HeaderEnd + 4);
+		}
+
+		return true;
+	}
+
+	/** Append a request for the given path to the outgoing buffer */
+	void QueueRequest(const std::string& Path)
+	{
+		if (!Options.bWebSocket)
+		{
+			Outgoing += "GET " + Path + " HTTP/1.1\r\nHost: " + Options.Host + "\r\n";
+			if (!Options.Priority.empty())
+			{
+				Outgoing += "X-Hermes-Priority: " + Options.Priority + "\r\n";
+			}
+			Outgoing += "X-Hermes-Token: " + Options.Token + "\r\n\r\n";
+			return;
+		}
+
+		// Client frames must be masked, a zero mask keeps the payload readable and is just as valid
+		Outgoing += char(0x81);
+		if (Path.size() < 126)
+		{
+			Outgoing += char(0x80 | Path.size());
+		}
+		else
+		{
+			Outgoing += char(0x80 | 126);
+			Outgoing += char((Path.size() >> 8) & 0xFF);
+			Outgoing += char(Path.size() & 0xFF);
+		}
+		Outgoing.append(4, '\0');
+		Outgoing += Path;
+	}
+
+	bool Flush()
+	{
+		const bool bSuccess = SendAll(Outgoing);
+		Outgoing.clear();
+		return bSuccess;
+	}
+
+	/** Block until at least one response has arrived, returns the status codes of all complete responses */
+	bool ReceiveResponses(std::vector<int>& OutStatusCodes)
+	{
+		OutStatusCodes.clear();
+		while (true)
+		{
+			while (ParseResponse(OutStatusCodes))
+			{
+			}
+
+			if (!OutStatusCodes.empty())
+			{
+				return true;
+			}
+
+			if (!ReceiveSome())
+			{
+				return false;
+			}
+		}
+	}
+
+private:
+	bool IsValidSocket() const
+	{
+#ifdef _WIN32
+		return Socket != INVALID_SOCKET;
+#else
+		return Socket >= 0;
+#endif
+	}
+
+	bool SendAll(const std::string& Data)
+	{
+		size_t Offset = 0;
+		while (Offset < Data.size())
+		{
+			const ssize_t Sent = send(Socket, Data.data() + Offset, int(Data.size() - Offset), MSG_NOSIGNAL);
+			if (Sent <= 0)
+			{
+				return false;
+			}
+			Offset += size_t(Sent);
+		}
+		return true;
+	}
+
+	bool ReceiveSome()
+	{
+		char Buffer[16 * 1024];
+		const ssize_t Count = recv(Socket, Buffer, int(sizeof(Buffer)), 0);
+		if (Count <= 0)
+		{
+			return false;
+		}
+		Received.append(Buffer, size_t(Count));
+		return true;
+	}
+
+	bool ParseResponse(std::vector<int>& OutStatusCodes)
+	{
+		if (Options.bWebSocket)
+		{
+			if (Received.size() < 2)
+			{
+				return false;
+			}
+			size_t PayloadSize = uint8_t(Received[1]) & 0x7F;
+			size_t HeaderSize = 2;
+			if (PayloadSize == 126)
+			{
+				if (Received.size() < 4)
+				{
+					return false;
+				}
+				PayloadSize = (size_t(uint8_t(Received[2])) << 8) | uint8_t(Received[3]);
+				HeaderSize = 4;
+			}
+			if (Received.size() < HeaderSize + PayloadSize)
+			{
+				return false;
+			}
+
+			// Replies look like "200 OK"
+			const int Opcode = uint8_t(Received[0]) & 0x0F;
+			OutStatusCodes.push_back(Opcode == 0x1 ? std::atoi(Received.c_str() + HeaderSize) : -1);
+			Received.erase(0, HeaderSize + PayloadSize);
+			return true;
+		}
+
+		const size_t HeaderEnd = Received.find("\r\n\r\n");
+		if (HeaderEnd == std::string::npos)
+		{
+			return false;
+		}
+
+		size_t ContentLength = 0;
+		const size_t ContentLengthStart = Received.find("Content-Length:");
+		if (ContentLengthStart != std::string::npos && ContentLengthStart < HeaderEnd)
+		{
+			ContentLength = std::strtoull(Received.c_str() + ContentLengthStart + 15, nullptr, 10);
+		}
+		if (Received.size() < HeaderEnd + 4 + ContentLength)
+		{
+			return false;
+		}
+
+		// "HTTP/1.1 200 OK"
+		OutStatusCodes.push_back(Received.size() > 12 ? std::atoi(Received.c_str() + 9) : -1);
+		Received.erase(0, HeaderEnd + 4 + ContentLength);
+		return true;
+	}
+
+	const FOptions& Options;
+#ifdef _WIN32
+	SOCKET Socket = INVALID_SOCKET;
+#else
+	int Socket = -1;
+#endif
+	std::string Outgoing;
+	std::string Received;
+};
+
+static void RunConnection(const FOptions& Options, int ConnectionIndex, FResults& OutResults)
+{
+	FConnection Connection(Options);
+	if (!Connection.Connect(OutResults.FatalError))
+	{
+		return;
+	}
+
+	// Seed deterministically so that runs with the same options send the same sequence of requests
+	std::mt19937 Random(uint32_t(ConnectionIndex) * 7919u + 17u);
+	std::vector<uint32_t> Weights;
+	for (const FWeightedPath& Path : Options.Mix)
+	{
+		Weights.push_back(Path.Weight);
+	}
+	std::discrete_distribution<size_t> PickPath(Weights.begin(), Weights.end());
+
+	const uint64_t TotalRequests = Options.WarmupPerConnection + Options.RequestsPerConnection;
+	std::deque<FClock::time_point> InFlight;
+	std::vector<int> StatusCodes;
+	uint64_t Sent = 0;
+	uint64_t Completed = 0;
+
+	while (Completed < TotalRequests)
+	{
+		while (Sent < TotalRequests && InFlight.size() < size_t(Options.Pipeline))
+		{
+			const std::string& Path = Options.Mix[PickPath(Random)].Path;
+			if (Options.bUniquePaths)
+			{
+				const char Separator = Path.find('?') == std::string::npos ? '?' : '&';
+				Connection.QueueRequest(Path + Separator + "loadgen=" + std::to_string(ConnectionIndex) + "." +
+				                        std::to_string(Sent));
+			}
+			else
+			{
+				Connection.QueueRequest(Path);
+			}
+			InFlight.push_back(FClock::now());
+			++Sent;
+		}
+
+		if (!Connection.Flush() || !Connection.ReceiveResponses(StatusCodes))
+		{
+			OutResults.FatalError = "Connection " + std::to_string(ConnectionIndex) + " was closed by the server";
+			return;
+		}
+
+		const FClock::time_point Now = FClock::now();
+		for (const int StatusCode : StatusCodes)
+		{
+			if (InFlight.empty())
+			{
+				OutResults.FatalError = "Received more responses than requests";
+				return;
+			}
+
+			const uint64_t LatencyNs = uint64_t(
+				std::chrono::duration_cast<std::chrono::nanoseconds>(Now - InFlight.front()).count());
+			InFlight.pop_front();
+
+			if (Completed++ < Options.WarmupPerConnection)
+			{
+				continue;
+			}
+
+			OutResults.Latency.Record(LatencyNs);
+			++OutResults.StatusCounts[StatusCode];
+			if (StatusCode < 200 || StatusCode >= 300)
+			{
+				++OutResults.Errors;
+			}
+		}
+	}
+}
+
+static std::map<std::string, double> ReadBaseline(const std::string& Filename)
+{
+	std::map<std::string, double> Values;
+	std::ifstream File(Filename);
+	std::string Key;
+	double Value;
+	while (File >> Key >> Value)
+	{
+		Values[Key] = Value;
+	}
+	return Values;
+}
+
+int main(int ArgC, char** ArgV)
+{
+	FOptions Options;
+	if (!ParseOptions(ArgC, ArgV, Options))
+	{
+		return 2;
+	}
+
+#ifdef _WIN32
+	WSADATA WsaData;
+	WSAStartup(MAKEWORD(2, 2), &WsaData);
+#endif
+
+	std::printf("Sending %" PRIu64 " requests over %d %s connection(s) to %s:%d, %d in flight per connection\n",
+	            Options.RequestsPerConnection * uint64_t(Options.Connections), Options.Connections,
+	            Options.bWebSocket ? "WebSocket" : "HTTP", Options.Host.c_str(), Options.Port, Options.Pipeline);
+
+	std::vector<FResults> PerConnection(size_t(Options.Connections));
+	std::vector<std::thread> Threads;
+	const FClock::time_point Start = FClock::now();
+	for (int Index = 0; Index < Options.Connections; ++Index)
+	{
+		Threads.emplace_back(RunConnection, std::cref(Options), Index, std::ref(PerConnection[size_t(Index)]));
+	}
+	for (std::thread& Thread : Threads)
+	{
+		Thread.join();
+	}
+
+	FResults Results;
+	Results.ElapsedSeconds = std::chrono::duration<double>(FClock::now() - Start).count();
+	for (const FResults& Connection : PerConnection)
+	{
+		if (!Connection.FatalError.empty())
+		{
+			std::fprintf(stderr, "error: %s\n", Connection.FatalError.c_str());
+			return 2;
+		}
+		Results.Latency.Merge(Connection.Latency);
+		Results.Errors += Connection.Errors;
+		for (const auto& Pair : Connection.StatusCounts)
+		{
+			Results.StatusCounts[Pair.first] += Pair.second;
+		}
+	}
+
+	// The elapsed time includes warmup, so this slightly underestimates throughput when warmup is large
+	const double RequestsPerSecond = double(Results.Latency.GetTotalCount()) / Results.ElapsedSeconds;
+	std::map<std::string, double> Measured;
+	Measured["rps"] = RequestsPerSecond;
+	Measured["p50_us"] = Results.Latency.ValueAtPercentile(50.0) / 1000.0;
+	Measured["p95_us"] = Results.Latency.ValueAtPercentile(95.0) / 1000.0;
+	Measured["p99_us"] = Results.Latency.ValueAtPercentile(99.0) / 1000.0;
+	Measured["p999_us"] = Results.Latency.ValueAtPercentile(99.9) / 1000.0;
+	Measured["max_us"] = Results.Latency.GetMax() / 1000.0;
+
+	std::printf("\n%-12s %12" PRIu64 "\n", "requests", Results.Latency.GetTotalCount());
+	std::printf("%-12s %12.3f s\n", "elapsed", Results.ElapsedSeconds);
+	std::printf("%-12s %12.1f req/s\n", "throughput", RequestsPerSecond);
+	std::printf("%-12s %12.1f us\n", "min", Results.Latency.GetMin() / 1000.0);
+	for (const char* Key : {"p50_us", "p95_us", "p99_us", "p999_us", "max_us"})
+	{
+		std::printf("%-12s %12.1f us\n", std::string(Key).substr(0, std::strlen(Key) - 3).c_str(), Measured[Key]);
+	}
+	for (const auto& Pair : Results.StatusCounts)
+	{
+		std::printf("status %-5d %12" PRIu64 "\n", Pair.first, Pair.second);
+	}
+
+	bool bPassed = true;
+	auto Fail = [&bPassed](const char* What, double Actual, double Limit)
+	{
+		std::fprintf(stderr, "FAIL: %s is %.1f, limit is %.1f\n", What, Actual, Limit);
+		bPassed = false;
+	};
+
+	if (Results.Errors > 0 && !Options.bAllowErrors)
+	{
+		std::fprintf(stderr, "FAIL: %" PRIu64 " request(s) did not succeed\n", Results.Errors);
+		bPassed = false;
+	}
+	if (Options.MaxP50Us > 0.0 && Measured["p50_us"] > Options.MaxP50Us)
+		Fail("p50 latency (us)", Measured["p50_us"], Options.MaxP50Us);
+	if (Options.MaxP95Us > 0.0 && Measured["p95_us"] > Options.MaxP95Us)
+		Fail("p95 latency (us)", Measured["p95_us"], Options.MaxP95Us);
+	if (Options.MaxP99Us > 0.0 && Measured["p99_us"] > Options.MaxP99Us)
+		Fail("p99 latency (us)", Measured["p99_us"], Options.MaxP99Us);
+	if (Options.MaxUs > 0.0 && Measured["max_us"] > Options.MaxUs)
+		Fail("max latency (us)", Measured["max_us"], Options.MaxUs);
+	if (Options.MinRequestsPerSecond > 0.0 && RequestsPerSecond < Options.MinRequestsPerSecond)
+		Fail("throughput (req/s)", RequestsPerSecond, Options.MinRequestsPerSecond);
+
+	if (!Options.BaselineFile.empty())
+	{
+		const std::map<std::string, double> Baseline = ReadBaseline(Options.BaselineFile);
+		if (Baseline.empty())
+		{
+			std::fprintf(stderr, "FAIL: unable to read baseline from %s\n", Options.BaselineFile.c_str());
+			bPassed = false;
+		}
+		for (const auto& Pair : Baseline)
+		{
+			const auto Current = Measured.find(Pair.first);
+			if (Current == Measured.end())
+			{
+				continue;
+			}
+
+			// Throughput regresses by going down, latencies regress by going up
+			if (Pair.first == "rps")
+			{
+				const double Limit = Pair.second * (1.0 - Options.Tolerance);
+				if (Current->second < Limit)
+					Fail("throughput vs. baseline (req/s)", Current->second, Limit);
+			}
+			else if (Pair.first != "max_us")
+			{
+				const double Limit = Pair.second * (1.0 + Options.Tolerance);
+				if (Current->second > Limit)
+					Fail((Pair.first + " vs. baseline").c_str(), Current->second, Limit);
+			}
+		}
+	}
+
+	if (!Options.WriteBaselineFile.empty())
+	{
+		std::ofstream File(Options.WriteBaselineFile);
+		for (const auto& Pair : Measured)
+		{
+			File << Pair.first << ' ' << Pair.second << '\n';
+		}
+		std::printf("Wrote baseline to %s\n", Options.WriteBaselineFile.c_str());
+	}
+
+	return bPassed ? 0 : 1;
+}